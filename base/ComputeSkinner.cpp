@@ -0,0 +1,345 @@
+/*
+* Compute shader skinning and morph target blending of animated meshes into cached vertex buffers
+*
+* This code is licensed under the MIT license(MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "ComputeSkinner.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace vks
+{
+	ComputeSkinner::Settings ComputeSkinner::settings;
+
+	namespace
+	{
+		struct PushConstants {
+			uint32_t firstVertex;
+			uint32_t vertexCount;
+			uint32_t targetVertex;
+			// In floats
+			uint32_t vertexStride;
+			uint32_t jointOffset;
+			uint32_t morphVertexOffset;
+			uint32_t morphWeightOffset;
+			// Skinning reads positions and normals from the target, as they have been morphed
+			uint32_t readTarget;
+		};
+
+		const uint32_t workGroupSize = 64;
+
+		std::vector<char> readShader(const std::string& filename)
+		{
+			std::vector<char> shaderCode;
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+			AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
+			if (asset) {
+				shaderCode.resize(AAsset_getLength(asset));
+				AAsset_read(asset, shaderCode.data(), shaderCode.size());
+				AAsset_close(asset);
+			}
+#else
+			std::ifstream is(filename, std::ios::binary | std::ios::in | std::ios::ate);
+			if (is.is_open()) {
+				shaderCode.resize(static_cast<size_t>(is.tellg()));
+				is.seekg(0, std::ios::beg);
+				is.read(shaderCode.data(), shaderCode.size());
+			}
+#endif
+			return shaderCode;
+		}
+	}
+
+	void ComputeSkinner::prepare(vks::VulkanDevice* device, VkQueue queue, const std::string& shaderDirectory, vks::JointPalette* jointPalette, uint32_t frameCount)
+	{
+		this->device = device;
+		this->queue = queue;
+		this->jointPalette = jointPalette;
+		targets.resize(frameCount);
+
+		std::vector<char> skinningCode;
+		if (settings.enabled) {
+			skinningCode = readShader(shaderDirectory + "skinning.comp.spv");
+			if (skinningCode.empty()) {
+				std::cout << "Skinning shader skinning.comp.spv not found, falling back to vertex shader skinning" << std::endl;
+			}
+		}
+		std::vector<char> morphCode = readShader(shaderDirectory + "morph.comp.spv");
+		if (morphCode.empty()) {
+			std::cout << "Morph target shader morph.comp.spv not found, morph targets will be ignored" << std::endl;
+		}
+		if (skinningCode.empty() && morphCode.empty()) {
+			return;
+		}
+
+		// Binding 0: Source vertices, binding 1: Deformed target vertices, binding 2: Joint palette
+		// Binding 3: Per vertex delta ranges, binding 4: Morph target deltas, binding 5: Morph weights
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings;
+		for (uint32_t b = 0; b < 6; b++) {
+			setLayoutBindings.push_back({ b, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr });
+		}
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI{};
+		descriptorSetLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		descriptorSetLayoutCI.pBindings = setLayoutBindings.data();
+		descriptorSetLayoutCI.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
+
+		VkPushConstantRange pushConstantRange{ VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants) };
+		VkPipelineLayoutCreateInfo pipelineLayoutCI{};
+		pipelineLayoutCI.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutCI.setLayoutCount = 1;
+		pipelineLayoutCI.pSetLayouts = &descriptorSetLayout;
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		VkDescriptorPoolSize poolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, static_cast<uint32_t>(setLayoutBindings.size()) * frameCount };
+		VkDescriptorPoolCreateInfo descriptorPoolCI{};
+		descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		descriptorPoolCI.poolSizeCount = 1;
+		descriptorPoolCI.pPoolSizes = &poolSize;
+		descriptorPoolCI.maxSets = frameCount;
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+		for (auto& target : targets) {
+			VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
+			descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+			descriptorSetAllocInfo.descriptorPool = descriptorPool;
+			descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayout;
+			descriptorSetAllocInfo.descriptorSetCount = 1;
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &target.descriptorSet));
+		}
+
+		if (!skinningCode.empty()) {
+			pipeline = createPipeline(skinningCode);
+		}
+		if (!morphCode.empty()) {
+			morphPipeline = createPipeline(morphCode);
+		}
+	}
+
+	VkPipeline ComputeSkinner::createPipeline(const std::vector<char>& shaderCode)
+	{
+		VkShaderModuleCreateInfo moduleCreateInfo{};
+		moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleCreateInfo.codeSize = shaderCode.size();
+		moduleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(shaderCode.data());
+		VkShaderModule shaderModule;
+		VK_CHECK_RESULT(vkCreateShaderModule(device->logicalDevice, &moduleCreateInfo, nullptr, &shaderModule));
+		VkComputePipelineCreateInfo pipelineCI{};
+		pipelineCI.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineCI.layout = pipelineLayout;
+		pipelineCI.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineCI.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineCI.stage.module = shaderModule;
+		pipelineCI.stage.pName = "main";
+		// Joint layout of the palette
+		VkBool32 dualQuaternions = vks::JointPalette::settings.dualQuaternions;
+		VkSpecializationMapEntry specializationEntry{ 0, 0, sizeof(VkBool32) };
+		VkSpecializationInfo specializationInfo{ 1, &specializationEntry, sizeof(VkBool32), &dualQuaternions };
+		pipelineCI.stage.pSpecializationInfo = &specializationInfo;
+		VkPipeline computePipeline;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &computePipeline));
+		vkDestroyShaderModule(device->logicalDevice, shaderModule, nullptr);
+		return computePipeline;
+	}
+
+	void ComputeSkinner::destroyTargets()
+	{
+		for (auto& target : targets) {
+			if (target.buffer != VK_NULL_HANDLE) {
+				vkDestroyBuffer(device->logicalDevice, target.buffer, nullptr);
+				vkFreeMemory(device->logicalDevice, target.memory, nullptr);
+				target.buffer = VK_NULL_HANDLE;
+				target.memory = VK_NULL_HANDLE;
+			}
+			if (target.weights != VK_NULL_HANDLE) {
+				vkUnmapMemory(device->logicalDevice, target.weightsMemory);
+				vkDestroyBuffer(device->logicalDevice, target.weights, nullptr);
+				vkFreeMemory(device->logicalDevice, target.weightsMemory, nullptr);
+				target.weights = VK_NULL_HANDLE;
+				target.weightsMemory = VK_NULL_HANDLE;
+				target.weightsMapped = nullptr;
+			}
+		}
+		for (auto buffer : { &vertexDeltas, &deltas }) {
+			if (buffer->buffer != VK_NULL_HANDLE) {
+				vkDestroyBuffer(device->logicalDevice, buffer->buffer, nullptr);
+				vkFreeMemory(device->logicalDevice, buffer->memory, nullptr);
+				*buffer = StaticBuffer();
+			}
+		}
+		jobs.clear();
+		weightCount = 0;
+	}
+
+	void ComputeSkinner::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		destroyTargets();
+		targets.clear();
+		for (auto computePipeline : { &pipeline, &morphPipeline }) {
+			if (*computePipeline != VK_NULL_HANDLE) {
+				vkDestroyPipeline(device->logicalDevice, *computePipeline, nullptr);
+				*computePipeline = VK_NULL_HANDLE;
+			}
+		}
+		if (descriptorPool != VK_NULL_HANDLE) {
+			vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+			vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+			descriptorPool = VK_NULL_HANDLE;
+		}
+		device = nullptr;
+	}
+
+	void ComputeSkinner::uploadStatic(VkCommandBuffer copyCmd, const void* data, VkDeviceSize size, StaticBuffer& target, std::vector<StaticBuffer>& stagingBuffers)
+	{
+		StaticBuffer staging;
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, size, &staging.buffer, &staging.memory, const_cast<void*>(data)));
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, size, &target.buffer, &target.memory));
+		VkBufferCopy copyRegion{ 0, 0, size };
+		vkCmdCopyBuffer(copyCmd, staging.buffer, target.buffer, 1, &copyRegion);
+		stagingBuffers.push_back(staging);
+	}
+
+	void ComputeSkinner::setSource(VkBuffer vertexBuffer, uint32_t vertexStride, const std::vector<Job>& jobs, const MorphTargets& morphTargets)
+	{
+		destroyTargets();
+		if (jobs.empty() || ((pipeline == VK_NULL_HANDLE) && (morphPipeline == VK_NULL_HANDLE))) {
+			return;
+		}
+		this->jobs = jobs;
+		this->vertexStride = vertexStride;
+
+		uint32_t targetVertexCount = 0;
+		bool morphed = false;
+		std::vector<VkBufferCopy> copyRegions;
+		for (auto& job : this->jobs) {
+			targetVertexCount = std::max(targetVertexCount, job.targetVertex + job.vertexCount);
+			morphed |= (job.morphTargetCount > 0);
+			copyRegions.push_back({ static_cast<VkDeviceSize>(job.firstVertex) * vertexStride, static_cast<VkDeviceSize>(job.targetVertex) * vertexStride, static_cast<VkDeviceSize>(job.vertexCount) * vertexStride });
+		}
+		const VkDeviceSize bufferSize = static_cast<VkDeviceSize>(targetVertexCount) * vertexStride;
+
+		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		for (auto& target : targets) {
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, bufferSize, &target.buffer, &target.memory));
+			vkCmdCopyBuffer(copyCmd, vertexBuffer, target.buffer, static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+		}
+		std::vector<StaticBuffer> stagingBuffers;
+		if (morphed) {
+			uploadStatic(copyCmd, morphTargets.vertexDeltas.data(), morphTargets.vertexDeltas.size() * sizeof(uint32_t), vertexDeltas, stagingBuffers);
+			uploadStatic(copyCmd, morphTargets.deltas.data(), morphTargets.deltas.size() * sizeof(MorphDelta), deltas, stagingBuffers);
+			weightCount = static_cast<uint32_t>(morphTargets.weights.size());
+			for (auto& target : targets) {
+				VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, weightCount * sizeof(float), &target.weights, &target.weightsMemory, const_cast<float*>(morphTargets.weights.data())));
+				VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, target.weightsMemory, 0, VK_WHOLE_SIZE, 0, &target.weightsMapped));
+			}
+		}
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+		vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		device->flushCommandBuffer(copyCmd, queue, true);
+		for (auto& staging : stagingBuffers) {
+			vkDestroyBuffer(device->logicalDevice, staging.buffer, nullptr);
+			vkFreeMemory(device->logicalDevice, staging.memory, nullptr);
+		}
+
+		for (uint32_t i = 0; i < targets.size(); i++) {
+			VkDescriptorBufferInfo sourceDescriptor{ vertexBuffer, 0, VK_WHOLE_SIZE };
+			VkDescriptorBufferInfo targetDescriptor{ targets[i].buffer, 0, VK_WHOLE_SIZE };
+			VkDescriptorBufferInfo vertexDeltasDescriptor{ vertexDeltas.buffer, 0, VK_WHOLE_SIZE };
+			VkDescriptorBufferInfo deltasDescriptor{ deltas.buffer, 0, VK_WHOLE_SIZE };
+			VkDescriptorBufferInfo weightsDescriptor{ targets[i].weights, 0, VK_WHOLE_SIZE };
+			// Bindings that aren't used by any of the dispatches are left empty
+			const VkDescriptorBufferInfo* bufferInfos[6] = { &sourceDescriptor, &targetDescriptor, isAvailable() ? jointPalette->getDescriptor(i) : nullptr, &vertexDeltasDescriptor, &deltasDescriptor, &weightsDescriptor };
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+			for (uint32_t b = 0; b < 6; b++) {
+				if (!bufferInfos[b] || bufferInfos[b]->buffer == VK_NULL_HANDLE) {
+					continue;
+				}
+				VkWriteDescriptorSet writeDescriptorSet{};
+				writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				writeDescriptorSet.descriptorCount = 1;
+				writeDescriptorSet.dstSet = targets[i].descriptorSet;
+				writeDescriptorSet.dstBinding = b;
+				writeDescriptorSet.pBufferInfo = bufferInfos[b];
+				writeDescriptorSets.push_back(writeDescriptorSet);
+			}
+			vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
+	}
+
+	void ComputeSkinner::updateWeights(uint32_t frameIndex, const std::vector<float>& weights)
+	{
+		if (targets.empty() || !targets[frameIndex].weightsMapped) {
+			return;
+		}
+		memcpy(targets[frameIndex].weightsMapped, weights.data(), std::min(static_cast<uint32_t>(weights.size()), weightCount) * sizeof(float));
+	}
+
+	void ComputeSkinner::record(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+	{
+		if (jobs.empty()) {
+			return;
+		}
+		// The frame's previous draws from the target have finished, as its fence has been waited on before recording
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &targets[frameIndex].descriptorSet, 0, nullptr);
+		const uint32_t stride = vertexStride / static_cast<uint32_t>(sizeof(float));
+
+		// Morph targets are blended first, skinning then deforms the morphed vertices in place
+		bool morphed = false;
+		bool skinned = false;
+		for (auto& job : jobs) {
+			skinned |= job.skin;
+			if (job.morphTargetCount == 0) {
+				continue;
+			}
+			if (!morphed) {
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, morphPipeline);
+				morphed = true;
+			}
+			PushConstants pushConstants{ job.firstVertex, job.vertexCount, job.targetVertex, stride, job.jointOffset, job.morphVertexOffset, job.morphWeightOffset, 0 };
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+			vkCmdDispatch(commandBuffer, (job.vertexCount + workGroupSize - 1) / workGroupSize, 1, 1);
+		}
+
+		if (skinned) {
+			if (morphed) {
+				VkMemoryBarrier barrier{};
+				barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+				barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+			}
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+			for (auto& job : jobs) {
+				if (!job.skin) {
+					continue;
+				}
+				PushConstants pushConstants{ job.firstVertex, job.vertexCount, job.targetVertex, stride, job.jointOffset, job.morphVertexOffset, job.morphWeightOffset, job.morphTargetCount > 0 ? 1u : 0u };
+				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+				vkCmdDispatch(commandBuffer, (job.vertexCount + workGroupSize - 1) / workGroupSize, 1, 1);
+			}
+		}
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = targets[frameIndex].buffer;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+	}
+}
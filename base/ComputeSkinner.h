@@ -0,0 +1,137 @@
+/*
+* Compute shader skinning and morph target blending of animated meshes into cached vertex buffers
+*
+* Each skinned mesh is skinned once per frame with the joint palette into a per frame target buffer
+* All passes drawing the mesh read the skinned positions and normals from that buffer like static geometry, so the vertex shader doesn't need to blend joint matrices
+* Morph targets are stored as sparse per vertex delta lists and blended into the target before skinning, deltas of targets with a zero weight are skipped
+*
+* This code is licensed under the MIT license(MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.hpp"
+#include "JointPalette.h"
+
+namespace vks
+{
+	class ComputeSkinner
+	{
+	public:
+		struct Settings {
+			// Skin meshes with a compute pre-pass instead of in the vertex shader
+			bool enabled = false;
+		};
+		static Settings settings;
+
+		// Vertex range of a skinned and/or morphed mesh, deformed into the target buffer starting at targetVertex
+		struct Job {
+			uint32_t firstVertex;
+			uint32_t vertexCount;
+			uint32_t targetVertex;
+			// Skin the mesh with the palette range starting at jointOffset
+			bool skin;
+			uint32_t jointOffset;
+			// Number of morph targets, zero if the mesh isn't morphed
+			uint32_t morphTargetCount;
+			// First entry of the mesh in MorphTargets::vertexDeltas
+			uint32_t morphVertexOffset;
+			// First weight of the node in MorphTargets::weights
+			uint32_t morphWeightOffset;
+		};
+
+		// Position and normal offset of a vertex for one morph target (two vec4 in the shader, the target index is stored in the first w component)
+		struct MorphDelta {
+			glm::vec3 position;
+			uint32_t target;
+			glm::vec3 normal;
+			float padding = 0.0f;
+		};
+
+		// Sparse morph target deltas of all morphed meshes of a model
+		struct MorphTargets {
+			// Per mesh, the index of each vertex' first delta and one past the last vertex' deltas
+			std::vector<uint32_t> vertexDeltas;
+			// Non-zero deltas, ordered by vertex
+			std::vector<MorphDelta> deltas;
+			// Current weights of all morphed meshes, written by the animation update
+			std::vector<float> weights;
+		};
+
+	private:
+		struct FrameTarget {
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			// Morph weights, host visible as they change every frame
+			VkBuffer weights = VK_NULL_HANDLE;
+			VkDeviceMemory weightsMemory = VK_NULL_HANDLE;
+			void* weightsMapped = nullptr;
+		};
+
+		struct StaticBuffer {
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		VkQueue queue = VK_NULL_HANDLE;
+		vks::JointPalette* jointPalette = nullptr;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VkPipeline morphPipeline = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		std::vector<FrameTarget> targets;
+		StaticBuffer vertexDeltas;
+		StaticBuffer deltas;
+		std::vector<Job> jobs;
+		uint32_t vertexStride = 0;
+		uint32_t weightCount = 0;
+
+		void destroyTargets();
+		VkPipeline createPipeline(const std::vector<char>& shaderCode);
+		void uploadStatic(VkCommandBuffer copyCmd, const void* data, VkDeviceSize size, StaticBuffer& target, std::vector<StaticBuffer>& stagingBuffers);
+
+	public:
+		/**
+		* Create the morph pipeline, the skinning pipeline if compute skinning is enabled in the settings and one target per frame in flight
+		*
+		* @param shaderDirectory Directory containing skinning.comp.spv and morph.comp.spv, if skinning.comp.spv is missing meshes are skinned in the vertex shader, without morph.comp.spv morph targets are ignored
+		*/
+		void prepare(vks::VulkanDevice* device, VkQueue queue, const std::string& shaderDirectory, vks::JointPalette* jointPalette, uint32_t frameCount);
+		void destroy();
+
+		// Compute skinning is enabled and the shader is available
+		bool isAvailable() const { return settings.enabled && (pipeline != VK_NULL_HANDLE); }
+		// Morph targets can be blended
+		bool isMorphAvailable() const { return morphPipeline != VK_NULL_HANDLE; }
+
+		/**
+		* Create the target buffers for the skinned and morphed meshes of a vertex buffer
+		*
+		* Vertices that aren't written by the shaders (uvs, colors, etc.) are copied to the targets once
+		*
+		* @param vertexBuffer Source vertex buffer, needs storage and transfer source usage
+		* @param vertexStride Size of a vertex in bytes, attributes are expected in the layout of vkglTF::Model::Vertex
+		* @param jobs Meshes to deform, jobs may only skin if isAvailable() and only morph if isMorphAvailable()
+		* @param morphTargets Delta lists referenced by the jobs, the weights only determine the size of the per frame weight buffers
+		* @note Has to be called while the device is idle and after the joint palette's buffers have been allocated, an empty job list releases the targets
+		*/
+		void setSource(VkBuffer vertexBuffer, uint32_t vertexStride, const std::vector<Job>& jobs, const MorphTargets& morphTargets);
+
+		// Copy the current morph weights to a frame's buffer, call after waiting for the frame's fence
+		void updateWeights(uint32_t frameIndex, const std::vector<float>& weights);
+
+		// Record the dispatches of a frame, has to be recorded outside of a render pass before the deformed meshes are drawn
+		void record(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+		bool hasJobs() const { return !jobs.empty(); }
+		VkBuffer getTargetBuffer(uint32_t frameIndex) const { return targets[frameIndex].buffer; }
+	};
+}
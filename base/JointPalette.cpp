@@ -0,0 +1,134 @@
+/*
+* Joint matrices of all skinned meshes in one storage buffer per frame in flight
+*
+* This code is licensed under the MIT license(MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "JointPalette.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include <glm/gtc/quaternion.hpp>
+
+namespace vks
+{
+	JointPalette::Settings JointPalette::settings;
+
+	void JointPalette::prepare(vks::VulkanDevice* device, uint32_t frameCount)
+	{
+		assert(frameCount < 32);
+		this->device = device;
+		buffers.resize(frameCount);
+		allocateBuffers();
+	}
+
+	void JointPalette::destroyBuffers()
+	{
+		for (auto& frame : buffers) {
+			if (frame.buffer != VK_NULL_HANDLE) {
+				vkUnmapMemory(device->logicalDevice, frame.memory);
+				vkDestroyBuffer(device->logicalDevice, frame.buffer, nullptr);
+				vkFreeMemory(device->logicalDevice, frame.memory, nullptr);
+				frame = FrameBuffer{};
+			}
+		}
+		capacity = 0;
+	}
+
+	void JointPalette::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		destroyBuffers();
+		buffers.clear();
+		ranges.clear();
+		matrices.clear();
+		dualQuaternions.clear();
+		device = nullptr;
+	}
+
+	int32_t JointPalette::allocate(uint32_t count)
+	{
+		Range range{};
+		range.offset = static_cast<uint32_t>(matrices.size());
+		range.count = count;
+		range.used = true;
+		range.dirtyFrames = (1u << buffers.size()) - 1;
+		ranges.push_back(range);
+		matrices.resize(matrices.size() + count, glm::mat4(1.0f));
+		if (settings.dualQuaternions) {
+			// Identity rotation without translation
+			for (uint32_t i = 0; i < count; i++) {
+				dualQuaternions.push_back(glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+				dualQuaternions.push_back(glm::vec4(0.0f));
+			}
+		}
+		return static_cast<int32_t>(ranges.size()) - 1;
+	}
+
+	// Models free all of their ranges when they are destroyed, so releasing trailing ranges keeps the palette compact when scenes are reloaded
+	void JointPalette::free(int32_t range)
+	{
+		ranges[range].used = false;
+		while (!ranges.empty() && !ranges.back().used) {
+			ranges.pop_back();
+		}
+		matrices.resize(ranges.empty() ? 0 : ranges.back().offset + ranges.back().count);
+		dualQuaternions.resize(settings.dualQuaternions ? matrices.size() * 2 : 0);
+	}
+
+	void JointPalette::allocateBuffers()
+	{
+		const uint32_t required = std::max(1u, static_cast<uint32_t>(matrices.size()));
+		const VkDeviceSize requiredElementSize = settings.dualQuaternions ? 2 * sizeof(glm::vec4) : sizeof(glm::mat4);
+		if ((required <= capacity) && (requiredElementSize == elementSize)) {
+			return;
+		}
+		destroyBuffers();
+		// Grow in steps, so loading a slightly larger rig doesn't recreate the buffers again
+		capacity = std::max(required, 1024u);
+		elementSize = requiredElementSize;
+		const VkDeviceSize bufferSize = capacity * elementSize;
+		for (auto& frame : buffers) {
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, bufferSize, &frame.buffer, &frame.memory));
+			VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, frame.memory, 0, bufferSize, 0, &frame.mapped));
+			frame.descriptor = { frame.buffer, 0, bufferSize };
+		}
+		// New buffers have none of the current matrices
+		for (auto& range : ranges) {
+			range.dirtyFrames = (1u << buffers.size()) - 1;
+		}
+	}
+
+	void JointPalette::update(uint32_t frameIndex)
+	{
+		FrameBuffer& frame = buffers[frameIndex];
+		const uint32_t frameBit = 1u << frameIndex;
+		for (auto& range : ranges) {
+			if (range.used && (range.dirtyFrames & frameBit)) {
+				assert(range.offset + range.count <= capacity);
+				const void* source = settings.dualQuaternions ? static_cast<const void*>(&dualQuaternions[range.offset * 2]) : static_cast<const void*>(&matrices[range.offset]);
+				memcpy(static_cast<uint8_t*>(frame.mapped) + range.offset * elementSize, source, range.count * elementSize);
+				range.dirtyFrames &= ~frameBit;
+			}
+		}
+	}
+
+	void JointPalette::encodeDualQuaternion(const glm::mat4& matrix, glm::vec4* dualQuaternion)
+	{
+		// Remove scale before extracting the rotation
+		const glm::mat3 rotation(glm::normalize(glm::vec3(matrix[0])), glm::normalize(glm::vec3(matrix[1])), glm::normalize(glm::vec3(matrix[2])));
+		const glm::quat q = glm::quat_cast(rotation);
+		const glm::vec3 t(matrix[3]);
+		dualQuaternion[0] = glm::vec4(q.x, q.y, q.z, q.w);
+		// Dual part is 0.5 * t * q with t as a pure quaternion
+		dualQuaternion[1] = 0.5f * glm::vec4(
+			q.w * t.x + t.y * q.z - t.z * q.y,
+			q.w * t.y + t.z * q.x - t.x * q.z,
+			q.w * t.z + t.x * q.y - t.y * q.x,
+			-(t.x * q.x + t.y * q.y + t.z * q.z));
+	}
+}
@@ -0,0 +1,97 @@
+/*
+* Joint matrices of all skinned meshes in one storage buffer per frame in flight
+*
+* Each skinned mesh allocates a range of the palette and passes its offset to the vertex shader, so rigs aren't limited to a fixed number of joints
+* Matrices are written to system memory and update() copies the ranges that changed since a frame's buffer was last updated
+* With dual quaternion skinning, joints are uploaded as a real and a dual part (two vec4) instead of a matrix
+*
+* This code is licensed under the MIT license(MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	class JointPalette
+	{
+	public:
+		struct Settings {
+			// Upload joints as dual quaternions, has to be set before ranges are allocated
+			bool dualQuaternions = false;
+		};
+		static Settings settings;
+
+	private:
+		struct Range {
+			uint32_t offset = 0;
+			uint32_t count = 0;
+			bool used = false;
+			// One bit per frame whose buffer doesn't contain the range's current matrices yet
+			uint32_t dirtyFrames = 0;
+		};
+
+		struct FrameBuffer {
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			void* mapped = nullptr;
+			VkDescriptorBufferInfo descriptor;
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		std::vector<Range> ranges;
+		std::vector<FrameBuffer> buffers;
+		// Capacity of the buffers in joints
+		uint32_t capacity = 0;
+		VkDeviceSize elementSize = 0;
+
+		void destroyBuffers();
+
+	public:
+		// Current joint matrices, ranges are written by the models that allocated them
+		std::vector<glm::mat4> matrices;
+		// Real and dual part of each joint if dual quaternions are enabled, written with encodeDualQuaternion
+		std::vector<glm::vec4> dualQuaternions;
+
+		/**
+		* Create the per frame buffers, these are also required without skinned meshes as the vertex shader always references them
+		*
+		* @param frameCount Number of frames that can be in flight (less than 32), each one gets its own buffer
+		*/
+		void prepare(vks::VulkanDevice* device, uint32_t frameCount);
+		void destroy();
+
+		// Allocate a range of matrices, returns the range's handle
+		int32_t allocate(uint32_t count);
+		void free(int32_t range);
+		uint32_t getOffset(int32_t range) const { return ranges[range].offset; }
+
+		// Mark the matrices of a range as changed, ranges can be marked from different threads
+		void markDirty(int32_t range) { ranges[range].dirtyFrames = (1u << buffers.size()) - 1; }
+
+		/**
+		* Recreate the buffers if the allocated ranges don't fit into them anymore
+		*
+		* @note Has to be called while the device is idle (e.g. after loading a scene), descriptors referencing the buffers need to be updated afterwards
+		*/
+		void allocateBuffers();
+
+		// Copy changed ranges to a frame's buffer, call after waiting for the frame's fence
+		void update(uint32_t frameIndex);
+
+		// Convert a rigid joint matrix into a unit dual quaternion (real and dual part), scale is discarded
+		static void encodeDualQuaternion(const glm::mat4& matrix, glm::vec4* dualQuaternion);
+
+		VkDescriptorBufferInfo* getDescriptor(uint32_t frameIndex) { return &buffers[frameIndex].descriptor; }
+		uint32_t getMatrixCount() const { return static_cast<uint32_t>(matrices.size()); }
+	};
+}
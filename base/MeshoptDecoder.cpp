@@ -0,0 +1,628 @@
+/**
+ * Decoder for EXT_meshopt_compression buffer views
+ *
+ * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+ */
+
+#include "MeshoptDecoder.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MESHOPT_SSE2
+#include <emmintrin.h>
+#if defined(__SSSE3__)
+#define MESHOPT_SSSE3
+#include <tmmintrin.h>
+#endif
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && defined(__aarch64__)
+#define MESHOPT_NEON
+#include <arm_neon.h>
+#endif
+
+namespace meshopt
+{
+	namespace
+	{
+		const uint8_t vertexHeader = 0xa0;
+		const uint8_t indexHeader = 0xe0;
+		const uint8_t sequenceHeader = 0xd0;
+
+		const size_t vertexBlockSizeBytes = 8192;
+		const size_t vertexBlockMaxSize = 256;
+		const size_t byteGroupSize = 16;
+		const size_t byteGroupDecodeLimit = 24;
+		const size_t tailMaxSize = 32;
+
+		size_t getVertexBlockSize(size_t vertexSize)
+		{
+			// Blocks must fit into the scratch buffer and are aligned to the byte group size
+			size_t result = vertexBlockSizeBytes / vertexSize;
+			result &= ~(byteGroupSize - 1);
+			return (result < vertexBlockMaxSize) ? result : vertexBlockMaxSize;
+		}
+
+		inline uint8_t unzigzag8(uint8_t v)
+		{
+			return static_cast<uint8_t>(-(v & 1) ^ (v >> 1));
+		}
+
+#if defined(MESHOPT_SSSE3) || defined(MESHOPT_NEON)
+		// For each 8 bit mask of bytes stored in full after the selectors: the shuffle gathering them (0x80 for bytes taken from the selectors) and their count
+		struct ByteGroupTables {
+			uint8_t shuffle[256][8];
+			uint8_t count[256];
+			ByteGroupTables()
+			{
+				for (int mask = 0; mask < 256; mask++) {
+					uint8_t count = 0;
+					for (int i = 0; i < 8; i++) {
+						const bool full = (mask >> i) & 1;
+						shuffle[mask][i] = full ? count : 0x80;
+						count += full ? 1 : 0;
+					}
+					this->count[mask] = count;
+				}
+			}
+		};
+		const ByteGroupTables byteGroupTables;
+#endif
+
+		// The SIMD versions may read up to byteGroupDecodeLimit bytes, decodeBytes checks that these are available
+		const uint8_t* decodeBytesGroup(const uint8_t* data, uint8_t* buffer, int bitslog2)
+		{
+#if defined(MESHOPT_SSSE3)
+			switch (bitslog2) {
+			case 0:
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(buffer), _mm_setzero_si128());
+				return data;
+			case 1:
+			case 2: {
+				// Spread the 2 or 4 bit selectors to one byte each, highest bits first
+				__m128i sel;
+				if (bitslog2 == 1) {
+					int selectors;
+					memcpy(&selectors, data, 4);
+					const __m128i sel2 = _mm_cvtsi32_si128(selectors);
+					const __m128i sel22 = _mm_unpacklo_epi8(_mm_srli_epi16(sel2, 4), sel2);
+					const __m128i sel2222 = _mm_unpacklo_epi8(_mm_srli_epi16(sel22, 2), sel22);
+					sel = _mm_and_si128(sel2222, _mm_set1_epi8(3));
+				} else {
+					const __m128i sel4 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(data));
+					const __m128i sel44 = _mm_unpacklo_epi8(_mm_srli_epi16(sel4, 4), sel4);
+					sel = _mm_and_si128(sel44, _mm_set1_epi8(15));
+				}
+				const uint8_t* rest = data + (4 << (bitslog2 - 1));
+				// Selectors with all bits set are replaced by the next byte stored in full
+				const __m128i full = _mm_cmpeq_epi8(sel, _mm_set1_epi8(static_cast<char>((1 << (1 << bitslog2)) - 1)));
+				const int fullMask = _mm_movemask_epi8(full);
+				const uint8_t mask0 = static_cast<uint8_t>(fullMask & 255);
+				const uint8_t mask1 = static_cast<uint8_t>(fullMask >> 8);
+				const __m128i shuffle0 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(byteGroupTables.shuffle[mask0]));
+				const __m128i shuffle1 = _mm_add_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(byteGroupTables.shuffle[mask1])), _mm_set1_epi8(static_cast<char>(byteGroupTables.count[mask0])));
+				const __m128i values = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rest)), _mm_unpacklo_epi64(shuffle0, shuffle1));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(buffer), _mm_or_si128(values, _mm_andnot_si128(full, sel)));
+				return rest + byteGroupTables.count[mask0] + byteGroupTables.count[mask1];
+			}
+			default:
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(buffer), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)));
+				return data + byteGroupSize;
+			}
+#elif defined(MESHOPT_NEON)
+			switch (bitslog2) {
+			case 0:
+				vst1q_u8(buffer, vdupq_n_u8(0));
+				return data;
+			case 1:
+			case 2: {
+				uint8x16_t sel;
+				if (bitslog2 == 1) {
+					const uint8x8_t sel2 = vld1_u8(data);
+					const uint8x8_t sel22 = vzip_u8(vshr_n_u8(sel2, 4), sel2).val[0];
+					const uint8x8x2_t sel2222 = vzip_u8(vshr_n_u8(sel22, 2), sel22);
+					sel = vandq_u8(vcombine_u8(sel2222.val[0], sel2222.val[1]), vdupq_n_u8(3));
+				} else {
+					const uint8x8_t sel4 = vld1_u8(data);
+					const uint8x8x2_t sel44 = vzip_u8(vshr_n_u8(sel4, 4), vand_u8(sel4, vdup_n_u8(15)));
+					sel = vcombine_u8(sel44.val[0], sel44.val[1]);
+				}
+				const uint8_t* rest = data + (4 << (bitslog2 - 1));
+				const uint8x16_t full = vceqq_u8(sel, vdupq_n_u8(static_cast<uint8_t>((1 << (1 << bitslog2)) - 1)));
+				// One bit per byte of each half, like movemask
+				const uint8_t bitValues[8] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+				const uint8x8_t bits = vld1_u8(bitValues);
+				const uint8_t mask0 = vaddv_u8(vand_u8(vget_low_u8(full), bits));
+				const uint8_t mask1 = vaddv_u8(vand_u8(vget_high_u8(full), bits));
+				const uint8x8_t values0 = vtbl1_u8(vld1_u8(rest), vld1_u8(byteGroupTables.shuffle[mask0]));
+				const uint8x8_t values1 = vtbl1_u8(vld1_u8(rest + byteGroupTables.count[mask0]), vld1_u8(byteGroupTables.shuffle[mask1]));
+				vst1q_u8(buffer, vbslq_u8(full, vcombine_u8(values0, values1), sel));
+				return rest + byteGroupTables.count[mask0] + byteGroupTables.count[mask1];
+			}
+			default:
+				vst1q_u8(buffer, vld1q_u8(data));
+				return data + byteGroupSize;
+			}
+#else
+			uint8_t byte, enc, encv;
+			const uint8_t* dataVar;
+
+#define READ() byte = *data++
+#define NEXT(bits) enc = byte >> (8 - bits); byte <<= bits; encv = *dataVar; *buffer++ = (enc == (1 << bits) - 1) ? encv : enc; dataVar += (enc == (1 << bits) - 1)
+
+			switch (bitslog2) {
+			case 0:
+				memset(buffer, 0, byteGroupSize);
+				return data;
+			case 1:
+				dataVar = data + 4;
+				// 4 bytes with 4 2-bit values each, highest bits first
+				READ(); NEXT(2); NEXT(2); NEXT(2); NEXT(2);
+				READ(); NEXT(2); NEXT(2); NEXT(2); NEXT(2);
+				READ(); NEXT(2); NEXT(2); NEXT(2); NEXT(2);
+				READ(); NEXT(2); NEXT(2); NEXT(2); NEXT(2);
+				return dataVar;
+			case 2:
+				dataVar = data + 8;
+				// 8 bytes with 2 4-bit values each, highest bits first
+				READ(); NEXT(4); NEXT(4);
+				READ(); NEXT(4); NEXT(4);
+				READ(); NEXT(4); NEXT(4);
+				READ(); NEXT(4); NEXT(4);
+				READ(); NEXT(4); NEXT(4);
+				READ(); NEXT(4); NEXT(4);
+				READ(); NEXT(4); NEXT(4);
+				READ(); NEXT(4); NEXT(4);
+				return dataVar;
+			default:
+				memcpy(buffer, data, byteGroupSize);
+				return data + byteGroupSize;
+			}
+
+#undef READ
+#undef NEXT
+#endif
+		}
+
+		const uint8_t* decodeBytes(const uint8_t* data, const uint8_t* dataEnd, uint8_t* buffer, size_t bufferSize)
+		{
+			// Two header bits per byte group select the bit width of that group
+			const uint8_t* header = data;
+			size_t headerSize = (bufferSize / byteGroupSize + 3) / 4;
+			if (size_t(dataEnd - data) < headerSize) {
+				return nullptr;
+			}
+			data += headerSize;
+
+			for (size_t i = 0; i < bufferSize; i += byteGroupSize) {
+				if (size_t(dataEnd - data) < byteGroupDecodeLimit) {
+					return nullptr;
+				}
+				size_t headerOffset = i / byteGroupSize;
+				int bitslog2 = (header[headerOffset / 4] >> ((headerOffset % 4) * 2)) & 3;
+				data = decodeBytesGroup(data, buffer + i, bitslog2);
+			}
+			return data;
+		}
+
+		const uint8_t* decodeVertexBlock(const uint8_t* data, const uint8_t* dataEnd, uint8_t* vertexData, size_t vertexCount, size_t vertexSize, uint8_t lastVertex[256])
+		{
+			uint8_t buffer[vertexBlockMaxSize];
+			uint8_t transposed[vertexBlockSizeBytes];
+
+			size_t vertexCountAligned = (vertexCount + byteGroupSize - 1) & ~(byteGroupSize - 1);
+
+			// Every byte of the vertex is stored as a separate stream of zigzag encoded deltas
+			for (size_t k = 0; k < vertexSize; k++) {
+				data = decodeBytes(data, dataEnd, buffer, vertexCountAligned);
+				if (!data) {
+					return nullptr;
+				}
+				size_t vertexOffset = k;
+				uint8_t p = lastVertex[k];
+				for (size_t i = 0; i < vertexCount; i++) {
+					uint8_t v = static_cast<uint8_t>(unzigzag8(buffer[i]) + p);
+					transposed[vertexOffset] = v;
+					p = v;
+					vertexOffset += vertexSize;
+				}
+			}
+
+			memcpy(vertexData, transposed, vertexCount * vertexSize);
+			memcpy(lastVertex, &transposed[vertexSize * (vertexCount - 1)], vertexSize);
+			return data;
+		}
+
+		inline uint32_t decodeVByte(const uint8_t*& data)
+		{
+			uint8_t lead = *data++;
+			if (lead < 128) {
+				return lead;
+			}
+			uint32_t result = lead & 127;
+			uint32_t shift = 7;
+			for (int i = 0; i < 4; i++) {
+				uint8_t group = *data++;
+				result |= uint32_t(group & 127) << shift;
+				shift += 7;
+				if (group < 128) {
+					break;
+				}
+			}
+			return result;
+		}
+
+		inline uint32_t decodeIndex(const uint8_t*& data, uint32_t last)
+		{
+			uint32_t v = decodeVByte(data);
+			uint32_t d = (v >> 1) ^ -int32_t(v & 1);
+			return last + d;
+		}
+
+		inline void writeTriangle(void* destination, size_t offset, size_t indexSize, uint32_t a, uint32_t b, uint32_t c)
+		{
+			if (indexSize == 2) {
+				uint16_t* dst = static_cast<uint16_t*>(destination) + offset;
+				dst[0] = uint16_t(a);
+				dst[1] = uint16_t(b);
+				dst[2] = uint16_t(c);
+			} else {
+				uint32_t* dst = static_cast<uint32_t*>(destination) + offset;
+				dst[0] = a;
+				dst[1] = b;
+				dst[2] = c;
+			}
+		}
+
+		inline void pushEdgeFifo(uint32_t fifo[16][2], uint32_t a, uint32_t b, size_t& offset)
+		{
+			fifo[offset][0] = a;
+			fifo[offset][1] = b;
+			offset = (offset + 1) & 15;
+		}
+
+		inline void pushVertexFifo(uint32_t fifo[16], uint32_t v, size_t& offset, int cond = 1)
+		{
+			fifo[offset] = v;
+			offset = (offset + cond) & 15;
+		}
+
+		template <typename T>
+		void decodeFilterOctImpl(T* data, size_t count)
+		{
+			const float max = float((1 << (sizeof(T) * 8 - 1)) - 1);
+			for (size_t i = 0; i < count; i++) {
+				// x and y are stored, z is reconstructed from the fourth component that encodes 1.0 at the same precision
+				float x = float(data[i * 4 + 0]);
+				float y = float(data[i * 4 + 1]);
+				float z = float(data[i * 4 + 2]) - fabsf(x) - fabsf(y);
+				// Fix up octahedral coordinates for z < 0
+				float t = (z >= 0.f) ? 0.f : z;
+				x += (x >= 0.f) ? t : -t;
+				y += (y >= 0.f) ? t : -t;
+				float l = sqrtf(x * x + y * y + z * z);
+				float s = max / l;
+				data[i * 4 + 0] = T(int(x * s + (x >= 0.f ? 0.5f : -0.5f)));
+				data[i * 4 + 1] = T(int(y * s + (y >= 0.f ? 0.5f : -0.5f)));
+				data[i * 4 + 2] = T(int(z * s + (z >= 0.f ? 0.5f : -0.5f)));
+			}
+		}
+	}
+
+	int decodeVertexBuffer(void* destination, size_t vertexCount, size_t vertexSize, const uint8_t* buffer, size_t bufferSize)
+	{
+		if ((vertexSize == 0) || (vertexSize > 256) || (vertexSize % 4 != 0)) {
+			return -1;
+		}
+		uint8_t* vertexData = static_cast<uint8_t*>(destination);
+		const uint8_t* data = buffer;
+		const uint8_t* dataEnd = buffer + bufferSize;
+
+		if (size_t(dataEnd - data) < 1 + vertexSize) {
+			return -2;
+		}
+		uint8_t dataHeader = *data++;
+		if ((dataHeader & 0xf0) != vertexHeader) {
+			return -1;
+		}
+		int version = dataHeader & 0x0f;
+		if (version > 0) {
+			return -1;
+		}
+
+		// The first vertex of the stream is delta encoded against the tail
+		uint8_t lastVertex[256];
+		memcpy(lastVertex, dataEnd - vertexSize, vertexSize);
+
+		size_t vertexBlockSize = getVertexBlockSize(vertexSize);
+		size_t vertexOffset = 0;
+		while (vertexOffset < vertexCount) {
+			size_t blockSize = (vertexOffset + vertexBlockSize < vertexCount) ? vertexBlockSize : vertexCount - vertexOffset;
+			data = decodeVertexBlock(data, dataEnd, vertexData + vertexOffset * vertexSize, blockSize, vertexSize, lastVertex);
+			if (!data) {
+				return -2;
+			}
+			vertexOffset += blockSize;
+		}
+
+		size_t tailSize = vertexSize < tailMaxSize ? tailMaxSize : vertexSize;
+		if (size_t(dataEnd - data) != tailSize) {
+			return -3;
+		}
+		return 0;
+	}
+
+	int decodeIndexBuffer(void* destination, size_t indexCount, size_t indexSize, const uint8_t* buffer, size_t bufferSize)
+	{
+		if ((indexCount % 3 != 0) || ((indexSize != 2) && (indexSize != 4))) {
+			return -1;
+		}
+		// The minimum valid encoding is the header, one byte per triangle and the 16 byte codeaux table
+		if (bufferSize < 1 + indexCount / 3 + 16) {
+			return -2;
+		}
+		if ((buffer[0] & 0xf0) != indexHeader) {
+			return -1;
+		}
+		int version = buffer[0] & 0x0f;
+		if (version > 1) {
+			return -1;
+		}
+
+		uint32_t edgefifo[16][2];
+		uint32_t vertexfifo[16];
+		memset(edgefifo, -1, sizeof(edgefifo));
+		memset(vertexfifo, -1, sizeof(vertexfifo));
+		size_t edgefifooffset = 0;
+		size_t vertexfifooffset = 0;
+
+		uint32_t next = 0;
+		uint32_t last = 0;
+		int fecmax = version >= 1 ? 13 : 15;
+
+		const uint8_t* code = buffer + 1;
+		const uint8_t* data = code + indexCount / 3;
+		const uint8_t* dataSafeEnd = buffer + bufferSize - 16;
+		const uint8_t* codeauxTable = dataSafeEnd;
+
+		for (size_t i = 0; i < indexCount; i += 3) {
+			// Each triangle reads at most 16 bytes, so reads past this check don't need bounds checks
+			if (data > dataSafeEnd) {
+				return -2;
+			}
+			uint8_t codetri = *code++;
+
+			if (codetri < 0xf0) {
+				int fe = codetri >> 4;
+				uint32_t a = edgefifo[(edgefifooffset - 1 - fe) & 15][0];
+				uint32_t b = edgefifo[(edgefifooffset - 1 - fe) & 15][1];
+				int fec = codetri & 15;
+				if (fec < fecmax) {
+					uint32_t cf = vertexfifo[(vertexfifooffset - 1 - fec) & 15];
+					uint32_t c = (fec == 0) ? next : cf;
+					int fec0 = fec == 0;
+					next += fec0;
+					writeTriangle(destination, i, indexSize, a, b, c);
+					pushVertexFifo(vertexfifo, c, vertexfifooffset, fec0);
+					pushEdgeFifo(edgefifo, c, b, edgefifooffset);
+					pushEdgeFifo(edgefifo, a, c, edgefifooffset);
+				} else {
+					// fec - (fec ^ 3) decodes 13 and 14 into -1 and 1, free indices are delta encoded against the last one
+					uint32_t c = 0;
+					last = c = (fec != 15) ? last + (fec - (fec ^ 3)) : decodeIndex(data, last);
+					writeTriangle(destination, i, indexSize, a, b, c);
+					pushVertexFifo(vertexfifo, c, vertexfifooffset);
+					pushEdgeFifo(edgefifo, c, b, edgefifooffset);
+					pushEdgeFifo(edgefifo, a, c, edgefifooffset);
+				}
+			} else {
+				if (codetri < 0xfe) {
+					// Fast path: codeaux comes from the table at the end of the stream
+					uint8_t codeaux = codeauxTable[codetri & 15];
+					int feb = codeaux >> 4;
+					int fec = codeaux & 15;
+					uint32_t a = next++;
+					uint32_t bf = vertexfifo[(vertexfifooffset - feb) & 15];
+					uint32_t b = (feb == 0) ? next : bf;
+					int feb0 = feb == 0;
+					next += feb0;
+					uint32_t cf = vertexfifo[(vertexfifooffset - fec) & 15];
+					uint32_t c = (fec == 0) ? next : cf;
+					int fec0 = fec == 0;
+					next += fec0;
+					writeTriangle(destination, i, indexSize, a, b, c);
+					pushVertexFifo(vertexfifo, a, vertexfifooffset);
+					pushVertexFifo(vertexfifo, b, vertexfifooffset, feb0);
+					pushVertexFifo(vertexfifo, c, vertexfifooffset, fec0);
+					pushEdgeFifo(edgefifo, b, a, edgefifooffset);
+					pushEdgeFifo(edgefifo, c, b, edgefifooffset);
+					pushEdgeFifo(edgefifo, a, c, edgefifooffset);
+				} else {
+					// Slow path: a full codeaux byte follows in the data stream
+					uint8_t codeaux = *data++;
+					int fea = codetri == 0xfe ? 0 : 15;
+					int feb = codeaux >> 4;
+					int fec = codeaux & 15;
+					// A zero codeaux outside of the table resets the running index
+					if (codeaux == 0) {
+						next = 0;
+					}
+					uint32_t a = (fea == 0) ? next++ : 0;
+					uint32_t b = (feb == 0) ? next++ : vertexfifo[(vertexfifooffset - feb) & 15];
+					uint32_t c = (fec == 0) ? next++ : vertexfifo[(vertexfifooffset - fec) & 15];
+					if (fea == 15) {
+						last = a = decodeIndex(data, last);
+					}
+					if (feb == 15) {
+						last = b = decodeIndex(data, last);
+					}
+					if (fec == 15) {
+						last = c = decodeIndex(data, last);
+					}
+					writeTriangle(destination, i, indexSize, a, b, c);
+					pushVertexFifo(vertexfifo, a, vertexfifooffset);
+					pushVertexFifo(vertexfifo, b, vertexfifooffset, (feb == 0) | (feb == 15));
+					pushVertexFifo(vertexfifo, c, vertexfifooffset, (fec == 0) | (fec == 15));
+					pushEdgeFifo(edgefifo, b, a, edgefifooffset);
+					pushEdgeFifo(edgefifo, c, b, edgefifooffset);
+					pushEdgeFifo(edgefifo, a, c, edgefifooffset);
+				}
+			}
+		}
+
+		// All data bytes must have been consumed up to the codeaux table
+		if (data != dataSafeEnd) {
+			return -3;
+		}
+		return 0;
+	}
+
+	int decodeIndexSequence(void* destination, size_t indexCount, size_t indexSize, const uint8_t* buffer, size_t bufferSize)
+	{
+		if ((indexSize != 2) && (indexSize != 4)) {
+			return -1;
+		}
+		// The minimum valid encoding is the header, one byte per index and a 4 byte tail
+		if (bufferSize < 1 + indexCount + 4) {
+			return -2;
+		}
+		if ((buffer[0] & 0xf0) != sequenceHeader) {
+			return -1;
+		}
+		int version = buffer[0] & 0x0f;
+		if (version > 1) {
+			return -1;
+		}
+
+		const uint8_t* data = buffer + 1;
+		const uint8_t* dataSafeEnd = buffer + bufferSize - 4;
+		uint32_t last[2] = {};
+
+		for (size_t i = 0; i < indexCount; i++) {
+			// Each index reads at most 5 bytes, the 4 byte tail keeps reads in bounds
+			if (data >= dataSafeEnd) {
+				return -2;
+			}
+			uint32_t v = decodeVByte(data);
+			// Lowest bit selects one of two baselines, the rest is a zigzag delta
+			uint32_t current = v & 1;
+			v >>= 1;
+			uint32_t d = (v >> 1) ^ -int32_t(v & 1);
+			uint32_t index = last[current] + d;
+			last[current] = index;
+			if (indexSize == 2) {
+				static_cast<uint16_t*>(destination)[i] = uint16_t(index);
+			} else {
+				static_cast<uint32_t*>(destination)[i] = index;
+			}
+		}
+
+		if (data != dataSafeEnd) {
+			return -3;
+		}
+		return 0;
+	}
+
+	void decodeFilterOct(void* data, size_t count, size_t stride)
+	{
+		if (stride == 4) {
+			decodeFilterOctImpl(static_cast<int8_t*>(data), count);
+		} else {
+			decodeFilterOctImpl(static_cast<int16_t*>(data), count);
+		}
+	}
+
+	void decodeFilterQuat(void* data, size_t count)
+	{
+		int16_t* d = static_cast<int16_t*>(data);
+		const float scale = 1.f / sqrtf(2.f);
+		for (size_t i = 0; i < count; i++) {
+			// The two lowest bits of the fourth component store the index of the dropped (largest) component, the rest its scale
+			int sf = d[i * 4 + 3] | 3;
+			float ss = scale / float(sf);
+			float x = float(d[i * 4 + 0]) * ss;
+			float y = float(d[i * 4 + 1]) * ss;
+			float z = float(d[i * 4 + 2]) * ss;
+			float ww = 1.f - x * x - y * y - z * z;
+			float w = sqrtf(ww >= 0.f ? ww : 0.f);
+			int xf = int(x * 32767.f + (x >= 0.f ? 0.5f : -0.5f));
+			int yf = int(y * 32767.f + (y >= 0.f ? 0.5f : -0.5f));
+			int zf = int(z * 32767.f + (z >= 0.f ? 0.5f : -0.5f));
+			int wf = int(w * 32767.f + 0.5f);
+			int qc = d[i * 4 + 3] & 3;
+			d[i * 4 + ((qc + 1) & 3)] = int16_t(xf);
+			d[i * 4 + ((qc + 2) & 3)] = int16_t(yf);
+			d[i * 4 + ((qc + 3) & 3)] = int16_t(zf);
+			d[i * 4 + ((qc + 0) & 3)] = int16_t(wf);
+		}
+	}
+
+	void decodeFilterExp(void* data, size_t count, size_t stride)
+	{
+		// Every 32 bit component is a 24 bit signed mantissa with an 8 bit signed exponent
+		uint32_t* d = static_cast<uint32_t*>(data);
+		size_t components = count * (stride / 4);
+		size_t i = 0;
+#if defined(MESHOPT_SSE2)
+		for (; i + 4 <= components; i += 4) {
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(d + i));
+			// ldexp(float(m), e) by building 2^e directly in the exponent bits
+			__m128i m = _mm_srai_epi32(_mm_slli_epi32(v, 8), 8);
+			__m128i e = _mm_srai_epi32(v, 24);
+			__m128 p = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(e, _mm_set1_epi32(127)), 23));
+			__m128 r = _mm_mul_ps(p, _mm_cvtepi32_ps(m));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(d + i), _mm_castps_si128(r));
+		}
+#endif
+		for (; i < components; i++) {
+			uint32_t v = d[i];
+			int m = int(v << 8) >> 8;
+			int e = int(v) >> 24;
+			union { float f; uint32_t ui; } u;
+			u.ui = uint32_t(e + 127) << 23;
+			u.f = u.f * float(m);
+			d[i] = u.ui;
+		}
+	}
+
+	int decode(void* destination, size_t count, size_t stride, const uint8_t* source, size_t sourceSize, Mode mode, Filter filter)
+	{
+		// Filters are only defined for these strides, anything else would read or write past the decoded elements
+		const bool validFilter = (filter == Filter::None) ||
+			((filter == Filter::Octahedral) && ((stride == 4) || (stride == 8))) ||
+			((filter == Filter::Quaternion) && (stride == 8)) ||
+			((filter == Filter::Exponential) && (stride % 4 == 0));
+		if (!validFilter) {
+			return -1;
+		}
+		int res = 0;
+		switch (mode) {
+		case Mode::Attributes:
+			res = decodeVertexBuffer(destination, count, stride, source, sourceSize);
+			break;
+		case Mode::Triangles:
+			res = decodeIndexBuffer(destination, count, stride, source, sourceSize);
+			break;
+		case Mode::Indices:
+			res = decodeIndexSequence(destination, count, stride, source, sourceSize);
+			break;
+		}
+		if (res != 0) {
+			return res;
+		}
+		switch (filter) {
+		case Filter::Octahedral:
+			decodeFilterOct(destination, count, stride);
+			break;
+		case Filter::Quaternion:
+			decodeFilterQuat(destination, count);
+			break;
+		case Filter::Exponential:
+			decodeFilterExp(destination, count, stride);
+			break;
+		default:
+			break;
+		}
+		return 0;
+	}
+}
@@ -0,0 +1,37 @@
+/**
+ * Decoder for EXT_meshopt_compression buffer views
+ *
+ * Implements the vertex/index codecs and the octahedral, quaternion and exponential filters
+ * as described in the extension specification (bitstream compatible with meshoptimizer)
+ *
+ * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace meshopt
+{
+	enum class Mode { Attributes, Triangles, Indices };
+	enum class Filter { None, Octahedral, Quaternion, Exponential };
+
+	// All decode functions return 0 on success and a negative value for malformed input
+	int decodeVertexBuffer(void* destination, size_t vertexCount, size_t vertexSize, const uint8_t* buffer, size_t bufferSize);
+	int decodeIndexBuffer(void* destination, size_t indexCount, size_t indexSize, const uint8_t* buffer, size_t bufferSize);
+	int decodeIndexSequence(void* destination, size_t indexCount, size_t indexSize, const uint8_t* buffer, size_t bufferSize);
+
+	// Filters are applied in place on already decoded data, octahedral requires a stride of 4 or 8, quaternion 8 and exponential a multiple of 4
+	void decodeFilterOct(void* data, size_t count, size_t stride);
+	void decodeFilterQuat(void* data, size_t count);
+	void decodeFilterExp(void* data, size_t count, size_t stride);
+
+	/**
+	 * Decode one compressed buffer view
+	 *
+	 * @param destination Output with room for count * stride bytes
+	 * @return 0 on success, negative on error (including a filter used with an unsupported stride)
+	 */
+	int decode(void* destination, size_t count, size_t stride, const uint8_t* source, size_t sourceSize, Mode mode, Filter filter);
+}
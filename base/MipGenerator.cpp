@@ -0,0 +1,287 @@
+/*
+* Compute shader based mip chain generation for uploaded textures
+*
+* This code is licensed under the MIT license(MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "MipGenerator.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+namespace vks
+{
+	namespace
+	{
+		struct PushConstants {
+			int32_t sourceWidth;
+			int32_t sourceHeight;
+			int32_t levelCount;
+			int32_t srgb;
+		};
+	}
+
+	VkShaderModule MipGenerator::loadShaderModule(const std::string& filename)
+	{
+		std::vector<char> shaderCode;
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+		AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
+		if (!asset) {
+			return VK_NULL_HANDLE;
+		}
+		shaderCode.resize(AAsset_getLength(asset));
+		AAsset_read(asset, shaderCode.data(), shaderCode.size());
+		AAsset_close(asset);
+#else
+		std::ifstream is(filename, std::ios::binary | std::ios::in | std::ios::ate);
+		if (!is.is_open()) {
+			return VK_NULL_HANDLE;
+		}
+		shaderCode.resize(static_cast<size_t>(is.tellg()));
+		is.seekg(0, std::ios::beg);
+		is.read(shaderCode.data(), shaderCode.size());
+#endif
+		if (shaderCode.empty()) {
+			return VK_NULL_HANDLE;
+		}
+		VkShaderModuleCreateInfo moduleCreateInfo{};
+		moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleCreateInfo.codeSize = shaderCode.size();
+		moduleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(shaderCode.data());
+		VkShaderModule shaderModule;
+		VK_CHECK_RESULT(vkCreateShaderModule(device->logicalDevice, &moduleCreateInfo, nullptr, &shaderModule));
+		return shaderModule;
+	}
+
+	void MipGenerator::prepare(vks::VulkanDevice* device, VkQueue queue, const std::string& shaderDirectory)
+	{
+		this->device = device;
+		this->queue = queue;
+
+		// Binding 0: Source level, binding 1: Up to six destination levels
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			{ 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+			{ 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, levelsPerDispatch, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI{};
+		descriptorSetLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		descriptorSetLayoutCI.pBindings = setLayoutBindings.data();
+		descriptorSetLayoutCI.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
+
+		VkPushConstantRange pushConstantRange{ VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants) };
+		VkPipelineLayoutCreateInfo pipelineLayoutCI{};
+		pipelineLayoutCI.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutCI.setLayoutCount = 1;
+		pipelineLayoutCI.pSetLayouts = &descriptorSetLayout;
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		VkDescriptorPoolSize poolSize{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, maxDescriptorSets * (levelsPerDispatch + 1) };
+		VkDescriptorPoolCreateInfo descriptorPoolCI{};
+		descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		descriptorPoolCI.poolSizeCount = 1;
+		descriptorPoolCI.pPoolSizes = &poolSize;
+		descriptorPoolCI.maxSets = maxDescriptorSets;
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+
+		// Two channel and single channel storage images require the extended storage formats feature
+		const std::vector<std::pair<VkFormat, std::string>> shaders = {
+			{ VK_FORMAT_R8G8B8A8_UNORM, "genmips_rgba8.comp.spv" },
+			{ VK_FORMAT_R8G8_UNORM, "genmips_rg8.comp.spv" },
+			{ VK_FORMAT_R8_UNORM, "genmips_r8.comp.spv" },
+		};
+		for (auto& shader : shaders) {
+			if ((shader.first != VK_FORMAT_R8G8B8A8_UNORM) && !device->enabledFeatures.shaderStorageImageExtendedFormats) {
+				continue;
+			}
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties(device->physicalDevice, shader.first, &formatProperties);
+			if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT)) {
+				continue;
+			}
+			VkShaderModule shaderModule = loadShaderModule(shaderDirectory + shader.second);
+			if (shaderModule == VK_NULL_HANDLE) {
+				std::cout << "Mip generation shader " << shader.second << " not found, falling back to blits" << std::endl;
+				continue;
+			}
+			VkComputePipelineCreateInfo pipelineCI{};
+			pipelineCI.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+			pipelineCI.layout = pipelineLayout;
+			pipelineCI.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			pipelineCI.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+			pipelineCI.stage.module = shaderModule;
+			pipelineCI.stage.pName = "main";
+			VkPipeline pipeline;
+			VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &pipeline));
+			vkDestroyShaderModule(device->logicalDevice, shaderModule, nullptr);
+			pipelines[shader.first] = pipeline;
+		}
+	}
+
+	void MipGenerator::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		flush();
+		for (auto& pipeline : pipelines) {
+			vkDestroyPipeline(device->logicalDevice, pipeline.second, nullptr);
+		}
+		pipelines.clear();
+		vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+		device = nullptr;
+	}
+
+	bool MipGenerator::isSupported(VkFormat format) const
+	{
+		return pipelines.find(format) != pipelines.end();
+	}
+
+	VkCommandBuffer MipGenerator::commandBuffer()
+	{
+		if (batch.commandBuffer == VK_NULL_HANDLE) {
+			batch.commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		}
+		return batch.commandBuffer;
+	}
+
+	void MipGenerator::generate(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, bool srgb)
+	{
+		const uint32_t dispatchCount = (mipLevels - 1 + levelsPerDispatch - 1) / levelsPerDispatch;
+		if (batch.descriptorSets + dispatchCount > maxDescriptorSets) {
+			// Commands recorded so far (including this image's upload) are executed first
+			flush();
+		}
+		VkCommandBuffer cmdBuffer = commandBuffer();
+
+		// One storage view per level
+		std::vector<VkImageView> levelViews(mipLevels);
+		for (uint32_t i = 0; i < mipLevels; i++) {
+			VkImageViewCreateInfo viewInfo{};
+			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewInfo.image = image;
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = format;
+			viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 };
+			VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewInfo, nullptr, &levelViews[i]));
+			batch.views.push_back(levelViews[i]);
+		}
+
+		{
+			VkImageMemoryBarrier imageMemoryBarriers[2]{};
+			imageMemoryBarriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			imageMemoryBarriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			imageMemoryBarriers[0].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+			imageMemoryBarriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			imageMemoryBarriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			imageMemoryBarriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageMemoryBarriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageMemoryBarriers[0].image = image;
+			imageMemoryBarriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+			imageMemoryBarriers[1] = imageMemoryBarriers[0];
+			imageMemoryBarriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageMemoryBarriers[1].srcAccessMask = 0;
+			imageMemoryBarriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			imageMemoryBarriers[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 1, mipLevels - 1, 0, 1 };
+			vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, (mipLevels > 1) ? 2 : 1, imageMemoryBarriers);
+		}
+
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[format]);
+		for (uint32_t sourceLevel = 0; sourceLevel + 1 < mipLevels; sourceLevel += levelsPerDispatch) {
+			const uint32_t levelCount = std::min(levelsPerDispatch, mipLevels - 1 - sourceLevel);
+
+			VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
+			descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+			descriptorSetAllocInfo.descriptorPool = descriptorPool;
+			descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayout;
+			descriptorSetAllocInfo.descriptorSetCount = 1;
+			VkDescriptorSet descriptorSet;
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &descriptorSet));
+			batch.descriptorSets++;
+
+			// Unused array elements point at the last generated level, the shader doesn't write to them
+			VkDescriptorImageInfo sourceInfo{ VK_NULL_HANDLE, levelViews[sourceLevel], VK_IMAGE_LAYOUT_GENERAL };
+			VkDescriptorImageInfo levelInfos[levelsPerDispatch];
+			for (uint32_t i = 0; i < levelsPerDispatch; i++) {
+				levelInfos[i] = { VK_NULL_HANDLE, levelViews[sourceLevel + 1 + std::min(i, levelCount - 1)], VK_IMAGE_LAYOUT_GENERAL };
+			}
+			VkWriteDescriptorSet writeDescriptorSets[2]{};
+			writeDescriptorSets[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writeDescriptorSets[0].dstSet = descriptorSet;
+			writeDescriptorSets[0].dstBinding = 0;
+			writeDescriptorSets[0].descriptorCount = 1;
+			writeDescriptorSets[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			writeDescriptorSets[0].pImageInfo = &sourceInfo;
+			writeDescriptorSets[1] = writeDescriptorSets[0];
+			writeDescriptorSets[1].dstBinding = 1;
+			writeDescriptorSets[1].descriptorCount = levelsPerDispatch;
+			writeDescriptorSets[1].pImageInfo = levelInfos;
+			vkUpdateDescriptorSets(device->logicalDevice, 2, writeDescriptorSets, 0, nullptr);
+
+			const uint32_t sourceWidth = std::max(1u, width >> sourceLevel);
+			const uint32_t sourceHeight = std::max(1u, height >> sourceLevel);
+			PushConstants pushConstants{ static_cast<int32_t>(sourceWidth), static_cast<int32_t>(sourceHeight), static_cast<int32_t>(levelCount), srgb ? 1 : 0 };
+			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+			vkCmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+			// Every workgroup covers 32x32 texels of the first generated level
+			const uint32_t firstWidth = std::max(1u, sourceWidth >> 1);
+			const uint32_t firstHeight = std::max(1u, sourceHeight >> 1);
+			vkCmdDispatch(cmdBuffer, (firstWidth + 31) / 32, (firstHeight + 31) / 32, 1);
+
+			if (sourceLevel + levelsPerDispatch + 1 < mipLevels) {
+				// The last level written by this dispatch is the source of the next one
+				VkMemoryBarrier memoryBarrier{};
+				memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+				memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+				vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			}
+		}
+
+		{
+			VkImageMemoryBarrier imageMemoryBarrier{};
+			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageMemoryBarrier.image = image;
+			imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 };
+			vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		}
+	}
+
+	void MipGenerator::releaseAfterFlush(VkBuffer buffer, VkDeviceMemory memory, VkDeviceSize size)
+	{
+		batch.stagingBuffers.push_back({ buffer, memory });
+		batch.stagingSize += size;
+		if (batch.stagingSize > maxStagingSize) {
+			flush();
+		}
+	}
+
+	void MipGenerator::flush()
+	{
+		if (batch.commandBuffer != VK_NULL_HANDLE) {
+			device->flushCommandBuffer(batch.commandBuffer, queue, true);
+		}
+		for (auto view : batch.views) {
+			vkDestroyImageView(device->logicalDevice, view, nullptr);
+		}
+		for (auto& staging : batch.stagingBuffers) {
+			vkDestroyBuffer(device->logicalDevice, staging.first, nullptr);
+			vkFreeMemory(device->logicalDevice, staging.second, nullptr);
+		}
+		if (batch.descriptorSets > 0) {
+			VK_CHECK_RESULT(vkResetDescriptorPool(device->logicalDevice, descriptorPool, 0));
+		}
+		batch = Batch();
+	}
+}
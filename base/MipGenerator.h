@@ -0,0 +1,76 @@
+/*
+* Compute shader based mip chain generation for uploaded textures
+*
+* Generates up to six levels per dispatch, so most textures need one or two dispatches instead of one blit per level
+* Commands of multiple textures are batched into one command buffer that is submitted by flush()
+*
+* This code is licensed under the MIT license(MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.hpp"
+
+namespace vks
+{
+	class MipGenerator
+	{
+	private:
+		// Pending resources of the current batch, released once it has been executed
+		struct Batch {
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			std::vector<VkImageView> views;
+			std::vector<std::pair<VkBuffer, VkDeviceMemory>> stagingBuffers;
+			VkDeviceSize stagingSize = 0;
+			uint32_t descriptorSets = 0;
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		VkQueue queue = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		std::map<VkFormat, VkPipeline> pipelines;
+		Batch batch;
+
+		VkShaderModule loadShaderModule(const std::string& filename);
+
+	public:
+		static const uint32_t levelsPerDispatch = 6;
+		static const uint32_t maxDescriptorSets = 256;
+		// Staging memory kept alive by a batch before it is flushed automatically
+		static const VkDeviceSize maxStagingSize = 256 * 1024 * 1024;
+
+		/**
+		* Create the pipelines for all formats with available shaders and storage image support
+		*
+		* @param shaderDirectory Directory containing the genmips_*.comp.spv shaders, missing shaders disable compute mip generation for that format
+		*/
+		void prepare(vks::VulkanDevice* device, VkQueue queue, const std::string& shaderDirectory);
+		void destroy();
+
+		bool isSupported(VkFormat format) const;
+
+		// Command buffer of the current batch, texture uploads record their copies into it before calling generate
+		VkCommandBuffer commandBuffer();
+
+		/**
+		* Record the generation of all levels below level 0
+		*
+		* @note Level 0 must be in TRANSFER_DST_OPTIMAL layout, all levels end up in SHADER_READ_ONLY_OPTIMAL once the batch has been flushed
+		* @param srgb Filter the color channels in linear space (for sRGB encoded data stored in UNORM images)
+		*/
+		void generate(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, bool srgb);
+
+		// Keep a staging buffer alive until the batch has been executed
+		void releaseAfterFlush(VkBuffer buffer, VkDeviceMemory memory, VkDeviceSize size);
+
+		// Submit the current batch, wait for it and release its transient resources
+		void flush();
+	};
+}
@@ -0,0 +1,384 @@
+/*
+* Pixel format conversions for decoded images on their way to the GPU
+*
+* This code is licensed under the MIT license(MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "PixelConverter.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PIXELCONVERTER_SSE2
+#include <emmintrin.h>
+#if defined(__SSSE3__)
+#define PIXELCONVERTER_SSSE3
+#include <tmmintrin.h>
+#endif
+#if defined(__F16C__)
+#define PIXELCONVERTER_F16C
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PIXELCONVERTER_NEON
+#include <arm_neon.h>
+#endif
+
+namespace vks
+{
+	namespace
+	{
+		uint32_t floatBits(float value)
+		{
+			uint32_t bits;
+			memcpy(&bits, &value, sizeof(bits));
+			return bits;
+		}
+
+		float bitsFloat(uint32_t bits)
+		{
+			float value;
+			memcpy(&value, &bits, sizeof(value));
+			return value;
+		}
+
+		// Source channel of each destination channel, -1 for channels that are filled with 255
+		void getSourceChannels(uint32_t srcChannels, const uint32_t* channels, uint32_t dstChannels, int* sourceIndex)
+		{
+			for (uint32_t c = 0; c < dstChannels; c++) {
+				const uint32_t channel = channels[c];
+				if (srcChannels <= 2) {
+					// Grey or grey + alpha
+					sourceIndex[c] = (channel < 3) ? 0 : ((srcChannels == 2) ? 1 : -1);
+				} else {
+					sourceIndex[c] = (channel < srcChannels) ? static_cast<int>(channel) : -1;
+				}
+			}
+		}
+
+		// Copy one channel of 2 or 4 channel pixels
+		void extractChannel(const uint8_t* src, uint32_t srcChannels, uint32_t channel, uint8_t* dst, size_t pixelCount)
+		{
+			size_t i = 0;
+#if defined(PIXELCONVERTER_SSE2)
+			// Shift the channel into the low byte of each pixel and pack the low bytes
+			const __m128i shift = _mm_cvtsi32_si128(static_cast<int>(channel * 8));
+			if (srcChannels == 4) {
+				const __m128i mask = _mm_set1_epi32(0xFF);
+				for (; i + 16 <= pixelCount; i += 16) {
+					const __m128i* p = reinterpret_cast<const __m128i*>(src + i * 4);
+					const __m128i p0 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(p + 0), shift), mask);
+					const __m128i p1 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(p + 1), shift), mask);
+					const __m128i p2 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(p + 2), shift), mask);
+					const __m128i p3 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(p + 3), shift), mask);
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3)));
+				}
+			} else if (srcChannels == 2) {
+				const __m128i mask = _mm_set1_epi16(0xFF);
+				for (; i + 16 <= pixelCount; i += 16) {
+					const __m128i* p = reinterpret_cast<const __m128i*>(src + i * 2);
+					const __m128i p0 = _mm_and_si128(_mm_srl_epi16(_mm_loadu_si128(p + 0), shift), mask);
+					const __m128i p1 = _mm_and_si128(_mm_srl_epi16(_mm_loadu_si128(p + 1), shift), mask);
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(p0, p1));
+				}
+			}
+#elif defined(PIXELCONVERTER_NEON)
+			if (srcChannels == 4) {
+				for (; i + 16 <= pixelCount; i += 16) {
+					const uint8x16x4_t p = vld4q_u8(src + i * 4);
+					vst1q_u8(dst + i, p.val[channel]);
+				}
+			} else if (srcChannels == 2) {
+				for (; i + 16 <= pixelCount; i += 16) {
+					const uint8x16x2_t p = vld2q_u8(src + i * 2);
+					vst1q_u8(dst + i, p.val[channel]);
+				}
+			}
+#endif
+			for (; i < pixelCount; i++) {
+				dst[i] = src[i * srcChannels + channel];
+			}
+		}
+
+		// Copy two adjacent channels (first, first + 1) of RGBA pixels
+		void extractChannelPair(const uint8_t* src, uint32_t first, uint8_t* dst, size_t pixelCount)
+		{
+			size_t i = 0;
+#if defined(PIXELCONVERTER_SSE2)
+			// Pairs are 16 bit values, they are biased into the signed range so the saturating pack keeps them intact
+			const __m128i shift = _mm_cvtsi32_si128(static_cast<int>(first * 8));
+			const __m128i mask = _mm_set1_epi32(0xFFFF);
+			const __m128i bias32 = _mm_set1_epi32(0x8000);
+			const __m128i bias16 = _mm_set1_epi16(static_cast<short>(0x8000));
+			for (; i + 8 <= pixelCount; i += 8) {
+				const __m128i* p = reinterpret_cast<const __m128i*>(src + i * 4);
+				const __m128i p0 = _mm_sub_epi32(_mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(p + 0), shift), mask), bias32);
+				const __m128i p1 = _mm_sub_epi32(_mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(p + 1), shift), mask), bias32);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2), _mm_add_epi16(_mm_packs_epi32(p0, p1), bias16));
+			}
+#elif defined(PIXELCONVERTER_NEON)
+			for (; i + 16 <= pixelCount; i += 16) {
+				const uint8x16x4_t p = vld4q_u8(src + i * 4);
+				uint8x16x2_t pair;
+				pair.val[0] = p.val[first];
+				pair.val[1] = p.val[first + 1];
+				vst2q_u8(dst + i * 2, pair);
+			}
+#endif
+			for (; i < pixelCount; i++) {
+				dst[i * 2 + 0] = src[i * 4 + first];
+				dst[i * 2 + 1] = src[i * 4 + first + 1];
+			}
+		}
+
+		uint16_t floatToHalfScalar(float value)
+		{
+			// Rounds to nearest even, see https://gist.github.com/rygorous/2156668
+			uint32_t bits = floatBits(value);
+			const uint32_t sign = bits & 0x80000000u;
+			bits ^= sign;
+			uint32_t half;
+			if (bits >= (143u << 23)) {
+				// Infinity or NaN (NaNs become quiet)
+				half = (bits > 0x7F800000u) ? 0x7E00u : 0x7C00u;
+			} else if (bits < (113u << 23)) {
+				// Subnormal or zero, adding the magic value aligns the mantissa bits and rounds
+				const uint32_t magic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+				half = floatBits(bitsFloat(bits) + bitsFloat(magic)) - magic;
+			} else {
+				const uint32_t mantissaOdd = (bits >> 13) & 1u;
+				bits += (static_cast<uint32_t>(15 - 127) << 23) + 0xFFFu + mantissaOdd;
+				half = bits >> 13;
+			}
+			return static_cast<uint16_t>(half | (sign >> 16));
+		}
+
+#if defined(PIXELCONVERTER_SSE2) && !defined(PIXELCONVERTER_F16C)
+		// Four lanes of floatToHalfScalar, the result is in the low 16 bits of each lane
+		__m128i floatToHalfSSE2(__m128 value)
+		{
+			const __m128i magic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+			__m128i bits = _mm_castps_si128(value);
+			const __m128i sign = _mm_and_si128(bits, _mm_set1_epi32(static_cast<int>(0x80000000u)));
+			bits = _mm_xor_si128(bits, sign);
+
+			const __m128i mantissaOdd = _mm_and_si128(_mm_srli_epi32(bits, 13), _mm_set1_epi32(1));
+			const __m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(bits, _mm_set1_epi32(static_cast<int>((static_cast<uint32_t>(15 - 127) << 23) + 0xFFFu))), mantissaOdd), 13);
+			const __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(bits), _mm_castsi128_ps(magic))), magic);
+			const __m128i special = _mm_or_si128(_mm_set1_epi32(0x7C00), _mm_and_si128(_mm_cmpgt_epi32(bits, _mm_set1_epi32(0x7F800000)), _mm_set1_epi32(0x200)));
+
+			// bits has no sign bit anymore, so the signed compares are safe
+			const __m128i isSubnormal = _mm_cmplt_epi32(bits, _mm_set1_epi32(113 << 23));
+			const __m128i isSpecial = _mm_cmpgt_epi32(bits, _mm_set1_epi32((143 << 23) - 1));
+			__m128i half = _mm_or_si128(_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+			half = _mm_or_si128(_mm_and_si128(isSpecial, special), _mm_andnot_si128(isSpecial, half));
+			return _mm_or_si128(half, _mm_srli_epi32(sign, 16));
+		}
+#endif
+	}
+
+	void PixelConverter::swizzle(const uint8_t* src, uint32_t srcChannels, uint8_t* dst, const uint32_t* channels, uint32_t dstChannels, size_t pixelCount)
+	{
+		int sourceIndex[4];
+		getSourceChannels(srcChannels, channels, dstChannels, sourceIndex);
+
+		bool identity = (srcChannels == dstChannels);
+		for (uint32_t c = 0; c < dstChannels; c++) {
+			identity = identity && (sourceIndex[c] == static_cast<int>(c));
+		}
+		if (identity) {
+			memcpy(dst, src, pixelCount * srcChannels);
+			return;
+		}
+
+		// Common cases for textures: RGB to RGBA, single channels (occlusion) and channel pairs (normal and metallic/roughness maps)
+		if ((srcChannels == 3) && (dstChannels == 4) && (sourceIndex[0] == 0) && (sourceIndex[1] == 1) && (sourceIndex[2] == 2) && (sourceIndex[3] < 0)) {
+			rgbToRgba(src, dst, pixelCount);
+			return;
+		}
+		if ((dstChannels == 1) && (sourceIndex[0] >= 0) && ((srcChannels == 2) || (srcChannels == 4))) {
+			extractChannel(src, srcChannels, static_cast<uint32_t>(sourceIndex[0]), dst, pixelCount);
+			return;
+		}
+		if ((dstChannels == 2) && (srcChannels == 4) && (sourceIndex[0] >= 0) && (sourceIndex[0] < 3) && (sourceIndex[1] == sourceIndex[0] + 1)) {
+			extractChannelPair(src, static_cast<uint32_t>(sourceIndex[0]), dst, pixelCount);
+			return;
+		}
+
+		for (size_t i = 0; i < pixelCount; i++) {
+			for (uint32_t c = 0; c < dstChannels; c++) {
+				dst[c] = (sourceIndex[c] < 0) ? 255 : src[sourceIndex[c]];
+			}
+			src += srcChannels;
+			dst += dstChannels;
+		}
+	}
+
+	void PixelConverter::rgbToRgba(const uint8_t* src, uint8_t* dst, size_t pixelCount)
+	{
+		size_t i = 0;
+#if defined(PIXELCONVERTER_SSSE3)
+		// Reads 16 bytes for every 12 consumed, so the last pixels are left to the loop below
+		const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+		for (; i + 6 <= pixelCount; i += 4) {
+			const __m128i rgb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha));
+		}
+#elif defined(PIXELCONVERTER_NEON)
+		for (; i + 16 <= pixelCount; i += 16) {
+			const uint8x16x3_t rgb = vld3q_u8(src + i * 3);
+			uint8x16x4_t rgba;
+			rgba.val[0] = rgb.val[0];
+			rgba.val[1] = rgb.val[1];
+			rgba.val[2] = rgb.val[2];
+			rgba.val[3] = vdupq_n_u8(255);
+			vst4q_u8(dst + i * 4, rgba);
+		}
+#endif
+		for (; i < pixelCount; i++) {
+			dst[i * 4 + 0] = src[i * 3 + 0];
+			dst[i * 4 + 1] = src[i * 3 + 1];
+			dst[i * 4 + 2] = src[i * 3 + 2];
+			dst[i * 4 + 3] = 255;
+		}
+	}
+
+	uint16_t PixelConverter::floatToHalf(float value)
+	{
+		return floatToHalfScalar(value);
+	}
+
+	void PixelConverter::floatToHalf(const float* src, uint16_t* dst, size_t count)
+	{
+		size_t i = 0;
+#if defined(PIXELCONVERTER_F16C)
+		for (; i + 8 <= count; i += 8) {
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+		}
+#elif defined(PIXELCONVERTER_SSE2)
+		// Halves (and their sign bit) don't fit the signed saturating pack, so they are biased around it
+		const __m128i bias32 = _mm_set1_epi32(0x8000);
+		const __m128i bias16 = _mm_set1_epi16(static_cast<short>(0x8000));
+		for (; i + 8 <= count; i += 8) {
+			const __m128i h0 = _mm_sub_epi32(floatToHalfSSE2(_mm_loadu_ps(src + i)), bias32);
+			const __m128i h1 = _mm_sub_epi32(floatToHalfSSE2(_mm_loadu_ps(src + i + 4)), bias32);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_add_epi16(_mm_packs_epi32(h0, h1), bias16));
+		}
+#elif defined(PIXELCONVERTER_NEON) && defined(__aarch64__)
+		for (; i + 4 <= count; i += 4) {
+			vst1_u16(dst + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + i))));
+		}
+#endif
+		for (; i < count; i++) {
+			dst[i] = floatToHalfScalar(src[i]);
+		}
+	}
+
+	void PixelConverter::unorm16ToHalf(const uint16_t* src, uint16_t* dst, size_t count)
+	{
+		// Converted through floats in blocks, so the float to half kernel does the rounding
+		const float scale = 1.0f / 65535.0f;
+		float values[256];
+		for (size_t offset = 0; offset < count; offset += 256) {
+			const size_t blockCount = std::min<size_t>(256, count - offset);
+			const uint16_t* block = src + offset;
+			size_t i = 0;
+#if defined(PIXELCONVERTER_SSE2)
+			const __m128i zero = _mm_setzero_si128();
+			const __m128 scaleVector = _mm_set1_ps(scale);
+			for (; i + 8 <= blockCount; i += 8) {
+				const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+				_mm_storeu_ps(values + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero)), scaleVector));
+				_mm_storeu_ps(values + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero)), scaleVector));
+			}
+#elif defined(PIXELCONVERTER_NEON)
+			for (; i + 8 <= blockCount; i += 8) {
+				const uint16x8_t v = vld1q_u16(block + i);
+				vst1q_f32(values + i, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(v))), scale));
+				vst1q_f32(values + i + 4, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(v))), scale));
+			}
+#endif
+			for (; i < blockCount; i++) {
+				values[i] = block[i] * scale;
+			}
+			floatToHalf(values, dst + offset, blockCount);
+		}
+	}
+
+	void PixelConverter::toRgbaHalf(const void* src, ComponentType type, uint32_t srcChannels, uint16_t* dst, size_t pixelCount)
+	{
+		const uint32_t rgba[4] = { 0, 1, 2, 3 };
+		int sourceIndex[4];
+		getSourceChannels(srcChannels, rgba, 4, sourceIndex);
+		const uint16_t halfOne = 0x3C00;
+
+		if (type == ComponentType::Half) {
+			const uint16_t* halves = static_cast<const uint16_t*>(src);
+			if (srcChannels == 4) {
+				memcpy(dst, halves, pixelCount * 4 * sizeof(uint16_t));
+				return;
+			}
+			for (size_t i = 0; i < pixelCount; i++) {
+				for (uint32_t c = 0; c < 4; c++) {
+					dst[i * 4 + c] = (sourceIndex[c] < 0) ? halfOne : halves[i * srcChannels + sourceIndex[c]];
+				}
+			}
+			return;
+		}
+
+		// Channels are expanded to RGBA (in the source type) in blocks, which are then converted as a whole
+		const size_t blockPixels = 64;
+		if (type == ComponentType::UInt16) {
+			const uint16_t* values = static_cast<const uint16_t*>(src);
+			if (srcChannels == 4) {
+				unorm16ToHalf(values, dst, pixelCount * 4);
+				return;
+			}
+			uint16_t block[blockPixels * 4];
+			for (size_t offset = 0; offset < pixelCount; offset += blockPixels) {
+				const size_t count = std::min(blockPixels, pixelCount - offset);
+				for (size_t i = 0; i < count; i++) {
+					for (uint32_t c = 0; c < 4; c++) {
+						block[i * 4 + c] = (sourceIndex[c] < 0) ? 65535 : values[(offset + i) * srcChannels + sourceIndex[c]];
+					}
+				}
+				unorm16ToHalf(block, dst + offset * 4, count * 4);
+			}
+			return;
+		}
+
+		if (type == ComponentType::Float) {
+			const float* values = static_cast<const float*>(src);
+			if (srcChannels == 4) {
+				floatToHalf(values, dst, pixelCount * 4);
+				return;
+			}
+			float block[blockPixels * 4];
+			for (size_t offset = 0; offset < pixelCount; offset += blockPixels) {
+				const size_t count = std::min(blockPixels, pixelCount - offset);
+				for (size_t i = 0; i < count; i++) {
+					for (uint32_t c = 0; c < 4; c++) {
+						block[i * 4 + c] = (sourceIndex[c] < 0) ? 1.0f : values[(offset + i) * srcChannels + sourceIndex[c]];
+					}
+				}
+				floatToHalf(block, dst + offset * 4, count * 4);
+			}
+			return;
+		}
+
+		// 8 bit
+		const uint8_t* values = static_cast<const uint8_t*>(src);
+		float block[blockPixels * 4];
+		for (size_t offset = 0; offset < pixelCount; offset += blockPixels) {
+			const size_t count = std::min(blockPixels, pixelCount - offset);
+			for (size_t i = 0; i < count; i++) {
+				for (uint32_t c = 0; c < 4; c++) {
+					block[i * 4 + c] = (sourceIndex[c] < 0) ? 1.0f : values[(offset + i) * srcChannels + sourceIndex[c]] / 255.0f;
+				}
+			}
+			floatToHalf(block, dst + offset * 4, count * 4);
+		}
+	}
+}
@@ -0,0 +1,46 @@
+/*
+* Pixel format conversions for decoded images on their way to the GPU (channel selection and expansion, 16 bit and float to half)
+*
+* Conversions that map well onto SIMD have SSE2 (SSSE3/F16C where the compiler targets them) and NEON paths with scalar fallbacks
+* All functions write to caller provided memory, which may be mapped staging memory
+*
+* This code is licensed under the MIT license(MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace vks
+{
+	class PixelConverter
+	{
+	public:
+		enum class ComponentType { UInt8, UInt16, Half, Float };
+
+		/**
+		* Copy 8 bit pixels while selecting and reordering channels
+		*
+		* @param channels Source channel for each of the dstChannels destination channels
+		* @note Missing channels are expanded like the GPU would: grey (and grey + alpha) sources return grey for 0-2, absent channels are 255
+		*/
+		static void swizzle(const uint8_t* src, uint32_t srcChannels, uint8_t* dst, const uint32_t* channels, uint32_t dstChannels, size_t pixelCount);
+
+		// RGB to RGBA with opaque alpha
+		static void rgbToRgba(const uint8_t* src, uint8_t* dst, size_t pixelCount);
+
+		// IEEE 754 half floats, rounded to nearest even (values out of range become infinity)
+		static uint16_t floatToHalf(float value);
+		static void floatToHalf(const float* src, uint16_t* dst, size_t count);
+		// Normalized 16 bit integers (0..65535 maps to 0..1)
+		static void unorm16ToHalf(const uint16_t* src, uint16_t* dst, size_t count);
+
+		/**
+		* Convert pixels with 1 to 4 channels of the given component type to RGBA half floats
+		*
+		* @note Channels are expanded like swizzle does, an absent alpha channel is 1.0
+		*/
+		static void toRgbaHalf(const void* src, ComponentType type, uint32_t srcChannels, uint16_t* dst, size_t pixelCount);
+	};
+}
@@ -0,0 +1,156 @@
+/*
+* Deduplication of texture images and sampler objects shared by the glTF and USDZ model classes
+*
+* This code is licensed under the MIT license(MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+
+#include "vulkan/vulkan.h"
+#include "macros.h"
+
+namespace vks
+{
+	// 64 bit FNV-1a over 8 byte words (bytes for the tail), fast enough to hash decoded images at load time
+	inline uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 0xCBF29CE484222325ull)
+	{
+		const uint64_t prime = 0x100000001B3ull;
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8) {
+			uint64_t word;
+			memcpy(&word, bytes + i, sizeof(word));
+			hash = (hash ^ word) * prime;
+		}
+		for (; i < size; i++) {
+			hash = (hash ^ bytes[i]) * prime;
+		}
+		return hash;
+	}
+
+	/*
+		Reference counted sampler objects keyed by their sampling state
+		Textures with identical sampler state share one VkSampler, so the number of samplers stays bounded by the number of distinct states
+	*/
+	class SamplerCache
+	{
+	private:
+		struct Entry {
+			VkSampler sampler;
+			uint32_t refCount;
+		};
+		typedef std::tuple<VkFilter, VkFilter, VkSamplerMipmapMode, VkSamplerAddressMode, VkSamplerAddressMode, VkSamplerAddressMode, VkCompareOp, VkBorderColor, float, float, VkBool32> Key;
+		std::map<Key, Entry> samplers;
+		std::mutex mutex;
+
+		static Key getKey(const VkSamplerCreateInfo& createInfo)
+		{
+			return Key(createInfo.magFilter, createInfo.minFilter, createInfo.mipmapMode, createInfo.addressModeU, createInfo.addressModeV, createInfo.addressModeW, createInfo.compareOp, createInfo.borderColor, createInfo.maxLod, createInfo.anisotropyEnable ? createInfo.maxAnisotropy : 1.0f, createInfo.anisotropyEnable);
+		}
+
+	public:
+		/** Get a sampler for the given state, creating it on first use */
+		VkSampler acquire(VkDevice device, const VkSamplerCreateInfo& createInfo)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			const Key key = getKey(createInfo);
+			auto it = samplers.find(key);
+			if (it != samplers.end()) {
+				it->second.refCount++;
+				return it->second.sampler;
+			}
+			Entry entry{};
+			VK_CHECK_RESULT(vkCreateSampler(device, &createInfo, nullptr, &entry.sampler));
+			entry.refCount = 1;
+			samplers[key] = entry;
+			return entry.sampler;
+		}
+
+		/** Drop one reference to a sampler returned by acquire, destroys it once it is no longer used */
+		void release(VkDevice device, VkSampler sampler)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto it = samplers.begin(); it != samplers.end(); ++it) {
+				if (it->second.sampler == sampler) {
+					if (--it->second.refCount == 0) {
+						vkDestroySampler(device, sampler, nullptr);
+						samplers.erase(it);
+					}
+					return;
+				}
+			}
+		}
+
+		size_t size()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return samplers.size();
+		}
+
+		/** Cache shared by all models */
+		static SamplerCache& shared()
+		{
+			static SamplerCache cache;
+			return cache;
+		}
+	};
+
+	/*
+		Maps the identity (file name) or content hash of a source image to the texture that owns the uploaded GPU image
+		Textures that resolve to the same key reuse that image instead of uploading it again
+	*/
+	class TextureCache
+	{
+	private:
+		std::unordered_map<std::string, uint32_t> images;
+
+	public:
+		/**
+		* Build a key from the decoded image data
+		*
+		* @param usage Anything besides the pixels that changes the uploaded image (e.g. texture roles or color space)
+		*/
+		static std::string contentKey(const void* data, size_t size, uint32_t width, uint32_t height, uint32_t components, uint32_t usage)
+		{
+			const uint32_t header[4] = { width, height, components, usage };
+			const uint64_t hash = hashBytes(data, size, hashBytes(header, sizeof(header)));
+			char key[32];
+			snprintf(key, sizeof(key), "content:%016llx", static_cast<unsigned long long>(hash));
+			return key;
+		}
+
+		/** Build a key from the file an image is loaded from */
+		static std::string identityKey(const std::string& filename, uint32_t usage)
+		{
+			return "file:" + filename + ":" + std::to_string(usage);
+		}
+
+		bool find(const std::string& key, uint32_t& textureIndex) const
+		{
+			auto it = images.find(key);
+			if (it == images.end()) {
+				return false;
+			}
+			textureIndex = it->second;
+			return true;
+		}
+
+		void insert(const std::string& key, uint32_t textureIndex)
+		{
+			images[key] = textureIndex;
+		}
+
+		void clear()
+		{
+			images.clear();
+		}
+	};
+}
@@ -0,0 +1,1263 @@
+/*
+* CPU block compression (BC1/BC4/BC5/BC7) for textures that are only available as 8 bit images (png, jpg)
+*
+* This code is licensed under the MIT license(MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "TextureCompressor.h"
+#include "ThreadPool.hpp"
+#include "TextureCache.hpp"
+
+#include "stb_image_resize2.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <sys/stat.h>
+#if defined(_WIN32)
+#include <direct.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXTURECOMPRESSOR_SSE2
+#include <emmintrin.h>
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && defined(__aarch64__)
+#define TEXTURECOMPRESSOR_NEON
+#include <arm_neon.h>
+#endif
+
+namespace vks
+{
+	TextureCompressor::Settings TextureCompressor::settings;
+
+	namespace
+	{
+		// Bump whenever the encoders change, so stale cache entries are no longer used
+		const uint32_t encoderVersion = 2;
+
+		uint32_t blockSize(TextureCompressor::Format format)
+		{
+			return ((format == TextureCompressor::Format::BC1) || (format == TextureCompressor::Format::BC4)) ? 8 : 16;
+		}
+
+		// Writes values least significant bit first, as required by the BC7 bit layout
+		struct BitWriter {
+			uint8_t* data;
+			uint32_t position = 0;
+			explicit BitWriter(uint8_t* data) : data(data) {}
+			void write(uint32_t value, uint32_t bitCount)
+			{
+				for (uint32_t i = 0; i < bitCount; i++, position++) {
+					if (value & (1u << i)) {
+						data[position >> 3] |= static_cast<uint8_t>(1u << (position & 7));
+					}
+				}
+			}
+		};
+
+		// Principal axis of a set of points using power iteration, falls back to the bounding box diagonal
+		template <int N>
+		void principalAxis(const float points[16][4], float mean[N], float axis[N])
+		{
+#if defined(TEXTURECOMPRESSOR_SSE2) || defined(TEXTURECOMPRESSOR_NEON)
+			// One point per register, channels beyond N are masked to zero so they don't contribute to the covariance
+			float meanLanes[4], axisLanes[4];
+#if defined(TEXTURECOMPRESSOR_SSE2)
+			const __m128 mask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, (N == 4) ? -1 : 0));
+			__m128 sum = _mm_setzero_ps();
+			__m128 minValue = _mm_set1_ps(255.0f);
+			__m128 maxValue = _mm_setzero_ps();
+			for (int i = 0; i < 16; i++) {
+				const __m128 p = _mm_and_ps(_mm_loadu_ps(points[i]), mask);
+				sum = _mm_add_ps(sum, p);
+				minValue = _mm_min_ps(minValue, p);
+				maxValue = _mm_max_ps(maxValue, p);
+			}
+			const __m128 meanV = _mm_mul_ps(sum, _mm_set1_ps(1.0f / 16.0f));
+			// Row a of the covariance matrix is the sum of d * d[a]
+			__m128 rows[4] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+			for (int i = 0; i < 16; i++) {
+				const __m128 d = _mm_sub_ps(_mm_and_ps(_mm_loadu_ps(points[i]), mask), meanV);
+				rows[0] = _mm_add_ps(rows[0], _mm_mul_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(0, 0, 0, 0))));
+				rows[1] = _mm_add_ps(rows[1], _mm_mul_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(1, 1, 1, 1))));
+				rows[2] = _mm_add_ps(rows[2], _mm_mul_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(2, 2, 2, 2))));
+				rows[3] = _mm_add_ps(rows[3], _mm_mul_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(3, 3, 3, 3))));
+			}
+			__m128 axisV = _mm_sub_ps(maxValue, minValue);
+			const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+			for (int iteration = 0; iteration < 8; iteration++) {
+				// The covariance matrix is symmetric, so the product with the axis is the sum of the rows scaled by the axis' components
+				__m128 next = _mm_mul_ps(rows[0], _mm_shuffle_ps(axisV, axisV, _MM_SHUFFLE(0, 0, 0, 0)));
+				next = _mm_add_ps(next, _mm_mul_ps(rows[1], _mm_shuffle_ps(axisV, axisV, _MM_SHUFFLE(1, 1, 1, 1))));
+				next = _mm_add_ps(next, _mm_mul_ps(rows[2], _mm_shuffle_ps(axisV, axisV, _MM_SHUFFLE(2, 2, 2, 2))));
+				next = _mm_add_ps(next, _mm_mul_ps(rows[3], _mm_shuffle_ps(axisV, axisV, _MM_SHUFFLE(3, 3, 3, 3))));
+				__m128 length = _mm_and_ps(next, absMask);
+				length = _mm_max_ps(length, _mm_shuffle_ps(length, length, _MM_SHUFFLE(1, 0, 3, 2)));
+				length = _mm_max_ps(length, _mm_shuffle_ps(length, length, _MM_SHUFFLE(2, 3, 0, 1)));
+				if (_mm_cvtss_f32(length) < 1e-6f) {
+					break;
+				}
+				axisV = _mm_div_ps(next, length);
+			}
+			_mm_storeu_ps(meanLanes, meanV);
+			_mm_storeu_ps(axisLanes, axisV);
+#else
+			const uint32x4_t mask = vcombine_u32(vdup_n_u32(UINT32_MAX), vcreate_u32((N == 4) ? UINT64_MAX : 0xFFFFFFFFull));
+			float32x4_t sum = vdupq_n_f32(0.0f);
+			float32x4_t minValue = vdupq_n_f32(255.0f);
+			float32x4_t maxValue = vdupq_n_f32(0.0f);
+			for (int i = 0; i < 16; i++) {
+				const float32x4_t p = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(vld1q_f32(points[i])), mask));
+				sum = vaddq_f32(sum, p);
+				minValue = vminq_f32(minValue, p);
+				maxValue = vmaxq_f32(maxValue, p);
+			}
+			const float32x4_t meanV = vmulq_n_f32(sum, 1.0f / 16.0f);
+			float32x4_t rows[4] = { vdupq_n_f32(0.0f), vdupq_n_f32(0.0f), vdupq_n_f32(0.0f), vdupq_n_f32(0.0f) };
+			for (int i = 0; i < 16; i++) {
+				const float32x4_t d = vsubq_f32(vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(vld1q_f32(points[i])), mask)), meanV);
+				rows[0] = vaddq_f32(rows[0], vmulq_laneq_f32(d, d, 0));
+				rows[1] = vaddq_f32(rows[1], vmulq_laneq_f32(d, d, 1));
+				rows[2] = vaddq_f32(rows[2], vmulq_laneq_f32(d, d, 2));
+				rows[3] = vaddq_f32(rows[3], vmulq_laneq_f32(d, d, 3));
+			}
+			float32x4_t axisV = vsubq_f32(maxValue, minValue);
+			for (int iteration = 0; iteration < 8; iteration++) {
+				float32x4_t next = vmulq_laneq_f32(rows[0], axisV, 0);
+				next = vaddq_f32(next, vmulq_laneq_f32(rows[1], axisV, 1));
+				next = vaddq_f32(next, vmulq_laneq_f32(rows[2], axisV, 2));
+				next = vaddq_f32(next, vmulq_laneq_f32(rows[3], axisV, 3));
+				const float length = vmaxvq_f32(vabsq_f32(next));
+				if (length < 1e-6f) {
+					break;
+				}
+				axisV = vdivq_f32(next, vdupq_n_f32(length));
+			}
+			vst1q_f32(meanLanes, meanV);
+			vst1q_f32(axisLanes, axisV);
+#endif
+			for (int c = 0; c < N; c++) {
+				mean[c] = meanLanes[c];
+				axis[c] = axisLanes[c];
+			}
+#else
+			float minValue[N], maxValue[N];
+			for (int c = 0; c < N; c++) {
+				mean[c] = 0.0f;
+				minValue[c] = 255.0f;
+				maxValue[c] = 0.0f;
+			}
+			for (int i = 0; i < 16; i++) {
+				for (int c = 0; c < N; c++) {
+					mean[c] += points[i][c];
+					minValue[c] = std::min(minValue[c], points[i][c]);
+					maxValue[c] = std::max(maxValue[c], points[i][c]);
+				}
+			}
+			for (int c = 0; c < N; c++) {
+				mean[c] /= 16.0f;
+			}
+			float covariance[N][N] = {};
+			for (int i = 0; i < 16; i++) {
+				for (int a = 0; a < N; a++) {
+					for (int b = a; b < N; b++) {
+						covariance[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+					}
+				}
+			}
+			for (int a = 0; a < N; a++) {
+				for (int b = 0; b < a; b++) {
+					covariance[a][b] = covariance[b][a];
+				}
+			}
+			for (int c = 0; c < N; c++) {
+				axis[c] = maxValue[c] - minValue[c];
+			}
+			for (int iteration = 0; iteration < 8; iteration++) {
+				float next[N] = {};
+				float length = 0.0f;
+				for (int a = 0; a < N; a++) {
+					for (int b = 0; b < N; b++) {
+						next[a] += covariance[a][b] * axis[b];
+					}
+					length = std::max(length, std::fabs(next[a]));
+				}
+				if (length < 1e-6f) {
+					break;
+				}
+				for (int c = 0; c < N; c++) {
+					axis[c] = next[c] / length;
+				}
+			}
+#endif
+		}
+
+		// Endpoints spanning the projection of all points onto the principal axis
+		template <int N>
+		void fitEndpoints(const float points[16][4], float e0[N], float e1[N])
+		{
+			float mean[N], axis[N];
+			principalAxis<N>(points, mean, axis);
+			float tMin = 0.0f, tMax = 0.0f;
+#if defined(TEXTURECOMPRESSOR_SSE2)
+			// Projections of four points at once, with the points transposed into one register per channel
+			__m128 tMinV = _mm_setzero_ps();
+			__m128 tMaxV = _mm_setzero_ps();
+			for (int i = 0; i < 16; i += 4) {
+				__m128 channels[4] = { _mm_loadu_ps(points[i]), _mm_loadu_ps(points[i + 1]), _mm_loadu_ps(points[i + 2]), _mm_loadu_ps(points[i + 3]) };
+				_MM_TRANSPOSE4_PS(channels[0], channels[1], channels[2], channels[3]);
+				__m128 t = _mm_setzero_ps();
+				for (int c = 0; c < N; c++) {
+					t = _mm_add_ps(t, _mm_mul_ps(_mm_sub_ps(channels[c], _mm_set1_ps(mean[c])), _mm_set1_ps(axis[c])));
+				}
+				tMinV = _mm_min_ps(tMinV, t);
+				tMaxV = _mm_max_ps(tMaxV, t);
+			}
+			float tMins[4], tMaxs[4];
+			_mm_storeu_ps(tMins, tMinV);
+			_mm_storeu_ps(tMaxs, tMaxV);
+			for (int i = 0; i < 4; i++) {
+				tMin = std::min(tMin, tMins[i]);
+				tMax = std::max(tMax, tMaxs[i]);
+			}
+#elif defined(TEXTURECOMPRESSOR_NEON)
+			float32x4_t tMinV = vdupq_n_f32(0.0f);
+			float32x4_t tMaxV = vdupq_n_f32(0.0f);
+			for (int i = 0; i < 16; i += 4) {
+				const float32x4x4_t channels = vld4q_f32(points[i]);
+				float32x4_t t = vdupq_n_f32(0.0f);
+				for (int c = 0; c < N; c++) {
+					t = vaddq_f32(t, vmulq_n_f32(vsubq_f32(channels.val[c], vdupq_n_f32(mean[c])), axis[c]));
+				}
+				tMinV = vminq_f32(tMinV, t);
+				tMaxV = vmaxq_f32(tMaxV, t);
+			}
+			tMin = vminvq_f32(tMinV);
+			tMax = vmaxvq_f32(tMaxV);
+#else
+			for (int i = 0; i < 16; i++) {
+				float t = 0.0f;
+				for (int c = 0; c < N; c++) {
+					t += (points[i][c] - mean[c]) * axis[c];
+				}
+				tMin = std::min(tMin, t);
+				tMax = std::max(tMax, t);
+			}
+#endif
+			float lengthSquared = 0.0f;
+			for (int c = 0; c < N; c++) {
+				lengthSquared += axis[c] * axis[c];
+			}
+			if (lengthSquared > 0.0f) {
+				tMin /= lengthSquared;
+				tMax /= lengthSquared;
+			}
+			for (int c = 0; c < N; c++) {
+				e0[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * tMin));
+				e1[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * tMax));
+			}
+		}
+
+		// Least squares endpoints for fixed interpolation weights (weight of e1 per point)
+		template <int N>
+		bool refineEndpoints(const float points[16][4], const float weights[16], float e0[N], float e1[N])
+		{
+			float a = 0.0f, b = 0.0f, c = 0.0f;
+			float x[N] = {}, y[N] = {};
+			for (int i = 0; i < 16; i++) {
+				const float w = weights[i];
+				a += (1.0f - w) * (1.0f - w);
+				b += (1.0f - w) * w;
+				c += w * w;
+				for (int k = 0; k < N; k++) {
+					x[k] += (1.0f - w) * points[i][k];
+					y[k] += w * points[i][k];
+				}
+			}
+			const float det = a * c - b * b;
+			if (std::fabs(det) < 1e-6f) {
+				return false;
+			}
+			for (int k = 0; k < N; k++) {
+				e0[k] = std::min(255.0f, std::max(0.0f, (c * x[k] - b * y[k]) / det));
+				e1[k] = std::min(255.0f, std::max(0.0f, (a * y[k] - b * x[k]) / det));
+			}
+			return true;
+		}
+
+		void loadPoints(const uint8_t* pixels, float points[16][4])
+		{
+			for (int i = 0; i < 16; i++) {
+				for (int c = 0; c < 4; c++) {
+					points[i][c] = static_cast<float>(pixels[i * 4 + c]);
+				}
+			}
+		}
+
+		// BC1
+
+		uint16_t packRGB565(const float color[3])
+		{
+			const uint32_t r = static_cast<uint32_t>(color[0] * 31.0f / 255.0f + 0.5f);
+			const uint32_t g = static_cast<uint32_t>(color[1] * 63.0f / 255.0f + 0.5f);
+			const uint32_t b = static_cast<uint32_t>(color[2] * 31.0f / 255.0f + 0.5f);
+			return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+		}
+
+		void unpackRGB565(uint16_t color, int rgb[3])
+		{
+			const int r = (color >> 11) & 31;
+			const int g = (color >> 5) & 63;
+			const int b = color & 31;
+			rgb[0] = (r << 3) | (r >> 2);
+			rgb[1] = (g << 2) | (g >> 4);
+			rgb[2] = (b << 3) | (b >> 2);
+		}
+
+#if defined(TEXTURECOMPRESSOR_SSE2)
+		// Squared RGB errors of four pixels (unpacked to 16 bit, alpha masked out) to a palette color given as two 16 bit RGB0 values
+		inline __m128i colorErrors(__m128i low, __m128i high, __m128i color)
+		{
+			const __m128i dLow = _mm_sub_epi16(low, color);
+			const __m128i dHigh = _mm_sub_epi16(high, color);
+			// Pairs of channels per pixel (rg, b0), summed after separating them into even and odd lanes
+			const __m128 eLow = _mm_castsi128_ps(_mm_madd_epi16(dLow, dLow));
+			const __m128 eHigh = _mm_castsi128_ps(_mm_madd_epi16(dHigh, dHigh));
+			const __m128i even = _mm_castps_si128(_mm_shuffle_ps(eLow, eHigh, _MM_SHUFFLE(2, 0, 2, 0)));
+			const __m128i odd = _mm_castps_si128(_mm_shuffle_ps(eLow, eHigh, _MM_SHUFFLE(3, 1, 3, 1)));
+			return _mm_add_epi32(even, odd);
+		}
+#elif defined(TEXTURECOMPRESSOR_NEON)
+		inline int32x4_t colorErrors(int16x8_t low, int16x8_t high, int16x8_t color)
+		{
+			const int16x8_t dLow = vsubq_s16(low, color);
+			const int16x8_t dHigh = vsubq_s16(high, color);
+			const int32x4_t e01 = vpaddq_s32(vmull_s16(vget_low_s16(dLow), vget_low_s16(dLow)), vmull_high_s16(dLow, dLow));
+			const int32x4_t e23 = vpaddq_s32(vmull_s16(vget_low_s16(dHigh), vget_low_s16(dHigh)), vmull_high_s16(dHigh, dHigh));
+			return vpaddq_s32(e01, e23);
+		}
+#endif
+
+		// Squared errors of all pixels to their closest palette color, writes the index of that color for each pixel
+		uint32_t matchPalette(const uint8_t* pixels, const int palette[][3], uint32_t paletteSize, uint32_t indices[16])
+		{
+			uint32_t error = 0;
+#if defined(TEXTURECOMPRESSOR_SSE2)
+			const __m128i alphaMask = _mm_set1_epi32(0x00FFFFFF);
+			const __m128i zero = _mm_setzero_si128();
+			__m128i colors[4];
+			for (uint32_t p = 0; p < paletteSize; p++) {
+				colors[p] = _mm_setr_epi16(static_cast<short>(palette[p][0]), static_cast<short>(palette[p][1]), static_cast<short>(palette[p][2]), 0, static_cast<short>(palette[p][0]), static_cast<short>(palette[p][1]), static_cast<short>(palette[p][2]), 0);
+			}
+			for (int i = 0; i < 16; i += 4) {
+				const __m128i pixelData = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i * 4)), alphaMask);
+				const __m128i low = _mm_unpacklo_epi8(pixelData, zero);
+				const __m128i high = _mm_unpackhi_epi8(pixelData, zero);
+				__m128i bestError = colorErrors(low, high, colors[0]);
+				__m128i bestIndex = zero;
+				for (uint32_t p = 1; p < paletteSize; p++) {
+					const __m128i e = colorErrors(low, high, colors[p]);
+					const __m128i less = _mm_cmplt_epi32(e, bestError);
+					bestError = _mm_or_si128(_mm_and_si128(less, e), _mm_andnot_si128(less, bestError));
+					bestIndex = _mm_or_si128(_mm_and_si128(less, _mm_set1_epi32(static_cast<int>(p))), _mm_andnot_si128(less, bestIndex));
+				}
+				uint32_t errors[4];
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(errors), bestError);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(indices + i), bestIndex);
+				error += errors[0] + errors[1] + errors[2] + errors[3];
+			}
+#elif defined(TEXTURECOMPRESSOR_NEON)
+			const uint8x16_t alphaMask = vreinterpretq_u8_u32(vdupq_n_u32(0x00FFFFFF));
+			int16x8_t colors[4];
+			for (uint32_t p = 0; p < paletteSize; p++) {
+				const int16_t color[8] = { static_cast<int16_t>(palette[p][0]), static_cast<int16_t>(palette[p][1]), static_cast<int16_t>(palette[p][2]), 0, static_cast<int16_t>(palette[p][0]), static_cast<int16_t>(palette[p][1]), static_cast<int16_t>(palette[p][2]), 0 };
+				colors[p] = vld1q_s16(color);
+			}
+			for (int i = 0; i < 16; i += 4) {
+				const uint8x16_t pixelData = vandq_u8(vld1q_u8(pixels + i * 4), alphaMask);
+				const int16x8_t low = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(pixelData)));
+				const int16x8_t high = vreinterpretq_s16_u16(vmovl_high_u8(pixelData));
+				int32x4_t bestError = colorErrors(low, high, colors[0]);
+				uint32x4_t bestIndex = vdupq_n_u32(0);
+				for (uint32_t p = 1; p < paletteSize; p++) {
+					const int32x4_t e = colorErrors(low, high, colors[p]);
+					const uint32x4_t less = vcltq_s32(e, bestError);
+					bestError = vbslq_s32(less, e, bestError);
+					bestIndex = vbslq_u32(less, vdupq_n_u32(p), bestIndex);
+				}
+				vst1q_u32(indices + i, bestIndex);
+				error += static_cast<uint32_t>(vaddvq_s32(bestError));
+			}
+#else
+			for (int i = 0; i < 16; i++) {
+				uint32_t bestError = UINT32_MAX;
+				uint32_t bestIndex = 0;
+				for (uint32_t p = 0; p < paletteSize; p++) {
+					uint32_t e = 0;
+					for (int c = 0; c < 3; c++) {
+						const int d = static_cast<int>(pixels[i * 4 + c]) - palette[p][c];
+						e += static_cast<uint32_t>(d * d);
+					}
+					if (e < bestError) {
+						bestError = e;
+						bestIndex = p;
+					}
+				}
+				indices[i] = bestIndex;
+				error += bestError;
+			}
+#endif
+			return error;
+		}
+
+		// Encodes a four color BC1 block for the given endpoints and returns the squared error
+		uint32_t encodeBC1(const uint8_t* pixels, const float e0[3], const float e1[3], uint8_t* block)
+		{
+			uint16_t c0 = packRGB565(e0);
+			uint16_t c1 = packRGB565(e1);
+			if (c0 < c1) {
+				std::swap(c0, c1);
+			}
+			uint32_t indices = 0;
+			uint32_t error = 0;
+			if (c0 != c1) {
+				int palette[4][3];
+				unpackRGB565(c0, palette[0]);
+				unpackRGB565(c1, palette[1]);
+				for (int c = 0; c < 3; c++) {
+					palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+					palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+				}
+				uint32_t pixelIndices[16];
+				error = matchPalette(pixels, palette, 4, pixelIndices);
+				for (int i = 0; i < 16; i++) {
+					indices |= pixelIndices[i] << (i * 2);
+				}
+			} else {
+				int color[1][3];
+				unpackRGB565(c0, color[0]);
+				uint32_t pixelIndices[16];
+				error = matchPalette(pixels, color, 1, pixelIndices);
+			}
+			block[0] = static_cast<uint8_t>(c0 & 0xFF);
+			block[1] = static_cast<uint8_t>(c0 >> 8);
+			block[2] = static_cast<uint8_t>(c1 & 0xFF);
+			block[3] = static_cast<uint8_t>(c1 >> 8);
+			memcpy(block + 4, &indices, 4);
+			return error;
+		}
+
+		// BC4
+
+		void encodeBC4(const uint8_t* pixels, uint32_t channel, uint8_t* block)
+		{
+			int minValue = 255, maxValue = 0;
+#if defined(TEXTURECOMPRESSOR_SSE2)
+			// The channel of all 16 pixels in one register, shifted into the low byte of each pixel and packed
+			const __m128i shift = _mm_cvtsi32_si128(static_cast<int>(channel * 8));
+			const __m128i byteMask = _mm_set1_epi32(0xFF);
+			const __m128i* source = reinterpret_cast<const __m128i*>(pixels);
+			const __m128i p0 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(source + 0), shift), byteMask);
+			const __m128i p1 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(source + 1), shift), byteMask);
+			const __m128i p2 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(source + 2), shift), byteMask);
+			const __m128i p3 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(source + 3), shift), byteMask);
+			const __m128i values = _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3));
+			__m128i minV = _mm_min_epu8(values, _mm_srli_si128(values, 8));
+			__m128i maxV = _mm_max_epu8(values, _mm_srli_si128(values, 8));
+			minV = _mm_min_epu8(minV, _mm_srli_si128(minV, 4));
+			maxV = _mm_max_epu8(maxV, _mm_srli_si128(maxV, 4));
+			minV = _mm_min_epu8(minV, _mm_srli_si128(minV, 2));
+			maxV = _mm_max_epu8(maxV, _mm_srli_si128(maxV, 2));
+			minV = _mm_min_epu8(minV, _mm_srli_si128(minV, 1));
+			maxV = _mm_max_epu8(maxV, _mm_srli_si128(maxV, 1));
+			minValue = _mm_cvtsi128_si32(minV) & 0xFF;
+			maxValue = _mm_cvtsi128_si32(maxV) & 0xFF;
+#elif defined(TEXTURECOMPRESSOR_NEON)
+			const uint8x16_t values = vld4q_u8(pixels).val[channel];
+			minValue = vminvq_u8(values);
+			maxValue = vmaxvq_u8(values);
+#else
+			for (int i = 0; i < 16; i++) {
+				const int v = pixels[i * 4 + channel];
+				minValue = std::min(minValue, v);
+				maxValue = std::max(maxValue, v);
+			}
+#endif
+			memset(block, 0, 8);
+			block[0] = static_cast<uint8_t>(maxValue);
+			block[1] = static_cast<uint8_t>(minValue);
+			if (minValue == maxValue) {
+				return;
+			}
+			// Eight value mode (first endpoint larger than the second)
+			int palette[8];
+			palette[0] = maxValue;
+			palette[1] = minValue;
+			for (int k = 2; k < 8; k++) {
+				palette[k] = ((8 - k) * maxValue + (k - 1) * minValue + 3) / 7;
+			}
+			uint64_t indices = 0;
+#if defined(TEXTURECOMPRESSOR_SSE2) || defined(TEXTURECOMPRESSOR_NEON)
+			// Absolute differences of all 16 pixels to one palette entry at a time
+			uint8_t pixelIndices[16];
+#if defined(TEXTURECOMPRESSOR_SSE2)
+			// Unsigned bytes are compared as signed values after flipping their sign bit
+			const __m128i sign = _mm_set1_epi8(static_cast<char>(0x80));
+			__m128i bestError = _mm_set1_epi8(static_cast<char>(0xFF));
+			__m128i bestIndex = _mm_setzero_si128();
+			for (int k = 0; k < 8; k++) {
+				const __m128i entry = _mm_set1_epi8(static_cast<char>(palette[k]));
+				const __m128i e = _mm_or_si128(_mm_subs_epu8(values, entry), _mm_subs_epu8(entry, values));
+				const __m128i less = (k == 0) ? _mm_set1_epi8(-1) : _mm_cmplt_epi8(_mm_xor_si128(e, sign), _mm_xor_si128(bestError, sign));
+				bestError = _mm_or_si128(_mm_and_si128(less, e), _mm_andnot_si128(less, bestError));
+				bestIndex = _mm_or_si128(_mm_and_si128(less, _mm_set1_epi8(static_cast<char>(k))), _mm_andnot_si128(less, bestIndex));
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pixelIndices), bestIndex);
+#else
+			uint8x16_t bestError = vabdq_u8(values, vdupq_n_u8(static_cast<uint8_t>(palette[0])));
+			uint8x16_t bestIndex = vdupq_n_u8(0);
+			for (int k = 1; k < 8; k++) {
+				const uint8x16_t e = vabdq_u8(values, vdupq_n_u8(static_cast<uint8_t>(palette[k])));
+				const uint8x16_t less = vcltq_u8(e, bestError);
+				bestError = vbslq_u8(less, e, bestError);
+				bestIndex = vbslq_u8(less, vdupq_n_u8(static_cast<uint8_t>(k)), bestIndex);
+			}
+			vst1q_u8(pixelIndices, bestIndex);
+#endif
+			for (int i = 0; i < 16; i++) {
+				indices |= static_cast<uint64_t>(pixelIndices[i]) << (i * 3);
+			}
+#else
+			for (int i = 0; i < 16; i++) {
+				const int v = pixels[i * 4 + channel];
+				uint64_t bestIndex = 0;
+				int bestError = 256;
+				for (int k = 0; k < 8; k++) {
+					const int e = std::abs(v - palette[k]);
+					if (e < bestError) {
+						bestError = e;
+						bestIndex = static_cast<uint64_t>(k);
+					}
+				}
+				indices |= bestIndex << (i * 3);
+			}
+#endif
+			for (int i = 0; i < 6; i++) {
+				block[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+			}
+		}
+
+		// BC7 (mode 6: single subset, RGBA 7.7.7.7 endpoints with unique p-bits, 4 bit indices)
+
+		const int bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		struct BC7Mode6 {
+			int endpoints[2][4];
+			int pbits[2];
+			uint8_t indices[16];
+			uint32_t error;
+		};
+
+		void quantizeBC7(const float e0[4], const float e1[4], int p0, int p1, BC7Mode6& result)
+		{
+			const float* source[2] = { e0, e1 };
+			const int pbits[2] = { p0, p1 };
+			for (int e = 0; e < 2; e++) {
+				for (int c = 0; c < 4; c++) {
+					const int q = static_cast<int>(std::floor((source[e][c] - pbits[e]) * 0.5f + 0.5f));
+					result.endpoints[e][c] = std::min(127, std::max(0, q));
+				}
+				result.pbits[e] = pbits[e];
+			}
+		}
+
+		void evaluateBC7(const uint8_t* pixels, BC7Mode6& result)
+		{
+			int expanded[2][4];
+			for (int e = 0; e < 2; e++) {
+				for (int c = 0; c < 4; c++) {
+					expanded[e][c] = (result.endpoints[e][c] << 1) | result.pbits[e];
+				}
+			}
+			int palette[16][4];
+			for (int i = 0; i < 16; i++) {
+				for (int c = 0; c < 4; c++) {
+					palette[i][c] = ((64 - bc7Weights[i]) * expanded[0][c] + bc7Weights[i] * expanded[1][c] + 32) >> 6;
+				}
+			}
+			// The palette lies on a line, so only the entries around the projection of each pixel need to be checked
+			int direction[4];
+			int lengthSquared = 0;
+			for (int c = 0; c < 4; c++) {
+				direction[c] = expanded[1][c] - expanded[0][c];
+				lengthSquared += direction[c] * direction[c];
+			}
+			result.error = 0;
+#if defined(TEXTURECOMPRESSOR_SSE2) || defined(TEXTURECOMPRESSOR_NEON)
+			// 16 bit palette with two padding entries, so the errors of three consecutive entries are computed with two loads
+			int16_t palette16[18][4] = {};
+			for (int p = 0; p < 16; p++) {
+				for (int c = 0; c < 4; c++) {
+					palette16[p][c] = static_cast<int16_t>(palette[p][c]);
+				}
+			}
+#if defined(TEXTURECOMPRESSOR_SSE2)
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i origin = _mm_setr_epi16(static_cast<short>(expanded[0][0]), static_cast<short>(expanded[0][1]), static_cast<short>(expanded[0][2]), static_cast<short>(expanded[0][3]), 0, 0, 0, 0);
+			const __m128i directionV = _mm_setr_epi16(static_cast<short>(direction[0]), static_cast<short>(direction[1]), static_cast<short>(direction[2]), static_cast<short>(direction[3]), 0, 0, 0, 0);
+#else
+			const int16x4_t origin = { static_cast<int16_t>(expanded[0][0]), static_cast<int16_t>(expanded[0][1]), static_cast<int16_t>(expanded[0][2]), static_cast<int16_t>(expanded[0][3]) };
+			const int16x4_t directionV = { static_cast<int16_t>(direction[0]), static_cast<int16_t>(direction[1]), static_cast<int16_t>(direction[2]), static_cast<int16_t>(direction[3]) };
+#endif
+			for (int i = 0; i < 16; i++) {
+				int32_t pixel;
+				memcpy(&pixel, pixels + i * 4, 4);
+				int errors[3];
+				int first = 0, last = 0;
+#if defined(TEXTURECOMPRESSOR_SSE2)
+				const __m128i pixelV = _mm_unpacklo_epi8(_mm_cvtsi32_si128(pixel), zero);
+				if (lengthSquared > 0) {
+					const __m128i dot = _mm_madd_epi16(_mm_sub_epi16(pixelV, origin), directionV);
+					const int estimate = std::min(15, std::max(0, (_mm_cvtsi128_si32(_mm_add_epi32(dot, _mm_srli_si128(dot, 4))) * 15 * 2 + lengthSquared) / (lengthSquared * 2)));
+					first = std::max(0, estimate - 1);
+					last = std::min(15, estimate + 1);
+				}
+				const __m128i pixelPair = _mm_unpacklo_epi64(pixelV, pixelV);
+				const __m128i d01 = _mm_sub_epi16(pixelPair, _mm_loadu_si128(reinterpret_cast<const __m128i*>(palette16[first])));
+				const __m128i d2 = _mm_sub_epi16(pixelPair, _mm_loadl_epi64(reinterpret_cast<const __m128i*>(palette16[first + 2])));
+				const __m128 e01 = _mm_castsi128_ps(_mm_madd_epi16(d01, d01));
+				const __m128 e2 = _mm_castsi128_ps(_mm_madd_epi16(d2, d2));
+				int sums[4];
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(sums), _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(e01, e2, _MM_SHUFFLE(2, 0, 2, 0))), _mm_castps_si128(_mm_shuffle_ps(e01, e2, _MM_SHUFFLE(3, 1, 3, 1)))));
+				errors[0] = sums[0];
+				errors[1] = sums[1];
+				errors[2] = sums[2];
+#else
+				const int16x4_t pixelV = vreinterpret_s16_u16(vget_low_u16(vmovl_u8(vcreate_u8(static_cast<uint32_t>(pixel)))));
+				if (lengthSquared > 0) {
+					const int dot = vaddvq_s32(vmull_s16(vsub_s16(pixelV, origin), directionV));
+					const int estimate = std::min(15, std::max(0, (dot * 15 * 2 + lengthSquared) / (lengthSquared * 2)));
+					first = std::max(0, estimate - 1);
+					last = std::min(15, estimate + 1);
+				}
+				for (int k = 0; k < 3; k++) {
+					const int16x4_t d = vsub_s16(pixelV, vld1_s16(palette16[first + k]));
+					errors[k] = vaddvq_s32(vmull_s16(d, d));
+				}
+#endif
+				uint32_t bestError = UINT32_MAX;
+				uint8_t bestIndex = 0;
+				for (int p = first; p <= last; p++) {
+					const uint32_t e = static_cast<uint32_t>(errors[p - first]);
+					if (e < bestError) {
+						bestError = e;
+						bestIndex = static_cast<uint8_t>(p);
+					}
+				}
+				result.indices[i] = bestIndex;
+				result.error += bestError;
+			}
+#else
+			for (int i = 0; i < 16; i++) {
+				int first = 0, last = 0;
+				if (lengthSquared > 0) {
+					int dot = 0;
+					for (int c = 0; c < 4; c++) {
+						dot += (static_cast<int>(pixels[i * 4 + c]) - expanded[0][c]) * direction[c];
+					}
+					const int estimate = std::min(15, std::max(0, (dot * 15 * 2 + lengthSquared) / (lengthSquared * 2)));
+					first = std::max(0, estimate - 1);
+					last = std::min(15, estimate + 1);
+				}
+				uint32_t bestError = UINT32_MAX;
+				uint8_t bestIndex = 0;
+				for (int p = first; p <= last; p++) {
+					uint32_t e = 0;
+					for (int c = 0; c < 4; c++) {
+						const int d = static_cast<int>(pixels[i * 4 + c]) - palette[p][c];
+						e += static_cast<uint32_t>(d * d);
+					}
+					if (e < bestError) {
+						bestError = e;
+						bestIndex = static_cast<uint8_t>(p);
+					}
+				}
+				result.indices[i] = bestIndex;
+				result.error += bestError;
+			}
+#endif
+		}
+
+		void searchBC7(const uint8_t* pixels, const float e0[4], const float e1[4], bool quality, BC7Mode6& best)
+		{
+			// Fast only tries matching p-bits, quality tries all four combinations
+			const int combinations = quality ? 4 : 2;
+			for (int i = 0; i < combinations; i++) {
+				const int p0 = quality ? (i & 1) : i;
+				const int p1 = quality ? (i >> 1) : i;
+				BC7Mode6 candidate;
+				quantizeBC7(e0, e1, p0, p1, candidate);
+				evaluateBC7(pixels, candidate);
+				if (candidate.error < best.error) {
+					best = candidate;
+				}
+			}
+		}
+
+		void writeBC7(BC7Mode6& mode, uint8_t* block)
+		{
+			// The most significant bit of the first index is implicitly zero
+			if (mode.indices[0] & 8) {
+				for (int c = 0; c < 4; c++) {
+					std::swap(mode.endpoints[0][c], mode.endpoints[1][c]);
+				}
+				std::swap(mode.pbits[0], mode.pbits[1]);
+				for (int i = 0; i < 16; i++) {
+					mode.indices[i] = static_cast<uint8_t>(15 - mode.indices[i]);
+				}
+			}
+			memset(block, 0, 16);
+			BitWriter writer(block);
+			writer.write(1u << 6, 7);
+			for (int c = 0; c < 4; c++) {
+				writer.write(static_cast<uint32_t>(mode.endpoints[0][c]), 7);
+				writer.write(static_cast<uint32_t>(mode.endpoints[1][c]), 7);
+			}
+			writer.write(static_cast<uint32_t>(mode.pbits[0]), 1);
+			writer.write(static_cast<uint32_t>(mode.pbits[1]), 1);
+			writer.write(mode.indices[0], 3);
+			for (int i = 1; i < 16; i++) {
+				writer.write(mode.indices[i], 4);
+			}
+		}
+
+		// KTX2 cache
+
+		const uint8_t ktx2Identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+		struct KTX2Header {
+			uint8_t identifier[12];
+			uint32_t vkFormat;
+			uint32_t typeSize;
+			uint32_t pixelWidth;
+			uint32_t pixelHeight;
+			uint32_t pixelDepth;
+			uint32_t layerCount;
+			uint32_t faceCount;
+			uint32_t levelCount;
+			uint32_t supercompressionScheme;
+			uint32_t dfdByteOffset;
+			uint32_t dfdByteLength;
+			uint32_t kvdByteOffset;
+			uint32_t kvdByteLength;
+			uint64_t sgdByteOffset;
+			uint64_t sgdByteLength;
+		};
+
+		struct KTX2LevelIndex {
+			uint64_t byteOffset;
+			uint64_t byteLength;
+			uint64_t uncompressedByteLength;
+		};
+
+		std::string getCacheFile(const uint8_t* rgba, uint32_t width, uint32_t height, TextureCompressor::Format format, bool srgb)
+		{
+			const uint32_t key[6] = { encoderVersion, width, height, static_cast<uint32_t>(format), srgb ? 1u : 0u, static_cast<uint32_t>(TextureCompressor::settings.preset) };
+			const uint64_t hash = hashBytes(rgba, static_cast<size_t>(width) * height * 4, hashBytes(key, sizeof(key)));
+			char name[32];
+			snprintf(name, sizeof(name), "%016llx.ktx2", static_cast<unsigned long long>(hash));
+			return TextureCompressor::settings.cacheDirectory + "/" + name;
+		}
+
+		// Basic data format descriptor for the block compressed formats written to the cache (all UNORM, linear transfer)
+		std::vector<uint32_t> getDataFormatDescriptor(TextureCompressor::Format format)
+		{
+			// KHR_DF_MODEL_BC1A, BC4, BC5, BC7
+			uint32_t colorModel = 128;
+			uint32_t sampleCount = 1;
+			switch (format) {
+			case TextureCompressor::Format::BC1: colorModel = 128; break;
+			case TextureCompressor::Format::BC4: colorModel = 131; break;
+			case TextureCompressor::Format::BC5: colorModel = 132; sampleCount = 2; break;
+			case TextureCompressor::Format::BC7: colorModel = 134; break;
+			}
+			const uint32_t bytesPerBlock = blockSize(format);
+			const uint32_t blockByteLength = 24 + 16 * sampleCount;
+			std::vector<uint32_t> dfd;
+			dfd.push_back(4 + blockByteLength);
+			dfd.push_back(0);
+			dfd.push_back(2 | (blockByteLength << 16));
+			dfd.push_back(colorModel | (1u << 8) | (1u << 16));
+			dfd.push_back(3 | (3 << 8));
+			dfd.push_back(bytesPerBlock);
+			dfd.push_back(0);
+			const uint32_t sampleBits = (sampleCount == 2) ? 64 : bytesPerBlock * 8;
+			for (uint32_t s = 0; s < sampleCount; s++) {
+				dfd.push_back((s * sampleBits) | ((sampleBits - 1) << 16) | (s << 24));
+				dfd.push_back(0);
+				dfd.push_back(0);
+				dfd.push_back(UINT32_MAX);
+			}
+			return dfd;
+		}
+
+		bool readCache(const std::string& filename, const TextureCompressor::Image& expected, TextureCompressor::Image& image)
+		{
+			std::ifstream file(filename, std::ios::binary | std::ios::ate);
+			if (!file.is_open()) {
+				return false;
+			}
+			const size_t fileSize = static_cast<size_t>(file.tellg());
+			if (fileSize < sizeof(KTX2Header)) {
+				return false;
+			}
+			std::vector<uint8_t> data(fileSize);
+			file.seekg(0, std::ios::beg);
+			file.read(reinterpret_cast<char*>(data.data()), fileSize);
+			if (!file) {
+				return false;
+			}
+			KTX2Header header;
+			memcpy(&header, data.data(), sizeof(header));
+			if ((memcmp(header.identifier, ktx2Identifier, sizeof(ktx2Identifier)) != 0) || (header.vkFormat != static_cast<uint32_t>(expected.format)) || (header.pixelWidth != expected.width) || (header.pixelHeight != expected.height) || (header.levelCount != static_cast<uint32_t>(expected.levels.size())) || (header.supercompressionScheme != 0)) {
+				return false;
+			}
+			if (sizeof(KTX2Header) + header.levelCount * sizeof(KTX2LevelIndex) > fileSize) {
+				return false;
+			}
+			image.format = expected.format;
+			image.width = expected.width;
+			image.height = expected.height;
+			image.levels.resize(header.levelCount);
+			for (uint32_t i = 0; i < header.levelCount; i++) {
+				KTX2LevelIndex level;
+				memcpy(&level, data.data() + sizeof(KTX2Header) + i * sizeof(KTX2LevelIndex), sizeof(level));
+				if ((level.byteLength != expected.levels[i].size()) || (level.byteOffset + level.byteLength > fileSize)) {
+					return false;
+				}
+				image.levels[i].assign(data.begin() + level.byteOffset, data.begin() + level.byteOffset + level.byteLength);
+			}
+			return true;
+		}
+
+		void writeCache(const std::string& filename, const TextureCompressor::Image& image, TextureCompressor::Format format)
+		{
+			const std::string& directory = TextureCompressor::settings.cacheDirectory;
+#if defined(_WIN32)
+			_mkdir(directory.c_str());
+#else
+			mkdir(directory.c_str(), 0755);
+#endif
+			const uint32_t levelCount = static_cast<uint32_t>(image.levels.size());
+			const std::vector<uint32_t> dfd = getDataFormatDescriptor(format);
+
+			KTX2Header header{};
+			memcpy(header.identifier, ktx2Identifier, sizeof(ktx2Identifier));
+			header.vkFormat = static_cast<uint32_t>(image.format);
+			header.typeSize = 1;
+			header.pixelWidth = image.width;
+			header.pixelHeight = image.height;
+			header.faceCount = 1;
+			header.levelCount = levelCount;
+			header.dfdByteOffset = static_cast<uint32_t>(sizeof(KTX2Header) + levelCount * sizeof(KTX2LevelIndex));
+			header.dfdByteLength = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+
+			// Level data is stored smallest level first, aligned to the block size
+			const uint64_t alignment = blockSize(format);
+			std::vector<KTX2LevelIndex> levelIndex(levelCount);
+			uint64_t offset = header.dfdByteOffset + header.dfdByteLength;
+			for (uint32_t i = levelCount; i-- > 0;) {
+				offset = (offset + alignment - 1) / alignment * alignment;
+				levelIndex[i].byteOffset = offset;
+				levelIndex[i].byteLength = image.levels[i].size();
+				levelIndex[i].uncompressedByteLength = image.levels[i].size();
+				offset += image.levels[i].size();
+			}
+
+			std::vector<uint8_t> data(static_cast<size_t>(offset), 0);
+			memcpy(data.data(), &header, sizeof(header));
+			memcpy(data.data() + sizeof(header), levelIndex.data(), levelCount * sizeof(KTX2LevelIndex));
+			memcpy(data.data() + header.dfdByteOffset, dfd.data(), header.dfdByteLength);
+			for (uint32_t i = 0; i < levelCount; i++) {
+				memcpy(data.data() + levelIndex[i].byteOffset, image.levels[i].data(), image.levels[i].size());
+			}
+
+			// Write to a temporary file first, so an interrupted write never leaves a truncated cache entry behind
+			const std::string tempFilename = filename + ".tmp";
+			{
+				std::ofstream file(tempFilename, std::ios::binary | std::ios::trunc);
+				if (!file.is_open()) {
+					std::cerr << "Could not write texture cache file " << tempFilename << std::endl;
+					return;
+				}
+				file.write(reinterpret_cast<const char*>(data.data()), data.size());
+			}
+			std::remove(filename.c_str());
+			if (std::rename(tempFilename.c_str(), filename.c_str()) != 0) {
+				std::remove(tempFilename.c_str());
+			}
+		}
+	}
+
+	VkFormat TextureCompressor::getFormat(Format format)
+	{
+		switch (format) {
+		case Format::BC1:
+			return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+		case Format::BC4:
+			return VK_FORMAT_BC4_UNORM_BLOCK;
+		case Format::BC5:
+			return VK_FORMAT_BC5_UNORM_BLOCK;
+		case Format::BC7:
+			return VK_FORMAT_BC7_UNORM_BLOCK;
+		}
+		return VK_FORMAT_UNDEFINED;
+	}
+
+	bool TextureCompressor::isSupported(vks::VulkanDevice* device, Format format)
+	{
+		if (!device->features.textureCompressionBC) {
+			return false;
+		}
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, getFormat(format), &formatProperties);
+		return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+	}
+
+	void TextureCompressor::encodeBlockBC1(const uint8_t* pixels, uint8_t* block, bool quality)
+	{
+		float points[16][4];
+		loadPoints(pixels, points);
+		float e0[3], e1[3];
+		fitEndpoints<3>(points, e0, e1);
+		uint32_t error = encodeBC1(pixels, e0, e1, block);
+		if (!quality || (error == 0)) {
+			return;
+		}
+		// Weight of the second endpoint for each palette entry (c0, c1, 2/3 c0 + 1/3 c1, 1/3 c0 + 2/3 c1)
+		const float paletteWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+		for (int iteration = 0; iteration < 2; iteration++) {
+			uint32_t indices;
+			memcpy(&indices, block + 4, 4);
+			float weights[16];
+			for (int i = 0; i < 16; i++) {
+				weights[i] = paletteWeights[(indices >> (i * 2)) & 3];
+			}
+			int c0[3], c1[3];
+			unpackRGB565(static_cast<uint16_t>(block[0] | (block[1] << 8)), c0);
+			unpackRGB565(static_cast<uint16_t>(block[2] | (block[3] << 8)), c1);
+			if ((c0[0] == c1[0]) && (c0[1] == c1[1]) && (c0[2] == c1[2])) {
+				return;
+			}
+			if (!refineEndpoints<3>(points, weights, e0, e1)) {
+				return;
+			}
+			uint8_t candidate[8];
+			const uint32_t candidateError = encodeBC1(pixels, e0, e1, candidate);
+			if (candidateError >= error) {
+				return;
+			}
+			memcpy(block, candidate, 8);
+			error = candidateError;
+		}
+	}
+
+	void TextureCompressor::encodeBlockBC4(const uint8_t* pixels, uint32_t channel, uint8_t* block)
+	{
+		encodeBC4(pixels, channel, block);
+	}
+
+	void TextureCompressor::encodeBlockBC5(const uint8_t* pixels, uint8_t* block)
+	{
+		encodeBC4(pixels, 0, block);
+		encodeBC4(pixels, 1, block + 8);
+	}
+
+	void TextureCompressor::encodeBlockBC7(const uint8_t* pixels, uint8_t* block, bool quality)
+	{
+		float points[16][4];
+		loadPoints(pixels, points);
+		float e0[4], e1[4];
+		fitEndpoints<4>(points, e0, e1);
+		BC7Mode6 best;
+		best.error = UINT32_MAX;
+		searchBC7(pixels, e0, e1, quality, best);
+		if (quality && (best.error > 0)) {
+			float weights[16];
+			for (int i = 0; i < 16; i++) {
+				weights[i] = bc7Weights[best.indices[i]] / 64.0f;
+			}
+			if (refineEndpoints<4>(points, weights, e0, e1)) {
+				searchBC7(pixels, e0, e1, quality, best);
+			}
+		}
+		writeBC7(best, block);
+	}
+
+	void TextureCompressor::downsample(const uint8_t* source, uint32_t sourceWidth, uint32_t sourceHeight, uint8_t* destination, uint32_t width, uint32_t height, uint32_t channels, bool srgb)
+	{
+		if ((channels == 4) && srgb) {
+			stbir_resize_uint8_srgb(source, sourceWidth, sourceHeight, 0, destination, width, height, 0, STBIR_RGBA);
+			return;
+		}
+		const stbir_pixel_layout layout = (channels == 1) ? STBIR_1CHANNEL : ((channels == 2) ? STBIR_2CHANNEL : STBIR_4CHANNEL);
+		stbir_resize_uint8_linear(source, sourceWidth, sourceHeight, 0, destination, width, height, 0, layout);
+	}
+
+	void TextureCompressor::resize(const uint8_t* source, uint32_t sourceWidth, uint32_t sourceHeight, uint8_t* destination, uint32_t width, uint32_t height, uint32_t channels, bool srgb)
+	{
+		// Layouts with alpha keep it linear for sRGB images and weight the color channels by it
+		stbir_pixel_layout layout = STBIR_4CHANNEL;
+		switch (channels) {
+		case 1:
+			layout = STBIR_1CHANNEL;
+			break;
+		case 2:
+			layout = srgb ? STBIR_RA : STBIR_2CHANNEL;
+			break;
+		case 3:
+			layout = STBIR_RGB;
+			break;
+		default:
+			layout = srgb ? STBIR_RGBA : STBIR_4CHANNEL;
+			break;
+		}
+
+		STBIR_RESIZE resize;
+		stbir_resize_init(&resize, source, static_cast<int>(sourceWidth), static_cast<int>(sourceHeight), 0, destination, static_cast<int>(width), static_cast<int>(height), 0, layout, srgb ? STBIR_TYPE_UINT8_SRGB : STBIR_TYPE_UINT8);
+		// Each split covers a band of output rows, the resizer may use fewer splits than requested for small images
+		ThreadPool& pool = ThreadPool::shared();
+		const int splits = stbir_build_samplers_with_splits(&resize, static_cast<int>(pool.threadCount() + 1));
+		if (splits == 0) {
+			throw std::runtime_error("Could not prepare resizing of a " + std::to_string(sourceWidth) + "x" + std::to_string(sourceHeight) + " image");
+		}
+		pool.parallelFor(static_cast<size_t>(splits), [&](size_t i) {
+			stbir_resize_extended_split(&resize, static_cast<int>(i), 1);
+		});
+		stbir_free_samplers(&resize);
+	}
+
+	bool TextureCompressor::limitSize(const uint8_t* pixels, uint32_t& width, uint32_t& height, uint32_t channels, bool srgb, std::vector<uint8_t>& resized)
+	{
+		const uint32_t maxSize = settings.maxSize;
+		if ((maxSize == 0) || (std::max(width, height) <= maxSize)) {
+			return false;
+		}
+		const double scale = static_cast<double>(maxSize) / static_cast<double>(std::max(width, height));
+		const uint32_t targetWidth = std::min(maxSize, std::max(1u, static_cast<uint32_t>(std::lround(width * scale))));
+		const uint32_t targetHeight = std::min(maxSize, std::max(1u, static_cast<uint32_t>(std::lround(height * scale))));
+		resized.resize(static_cast<size_t>(targetWidth) * targetHeight * channels);
+		resize(pixels, width, height, resized.data(), targetWidth, targetHeight, channels, srgb);
+		width = targetWidth;
+		height = targetHeight;
+		return true;
+	}
+
+	void TextureCompressor::generateMipChain(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channels, bool srgb, Image& image)
+	{
+		const uint32_t levelCount = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
+		image.width = width;
+		image.height = height;
+		image.levels.resize(levelCount);
+		image.levels[0].assign(pixels, pixels + static_cast<size_t>(width) * height * channels);
+		for (uint32_t level = 1; level < levelCount; level++) {
+			const uint32_t levelWidth = std::max(1u, width >> level);
+			const uint32_t levelHeight = std::max(1u, height >> level);
+			image.levels[level].resize(static_cast<size_t>(levelWidth) * levelHeight * channels);
+			downsample(image.levels[level - 1].data(), std::max(1u, width >> (level - 1)), std::max(1u, height >> (level - 1)), image.levels[level].data(), levelWidth, levelHeight, channels, srgb);
+		}
+	}
+
+	void TextureCompressor::compress(const uint8_t* rgba, uint32_t width, uint32_t height, Format format, bool srgb, Image& image)
+	{
+		const uint32_t levelCount = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
+		const uint32_t bytesPerBlock = blockSize(format);
+		image.format = getFormat(format);
+		image.width = width;
+		image.height = height;
+		image.levels.resize(levelCount);
+		for (uint32_t level = 0; level < levelCount; level++) {
+			const uint32_t levelWidth = std::max(1u, width >> level);
+			const uint32_t levelHeight = std::max(1u, height >> level);
+			image.levels[level].resize(static_cast<size_t>((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * bytesPerBlock);
+		}
+
+		std::string cacheFile;
+		if (!settings.cacheDirectory.empty()) {
+			cacheFile = getCacheFile(rgba, width, height, format, srgb);
+			Image cached;
+			if (readCache(cacheFile, image, cached)) {
+				image = std::move(cached);
+				return;
+			}
+		}
+
+		const bool quality = (settings.preset == Preset::Quality);
+		ThreadPool& pool = ThreadPool::shared();
+		std::vector<uint8_t> levelPixels;
+		std::vector<uint8_t> previousPixels;
+		for (uint32_t level = 0; level < levelCount; level++) {
+			const uint32_t levelWidth = std::max(1u, width >> level);
+			const uint32_t levelHeight = std::max(1u, height >> level);
+			const uint8_t* pixels = rgba;
+			if (level > 0) {
+				// Each level is downsampled from the previous one
+				const uint32_t previousWidth = std::max(1u, width >> (level - 1));
+				const uint32_t previousHeight = std::max(1u, height >> (level - 1));
+				const uint8_t* source = (level == 1) ? rgba : previousPixels.data();
+				levelPixels.resize(static_cast<size_t>(levelWidth) * levelHeight * 4);
+				downsample(source, previousWidth, previousHeight, levelPixels.data(), levelWidth, levelHeight, 4, srgb);
+				pixels = levelPixels.data();
+			}
+
+			const uint32_t blocksX = (levelWidth + 3) / 4;
+			const uint32_t blocksY = (levelHeight + 3) / 4;
+			uint8_t* output = image.levels[level].data();
+			pool.parallelFor(blocksY, [&](size_t by) {
+				uint8_t blockPixels[64];
+				for (uint32_t bx = 0; bx < blocksX; bx++) {
+					// Pixels outside of the image repeat the last row/column
+					for (uint32_t y = 0; y < 4; y++) {
+						const uint32_t py = std::min(static_cast<uint32_t>(by) * 4 + y, levelHeight - 1);
+						for (uint32_t x = 0; x < 4; x++) {
+							const uint32_t px = std::min(bx * 4 + x, levelWidth - 1);
+							memcpy(&blockPixels[(y * 4 + x) * 4], &pixels[(static_cast<size_t>(py) * levelWidth + px) * 4], 4);
+						}
+					}
+					uint8_t* block = output + (by * blocksX + bx) * bytesPerBlock;
+					switch (format) {
+					case Format::BC1:
+						encodeBlockBC1(blockPixels, block, quality);
+						break;
+					case Format::BC4:
+						encodeBlockBC4(blockPixels, 0, block);
+						break;
+					case Format::BC5:
+						encodeBlockBC5(blockPixels, block);
+						break;
+					case Format::BC7:
+						encodeBlockBC7(blockPixels, block, quality);
+						break;
+					}
+				}
+			});
+			if (level > 0) {
+				std::swap(previousPixels, levelPixels);
+			}
+		}
+
+		if (!cacheFile.empty()) {
+			writeCache(cacheFile, image, format);
+		}
+	}
+
+	VkDeviceSize TextureCompressor::upload(const Image& compressed, vks::VulkanDevice* device, VkQueue copyQueue, VkImage& image, VkDeviceMemory& memory)
+	{
+		const uint32_t levelCount = static_cast<uint32_t>(compressed.levels.size());
+		VkDeviceSize totalSize = 0;
+		for (auto& level : compressed.levels) {
+			totalSize += level.size();
+		}
+
+		VkMemoryAllocateInfo memAllocInfo{};
+		memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		VkMemoryRequirements memReqs{};
+
+		VkBuffer stagingBuffer;
+		VkDeviceMemory stagingMemory;
+
+		VkBufferCreateInfo bufferCreateInfo{};
+		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferCreateInfo.size = totalSize;
+		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
+		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
+		memAllocInfo.allocationSize = memReqs.size;
+		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
+		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
+
+		std::vector<VkBufferImageCopy> copyRegions(levelCount);
+		uint8_t* data;
+		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
+		VkDeviceSize offset = 0;
+		for (uint32_t i = 0; i < levelCount; i++) {
+			memcpy(data + offset, compressed.levels[i].data(), compressed.levels[i].size());
+			VkBufferImageCopy& region = copyRegions[i];
+			region = {};
+			region.bufferOffset = offset;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = i;
+			region.imageSubresource.layerCount = 1;
+			region.imageExtent.width = std::max(1u, compressed.width >> i);
+			region.imageExtent.height = std::max(1u, compressed.height >> i);
+			region.imageExtent.depth = 1;
+			offset += compressed.levels[i].size();
+		}
+		vkUnmapMemory(device->logicalDevice, stagingMemory);
+
+		VkImageCreateInfo imageCreateInfo{};
+		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = compressed.format;
+		imageCreateInfo.mipLevels = levelCount;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCreateInfo.extent = { compressed.width, compressed.height, 1 };
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
+		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
+		memAllocInfo.allocationSize = memReqs.size;
+		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &memory));
+		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, memory, 0));
+
+		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+		VkImageSubresourceRange subresourceRange = {};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.levelCount = levelCount;
+		subresourceRange.layerCount = 1;
+
+		{
+			VkImageMemoryBarrier imageMemoryBarrier{};
+			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			imageMemoryBarrier.srcAccessMask = 0;
+			imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			imageMemoryBarrier.image = image;
+			imageMemoryBarrier.subresourceRange = subresourceRange;
+			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		}
+
+		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+
+		{
+			VkImageMemoryBarrier imageMemoryBarrier{};
+			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			imageMemoryBarrier.image = image;
+			imageMemoryBarrier.subresourceRange = subresourceRange;
+			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		}
+
+		device->flushCommandBuffer(copyCmd, copyQueue, true);
+
+		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
+		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+
+		return memReqs.size;
+	}
+}
@@ -0,0 +1,94 @@
+/*
+* CPU block compression (BC1/BC4/BC5/BC7) for textures that are only available as 8 bit images (png, jpg)
+*
+* Encoded images are stored in a content hashed KTX2 cache, so later loads of the same image skip encoding
+* Also hosts the CPU side resizing and mip chain generation shared by the glTF and USDZ texture loaders
+*
+* This code is licensed under the MIT license(MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.hpp"
+
+namespace vks
+{
+	class TextureCompressor
+	{
+	public:
+		enum class Preset { None, Fast, Quality };
+		enum class Format { BC1, BC4, BC5, BC7 };
+
+		struct Settings {
+			// None disables compression, images are then uploaded as uncompressed RGBA8
+			Preset preset = Preset::None;
+			// Directory for the KTX2 cache, an empty string disables the cache
+			std::string cacheDirectory = "texture_cache";
+			// Images larger than this in either dimension are downscaled on load, 0 keeps the original size
+			uint32_t maxSize = 0;
+		};
+		static Settings settings;
+
+		// Block compressed image with a full mip chain, level 0 first
+		struct Image {
+			VkFormat format = VK_FORMAT_UNDEFINED;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			std::vector<std::vector<uint8_t>> levels;
+		};
+
+		static bool enabled() { return settings.preset != Preset::None; }
+		static VkFormat getFormat(Format format);
+		// Checks if the device can sample the given format
+		static bool isSupported(vks::VulkanDevice* device, Format format);
+
+		/**
+		* Generate the mip chain of an RGBA8 image and block compress all levels, or load the result from the cache
+		*
+		* @param rgba Tightly packed RGBA8 pixels
+		* @param format Target format, BC4 encodes red and BC5 red and green only
+		* @param srgb Downsample the color channels in sRGB space (the data itself stays UNORM)
+		*/
+		static void compress(const uint8_t* rgba, uint32_t width, uint32_t height, Format format, bool srgb, Image& image);
+
+		/**
+		* Build a full mip chain of an uncompressed 8 bit image on the CPU, used if the GPU can't generate mips for its format
+		*
+		* @note The caller sets the image format
+		*/
+		static void generateMipChain(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channels, bool srgb, Image& image);
+		static void downsample(const uint8_t* source, uint32_t sourceWidth, uint32_t sourceHeight, uint8_t* destination, uint32_t width, uint32_t height, uint32_t channels, bool srgb);
+
+		/**
+		* Resize an 8 bit image with the resize split over the shared thread pool
+		*
+		* @param srgb Filter the color channels in linear space, alpha is always treated as linear
+		*/
+		static void resize(const uint8_t* source, uint32_t sourceWidth, uint32_t sourceHeight, uint8_t* destination, uint32_t width, uint32_t height, uint32_t channels, bool srgb);
+
+		/**
+		* Downscale an 8 bit image that exceeds settings.maxSize in either dimension, keeping its aspect ratio
+		*
+		* @return True if the image was resized into resized, width and height are then updated to its new size
+		*/
+		static bool limitSize(const uint8_t* pixels, uint32_t& width, uint32_t& height, uint32_t channels, bool srgb, std::vector<uint8_t>& resized);
+
+		/**
+		* Create a device local image and upload all levels of an image (compressed or not)
+		*
+		* @return Size of the image memory allocation
+		*/
+		static VkDeviceSize upload(const Image& compressed, vks::VulkanDevice* device, VkQueue copyQueue, VkImage& image, VkDeviceMemory& memory);
+
+		// Encoding of single 4x4 blocks of RGBA8 pixels (64 bytes, row major)
+		static void encodeBlockBC1(const uint8_t* pixels, uint8_t* block, bool quality);
+		static void encodeBlockBC4(const uint8_t* pixels, uint32_t channel, uint8_t* block);
+		static void encodeBlockBC5(const uint8_t* pixels, uint8_t* block);
+		static void encodeBlockBC7(const uint8_t* pixels, uint8_t* block, bool quality);
+	};
+}
@@ -0,0 +1,377 @@
+/*
+* Feedback driven mip streaming for textures loaded from png and jpg files (glTF and USDZ)
+*
+* This code is licensed under the MIT license(MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <queue>
+#include <tuple>
+
+namespace vks
+{
+	TextureStreamer::Settings TextureStreamer::settings;
+
+	VkDeviceSize TextureStreamer::levelSize(const Entry& entry, uint32_t firstLevel)
+	{
+		VkDeviceSize size = 0;
+		for (size_t i = firstLevel; i < entry.source.levels.size(); i++) {
+			size += entry.source.levels[i].size();
+		}
+		return size;
+	}
+
+	void TextureStreamer::prepare(vks::VulkanDevice* device, VkQueue queue, uint32_t frameCount)
+	{
+		this->device = device;
+		this->queue = queue;
+		entries.resize(maxTextures);
+		feedback.resize(frameCount);
+		const VkDeviceSize bufferSize = maxTextures * sizeof(uint32_t);
+		for (auto& frame : feedback) {
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, bufferSize, &frame.buffer, &frame.memory));
+			VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, frame.memory, 0, bufferSize, 0, (void**)&frame.mapped));
+			memset(frame.mapped, 0xFF, bufferSize);
+			frame.descriptor = { frame.buffer, 0, bufferSize };
+			frame.firstLevels.resize(maxTextures, 0);
+		}
+	}
+
+	void TextureStreamer::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		for (int32_t slot = 0; slot < static_cast<int32_t>(entries.size()); slot++) {
+			if (entries[slot].used) {
+				remove(slot);
+			}
+		}
+		for (auto& frame : feedback) {
+			for (auto& resident : frame.retired) {
+				destroyResident(resident);
+			}
+			vkUnmapMemory(device->logicalDevice, frame.memory);
+			vkDestroyBuffer(device->logicalDevice, frame.buffer, nullptr);
+			vkFreeMemory(device->logicalDevice, frame.memory, nullptr);
+		}
+		feedback.clear();
+		entries.clear();
+		device = nullptr;
+	}
+
+	// Creates an image for the given first level and all coarser ones and submits the upload of these levels without waiting for it
+	void TextureStreamer::createResident(Entry& entry, uint32_t firstLevel, Upload& upload)
+	{
+		const TextureCompressor::Image& source = entry.source;
+		const uint32_t levelCount = static_cast<uint32_t>(source.levels.size()) - firstLevel;
+		const uint32_t width = std::max(1u, source.width >> firstLevel);
+		const uint32_t height = std::max(1u, source.height >> firstLevel);
+		const VkDeviceSize stagingSize = levelSize(entry, firstLevel);
+
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingSize, &upload.stagingBuffer, &upload.stagingMemory));
+
+		std::vector<VkBufferImageCopy> copyRegions(levelCount);
+		uint8_t* data;
+		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, upload.stagingMemory, 0, stagingSize, 0, (void**)&data));
+		VkDeviceSize offset = 0;
+		for (uint32_t i = 0; i < levelCount; i++) {
+			const std::vector<uint8_t>& level = source.levels[firstLevel + i];
+			memcpy(data + offset, level.data(), level.size());
+			VkBufferImageCopy& region = copyRegions[i];
+			region = {};
+			region.bufferOffset = offset;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = i;
+			region.imageSubresource.layerCount = 1;
+			region.imageExtent.width = std::max(1u, width >> i);
+			region.imageExtent.height = std::max(1u, height >> i);
+			region.imageExtent.depth = 1;
+			offset += level.size();
+		}
+		vkUnmapMemory(device->logicalDevice, upload.stagingMemory);
+
+		Resident& resident = upload.resident;
+		resident.firstLevel = firstLevel;
+
+		VkImageCreateInfo imageCreateInfo{};
+		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = source.format;
+		imageCreateInfo.mipLevels = levelCount;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCreateInfo.extent = { width, height, 1 };
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &resident.image));
+		VkMemoryRequirements memReqs{};
+		vkGetImageMemoryRequirements(device->logicalDevice, resident.image, &memReqs);
+		VkMemoryAllocateInfo memAllocInfo{};
+		memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memAllocInfo.allocationSize = memReqs.size;
+		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &resident.memory));
+		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, resident.image, resident.memory, 0));
+		resident.memorySize = memReqs.size;
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = resident.image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = source.format;
+		viewInfo.components = entry.components;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.layerCount = 1;
+		viewInfo.subresourceRange.levelCount = levelCount;
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewInfo, nullptr, &resident.view));
+
+		upload.commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+		VkImageSubresourceRange subresourceRange = {};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.levelCount = levelCount;
+		subresourceRange.layerCount = 1;
+
+		{
+			VkImageMemoryBarrier imageMemoryBarrier{};
+			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			imageMemoryBarrier.srcAccessMask = 0;
+			imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			imageMemoryBarrier.image = resident.image;
+			imageMemoryBarrier.subresourceRange = subresourceRange;
+			vkCmdPipelineBarrier(upload.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		}
+
+		vkCmdCopyBufferToImage(upload.commandBuffer, upload.stagingBuffer, resident.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+
+		{
+			VkImageMemoryBarrier imageMemoryBarrier{};
+			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			imageMemoryBarrier.image = resident.image;
+			imageMemoryBarrier.subresourceRange = subresourceRange;
+			vkCmdPipelineBarrier(upload.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		}
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(upload.commandBuffer));
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceInfo, nullptr, &upload.fence));
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &upload.commandBuffer;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, upload.fence));
+	}
+
+	void TextureStreamer::destroyResident(Resident& resident)
+	{
+		vkDestroyImageView(device->logicalDevice, resident.view, nullptr);
+		vkDestroyImage(device->logicalDevice, resident.image, nullptr);
+		vkFreeMemory(device->logicalDevice, resident.memory, nullptr);
+		resident = Resident();
+	}
+
+	// Releases the transient resources of a finished upload, the uploaded image is kept
+	void TextureStreamer::destroyUpload(Upload& upload)
+	{
+		vkFreeCommandBuffers(device->logicalDevice, device->commandPool, 1, &upload.commandBuffer);
+		vkDestroyFence(device->logicalDevice, upload.fence, nullptr);
+		vkDestroyBuffer(device->logicalDevice, upload.stagingBuffer, nullptr);
+		vkFreeMemory(device->logicalDevice, upload.stagingMemory, nullptr);
+		upload = Upload();
+	}
+
+	int32_t TextureStreamer::add(TextureCompressor::Image& source, VkComponentMapping components)
+	{
+		if (!enabled() || !device || source.levels.empty()) {
+			return -1;
+		}
+		// Without shader writes there is no feedback, textures are then fully resident
+		if (!device->enabledFeatures.fragmentStoresAndAtomics) {
+			return -1;
+		}
+		auto it = std::find_if(entries.begin(), entries.end(), [](const Entry& entry) { return !entry.used; });
+		if (it == entries.end()) {
+			return -1;
+		}
+
+		Entry& entry = *it;
+		entry = Entry();
+		entry.used = true;
+		entry.source = std::move(source);
+		entry.components = components;
+		entry.tailLevel = static_cast<uint32_t>(entry.source.levels.size()) - 1;
+		while ((entry.tailLevel > 0) && (std::max(entry.source.width >> (entry.tailLevel - 1), entry.source.height >> (entry.tailLevel - 1)) <= settings.tailSize)) {
+			entry.tailLevel--;
+		}
+		entry.requestedLevel = entry.tailLevel;
+		entry.requestedFrame = frameCounter;
+		entry.sampledFrame = frameCounter;
+
+		// The mip tail is small, so it's uploaded right away
+		Upload upload;
+		createResident(entry, entry.tailLevel, upload);
+		VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &upload.fence, VK_TRUE, UINT64_MAX));
+		entry.resident = upload.resident;
+		destroyUpload(upload);
+		residentSize += entry.resident.memorySize;
+
+		const int32_t slot = static_cast<int32_t>(it - entries.begin());
+		for (auto& frame : feedback) {
+			frame.firstLevels[slot] = entry.resident.firstLevel;
+		}
+		return slot;
+	}
+
+	void TextureStreamer::remove(int32_t slot)
+	{
+		Entry& entry = entries[slot];
+		if (!entry.used) {
+			return;
+		}
+		if (entry.uploadPending) {
+			VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &entry.upload.fence, VK_TRUE, UINT64_MAX));
+			destroyResident(entry.upload.resident);
+			destroyUpload(entry.upload);
+		}
+		residentSize -= entry.resident.memorySize;
+		destroyResident(entry.resident);
+		entry = Entry();
+	}
+
+	uint32_t TextureStreamer::getTextureCount() const
+	{
+		return static_cast<uint32_t>(std::count_if(entries.begin(), entries.end(), [](const Entry& entry) { return entry.used; }));
+	}
+
+	// Converts the feedback of a frame into requested levels
+	// Finer requests are applied immediately, coarser ones only after they have been stable for settings.evictionDelay frames
+	void TextureStreamer::readFeedback(uint32_t frameIndex)
+	{
+		const Feedback& frame = feedback[frameIndex];
+		for (size_t slot = 0; slot < entries.size(); slot++) {
+			Entry& entry = entries[slot];
+			const uint32_t value = frame.mapped[slot];
+			if (!entry.used || (value == UINT32_MAX)) {
+				continue;
+			}
+			const int32_t level = static_cast<int32_t>(frame.firstLevels[slot]) + static_cast<int32_t>(value) - static_cast<int32_t>(feedbackBias);
+			const uint32_t requestedLevel = static_cast<uint32_t>(std::min(std::max(level, 0), static_cast<int32_t>(entry.tailLevel)));
+			entry.sampledFrame = frameCounter;
+			if ((requestedLevel <= entry.requestedLevel) || (frameCounter - entry.requestedFrame > settings.evictionDelay)) {
+				entry.requestedLevel = requestedLevel;
+				entry.requestedFrame = frameCounter;
+			}
+		}
+	}
+
+	// Returns the first level each texture should have resident
+	// If the requested levels don't fit into the budget, levels are dropped from the textures that haven't been sampled for the longest time first and from the largest levels next
+	std::vector<uint32_t> TextureStreamer::planResidency()
+	{
+		std::vector<uint32_t> targetLevels(entries.size(), 0);
+		VkDeviceSize totalSize = 0;
+		typedef std::tuple<uint64_t, VkDeviceSize, uint32_t> Candidate;
+		std::priority_queue<Candidate> candidates;
+		for (uint32_t slot = 0; slot < static_cast<uint32_t>(entries.size()); slot++) {
+			const Entry& entry = entries[slot];
+			if (!entry.used) {
+				continue;
+			}
+			targetLevels[slot] = std::min(entry.requestedLevel, entry.tailLevel);
+			totalSize += levelSize(entry, targetLevels[slot]);
+			if (targetLevels[slot] < entry.tailLevel) {
+				candidates.push(Candidate(frameCounter - entry.sampledFrame, entry.source.levels[targetLevels[slot]].size(), slot));
+			}
+		}
+		while ((totalSize > settings.budget) && !candidates.empty()) {
+			const uint32_t slot = std::get<2>(candidates.top());
+			candidates.pop();
+			const Entry& entry = entries[slot];
+			totalSize -= entry.source.levels[targetLevels[slot]].size();
+			targetLevels[slot]++;
+			if (targetLevels[slot] < entry.tailLevel) {
+				candidates.push(Candidate(frameCounter - entry.sampledFrame, entry.source.levels[targetLevels[slot]].size(), slot));
+			}
+		}
+		return targetLevels;
+	}
+
+	bool TextureStreamer::update(uint32_t frameIndex)
+	{
+		if (!enabled() || !device) {
+			return false;
+		}
+		frameCounter++;
+		readFeedback(frameIndex);
+
+		// Images retired the last time this frame came up are no longer referenced, as the fences of all other frames have been waited for since
+		Feedback& frame = feedback[frameIndex];
+		for (auto& resident : frame.retired) {
+			destroyResident(resident);
+		}
+		frame.retired.clear();
+
+		// Swap in images of finished uploads, the images they replace may still be in use by other frames in flight and are retired instead
+		bool changed = false;
+		for (auto& entry : entries) {
+			if (entry.used && entry.uploadPending && (vkGetFenceStatus(device->logicalDevice, entry.upload.fence) == VK_SUCCESS)) {
+				changed = true;
+				residentSize -= entry.resident.memorySize;
+				frame.retired.push_back(entry.resident);
+				entry.resident = entry.upload.resident;
+				residentSize += entry.resident.memorySize;
+				destroyUpload(entry.upload);
+				entry.uploadPending = false;
+			}
+		}
+
+		// Start uploads for textures whose residency should change, evictions first as they free memory and are cheap
+		const std::vector<uint32_t> targetLevels = planResidency();
+		std::vector<uint32_t> changes;
+		for (uint32_t slot = 0; slot < static_cast<uint32_t>(entries.size()); slot++) {
+			const Entry& entry = entries[slot];
+			if (entry.used && !entry.uploadPending && (targetLevels[slot] != entry.resident.firstLevel)) {
+				changes.push_back(slot);
+			}
+		}
+		std::sort(changes.begin(), changes.end(), [this, &targetLevels](uint32_t a, uint32_t b) {
+			const int32_t deltaA = static_cast<int32_t>(targetLevels[a]) - static_cast<int32_t>(entries[a].resident.firstLevel);
+			const int32_t deltaB = static_cast<int32_t>(targetLevels[b]) - static_cast<int32_t>(entries[b].resident.firstLevel);
+			return deltaA > deltaB;
+		});
+		VkDeviceSize uploadSize = 0;
+		for (uint32_t slot : changes) {
+			Entry& entry = entries[slot];
+			const VkDeviceSize size = levelSize(entry, targetLevels[slot]);
+			if ((uploadSize > 0) && (uploadSize + size > settings.uploadLimit)) {
+				break;
+			}
+			createResident(entry, targetLevels[slot], entry.upload);
+			entry.uploadPending = true;
+			uploadSize += size;
+		}
+
+		// Reset the feedback buffer for the frame that is recorded next
+		memset(frame.mapped, 0xFF, entries.size() * sizeof(uint32_t));
+		for (size_t slot = 0; slot < entries.size(); slot++) {
+			frame.firstLevels[slot] = entries[slot].resident.firstLevel;
+		}
+		return changed;
+	}
+}
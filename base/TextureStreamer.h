@@ -0,0 +1,134 @@
+/*
+* Feedback driven mip streaming for textures loaded from png and jpg files (glTF and USDZ)
+*
+* Streamed textures start with a small mip tail on the GPU while their full mip chain is kept in system memory
+* The material shaders write the finest mip level they sample for each texture into a per frame feedback buffer
+* Based on that feedback, update() uploads finer or evicts unneeded levels in the background within a memory budget
+*
+* Residency changes replace a texture's image with one that has a different number of levels, so only resident levels take up device memory
+*
+* This code is licensed under the MIT license(MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.hpp"
+#include "TextureCompressor.h"
+
+namespace vks
+{
+	class TextureStreamer
+	{
+	public:
+		struct Settings {
+			// Device memory available to streamed textures in bytes, 0 disables streaming and textures are fully resident
+			VkDeviceSize budget = 0;
+			// Levels up to this size are always resident
+			uint32_t tailSize = 128;
+			// Upper limit for the data uploaded per update to avoid hitches
+			VkDeviceSize uploadLimit = 32 * 1024 * 1024;
+			// Frames a texture must request a coarser level before finer levels are evicted
+			uint32_t evictionDelay = 120;
+		};
+		static Settings settings;
+
+		static const uint32_t maxTextures = 4096;
+		// Feedback values are stored with this bias, so levels finer than the resident ones (negative relative levels) can be encoded
+		static const uint32_t feedbackBias = 16;
+
+		// Image, view and level range currently used for sampling a streamed texture
+		struct Resident {
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			// Level of the full mip chain stored in mip 0 of image
+			uint32_t firstLevel = 0;
+			VkDeviceSize memorySize = 0;
+		};
+
+	private:
+		struct Upload {
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			VkBuffer stagingBuffer = VK_NULL_HANDLE;
+			VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
+			Resident resident;
+		};
+
+		struct Entry {
+			bool used = false;
+			TextureCompressor::Image source;
+			VkComponentMapping components;
+			Resident resident;
+			// Finest level requested by the feedback, frame it was requested at and frame the texture was last sampled
+			uint32_t requestedLevel = 0;
+			uint64_t requestedFrame = 0;
+			uint64_t sampledFrame = 0;
+			uint32_t tailLevel = 0;
+			bool uploadPending = false;
+			Upload upload;
+		};
+
+		struct Feedback {
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			uint32_t* mapped = nullptr;
+			VkDescriptorBufferInfo descriptor;
+			// First resident level of each texture when the frame was recorded, feedback is relative to these
+			std::vector<uint32_t> firstLevels;
+			// Images replaced while this frame was the current one, other frames in flight may still sample them
+			std::vector<Resident> retired;
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		VkQueue queue = VK_NULL_HANDLE;
+		std::vector<Entry> entries;
+		std::vector<Feedback> feedback;
+		uint64_t frameCounter = 0;
+		VkDeviceSize residentSize = 0;
+
+		static VkDeviceSize levelSize(const Entry& entry, uint32_t firstLevel);
+		void createResident(Entry& entry, uint32_t firstLevel, Upload& upload);
+		void destroyResident(Resident& resident);
+		void destroyUpload(Upload& upload);
+		void readFeedback(uint32_t frameIndex);
+		std::vector<uint32_t> planResidency();
+
+	public:
+		static bool enabled() { return settings.budget > 0; }
+
+		/**
+		* Create the per frame feedback buffers, these are also required if streaming is disabled as the material shaders always reference them
+		*
+		* @param frameCount Number of frames that can be in flight, each one gets its own feedback buffer
+		*/
+		void prepare(vks::VulkanDevice* device, VkQueue queue, uint32_t frameCount);
+		void destroy();
+
+		/**
+		* Take ownership of the full mip chain of a texture (source is moved from on success) and upload its mip tail
+		*
+		* @return Feedback slot of the texture, or -1 if streaming is disabled or all slots are in use (the caller then uploads the texture itself)
+		*/
+		int32_t add(TextureCompressor::Image& source, VkComponentMapping components);
+		void remove(int32_t slot);
+		const Resident& getResident(int32_t slot) const { return entries[slot].resident; }
+
+		VkDescriptorBufferInfo* getFeedbackDescriptor(uint32_t frameIndex) { return &feedback[frameIndex].descriptor; }
+
+		/**
+		* Evaluate the feedback of a frame whose command buffer has completed and adjust residency
+		*
+		* @note Call after waiting for the frame's fence and before recording it again
+		* @return True if the resident image of any texture changed, descriptors referencing streamed textures then need to be updated
+		*/
+		bool update(uint32_t frameIndex);
+
+		VkDeviceSize getResidentSize() const { return residentSize; }
+		uint32_t getTextureCount() const;
+	};
+}
@@ -0,0 +1,199 @@
+/*
+* Simple thread pool used for parallel asset loading
+*
+* This code is licensed under the MIT license(MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vks
+{
+	/*
+		Fixed size pool of worker threads consuming a shared job queue
+		Background jobs (e.g. deferred texture level transcodes) are only picked up while no regular job is queued
+		Threads waiting in parallelFor only execute their own work, so nested use from inside a job does not deadlock and loads don't wait for unrelated jobs
+	*/
+	class ThreadPool
+	{
+	private:
+		std::vector<std::thread> workers;
+		std::deque<std::function<void()>> jobs;
+		std::deque<std::function<void()>> backgroundJobs;
+		std::mutex queueMutex;
+		std::condition_variable condition;
+		bool stop = false;
+
+		void workerLoop()
+		{
+			while (true) {
+				std::function<void()> job;
+				{
+					std::unique_lock<std::mutex> lock(queueMutex);
+					condition.wait(lock, [this] { return stop || !jobs.empty() || !backgroundJobs.empty(); });
+					if (stop && jobs.empty() && backgroundJobs.empty()) {
+						return;
+					}
+					std::deque<std::function<void()>>& queue = jobs.empty() ? backgroundJobs : jobs;
+					job = std::move(queue.front());
+					queue.pop_front();
+				}
+				job();
+			}
+		}
+
+	public:
+		/**
+		* Create the pool
+		*
+		* @param threadCount Number of worker threads, 0 uses the number of hardware threads
+		*/
+		explicit ThreadPool(uint32_t threadCount = 0)
+		{
+			if (threadCount == 0) {
+				threadCount = std::max(1u, std::thread::hardware_concurrency());
+			}
+			for (uint32_t i = 0; i < threadCount; i++) {
+				workers.emplace_back([this] { workerLoop(); });
+			}
+		}
+
+		~ThreadPool()
+		{
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				stop = true;
+			}
+			condition.notify_all();
+			for (auto& worker : workers) {
+				worker.join();
+			}
+		}
+
+		uint32_t threadCount() const
+		{
+			return static_cast<uint32_t>(workers.size());
+		}
+
+		void push(std::function<void()> job)
+		{
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				jobs.push_back(std::move(job));
+			}
+			condition.notify_one();
+		}
+
+		void pushBackground(std::function<void()> job)
+		{
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				backgroundJobs.push_back(std::move(job));
+			}
+			condition.notify_one();
+		}
+
+		/**
+		* Submit a job and get a future for its result
+		*
+		* @note Waiting on the future from inside another job blocks that worker, use parallelFor for nested work
+		*/
+		template <typename F>
+		auto async(F&& func) -> std::future<decltype(func())>
+		{
+			auto task = std::make_shared<std::packaged_task<decltype(func())()>>(std::forward<F>(func));
+			std::future<decltype(func())> result = task->get_future();
+			push([task]() { (*task)(); });
+			return result;
+		}
+
+		/**
+		* Submit a low priority job that only runs while no regular job is queued, background jobs run in submission order
+		*/
+		template <typename F>
+		auto asyncBackground(F&& func) -> std::future<decltype(func())>
+		{
+			auto task = std::make_shared<std::packaged_task<decltype(func())()>>(std::forward<F>(func));
+			std::future<decltype(func())> result = task->get_future();
+			pushBackground([task]() { (*task)(); });
+			return result;
+		}
+
+		/**
+		* Pop one queued regular job and execute it on the calling thread
+		*
+		* @return False if the queue was empty
+		*/
+		bool runPendingJob()
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				if (jobs.empty()) {
+					return false;
+				}
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+			job();
+			return true;
+		}
+
+		/**
+		* Call func(i) for every i in [0, count) distributed over the pool and the calling thread, returns once all calls finished
+		*/
+		template <typename F>
+		void parallelFor(size_t count, F&& func)
+		{
+			if (count == 0) {
+				return;
+			}
+			if ((count == 1) || workers.empty()) {
+				for (size_t i = 0; i < count; i++) {
+					func(i);
+				}
+				return;
+			}
+			// Helper jobs can start after the call returned, so they only keep the counters alive and only touch func while an index is left
+			// A helper registers as running before claiming an index, once all indices are claimed the caller only has to wait for running helpers
+			struct State {
+				std::atomic<size_t> next{ 0 };
+				std::atomic<size_t> running{ 0 };
+			};
+			std::shared_ptr<State> state = std::make_shared<State>();
+			const size_t jobCount = std::min(count - 1, workers.size());
+			for (size_t i = 0; i < jobCount; i++) {
+				push([state, count, &func]() {
+					state->running++;
+					for (size_t index = state->next++; index < count; index = state->next++) {
+						func(index);
+					}
+					state->running--;
+				});
+			}
+			for (size_t i = state->next++; i < count; i = state->next++) {
+				func(i);
+			}
+			while (state->running > 0) {
+				std::this_thread::yield();
+			}
+		}
+
+		/** Pool shared by all loaders, created on first use */
+		static ThreadPool& shared()
+		{
+			static ThreadPool pool;
+			return pool;
+		}
+	};
+}
@@ -0,0 +1,117 @@
+/*
+* Flattened node transform hierarchy
+*
+* This code is licensed under the MIT license(MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "TransformHierarchy.h"
+
+#include <cassert>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORMHIERARCHY_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define TRANSFORMHIERARCHY_NEON
+#include <arm_neon.h>
+#endif
+
+namespace vks
+{
+	void TransformHierarchy::clear()
+	{
+		parents.resize(0);
+		localMatrices.resize(0);
+		worldMatrices.resize(0);
+		dirty.resize(0);
+		changed.resize(0);
+	}
+
+	uint32_t TransformHierarchy::add(int32_t parent)
+	{
+		const uint32_t index = static_cast<uint32_t>(parents.size());
+		assert(parent < static_cast<int32_t>(index));
+		parents.push_back(parent);
+		localMatrices.push_back(glm::mat4(1.0f));
+		worldMatrices.push_back(glm::mat4(1.0f));
+		dirty.push_back(1);
+		changed.push_back(0);
+		return index;
+	}
+
+	void TransformHierarchy::setLocalMatrix(uint32_t index, const glm::mat4& matrix)
+	{
+		localMatrices[index] = matrix;
+		dirty[index] = 1;
+	}
+
+	bool TransformHierarchy::update()
+	{
+		bool anyChanged = false;
+		for (size_t i = 0; i < parents.size(); i++) {
+			const int32_t parent = parents[i];
+			// Parents come first, so their changed flag is already up to date
+			if (!dirty[i] && ((parent < 0) || !changed[parent])) {
+				changed[i] = 0;
+				continue;
+			}
+			glm::mat4 world;
+			if (parent < 0) {
+				world = localMatrices[i];
+			} else {
+				multiply(worldMatrices[parent], localMatrices[i], world);
+			}
+			// Animations often hold values between keys, an unchanged world matrix doesn't need to be propagated or uploaded
+			changed[i] = (memcmp(&world, &worldMatrices[i], sizeof(glm::mat4)) != 0) ? 1 : 0;
+			worldMatrices[i] = world;
+			dirty[i] = 0;
+			anyChanged |= (changed[i] != 0);
+		}
+		return anyChanged;
+	}
+
+	// Column major, each column of the result is a linear combination of the columns of a
+	void TransformHierarchy::multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& result)
+	{
+		const float* pa = &a[0][0];
+		const float* pb = &b[0][0];
+		float* pr = &result[0][0];
+#if defined(TRANSFORMHIERARCHY_SSE2)
+		const __m128 a0 = _mm_loadu_ps(pa);
+		const __m128 a1 = _mm_loadu_ps(pa + 4);
+		const __m128 a2 = _mm_loadu_ps(pa + 8);
+		const __m128 a3 = _mm_loadu_ps(pa + 12);
+		for (int c = 0; c < 4; c++) {
+			const float* col = pb + c * 4;
+			__m128 r = _mm_mul_ps(a0, _mm_set1_ps(col[0]));
+			r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(col[1])));
+			r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(col[2])));
+			r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(col[3])));
+			_mm_storeu_ps(pr + c * 4, r);
+		}
+#elif defined(TRANSFORMHIERARCHY_NEON)
+		const float32x4_t a0 = vld1q_f32(pa);
+		const float32x4_t a1 = vld1q_f32(pa + 4);
+		const float32x4_t a2 = vld1q_f32(pa + 8);
+		const float32x4_t a3 = vld1q_f32(pa + 12);
+		for (int c = 0; c < 4; c++) {
+			const float* col = pb + c * 4;
+			float32x4_t r = vmulq_n_f32(a0, col[0]);
+			r = vmlaq_n_f32(r, a1, col[1]);
+			r = vmlaq_n_f32(r, a2, col[2]);
+			r = vmlaq_n_f32(r, a3, col[3]);
+			vst1q_f32(pr + c * 4, r);
+		}
+#else
+		// result may alias a or b
+		float r[16];
+		for (int c = 0; c < 4; c++) {
+			for (int row = 0; row < 4; row++) {
+				r[c * 4 + row] = pa[row] * pb[c * 4] + pa[4 + row] * pb[c * 4 + 1] + pa[8 + row] * pb[c * 4 + 2] + pa[12 + row] * pb[c * 4 + 3];
+			}
+		}
+		memcpy(pr, r, sizeof(r));
+#endif
+	}
+}
@@ -0,0 +1,51 @@
+/*
+* Flattened node transform hierarchy
+*
+* Nodes are stored in topological order (parents before their children), so world matrices are updated in a single linear pass
+* Only nodes whose local matrix was marked dirty or whose parent's world matrix changed are recalculated
+*
+* This code is licensed under the MIT license(MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	class TransformHierarchy
+	{
+	public:
+		// Parent of each node (-1 for roots), always lower than the node's own index
+		std::vector<int32_t> parents;
+		std::vector<glm::mat4> localMatrices;
+		std::vector<glm::mat4> worldMatrices;
+		// Set if the local matrix has been changed since the last update
+		std::vector<uint8_t> dirty;
+		// Set by update for nodes whose world matrix changed
+		std::vector<uint8_t> changed;
+
+		void clear();
+		// Adds a node, parents have to be added before their children
+		uint32_t add(int32_t parent);
+		void setLocalMatrix(uint32_t index, const glm::mat4& matrix);
+		void markDirty(uint32_t index) { dirty[index] = 1; }
+		size_t size() const { return parents.size(); }
+
+		/**
+		* Recalculate the world matrices of dirty nodes and their descendants
+		*
+		* @return True if any world matrix changed
+		*/
+		bool update();
+
+		// 4x4 matrix product a * b (SSE2/NEON with scalar fallback)
+		static void multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& result);
+	};
+}
@@ -11,6 +11,7 @@
 #pragma once
 
 #include <exception>
+#include <stdexcept>
 #include <assert.h>
 #include <algorithm>
 #include <cstring>
@@ -653,6 +653,14 @@ void VulkanExampleBase::initVulkan()
 	if (deviceFeatures.samplerAnisotropy) {
 		enabledFeatures.samplerAnisotropy = VK_TRUE;
 	}
+	// Compressed formats are picked by the texture loaders based on these
+	enabledFeatures.textureCompressionBC = deviceFeatures.textureCompressionBC;
+	enabledFeatures.textureCompressionETC2 = deviceFeatures.textureCompressionETC2;
+	enabledFeatures.textureCompressionASTC_LDR = deviceFeatures.textureCompressionASTC_LDR;
+	// Required for compute mip generation of R8 and R8G8 images
+	enabledFeatures.shaderStorageImageExtendedFormats = deviceFeatures.shaderStorageImageExtendedFormats;
+	// The material shaders write texture streaming feedback
+	enabledFeatures.fragmentStoresAndAtomics = deviceFeatures.fragmentStoresAndAtomics;
 	std::vector<const char*> enabledExtensions{};
 	VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledExtensions);
 	if (res != VK_SUCCESS) {
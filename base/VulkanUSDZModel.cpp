@@ -17,160 +17,36 @@
 
 #include "VulkanUSDZModel.h"
 
-#include "stb_image_resize2.h"
+#include "TextureCompressor.h"
+#include "TextureCache.hpp"
+#include "PixelConverter.h"
 
 // from tinyusdz/src/
 #include "io-util.hh"
 
 namespace vkUSDZ
 {
-
-namespace detail
-{
-	// Build occlusion, metallic and roughness texture
-	// r: occlusion
-	// g: roughness
-	// b: metallic
-	bool BuildOcclusionRoughnessMetallicTexture(
-		const float occlusionFactor,
-		const float roughnessFactor,
-		const float metallicFactor,
-		const std::vector<uint8_t> occlusionImageData,
-		const size_t occlusionImageWidth,
-		const size_t occlusionImageHeight,
-		const size_t occlusionImageChannels,
-		const size_t occlusionChannel,
-		const std::vector<uint8_t> roughnessImageData,
-		const size_t roughnessImageWidth,
-		const size_t roughnessImageHeight,
-		const size_t roughnessImageChannels,
-		const size_t roughnessChannel,
-		const std::vector<uint8_t> metallicImageData,
-		const size_t metallicImageWidth,
-		const size_t metallicImageHeight,
-		const size_t metallicImageChannels,
-		const size_t metallicChannel,
-		std::vector<uint8_t> &dst, // RGBA
-    size_t &dstWidth,	
-    size_t &dstHeight)	
-{
-	if (occlusionChannel > occlusionImageChannels) {
-		return false;
-	}
-	if (roughnessChannel > roughnessImageChannels) {
-		return false;
-	}
-	if (metallicChannel > metallicImageChannels) {
-		return false;
-	}
-
-	size_t maxImageWidth = 1;
-	size_t maxImageHeight = 1;
-	if (!occlusionImageData.empty()) {
-		maxImageWidth = (std::max)(maxImageWidth, occlusionImageWidth);
-		maxImageHeight = (std::max)(maxImageHeight, occlusionImageHeight);
-	}
-	if (!roughnessImageData.empty()) {
-		maxImageWidth = (std::max)(maxImageWidth,  roughnessImageWidth);
-		maxImageHeight = (std::max)(maxImageHeight, roughnessImageHeight);
-	}
-	if (!metallicImageData.empty()) {
-		maxImageWidth = (std::max)(maxImageWidth, metallicImageWidth);
-		maxImageHeight = (std::max)(maxImageHeight, metallicImageHeight);
-	}
-
-	std::vector<uint8_t> occlusionBuf;
-	std::vector<uint8_t> roughnessBuf;
-	std::vector<uint8_t> metallicBuf;
-
-	if (!occlusionImageData.empty()) {
-		if ((maxImageWidth != occlusionImageWidth) || (maxImageHeight != occlusionImageHeight)) {
-			stbir_pixel_layout layout;
-			if (occlusionImageChannels == 1) {
-				layout = STBIR_1CHANNEL;
-			} else if (occlusionImageChannels == 2) {
-				layout = STBIR_2CHANNEL;
-			} else if (occlusionImageChannels == 3) {
-				layout = STBIR_RGB;
-			} else { // assume RGBA
-				layout = STBIR_RGBA;
-			}
-
-			occlusionBuf.resize(maxImageWidth * maxImageHeight * occlusionImageChannels);
-
-			stbir_resize_uint8_linear(occlusionImageData.data(), occlusionImageWidth, occlusionImageHeight, 0, occlusionBuf.data(), maxImageWidth, maxImageHeight, 0, layout); 
-		}
-	} else {
-		occlusionBuf = occlusionImageData;
-	} 
-
-	if (!metallicImageData.empty()) {
-		if ((maxImageWidth != metallicImageWidth) || (maxImageHeight != metallicImageHeight)) {
-			stbir_pixel_layout layout;
-			if (metallicImageChannels == 1) {
-				layout = STBIR_1CHANNEL;
-			} else if (metallicImageChannels == 2) {
-				layout = STBIR_2CHANNEL;
-			} else if (metallicImageChannels == 3) {
-				layout = STBIR_RGB;
-			} else { // assume RGBA
-				layout = STBIR_RGBA;
-			}
-
-			metallicBuf.resize(maxImageWidth * maxImageHeight * metallicImageChannels);
-
-			stbir_resize_uint8_linear(metallicImageData.data(), metallicImageWidth, metallicImageHeight, 0, metallicBuf.data(), maxImageWidth, maxImageHeight, 0, layout); 
-		} else {
-			metallicBuf = metallicImageData;
-		}
-	} 
-
-	if (!roughnessImageData.empty()) {
-		if ((maxImageWidth != roughnessImageWidth) || (maxImageHeight != roughnessImageHeight)) {
-			stbir_pixel_layout layout;
-			if (roughnessImageChannels == 1) {
-				layout = STBIR_1CHANNEL;
-			} else if (roughnessImageChannels == 2) {
-				layout = STBIR_2CHANNEL;
-			} else if (roughnessImageChannels == 3) {
-				layout = STBIR_RGB;
-			} else { // assume RGBA
-				layout = STBIR_RGBA;
-			}
-
-			roughnessBuf.resize(maxImageWidth * maxImageHeight * roughnessImageChannels);
-
-			stbir_resize_uint8_linear(roughnessImageData.data(), roughnessImageWidth, roughnessImageHeight, 0, roughnessBuf.data(), maxImageWidth, maxImageHeight, 0, layout); 
-		} else {
-			roughnessBuf = roughnessImageData;
+	// Texel component types that can be uploaded, 8 bit images are kept as they are, everything else is converted to half floats
+	static bool getPixelComponentType(tinyusdz::tydra::ComponentType componentType, vks::PixelConverter::ComponentType& type)
+	{
+		switch (componentType) {
+		case tinyusdz::tydra::ComponentType::UInt8:
+			type = vks::PixelConverter::ComponentType::UInt8;
+			return true;
+		case tinyusdz::tydra::ComponentType::UInt16:
+			type = vks::PixelConverter::ComponentType::UInt16;
+			return true;
+		case tinyusdz::tydra::ComponentType::Half:
+			type = vks::PixelConverter::ComponentType::Half;
+			return true;
+		case tinyusdz::tydra::ComponentType::Float:
+			type = vks::PixelConverter::ComponentType::Float;
+			return true;
+		default:
+			return false;
 		}
-	} 
-
-	uint8_t occlusionValue = uint8_t((std::max)((std::min)(255, int(occlusionFactor * 255.0f)), 0));
-	uint8_t metallicValue = uint8_t((std::max)((std::min)(255, int(metallicFactor * 255.0f)), 0));
-	uint8_t roughnessValue = uint8_t((std::max)((std::min)(255, int(roughnessFactor * 255.0f)), 0));
-
-	dst.resize(maxImageWidth * maxImageHeight * 3);
-
-	for (size_t i = 0; i < maxImageWidth * maxImageHeight; i++) {
-		// Use the first component of texel when input is a texture.
-		uint8_t r = occlusionBuf.size() ? occlusionBuf[i * occlusionImageChannels + occlusionChannel] : occlusionValue;
-		uint8_t g = roughnessBuf.size() ? roughnessBuf[i * roughnessImageChannels + roughnessChannel] : roughnessValue;
-		uint8_t b = metallicBuf.size() ? metallicBuf[i * metallicImageChannels + metallicChannel] : metallicValue;
-
-		dst[3 * i + 0] = r;
-		dst[3 * i + 1] = g;
-		dst[3 * i + 2] = b;
 	}
 
-	dstWidth = maxImageWidth;
-	dstHeight = maxImageHeight;
-
-	return true;
-}
-
-
-} // namespace detail
 
 
 	// Bounding box
@@ -217,168 +93,185 @@ namespace detail
 
 	void Texture::destroy()
 	{
-		vkDestroyImageView(device->logicalDevice, view, nullptr);
-		vkDestroyImage(device->logicalDevice, image, nullptr);
-		vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
-		vkDestroySampler(device->logicalDevice, sampler, nullptr);
+		if (device == nullptr) {
+			return;
+		}
+		if ((imageOwner < 0) && (streamSlot >= 0)) {
+			streamer->remove(streamSlot);
+		} else if (imageOwner < 0) {
+			vkDestroyImageView(device->logicalDevice, view, nullptr);
+			vkDestroyImage(device->logicalDevice, image, nullptr);
+			vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
+		}
+		vks::SamplerCache::shared().release(device->logicalDevice, sampler);
+	}
+
+	// Samplers come from the shared cache, so textures with the same sampler state use the same object
+	void Texture::createSampler(TextureSampler textureSampler)
+	{
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = textureSampler.magFilter;
+		samplerInfo.minFilter = textureSampler.minFilter;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerInfo.addressModeU = textureSampler.addressModeU;
+		samplerInfo.addressModeV = textureSampler.addressModeV;
+		samplerInfo.addressModeW = textureSampler.addressModeW;
+		samplerInfo.compareOp = VK_COMPARE_OP_NEVER;
+		samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		// The image view limits the mip range, so the sampler doesn't depend on the texture's level count
+		samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+		samplerInfo.maxAnisotropy = 8.0f;
+		samplerInfo.anisotropyEnable = VK_TRUE;
+		sampler = vks::SamplerCache::shared().acquire(device->logicalDevice, samplerInfo);
 	}
 
-	void Texture::fromUSDZImage(tinyusdz::tydra::TextureImage &usdzimage, const std::vector<uint8_t> &imagedata, TextureSampler textureSampler, vks::VulkanDevice *device, VkQueue copyQueue)
+	void Texture::fromUSDZImage(tinyusdz::tydra::TextureImage &usdzimage, const std::vector<uint8_t> &imagedata, TextureSampler textureSampler, vks::VulkanDevice *device, VkQueue copyQueue, bool srgb, vks::MipGenerator* mipGenerator, vks::TextureStreamer* streamer)
 	{
 		this->device = device;
 
+		vks::PixelConverter::ComponentType componentType = vks::PixelConverter::ComponentType::UInt8;
+		getPixelComponentType(usdzimage.texelComponentType, componentType);
+		// 16 bit and float images are uploaded as half floats, the size limit, block compression and streaming only handle 8 bit images
+		const bool highBitDepth = (componentType != vks::PixelConverter::ComponentType::UInt8);
+		const uint32_t channels = static_cast<uint32_t>(usdzimage.channels);
+
+		// Oversized images are downscaled before they are compressed or get their mips generated
+		uint32_t imageWidth = static_cast<uint32_t>(usdzimage.width);
+		uint32_t imageHeight = static_cast<uint32_t>(usdzimage.height);
+		std::vector<uint8_t> resized;
+		if (!highBitDepth) {
+			vks::TextureCompressor::limitSize(imagedata.data(), imageWidth, imageHeight, channels, srgb, resized);
+		}
+		const std::vector<uint8_t>& pixels = resized.empty() ? imagedata : resized;
+		const size_t pixelCount = static_cast<size_t>(imageWidth) * imageHeight;
+
 		unsigned char* buffer = nullptr;
 		VkDeviceSize bufferSize = 0;
 		bool deleteBuffer = false;
+		VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
 		// TODO(syoyo): colorspace conversion
-		if (usdzimage.channels == 3) {
+		if (highBitDepth) {
+			format = VK_FORMAT_R16G16B16A16_SFLOAT;
+			bufferSize = pixelCount * 4 * sizeof(uint16_t);
+			buffer = new unsigned char[bufferSize];
+			vks::PixelConverter::toRgbaHalf(pixels.data(), componentType, channels, reinterpret_cast<uint16_t*>(buffer), pixelCount);
+			deleteBuffer = true;
+		} else if (channels != 4) {
 			// Most devices don't support RGB only on Vulkan so convert if necessary
+			// Gray (and gray alpha) images are expanded the way UsdUVTexture outputs them, so their value can be selected from any color channel
 			// TODO: Check actual format support and transform only if required
-			bufferSize = usdzimage.width * usdzimage.height * 4;
+			const uint32_t rgba[4] = { 0, 1, 2, 3 };
+			bufferSize = pixelCount * 4;
 			buffer = new unsigned char[bufferSize];
-			unsigned char* rgba = buffer;
-			const unsigned char* rgb = reinterpret_cast<const unsigned char *>(imagedata.data());
-			for (int32_t i = 0; i< usdzimage.width * usdzimage.height; ++i) {
-				for (int32_t j = 0; j < 3; ++j) {
-					rgba[j] = rgb[j];
-				}
-				rgba += 4;
-				rgb += 3;
-			}
+			vks::PixelConverter::swizzle(pixels.data(), channels, buffer, rgba, 4, pixelCount);
 			deleteBuffer = true;
 		}
 		else {
-			buffer = reinterpret_cast<unsigned char *>(const_cast<uint8_t *>(imagedata.data()));
-			bufferSize = imagedata.size();
+			buffer = reinterpret_cast<unsigned char *>(const_cast<uint8_t *>(pixels.data()));
+			bufferSize = pixels.size();
 		}
 
-		VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
 
-		VkFormatProperties formatProperties;
-
-		width = usdzimage.width;
-		height = usdzimage.height;
-		mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
-
-		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
-		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
-		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
-
-		VkMemoryAllocateInfo memAllocInfo{};
-		memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		VkMemoryRequirements memReqs{};
-
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
-
-		VkBufferCreateInfo bufferCreateInfo{};
-		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		bufferCreateInfo.size = bufferSize;
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-		uint8_t *data;
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-		memcpy(data, buffer, bufferSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
-
-		VkImageCreateInfo imageCreateInfo{};
-		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-		imageCreateInfo.format = format;
-		imageCreateInfo.mipLevels = mipLevels;
-		imageCreateInfo.arrayLayers = 1;
-		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
-		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		imageCreateInfo.extent = { width, height, 1 };
-		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
-		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+		vks::TextureCompressor::Image compressedImage;
+		if (vks::TextureCompressor::enabled() && !highBitDepth) {
+			// BC1 is used for opaque images with the fast preset, everything else is encoded as BC7
+			bool opaque = true;
+			if ((channels == 2) || (channels == 4)) {
+				for (VkDeviceSize i = 3; i < bufferSize && opaque; i += 4) {
+					opaque = (buffer[i] == 255);
+				}
+			}
+			const bool fast = (vks::TextureCompressor::settings.preset == vks::TextureCompressor::Preset::Fast);
+			const vks::TextureCompressor::Format compressedFormat = (fast && opaque) ? vks::TextureCompressor::Format::BC1 : vks::TextureCompressor::Format::BC7;
+			if (vks::TextureCompressor::isSupported(device, compressedFormat)) {
+				vks::TextureCompressor::compress(buffer, imageWidth, imageHeight, compressedFormat, srgb, compressedImage);
+			}
+		}
 
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		// Streamed textures need their full mip chain in system memory, so it's built on the CPU for them if they are not block compressed
+		if (compressedImage.levels.empty() && !highBitDepth && (streamer != nullptr) && vks::TextureStreamer::enabled()) {
+			compressedImage.format = format;
+			vks::TextureCompressor::generateMipChain(buffer, imageWidth, imageHeight, 4, srgb, compressedImage);
+		}
+		if (!compressedImage.levels.empty() && (streamer != nullptr)) {
+			streamSlot = streamer->add(compressedImage, { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A });
+		}
 
-		VkImageSubresourceRange subresourceRange = {};
-		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		subresourceRange.levelCount = 1;
-		subresourceRange.layerCount = 1;
+		if (streamSlot >= 0) {
+			width = imageWidth;
+			height = imageHeight;
+			mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
+			imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		} else if (!compressedImage.levels.empty()) {
+			// Block compressed on the CPU (or loaded from the texture cache), all mip levels are already included
+			format = compressedImage.format;
+			width = compressedImage.width;
+			height = compressedImage.height;
+			mipLevels = static_cast<uint32_t>(compressedImage.levels.size());
+			vks::TextureCompressor::upload(compressedImage, device, copyQueue, image, deviceMemory);
+			imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		} else {
+			width = imageWidth;
+			height = imageHeight;
+			mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
+
+			// RGBA8 and RGBA16F support blits on all devices, so these are the fallback if mips can't be generated with compute shaders
+			const bool computeMips = (mipGenerator != nullptr) && mipGenerator->isSupported(format);
+
+			VkMemoryAllocateInfo memAllocInfo{};
+			memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			VkMemoryRequirements memReqs{};
+
+			VkBuffer stagingBuffer;
+			VkDeviceMemory stagingMemory;
+
+			VkBufferCreateInfo bufferCreateInfo{};
+			bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferCreateInfo.size = bufferSize;
+			bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
+			vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
+			memAllocInfo.allocationSize = memReqs.size;
+			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
+			VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
+
+			uint8_t *data;
+			VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
+			memcpy(data, buffer, bufferSize);
+			vkUnmapMemory(device->logicalDevice, stagingMemory);
+
+			VkImageCreateInfo imageCreateInfo{};
+			imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageCreateInfo.format = format;
+			imageCreateInfo.mipLevels = mipLevels;
+			imageCreateInfo.arrayLayers = 1;
+			imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+			imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageCreateInfo.extent = { width, height, 1 };
+			imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+			if (computeMips) {
+				imageCreateInfo.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+			}
+			VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
+			vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
+			memAllocInfo.allocationSize = memReqs.size;
+			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
+			VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
 
-		{
-			VkImageMemoryBarrier imageMemoryBarrier{};
-			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			imageMemoryBarrier.srcAccessMask = 0;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			imageMemoryBarrier.image = image;
-			imageMemoryBarrier.subresourceRange = subresourceRange;
-			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-		}
-
-		VkBufferImageCopy bufferCopyRegion = {};
-		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		bufferCopyRegion.imageSubresource.mipLevel = 0;
-		bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-		bufferCopyRegion.imageSubresource.layerCount = 1;
-		bufferCopyRegion.imageExtent.width = width;
-		bufferCopyRegion.imageExtent.height = height;
-		bufferCopyRegion.imageExtent.depth = 1;
-
-		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+			VkCommandBuffer copyCmd = computeMips ? mipGenerator->commandBuffer() : device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 
-		{
-			VkImageMemoryBarrier imageMemoryBarrier{};
-			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-			imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-			imageMemoryBarrier.image = image;
-			imageMemoryBarrier.subresourceRange = subresourceRange;
-			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-		}
-
-		device->flushCommandBuffer(copyCmd, copyQueue, true);
-
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-
-		// Generate the mip chain (glTF uses jpg and png, so we need to create this manually)
-		VkCommandBuffer blitCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		for (uint32_t i = 1; i < mipLevels; i++) {
-			VkImageBlit imageBlit{};
-
-			imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageBlit.srcSubresource.layerCount = 1;
-			imageBlit.srcSubresource.mipLevel = i - 1;
-			imageBlit.srcOffsets[1].x = int32_t(width >> (i - 1));
-			imageBlit.srcOffsets[1].y = int32_t(height >> (i - 1));
-			imageBlit.srcOffsets[1].z = 1;
-
-			imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageBlit.dstSubresource.layerCount = 1;
-			imageBlit.dstSubresource.mipLevel = i;
-			imageBlit.dstOffsets[1].x = int32_t(width >> i);
-			imageBlit.dstOffsets[1].y = int32_t(height >> i);
-			imageBlit.dstOffsets[1].z = 1;
-
-			VkImageSubresourceRange mipSubRange = {};
-			mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			mipSubRange.baseMipLevel = i;
-			mipSubRange.levelCount = 1;
-			mipSubRange.layerCount = 1;
+			VkImageSubresourceRange subresourceRange = {};
+			subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			subresourceRange.levelCount = 1;
+			subresourceRange.layerCount = 1;
 
 			{
 				VkImageMemoryBarrier imageMemoryBarrier{};
@@ -388,79 +281,157 @@ namespace detail
 				imageMemoryBarrier.srcAccessMask = 0;
 				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 				imageMemoryBarrier.image = image;
-				imageMemoryBarrier.subresourceRange = mipSubRange;
-				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+				imageMemoryBarrier.subresourceRange = subresourceRange;
+				vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 			}
 
-			vkCmdBlitImage(blitCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+			VkBufferImageCopy bufferCopyRegion = {};
+			bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			bufferCopyRegion.imageSubresource.mipLevel = 0;
+			bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+			bufferCopyRegion.imageSubresource.layerCount = 1;
+			bufferCopyRegion.imageExtent.width = width;
+			bufferCopyRegion.imageExtent.height = height;
+			bufferCopyRegion.imageExtent.depth = 1;
+
+			vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+
+			if (computeMips) {
+				mipGenerator->generate(image, format, width, height, mipLevels, srgb);
+				mipGenerator->releaseAfterFlush(stagingBuffer, stagingMemory, bufferSize);
+				imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			} else {
 
-			{
-				VkImageMemoryBarrier imageMemoryBarrier{};
-				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-				imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-				imageMemoryBarrier.image = image;
-				imageMemoryBarrier.subresourceRange = mipSubRange;
-				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-			}
-		}
+				{
+					VkImageMemoryBarrier imageMemoryBarrier{};
+					imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+					imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+					imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+					imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+					imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+					imageMemoryBarrier.image = image;
+					imageMemoryBarrier.subresourceRange = subresourceRange;
+					vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+				}
 
-		subresourceRange.levelCount = mipLevels;
-		imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+				device->flushCommandBuffer(copyCmd, copyQueue, true);
+
+				vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
+				vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+
+				// Generate the mip chain (glTF uses jpg and png, so we need to create this manually)
+				VkCommandBuffer blitCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+				for (uint32_t i = 1; i < mipLevels; i++) {
+					VkImageBlit imageBlit{};
+
+					imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+					imageBlit.srcSubresource.layerCount = 1;
+					imageBlit.srcSubresource.mipLevel = i - 1;
+					imageBlit.srcOffsets[1].x = int32_t(width >> (i - 1));
+					imageBlit.srcOffsets[1].y = int32_t(height >> (i - 1));
+					imageBlit.srcOffsets[1].z = 1;
+
+					imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+					imageBlit.dstSubresource.layerCount = 1;
+					imageBlit.dstSubresource.mipLevel = i;
+					imageBlit.dstOffsets[1].x = int32_t(width >> i);
+					imageBlit.dstOffsets[1].y = int32_t(height >> i);
+					imageBlit.dstOffsets[1].z = 1;
+
+					VkImageSubresourceRange mipSubRange = {};
+					mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+					mipSubRange.baseMipLevel = i;
+					mipSubRange.levelCount = 1;
+					mipSubRange.layerCount = 1;
+
+					{
+						VkImageMemoryBarrier imageMemoryBarrier{};
+						imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+						imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+						imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+						imageMemoryBarrier.srcAccessMask = 0;
+						imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+						imageMemoryBarrier.image = image;
+						imageMemoryBarrier.subresourceRange = mipSubRange;
+						vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+					}
 
-		{
-			VkImageMemoryBarrier imageMemoryBarrier{};
-			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-			imageMemoryBarrier.image = image;
-			imageMemoryBarrier.subresourceRange = subresourceRange;
-			vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-		}
+					vkCmdBlitImage(blitCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+
+					{
+						VkImageMemoryBarrier imageMemoryBarrier{};
+						imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+						imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+						imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+						imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+						imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+						imageMemoryBarrier.image = image;
+						imageMemoryBarrier.subresourceRange = mipSubRange;
+						vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+					}
+				}
 
-		device->flushCommandBuffer(blitCmd, copyQueue, true);
+				subresourceRange.levelCount = mipLevels;
+				imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-		VkSamplerCreateInfo samplerInfo{};
-		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-		samplerInfo.magFilter = textureSampler.magFilter;
-		samplerInfo.minFilter = textureSampler.minFilter;
-		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-		samplerInfo.addressModeU = textureSampler.addressModeU;
-		samplerInfo.addressModeV = textureSampler.addressModeV;
-		samplerInfo.addressModeW = textureSampler.addressModeW;
-		samplerInfo.compareOp = VK_COMPARE_OP_NEVER;
-		samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		samplerInfo.maxAnisotropy = 1.0;
-		samplerInfo.anisotropyEnable = VK_FALSE;
-		samplerInfo.maxLod = (float)mipLevels;
-		samplerInfo.maxAnisotropy = 8.0f;
-		samplerInfo.anisotropyEnable = VK_TRUE;
-		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerInfo, nullptr, &sampler));
-
-		VkImageViewCreateInfo viewInfo{};
-		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-		viewInfo.image = image;
-		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		viewInfo.format = format;
-		viewInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
-		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		viewInfo.subresourceRange.layerCount = 1;
-		viewInfo.subresourceRange.levelCount = mipLevels;
-		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewInfo, nullptr, &view));
+				{
+					VkImageMemoryBarrier imageMemoryBarrier{};
+					imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+					imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+					imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+					imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+					imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+					imageMemoryBarrier.image = image;
+					imageMemoryBarrier.subresourceRange = subresourceRange;
+					vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+				}
 
-		descriptor.sampler = sampler;
-		descriptor.imageView = view;
-		descriptor.imageLayout = imageLayout;
+				device->flushCommandBuffer(blitCmd, copyQueue, true);
+			}
+		}
+
+		createSampler(textureSampler);
+
+		if (streamSlot >= 0) {
+			this->streamer = streamer;
+			updateStreamedResidency();
+		} else {
+			VkImageViewCreateInfo viewInfo{};
+			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewInfo.image = image;
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = format;
+			viewInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+			viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			viewInfo.subresourceRange.layerCount = 1;
+			viewInfo.subresourceRange.levelCount = mipLevels;
+			VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewInfo, nullptr, &view));
+
+			descriptor.sampler = sampler;
+			descriptor.imageView = view;
+			descriptor.imageLayout = imageLayout;
+		}
 
 		if (deleteBuffer)
 			delete[] buffer;
 
 	}
 
+	// Takes over the image currently made resident by the texture streamer
+	// Returns true if it changed since the last call
+	bool Texture::updateStreamedResidency()
+	{
+		const vks::TextureStreamer::Resident& resident = streamer->getResident(streamSlot);
+		if (view == resident.view) {
+			return false;
+		}
+		image = resident.image;
+		view = resident.view;
+		deviceMemory = resident.memory;
+		updateDescriptor();
+		return true;
+	}
+
 	// Primitive
 	Primitive::Primitive(uint32_t firstIndex, uint32_t indexCount, uint32_t vertexCount, Material &material) : firstIndex(firstIndex), indexCount(indexCount), vertexCount(vertexCount), material(material) {
 		hasIndices = indexCount > 0;
@@ -473,18 +444,25 @@ namespace detail
 	}
 
 	// Mesh
-	Mesh::Mesh(vks::VulkanDevice *device, glm::mat4 matrix) {
+	Mesh::Mesh(vks::VulkanDevice *device, glm::mat4 matrix, uint32_t frameCount) {
+		assert(frameCount < 32);
 		this->device = device;
 		this->uniformBlock.matrix = matrix;
+		const VkDeviceSize alignment = std::max<VkDeviceSize>(device->properties.limits.minUniformBufferOffsetAlignment, 1);
+		uniformBuffer.stride = (sizeof(uniformBlock) + alignment - 1) / alignment * alignment;
 		VK_CHECK_RESULT(device->createBuffer(
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			sizeof(uniformBlock),
+			uniformBuffer.stride * frameCount,
 			&uniformBuffer.buffer,
-			&uniformBuffer.memory,
-			&uniformBlock));
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, uniformBuffer.memory, 0, sizeof(uniformBlock), 0, &uniformBuffer.mapped));
-		uniformBuffer.descriptor = { uniformBuffer.buffer, 0, sizeof(uniformBlock) };
+			&uniformBuffer.memory));
+		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, uniformBuffer.memory, 0, VK_WHOLE_SIZE, 0, &uniformBuffer.mapped));
+		for (uint32_t i = 0; i < frameCount; i++) {
+			memcpy(static_cast<uint8_t*>(uniformBuffer.mapped) + i * uniformBuffer.stride, &uniformBlock, sizeof(uniformBlock));
+			uniformBuffer.descriptors.push_back({ uniformBuffer.buffer, i * uniformBuffer.stride, sizeof(uniformBlock) });
+		}
+		uniformBuffer.descriptorSets.resize(frameCount, VK_NULL_HANDLE);
+		uniformBuffer.dirtyFrames = 0;
 	};
 
 	Mesh::~Mesh() {
@@ -500,56 +478,32 @@ namespace detail
 		bb.valid = true;
 	}
 
+	void Mesh::updateUniformBuffer(uint32_t frameIndex) {
+		const uint32_t frameBit = 1u << frameIndex;
+		if (!(uniformBuffer.dirtyFrames & frameBit)) {
+			return;
+		}
+		memcpy(static_cast<uint8_t*>(uniformBuffer.mapped) + frameIndex * uniformBuffer.stride, &uniformBlock, sizeof(uniformBlock));
+		uniformBuffer.dirtyFrames &= ~frameBit;
+	}
+
 	// Node
 	glm::mat4 Node::localMatrix() {
-		if (!useCachedMatrix) {
-			cachedLocalMatrix = glm::translate(glm::mat4(1.0f), translation) * glm::mat4(rotation) * glm::scale(glm::mat4(1.0f), scale) * matrix;
-		};
-		return cachedLocalMatrix;
+		return glm::translate(glm::mat4(1.0f), translation) * glm::mat4(rotation) * glm::scale(glm::mat4(1.0f), scale) * matrix;
 	}
 
 	glm::mat4 Node::getMatrix() {
-		// Use a simple caching algorithm to avoid having to recalculate matrices to often while traversing the node hierarchy
-		if (!useCachedMatrix) {
-			glm::mat4 m = localMatrix();
-			vkUSDZ::Node* p = parent;
-			while (p) {
-				m = p->localMatrix() * m;
-				p = p->parent;
-			}
-			cachedMatrix = m;
-			useCachedMatrix = true;
-			return m;
-		} else {
-			return cachedMatrix;
-		}
-	}
-
-	void Node::update() {
-		useCachedMatrix = false;
-		if (mesh) {
-			glm::mat4 m = getMatrix();
-			if (skin) {
-				mesh->uniformBlock.matrix = m;
-				// Update join matrices
-				glm::mat4 inverseTransform = glm::inverse(m);
-				size_t numJoints = std::min((uint32_t)skin->joints.size(), MAX_NUM_JOINTS);
-				for (size_t i = 0; i < numJoints; i++) {
-					vkUSDZ::Node *jointNode = skin->joints[i];
-					glm::mat4 jointMat = jointNode->getMatrix() * skin->inverseBindMatrices[i];
-					jointMat = inverseTransform * jointMat;
-					mesh->uniformBlock.jointMatrix[i] = jointMat;
-				}
-				mesh->uniformBlock.jointcount = (float)numJoints;
-				memcpy(mesh->uniformBuffer.mapped, &mesh->uniformBlock, sizeof(mesh->uniformBlock));
-			} else {
-				memcpy(mesh->uniformBuffer.mapped, &m, sizeof(glm::mat4));
-			}
+		if (transforms) {
+			return transforms->worldMatrices[transformIndex];
 		}
-
-		for (auto& child : children) {
-			child->update();
+		// Not part of a transform hierarchy (yet)
+		glm::mat4 m = localMatrix();
+		vkUSDZ::Node* p = parent;
+		while (p) {
+			m = p->localMatrix() * m;
+			p = p->parent;
 		}
+		return m;
 	}
 
 	Node::~Node() {
@@ -561,10 +515,56 @@ namespace detail
 		}
 	}
 
+	// AnimationSampler
+
+	// Finds the keyframe interval containing time, returns false if time is outside of the track's range
+	bool AnimationSampler::findKey(float time, size_t& index)
+	{
+		if ((inputs.size() < 2) || (time < inputs.front()) || (time > inputs.back())) {
+			return false;
+		}
+		if (cursor + 1 >= inputs.size()) {
+			cursor = 0;
+		}
+		if ((time >= inputs[cursor]) && (time <= inputs[cursor + 1])) {
+			index = cursor;
+			return true;
+		}
+		if ((cursor + 2 < inputs.size()) && (time >= inputs[cursor + 1]) && (time <= inputs[cursor + 2])) {
+			index = ++cursor;
+			return true;
+		}
+		size_t upper = std::upper_bound(inputs.begin(), inputs.end(), time) - inputs.begin();
+		cursor = std::min(upper, inputs.size() - 1) - 1;
+		index = cursor;
+		return true;
+	}
+
+	glm::vec4 AnimationSampler::value(size_t index) const
+	{
+		glm::vec4 v{ 0.0f };
+		const float* src = &outputs[index * stride];
+		for (uint32_t i = 0; i < stride; i++) {
+			v[i] = src[i];
+		}
+		return v;
+	}
+
 	// Model
 
 	void Model::destroy(VkDevice device)
 	{
+		destroyScene(device);
+		deferredPrims.resize(0);
+		deferredPrimPaths.resize(0);
+		stage.reset();
+		usdzAsset.reset();
+	}
+
+	// Destroys everything that's been converted from the stage, a stage with deferred prims is kept
+	void Model::destroyScene(VkDevice device)
+	{
+		freeJointRanges();
 		if (vertices.buffer != VK_NULL_HANDLE) {
 			vkDestroyBuffer(device, vertices.buffer, nullptr);
 			vkFreeMemory(device, vertices.memory, nullptr);
@@ -587,6 +587,8 @@ namespace detail
 		animations.resize(0);
 		nodes.resize(0);
 		linearNodes.resize(0);
+		transformNodes.resize(0);
+		transforms.clear();
 		extensions.resize(0);
 		for (auto skin : skins) {
 			delete skin;
@@ -599,8 +601,8 @@ namespace detail
 		vkUSDZ::Node *newNode = new Node{};
 		newNode->index = nodeIndex;
 		newNode->parent = parent;
-		newNode->name = node.prim_name; // or node.abs_path
-		// newNode->skinIndex = node.skin; // TODO
+		newNode->name = node.prim_name;
+		newNode->path = node.abs_path;
 		newNode->matrix = glm::mat4(1.0f);
 
 		// Generate local node matrix
@@ -637,7 +639,7 @@ namespace detail
 		if ((node.nodeType == tinyusdz::tydra::NodeType::Mesh) && (node.id > -1)) {
 			assert(node.id < scene.meshes.size());
 			const tinyusdz::tydra::RenderMesh &rmesh = scene.meshes[size_t(node.id)];
-			Mesh *newMesh = new Mesh(device, newNode->matrix);
+			Mesh *newMesh = new Mesh(device, newNode->matrix, frameCount);
 
 			// TODO: GeomSubset
 			{
@@ -764,6 +766,12 @@ namespace detail
 							loaderInfo.indexPos++;
 					}
 				}					
+#if defined(VKUSDZ_STAGE_API)
+				// Skins are created per skeleton of the render scene in loadSkins
+				if (hasSkin) {
+					newNode->skinIndex = rmesh.skel_id;
+				}
+#endif
 				Primitive *newPrimitive = new Primitive(indexStart, indexCount, vertexCount, rmesh.material_id > -1 ? materials[size_t(rmesh.material_id)] : materials.back());
 				newPrimitive->setBoundingBox(posMin, posMax);
 				newMesh->primitives.push_back(newPrimitive);
@@ -810,44 +818,169 @@ namespace detail
 		}
 	}
 
-#if 0 // TODO
-	void Model::loadSkins(tinyusdz::Model &gltfModel)
+#if defined(VKUSDZ_STAGE_API)
+	static glm::mat4 toMat4(const tinyusdz::value::matrix4d& m)
 	{
-		for (tinyusdz::Skin &source : gltfModel.skins) {
-			Skin *newSkin = new Skin{};
-			newSkin->name = source.name;
-				
-			// Find skeleton root node
-			if (source.skeleton > -1) {
-				newSkin->skeletonRoot = nodeFromIndex(source.skeleton);
-			}
-
-			// Find joint nodes
-			for (int jointIndex : source.joints) {
-				Node* node = nodeFromIndex(jointIndex);
-				if (node) {
-					newSkin->joints.push_back(nodeFromIndex(jointIndex));
-				}
+		// USD matrices are row major with row vectors, which has the same memory layout as column major glm matrices
+		glm::mat4 matrix;
+		for (uint32_t i = 0; i < 4; i++) {
+			for (uint32_t j = 0; j < 4; j++) {
+				matrix[i][j] = static_cast<float>(m.m[i][j]);
 			}
+		}
+		return matrix;
+	}
 
-			// Get inverse bind matrices from buffer
-			if (source.inverseBindMatrices > -1) {
-				const tinyusdz::Accessor &accessor = gltfModel.accessors[source.inverseBindMatrices];
-				const tinyusdz::BufferView &bufferView = gltfModel.bufferViews[accessor.bufferView];
-				const tinyusdz::Buffer &buffer = gltfModel.buffers[bufferView.buffer];
-				newSkin->inverseBindMatrices.resize(accessor.count);
-				memcpy(newSkin->inverseBindMatrices.data(), &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::mat4));
-			}
+	// Splits an affine matrix without shear into translation, rotation and scale
+	static void decomposeMatrix(const glm::mat4& m, glm::vec3& translation, glm::quat& rotation, glm::vec3& scale)
+	{
+		translation = glm::vec3(m[3]);
+		scale = glm::vec3(glm::length(glm::vec3(m[0])), glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2])));
+		if (glm::determinant(glm::mat3(m)) < 0.0f) {
+			scale.x = -scale.x;
+		}
+		glm::mat3 r(glm::vec3(m[0]) / scale.x, glm::vec3(m[1]) / scale.y, glm::vec3(m[2]) / scale.z);
+		rotation = glm::normalize(glm::quat_cast(r));
+	}
+
+	// Animated nodes take their local transform from translation, rotation and scale, which start out with the node's static transform
+	static void makeAnimatable(Node* node)
+	{
+		if (node->matrix != glm::mat4(1.0f)) {
+			decomposeMatrix(node->matrix, node->translation, node->rotation, node->scale);
+			node->matrix = glm::mat4(1.0f);
+		}
+	}
 
+	// Creates a skin for each UsdSkel skeleton of the render scene, with a node per joint
+	// Joint nodes are added below the parent of the first mesh bound to the skeleton (usually the SkelRoot), as joint transforms are in skeleton space
+	void Model::loadSkins(const tinyusdz::tydra::RenderScene& scene)
+	{
+		uint32_t nodeIndex = 0;
+		for (auto node : linearNodes) {
+			nodeIndex = std::max(nodeIndex, node->index + 1);
+		}
+		for (size_t s = 0; s < scene.skeletons.size(); s++) {
+			const tinyusdz::tydra::SkelHierarchy& skeleton = scene.skeletons[s];
+			Skin* newSkin = new Skin{};
+			newSkin->name = skeleton.prim_name;
 			skins.push_back(newSkin);
+
+			Node* meshNode = nullptr;
+			for (auto node : linearNodes) {
+				if (node->mesh && (node->skinIndex == static_cast<int32_t>(s))) {
+					meshNode = node;
+					break;
+				}
+			}
+			if (!meshNode) {
+				continue;
+			}
+
+			// Joints are stored in the order of the skeleton's joints array, which the meshes' joint indices refer to
+			Node* rootJoint = nullptr;
+			std::vector<std::pair<const tinyusdz::tydra::SkelNode*, Node*>> stack = { { &skeleton.root_node, meshNode->parent } };
+			while (!stack.empty()) {
+				const tinyusdz::tydra::SkelNode* skelNode = stack.back().first;
+				Node* parent = stack.back().second;
+				stack.pop_back();
+
+				Node* joint = new Node{};
+				joint->index = nodeIndex++;
+				joint->parent = parent;
+				joint->name = skelNode->joint_name;
+				joint->path = skeleton.abs_path + "/" + skelNode->joint_path;
+				joint->matrix = toMat4(skelNode->rest_transform);
+				if (parent) {
+					parent->children.push_back(joint);
+				} else {
+					nodes.push_back(joint);
+				}
+				linearNodes.push_back(joint);
+				if (!rootJoint) {
+					rootJoint = joint;
+				}
+
+				if (skelNode->joint_id > -1) {
+					const size_t jointIndex = static_cast<size_t>(skelNode->joint_id);
+					if (jointIndex >= newSkin->joints.size()) {
+						newSkin->joints.resize(jointIndex + 1, nullptr);
+						newSkin->inverseBindMatrices.resize(jointIndex + 1, glm::mat4(1.0f));
+					}
+					newSkin->joints[jointIndex] = joint;
+					// Bind transforms are in skeleton space
+					newSkin->inverseBindMatrices[jointIndex] = glm::inverse(toMat4(skelNode->bind_transform));
+				}
+				for (auto it = skelNode->children.rbegin(); it != skelNode->children.rend(); ++it) {
+					stack.push_back({ &(*it), joint });
+				}
+			}
+			// Joints missing from the hierarchy fall back to the skeleton's root
+			for (auto& joint : newSkin->joints) {
+				if (!joint) {
+					joint = rootJoint;
+				}
+			}
+			newSkin->skeletonRoot = rootJoint;
 		}
 	}
+#else
+	// Skins and animations are read through the TinyUSDZ core API, see USE_USD_STAGE_API
+	void Model::loadSkins(const tinyusdz::tydra::RenderScene& scene)
+	{
+	}
 #endif
 
 	void Model::loadTextures(tinyusdz::tydra::RenderScene &scene, vks::VulkanDevice *device, VkQueue transferQueue)
 	{
-		for (tinyusdz::tydra::UVTexture &tex : scene.textures) {
+		// Only color textures are sRGB, data textures (roughness, metallic, normal and occlusion maps) get their mips filtered without conversion
+		std::vector<bool> colorTextures(scene.textures.size(), false);
+		for (const tinyusdz::tydra::RenderMaterial &rmat : scene.materials) {
+			if (rmat.surfaceShader.diffuseColor.is_texture()) {
+				colorTextures[size_t(rmat.surfaceShader.diffuseColor.texture_id)] = true;
+			}
+			if (rmat.surfaceShader.emissiveColor.is_texture()) {
+				colorTextures[size_t(rmat.surfaceShader.emissiveColor.texture_id)] = true;
+			}
+		}
+
+		// With lazy loading, textures are only loaded if a mesh uses one of their materials
+		std::vector<bool> requiredTextures(scene.textures.size(), !lazyLoading);
+		if (lazyLoading) {
+			std::vector<bool> usedMaterials(scene.materials.size(), false);
+			for (const tinyusdz::tydra::RenderMesh &rmesh : scene.meshes) {
+				if ((rmesh.material_id > -1) && (size_t(rmesh.material_id) < usedMaterials.size())) {
+					usedMaterials[size_t(rmesh.material_id)] = true;
+				}
+			}
+			auto addTexture = [&requiredTextures](const auto &param) {
+				if (param.is_texture()) {
+					requiredTextures[size_t(param.texture_id)] = true;
+				}
+			};
+			for (size_t mat_id = 0; mat_id < scene.materials.size(); mat_id++) {
+				if (!usedMaterials[mat_id]) {
+					continue;
+				}
+				const tinyusdz::tydra::PreviewSurfaceShader &shader = scene.materials[mat_id].surfaceShader;
+				addTexture(shader.diffuseColor);
+				addTexture(shader.emissiveColor);
+				addTexture(shader.normal);
+				addTexture(shader.roughness);
+				addTexture(shader.metallic);
+				addTexture(shader.occlusion);
+			}
+		}
+
+		textures.resize(scene.textures.size());
+		vks::TextureCache imageCache;
+		for (size_t tex_id = 0; tex_id < scene.textures.size(); tex_id++) {
+			if (!requiredTextures[tex_id]) {
+				continue;
+			}
+			tinyusdz::tydra::UVTexture &tex = scene.textures[tex_id];
 			assert(tex.texture_image_id > -1);
+			const bool srgb = colorTextures[tex_id];
 			tinyusdz::tydra::TextureImage &image = scene.images[tex.texture_image_id];
 			vkUSDZ::TextureSampler textureSampler;
 			// No sampler for USDZ texture for now, use a default one
@@ -860,10 +993,25 @@ namespace detail
 			assert(image.buffer_id > -1);
 			tinyusdz::tydra::BufferData &buffer = scene.buffers[image.buffer_id];
 
-			// FIXME: Assume all textures are 8bit at the moment.
+			// UVTextures referencing the same image (in the same color space) share the uploaded image
+			const std::string imageKey = vks::TextureCache::identityKey("image" + std::to_string(tex.texture_image_id), srgb ? 1 : 0);
+			uint32_t owner;
+			if (imageCache.find(imageKey, owner)) {
+				vkUSDZ::Texture texture = textures[owner];
+				texture.imageOwner = static_cast<int32_t>(owner);
+				texture.createSampler(textureSampler);
+				texture.updateDescriptor();
+				textures[tex_id] = texture;
+				continue;
+			}
+
 			vkUSDZ::Texture texture;
-			texture.fromUSDZImage(image, buffer.data, textureSampler, device, transferQueue);
-			textures.push_back(texture);
+			texture.fromUSDZImage(image, buffer.data, textureSampler, device, transferQueue, srgb, mipGenerator, textureStreamer);
+			imageCache.insert(imageKey, static_cast<uint32_t>(tex_id));
+			textures[tex_id] = texture;
+		}
+		if (mipGenerator) {
+			mipGenerator->flush();
 		}
 	}
 
@@ -929,143 +1077,37 @@ namespace detail
 
 	void Model::loadMaterials(tinyusdz::tydra::RenderScene &scene, vks::VulkanDevice *device, VkQueue transferQueue)
 	{
-		// First build roughnessMetallic texture map, since this will extend `textures` array
-		std::map<size_t, std::map<std::string, size_t>> textureIdMap; // key = material_id, value = (attr_name, tex_id)
- 
-		for (size_t mat_id = 0; mat_id < scene.materials.size(); mat_id++) {
-			const tinyusdz::tydra::RenderMaterial &rmat = scene.materials[mat_id];
-
-			if (rmat.surfaceShader.useSpecularWorkflow) {
-				// TODO
-				continue;
+		auto isSupportedImage = [&scene](const tinyusdz::tydra::UVTexture &tex) {
+			assert(tex.texture_image_id > -1);
+			vks::PixelConverter::ComponentType type;
+			return getPixelComponentType(scene.images[size_t(tex.texture_image_id)].texelComponentType, type);
+		};
+		// Textures that haven't been loaded are left unbound, with lazy loading their materials aren't used by any mesh
+		auto getTexture = [this](int index) -> Texture* {
+			if ((index < 0) || (size_t(index) >= textures.size()) || (textures[size_t(index)].device == nullptr)) {
+				return nullptr;
 			}
+			return &textures[size_t(index)];
+		};
+		// Component of the uploaded RGBA image that a UsdUVTexture output reads
+		auto outputChannel = [](const tinyusdz::tydra::UVTexture &tex) -> uint8_t {
+			if (tex.connectedOutputChannel == tinyusdz::tydra::UVTexture::Channel::G) {
+				return 1;
+			} else if (tex.connectedOutputChannel == tinyusdz::tydra::UVTexture::Channel::B) {
+				return 2;
+			} else if (tex.connectedOutputChannel == tinyusdz::tydra::UVTexture::Channel::A) {
+				return 3;
+			}
+			return 0;
+		};
 
-      // Build metallic + roughness texture
-      float occlusionFactor = 1.0f;
-      float roughnessFactor = rmat.surfaceShader.roughness.value;
-      float metallicFactor = rmat.surfaceShader.metallic.value;
-
-      // Occlusion is not considered here.
-      std::vector<uint8_t> occlusionImageData;
-      size_t occlusionImageWidth{0}, occlusionImageHeight{0}, occlusionImageChannels{0}, occlusionChannel{0};
-
-      std::vector<uint8_t> metallicImageData;
-      size_t metallicImageWidth{0}, metallicImageHeight{0}, metallicImageChannels{0}, metallicChannel{0};
-
-      std::vector<uint8_t> roughnessImageData;
-      size_t roughnessImageWidth{0}, roughnessImageHeight{0}, roughnessImageChannels{0}, roughnessChannel{0};
-
-      if (rmat.surfaceShader.roughness.is_texture()) {
-        assert(scene.textures[size_t(rmat.surfaceShader.roughness.texture_id)].texture_image_id > -1);
-        const tinyusdz::tydra::UVTexture &tex = scene.textures[size_t(rmat.surfaceShader.roughness.texture_id)];
-
-        if (tex.connectedOutputChannel == tinyusdz::tydra::UVTexture::Channel::R) {
-          roughnessChannel = 0;
-        } else if (tex.connectedOutputChannel == tinyusdz::tydra::UVTexture::Channel::G) {
-          roughnessChannel = 1;
-        } else if (tex.connectedOutputChannel == tinyusdz::tydra::UVTexture::Channel::B) {
-          roughnessChannel = 2;
-        } else if (tex.connectedOutputChannel == tinyusdz::tydra::UVTexture::Channel::A) {
-          roughnessChannel = 3;
-        } else {
-          // TODO: Report error
-        }
-
-        const tinyusdz::tydra::TextureImage &texImage = scene.images[size_t(tex.texture_image_id)];
-        if (texImage.texelComponentType == tinyusdz::tydra::ComponentType::UInt8) {
-          roughnessImageData = scene.buffers[size_t(texImage.buffer_id)].data; // copy
-          roughnessImageWidth = texImage.width;
-          roughnessImageHeight = texImage.height;
-          roughnessImageChannels = texImage.channels;
-        } else {
-          std::cerr << "Currently only 8bit texture is supported for roughness texture map.\n";
-        }
-      }
-
-      if (rmat.surfaceShader.metallic.is_texture()) {
-        assert(scene.textures[size_t(rmat.surfaceShader.metallic.texture_id)].texture_image_id > -1);
-
-        const tinyusdz::tydra::UVTexture &tex = scene.textures[size_t(rmat.surfaceShader.metallic.texture_id)];
-
-        if (tex.connectedOutputChannel == tinyusdz::tydra::UVTexture::Channel::R) {
-          metallicChannel = 0;
-        } else if (tex.connectedOutputChannel == tinyusdz::tydra::UVTexture::Channel::G) {
-          metallicChannel = 1;
-        } else if (tex.connectedOutputChannel == tinyusdz::tydra::UVTexture::Channel::B) {
-          metallicChannel = 2;
-        } else if (tex.connectedOutputChannel == tinyusdz::tydra::UVTexture::Channel::A) {
-          metallicChannel = 3;
-        } else {
-          // TODO: Report error
-        }
-
-        const tinyusdz::tydra::TextureImage &texImage = scene.images[size_t(tex.texture_image_id)];
-        if (texImage.texelComponentType == tinyusdz::tydra::ComponentType::UInt8) {
-          metallicImageData = scene.buffers[size_t(texImage.buffer_id)].data; // copy
-          metallicImageWidth = texImage.width;
-          metallicImageHeight = texImage.height;
-          metallicImageChannels = texImage.channels;
-        } else {
-          std::cerr << "Currently only 8bit texture is supported for metallic texture map.\n";
-        }
-      }
-
-      std::vector<uint8_t> ormImageData;
-      size_t ormImageWidth;
-      size_t ormImageHeight;
-
-      if (detail::BuildOcclusionRoughnessMetallicTexture(
-        occlusionFactor,
-        roughnessFactor,
-        metallicFactor,
-        occlusionImageData,
-        occlusionImageWidth,
-        occlusionImageHeight,
-        occlusionImageChannels,
-				occlusionChannel,
-        roughnessImageData,
-        roughnessImageWidth,
-        roughnessImageHeight,
-        roughnessImageChannels,
-				roughnessChannel,
-        metallicImageData,
-        metallicImageWidth,
-        metallicImageHeight,
-        metallicImageChannels,
-				metallicChannel,
-        ormImageData,
-        ormImageWidth,
-        ormImageHeight)) {
-
-        vkUSDZ::TextureSampler textureSampler;
-        // No sampler for USDZ texture for now, use a default one
-        textureSampler.magFilter = VK_FILTER_LINEAR;
-        textureSampler.minFilter = VK_FILTER_LINEAR;
-        textureSampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-        textureSampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-        textureSampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-
-        tinyusdz::tydra::TextureImage ormImage;
-        ormImage.width = ormImageWidth;
-        ormImage.height = ormImageHeight;
-        ormImage.channels = 3; // RGB
-
-        vkUSDZ::Texture texture;
-        texture.fromUSDZImage(ormImage, ormImageData, textureSampler, device, transferQueue);
-        size_t tex_id = textures.size();
-        textures.push_back(texture);
-
-				textureIdMap[mat_id]["metallicRoughness"] = tex_id;
-      }
-    }
-		
 		for (size_t mat_id = 0; mat_id < scene.materials.size(); mat_id++) {
 			const tinyusdz::tydra::RenderMaterial &rmat = scene.materials[mat_id];
 			vkUSDZ::Material material{};
 			// TODO: Read doubleSided attribute from bound mesh.
 			material.doubleSided = true;
 			if (rmat.surfaceShader.diffuseColor.is_texture()) {
-				material.baseColorTexture = &textures[size_t(rmat.surfaceShader.diffuseColor.texture_id)];
+				material.baseColorTexture = getTexture(rmat.surfaceShader.diffuseColor.texture_id);
 				material.texCoordSets.baseColor = 0;
 			} else {
 				material.baseColorFactor.r = rmat.surfaceShader.diffuseColor.value[0];
@@ -1104,24 +1146,41 @@ namespace detail
 			}
 #endif
 			} else {
-				
-        if (textureIdMap[mat_id].count("metallicRoughness")) {
-          material.metallicRoughnessTexture = &textures[textureIdMap[mat_id]["metallicRoughness"]];
-          material.texCoordSets.metallicRoughness = 0;
-        } else {
-          material.roughnessFactor = rmat.surfaceShader.roughness.value;
-          material.metallicFactor = rmat.surfaceShader.metallic.value;
-        }
-
+				// Roughness and metallic textures are bound as they are, the shader reads the channel their UsdUVTexture output is connected to
+				// Roughness uses the metallicRoughnessTexture slot
+				material.roughnessFactor = rmat.surfaceShader.roughness.value;
+				material.metallicFactor = rmat.surfaceShader.metallic.value;
+				if (rmat.surfaceShader.roughness.is_texture()) {
+					const tinyusdz::tydra::UVTexture &tex = scene.textures[size_t(rmat.surfaceShader.roughness.texture_id)];
+					if (isSupportedImage(tex)) {
+						material.metallicRoughnessTexture = getTexture(rmat.surfaceShader.roughness.texture_id);
+						material.roughnessChannel = outputChannel(tex);
+						material.roughnessFactor = 1.0f;
+						material.texCoordSets.metallicRoughness = 0;
+					} else {
+						std::cerr << "Unsupported texel component type for roughness texture map.\n";
+					}
+				}
+				if (rmat.surfaceShader.metallic.is_texture()) {
+					const tinyusdz::tydra::UVTexture &tex = scene.textures[size_t(rmat.surfaceShader.metallic.texture_id)];
+					if (isSupportedImage(tex)) {
+						material.metallicTexture = getTexture(rmat.surfaceShader.metallic.texture_id);
+						material.metallicChannel = outputChannel(tex);
+						material.metallicFactor = 1.0f;
+						material.texCoordSets.metallic = 0;
+					} else {
+						std::cerr << "Unsupported texel component type for metallic texture map.\n";
+					}
+				}
 			}
 
 			if (rmat.surfaceShader.normal.is_texture()) {
-				material.normalTexture = &textures[size_t(rmat.surfaceShader.normal.texture_id)];
+				material.normalTexture = getTexture(rmat.surfaceShader.normal.texture_id);
 				material.texCoordSets.normal = 0;
 			}
 
 			if (rmat.surfaceShader.emissiveColor.is_texture()) {
-				material.emissiveTexture = &textures[size_t(rmat.surfaceShader.emissiveColor.texture_id)];
+				material.emissiveTexture = getTexture(rmat.surfaceShader.emissiveColor.texture_id);
 				material.texCoordSets.emissive = 0;
 
 				// FIXME. Read emissiveColor from 'default' value of emissiveColor attribute.
@@ -1135,13 +1194,11 @@ namespace detail
 			}
 
 			if (rmat.surfaceShader.occlusion.is_texture()) {
-				assert(scene.textures[size_t(rmat.surfaceShader.occlusion.texture_id)].texture_image_id > -1);
-				const tinyusdz::tydra::TextureImage &texImage = scene.images[size_t(scene.textures[size_t(rmat.surfaceShader.occlusion.texture_id)].texture_image_id)];
-				if (texImage.texelComponentType != tinyusdz::tydra::ComponentType::UInt8) {
-					std::cerr << "HDR occlusion map is not supported yet.\n";
+				if (isSupportedImage(scene.textures[size_t(rmat.surfaceShader.occlusion.texture_id)])) {
+					material.occlusionTexture = getTexture(rmat.surfaceShader.occlusion.texture_id);
+					material.texCoordSets.occlusion = 0;
 				} else {
-          material.occlusionTexture = &textures[size_t(rmat.surfaceShader.occlusion.texture_id)];
-          material.texCoordSets.occlusion = 0;
+					std::cerr << "Unsupported texel component type for occlusion texture map.\n";
 				}
 			}
 
@@ -1183,192 +1240,392 @@ namespace detail
 		materials.push_back(Material());
 	}
 
-#if 0 // TODO
-	void Model::loadAnimations(tinyusdz::Model &gltfModel)
+#if defined(VKUSDZ_STAGE_API)
+	// Adds a linear track for one property of a node, key times are converted from time codes to seconds
+	static void addTrack(Animation& animation, Node* node, AnimationChannel::PathType path, const std::vector<float>& inputs, std::vector<float>&& outputs, uint32_t stride)
 	{
-		for (tinyusdz::Animation &anim : gltfModel.animations) {
-			vkUSDZ::Animation animation{};
-			animation.name = anim.name;
-			if (anim.name.empty()) {
-				animation.name = std::to_string(animations.size());
-			}
-
-			// Samplers
-			for (auto &samp : anim.samplers) {
-				vkUSDZ::AnimationSampler sampler{};
-
-				if (samp.interpolation == "LINEAR") {
-					sampler.interpolation = AnimationSampler::InterpolationType::LINEAR;
-				}
-				if (samp.interpolation == "STEP") {
-					sampler.interpolation = AnimationSampler::InterpolationType::STEP;
-				}
-				if (samp.interpolation == "CUBICSPLINE") {
-					sampler.interpolation = AnimationSampler::InterpolationType::CUBICSPLINE;
-				}
-
-				// Read sampler input time values
-				{
-					const tinyusdz::Accessor &accessor = gltfModel.accessors[samp.input];
-					const tinyusdz::BufferView &bufferView = gltfModel.bufferViews[accessor.bufferView];
-					const tinyusdz::Buffer &buffer = gltfModel.buffers[bufferView.buffer];
+		if ((inputs.size() < 2) || (outputs.size() < inputs.size() * stride)) {
+			return;
+		}
+		AnimationSampler sampler{};
+		sampler.inputs = inputs;
+		sampler.outputs = std::move(outputs);
+		sampler.stride = stride;
+		animation.start = std::min(animation.start, inputs.front());
+		animation.end = std::max(animation.end, inputs.back());
+
+		AnimationChannel channel{};
+		channel.path = path;
+		channel.node = node;
+		channel.samplerIndex = static_cast<uint32_t>(animation.samplers.size());
+		animation.samplers.push_back(std::move(sampler));
+		animation.channels.push_back(channel);
+	}
 
-					assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
+	// Reads the samples of a Tydra animation sampler with stride float components per value
+	template <typename T>
+	static void readSamples(const std::vector<T>& samples, uint32_t stride, double timeCodesPerSecond, std::vector<float>& inputs, std::vector<float>& outputs)
+	{
+		for (const auto& sample : samples) {
+			static_assert(sizeof(sample.value) % sizeof(float) == 0, "Sample values need to consist of floats");
+			inputs.push_back(static_cast<float>(sample.t / timeCodesPerSecond));
+			const float* value = reinterpret_cast<const float*>(&sample.value);
+			outputs.insert(outputs.end(), value, value + stride);
+		}
+	}
 
-					const void *dataPtr = &buffer.data[accessor.byteOffset + bufferView.byteOffset];
-					const float *buf = static_cast<const float*>(dataPtr);
-					for (size_t index = 0; index < accessor.count; index++) {
-						sampler.inputs.push_back(buf[index]);
-					}
+	// Samples time sampled xformOps and UsdSkel animations once into per node tracks, so playback only interpolates keys like glTF animations instead of converting the stage per time code
+	void Model::loadAnimations(const tinyusdz::tydra::RenderScene& scene)
+	{
+		double timeCodesPerSecond = stage->metas().timeCodesPerSecond.get_value();
+		if (timeCodesPerSecond <= 0.0) {
+			timeCodesPerSecond = 24.0;
+		}
 
-					for (auto input : sampler.inputs) {
-						if (input < animation.start) {
-							animation.start = input;
-						};
-						if (input > animation.end) {
-							animation.end = input;
-						}
+		// xformOps, all animated prims of the stage are played back together
+		Animation xformAnimation{};
+		xformAnimation.name = "xformOps";
+		for (auto node : linearNodes) {
+			if (node->path.empty()) {
+				continue;
+			}
+			auto prim = stage->GetPrimAtPath(tinyusdz::Path(node->path, ""));
+			if (!prim) {
+				continue;
+			}
+			const tinyusdz::Xformable* xformable = nullptr;
+			if (!tinyusdz::CastToXformable(*prim.value(), &xformable) || !xformable) {
+				continue;
+			}
+			// The local matrix is evaluated at every time code that one of the ops has a sample for
+			std::vector<double> times;
+			for (const auto& op : xformable->xformOps) {
+				if (!op.is_timesamples()) {
+					continue;
+				}
+				auto timeSamples = op.get_timesamples();
+				if (timeSamples) {
+					for (const auto& sample : timeSamples.value().get_samples()) {
+						times.push_back(sample.t);
 					}
 				}
+			}
+			std::sort(times.begin(), times.end());
+			times.erase(std::unique(times.begin(), times.end()), times.end());
+			if (times.size() < 2) {
+				continue;
+			}
 
-				// Read sampler output T/R/S values 
-				{
-					const tinyusdz::Accessor &accessor = gltfModel.accessors[samp.output];
-					const tinyusdz::BufferView &bufferView = gltfModel.bufferViews[accessor.bufferView];
-					const tinyusdz::Buffer &buffer = gltfModel.buffers[bufferView.buffer];
-
-					assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
-
-					const void *dataPtr = &buffer.data[accessor.byteOffset + bufferView.byteOffset];
+			std::vector<float> inputs;
+			std::vector<float> translations;
+			std::vector<float> rotations;
+			std::vector<float> scales;
+			for (double t : times) {
+				tinyusdz::value::matrix4d matrix;
+				bool resetXformStack = false;
+				std::string error;
+				if (!xformable->EvaluateXformOps(t, tinyusdz::value::TimeSampleInterpolationType::Linear, &matrix, &resetXformStack, &error)) {
+					std::cerr << "Could not evaluate xformOps of " << node->path << ": " << error << std::endl;
+					break;
+				}
+				glm::vec3 translation;
+				glm::quat rotation;
+				glm::vec3 scale;
+				decomposeMatrix(toMat4(matrix), translation, rotation, scale);
+				inputs.push_back(static_cast<float>(t / timeCodesPerSecond));
+				translations.insert(translations.end(), { translation.x, translation.y, translation.z });
+				rotations.insert(rotations.end(), { rotation.x, rotation.y, rotation.z, rotation.w });
+				scales.insert(scales.end(), { scale.x, scale.y, scale.z });
+			}
+			if (inputs.size() != times.size()) {
+				continue;
+			}
+			makeAnimatable(node);
+			addTrack(xformAnimation, node, AnimationChannel::PathType::TRANSLATION, inputs, std::move(translations), 3);
+			addTrack(xformAnimation, node, AnimationChannel::PathType::ROTATION, inputs, std::move(rotations), 4);
+			addTrack(xformAnimation, node, AnimationChannel::PathType::SCALE, inputs, std::move(scales), 3);
+		}
+		if (!xformAnimation.channels.empty()) {
+			animations.push_back(xformAnimation);
+		}
 
-					switch (accessor.type) {
-					case TINYGLTF_TYPE_VEC3: {
-						const glm::vec3 *buf = static_cast<const glm::vec3*>(dataPtr);
-						for (size_t index = 0; index < accessor.count; index++) {
-							sampler.outputsVec4.push_back(glm::vec4(buf[index], 0.0f));
-						}
+		// UsdSkel, one animation per skeleton with a bound SkelAnimation
+		for (size_t s = 0; (s < scene.skeletons.size()) && (s < skins.size()); s++) {
+			const int animationIndex = scene.skeletons[s].anim_id;
+			if ((animationIndex < 0) || (static_cast<size_t>(animationIndex) >= scene.animations.size())) {
+				continue;
+			}
+			const tinyusdz::tydra::Animation& source = scene.animations[static_cast<size_t>(animationIndex)];
+			Animation animation{};
+			animation.name = source.prim_name;
+			for (auto joint : skins[s]->joints) {
+				auto channels = source.channels_map.find(joint->name);
+				if (channels == source.channels_map.end()) {
+					continue;
+				}
+				for (const auto& channel : channels->second) {
+					std::vector<float> inputs;
+					std::vector<float> outputs;
+					switch (channel.first) {
+					case tinyusdz::tydra::AnimationChannel::ChannelType::Translation:
+						readSamples(channel.second.translations.samples, 3, timeCodesPerSecond, inputs, outputs);
+						makeAnimatable(joint);
+						addTrack(animation, joint, AnimationChannel::PathType::TRANSLATION, inputs, std::move(outputs), 3);
 						break;
-					}
-					case TINYGLTF_TYPE_VEC4: {
-						const glm::vec4 *buf = static_cast<const glm::vec4*>(dataPtr);
-						for (size_t index = 0; index < accessor.count; index++) {
-							sampler.outputsVec4.push_back(buf[index]);
-						}
+					case tinyusdz::tydra::AnimationChannel::ChannelType::Rotation:
+						readSamples(channel.second.rotations.samples, 4, timeCodesPerSecond, inputs, outputs);
+						makeAnimatable(joint);
+						addTrack(animation, joint, AnimationChannel::PathType::ROTATION, inputs, std::move(outputs), 4);
 						break;
-					}
-					default: {
-						std::cout << "unknown type" << std::endl;
+					case tinyusdz::tydra::AnimationChannel::ChannelType::Scale:
+						readSamples(channel.second.scales.samples, 3, timeCodesPerSecond, inputs, outputs);
+						makeAnimatable(joint);
+						addTrack(animation, joint, AnimationChannel::PathType::SCALE, inputs, std::move(outputs), 3);
+						break;
+					default:
 						break;
-					}
 					}
 				}
+			}
+			if (!animation.channels.empty()) {
+				animations.push_back(animation);
+			}
+		}
+	}
+#else
+	void Model::loadAnimations(const tinyusdz::tydra::RenderScene& scene)
+	{
+	}
+#endif
+
+#if defined(VKUSDZ_STAGE_API)
+	// Paths of prims are built from their element names, so this doesn't depend on absolute paths having been assigned by the loader
+	static bool isPathInSubtree(const std::string& path, const std::string& root)
+	{
+		return (path == root) || (path.compare(0, root.size() + 1, root + "/") == 0);
+	}
 
-				animation.samplers.push_back(sampler);
+	// The prim is selected or inside of a selected subtree
+	static bool isSelectedPrim(const std::string& path, const std::vector<std::string>& primPaths)
+	{
+		for (const auto& primPath : primPaths) {
+			if (isPathInSubtree(path, primPath)) {
+				return true;
 			}
+		}
+		return false;
+	}
 
-			// Channels
-			for (auto &source: anim.channels) {
-				vkUSDZ::AnimationChannel channel{};
+	// The prim is selected, inside of a selected subtree or one of the ancestors of a selected prim
+	static bool isOnPrimPath(const std::string& path, const std::vector<std::string>& primPaths)
+	{
+		for (const auto& primPath : primPaths) {
+			if (isPathInSubtree(path, primPath) || isPathInSubtree(primPath, path)) {
+				return true;
+			}
+		}
+		return false;
+	}
 
-				if (source.target_path == "rotation") {
-					channel.path = AnimationChannel::PathType::ROTATION;
-				}
-				if (source.target_path == "translation") {
-					channel.path = AnimationChannel::PathType::TRANSLATION;
-				}
-				if (source.target_path == "scale") {
-					channel.path = AnimationChannel::PathType::SCALE;
-				}
-				if (source.target_path == "weights") {
-					std::cout << "weights not yet supported, skipping channel" << std::endl;
-					continue;
-				}
-				channel.samplerIndex = source.sampler;
-				channel.node = nodeFromIndex(source.target_node);
-				if (!channel.node) {
-					continue;
-				}
+	static bool containsMaterial(const tinyusdz::Prim& prim)
+	{
+		if (prim.as<tinyusdz::Material>() != nullptr) {
+			return true;
+		}
+		for (const auto& child : prim.children()) {
+			if (containsMaterial(child)) {
+				return true;
+			}
+		}
+		return false;
+	}
 
-				animation.channels.push_back(channel);
+	// Moves children that are neither on one of the prim paths nor contain materials (which selected meshes may be bound to) out of the stage
+	static void filterPrims(std::vector<tinyusdz::Prim>& prims, const std::string& parentPath, const std::vector<std::string>& primPaths, std::vector<Model::DeferredPrim>& deferredPrims)
+	{
+		for (auto it = prims.begin(); it != prims.end();) {
+			const std::string path = parentPath + "/" + it->element_name();
+			if (isOnPrimPath(path, primPaths) || containsMaterial(*it)) {
+				// Selected subtrees and materials are loaded as a whole
+				if (!isSelectedPrim(path, primPaths) && (it->as<tinyusdz::Material>() == nullptr)) {
+					filterPrims(it->children(), path, primPaths, deferredPrims);
+				}
+				it++;
+			} else {
+				deferredPrims.push_back({ parentPath, std::move(*it) });
+				it = prims.erase(it);
 			}
+		}
+	}
 
-			animations.push_back(animation);
+	static tinyusdz::Prim* findPrim(std::vector<tinyusdz::Prim>& prims, const std::string& parentPath, const std::string& path)
+	{
+		for (auto& prim : prims) {
+			const std::string primPath = parentPath + "/" + prim.element_name();
+			if (primPath == path) {
+				return &prim;
+			}
+			if (isPathInSubtree(path, primPath)) {
+				return findPrim(prim.children(), primPath, path);
+			}
 		}
+		return nullptr;
 	}
+
 #endif
 
+	// Moves all prims that aren't in the subtrees of primPaths into deferredPrims
+	void Model::filterStage()
+	{
+#if defined(VKUSDZ_STAGE_API)
+		// Deferred prims are put back first, so the stage can be filtered again with a different set of paths
+		for (auto& deferred : deferredPrims) {
+			if (deferred.parentPath.empty()) {
+				stage->root_prims().push_back(std::move(deferred.prim));
+			} else {
+				tinyusdz::Prim* parent = findPrim(stage->root_prims(), "", deferred.parentPath);
+				assert(parent);
+				parent->children().push_back(std::move(deferred.prim));
+			}
+		}
+		deferredPrims.resize(0);
+		deferredPrimPaths.resize(0);
+		if (!primPaths.empty()) {
+			filterPrims(stage->root_prims(), "", primPaths, deferredPrims);
+		}
+		for (const auto& deferred : deferredPrims) {
+			deferredPrimPaths.push_back(deferred.parentPath + "/" + deferred.prim.element_name());
+		}
+		// Prim ids and absolute paths are reassigned for the changed hierarchy
+		stage->commit();
+#else
+		if (!primPaths.empty()) {
+			std::cerr << "Filtering USD stages by prim path requires a build with USE_USD_STAGE_API, loading the whole stage" << std::endl;
+			primPaths.resize(0);
+		}
+#endif
+	}
+
+	// Convert USD Scene(Stage) to Vulkan-friendly scene data using TinyUSDZ Tydra
+	bool Model::convertStage(tinyusdz::tydra::RenderScene& render_scene)
+	{
+		tinyusdz::tydra::RenderSceneConverter converter;
+		tinyusdz::tydra::RenderSceneConverterEnv env(*stage);
+
+		// In default, RenderSceneConverter triangulate meshes and build single vertex ind  ex.
+		// You can explicitly enable triangulation and vertex-indices build by
+		//env.mesh_config.triangulate = true;
+		//env.mesh_config.build_vertex_indices = true;
+
+		// Load textures as stored representaion(e.g. 8bit sRGB texture is read as 8bit sR  GB)
+		env.material_config.linearize_color_space = false;
+		env.material_config.preserve_texel_bitdepth = true;
+
+		if (usdzAsset) {
+			tinyusdz::AssetResolutionResolver arr;
+
+			// NOTE: Pointer address of usdz_asset must be valid until the call of RenderSce  neConverter::ConvertToRenderScene.
+			if (!tinyusdz::SetupUSDZAssetResolution(arr, usdzAsset.get())) {
+				std::cerr << "Failed to setup AssetResolution for USDZ asset\n";
+				return false;
+			};
+
+			env.asset_resolver = arr;
+
+		} else {
+		  env.set_search_paths({tinyusdz::io::GetBaseDir(filename)});
+		}
+
+		env.timecode = tinyusdz::value::TimeCode::Default();
+		bool ret = converter.ConvertToRenderScene(env, &render_scene);
+		if (!ret) {
+			std::cerr << "Failed to convert USD Stage to RenderScene: \n" << converter.GetError() << "\n";
+			return false;
+		}
+
+		if (converter.GetWarning().size()) {
+			std::cout << "ConvertToRenderScene warn: " << converter.GetWarning() << "\n";
+		}
+		return true;
+	}
+
 	void Model::loadFromFile(std::string filename, vks::VulkanDevice* device, VkQueue transferQueue, float scale)
 	{
-		tinyusdz::Stage stage;
 		std::string error;
 		std::string warning;
 
 		this->device = device;
+		this->filename = filename;
+		loadScale = scale;
+		stage = std::make_shared<tinyusdz::Stage>();
 
-		bool fileLoaded = tinyusdz::LoadUSDFromFile(filename, &stage, &warning, &error);
+		bool fileLoaded = tinyusdz::LoadUSDFromFile(filename, stage.get(), &warning, &error);
 		if (warning.size()) {
 			std::cerr << "WARN: " << warning << "\n";
 		}
+		if (!fileLoaded) {
+			// TODO: throw
+			std::cerr << "Could not load USDZ file: " << error << std::endl;
+			stage.reset();
+			return;
+		}
 
-		LoaderInfo loaderInfo{};
-		size_t vertexCount = 0;
-		size_t indexCount = 0;
-
-		if (fileLoaded) {
-			bool is_usdz = tinyusdz::IsUSDZ(filename);
-
-			// Convert USD Scene(Stage) to Vulkan-friendly scene data using TinyUSDZ Tydra
-			tinyusdz::tydra::RenderScene render_scene;
-			tinyusdz::tydra::RenderSceneConverter converter;
-			tinyusdz::tydra::RenderSceneConverterEnv env(stage);
-
-			// In default, RenderSceneConverter triangulate meshes and build single vertex ind  ex.
-			// You can explicitly enable triangulation and vertex-indices build by
-			//env.mesh_config.triangulate = true;
-			//env.mesh_config.build_vertex_indices = true;
-
-			// Load textures as stored representaion(e.g. 8bit sRGB texture is read as 8bit sR  GB)
-			env.material_config.linearize_color_space = false;
-			env.material_config.preserve_texel_bitdepth = true;
-
-			std::string usd_basedir = tinyusdz::io::GetBaseDir(filename);
-
-			tinyusdz::USDZAsset usdz_asset;
-			if (is_usdz) {
-				// Setup AssetResolutionResolver to read a asset(file) from memory.
-				if (!tinyusdz::ReadUSDZAssetInfoFromFile(filename, &usdz_asset, &warning, &error  )) {
-					std::cerr << "Failed to read USDZ assetInfo from file: " << error << "\n";
-					return;
-				}
-				if (warning.size()) {
-					std::cout << warning << "\n";
-				}
+		if (tinyusdz::IsUSDZ(filename)) {
+			// Setup AssetResolutionResolver to read a asset(file) from memory.
+			usdzAsset = std::make_shared<tinyusdz::USDZAsset>();
+			if (!tinyusdz::ReadUSDZAssetInfoFromFile(filename, usdzAsset.get(), &warning, &error  )) {
+				std::cerr << "Failed to read USDZ assetInfo from file: " << error << "\n";
+				stage.reset();
+				usdzAsset.reset();
+				return;
+			}
+			if (warning.size()) {
+				std::cout << warning << "\n";
+			}
+		}
 
-				tinyusdz::AssetResolutionResolver arr;
+		filterStage();
+		if (!deferredPrims.empty()) {
+			std::cout << "Deferred " << deferredPrims.size() << " prims outside of the selected prim paths" << std::endl;
+		}
+		loadStage(transferQueue);
 
-				// NOTE: Pointer address of usdz_asset must be valid until the call of RenderSce  neConverter::ConvertToRenderScene.
-				if (!tinyusdz::SetupUSDZAssetResolution(arr, &usdz_asset)) {
-					std::cerr << "Failed to setup AssetResolution for USDZ asset\n";
-					return;
-				};
+		// Nothing left to load later on
+		if (deferredPrims.empty()) {
+			stage.reset();
+			usdzAsset.reset();
+		}
+	}
 
-				env.asset_resolver = arr;
+	// Adds prim paths to the selection and reloads the scene with the deferred prims in them
+	bool Model::loadPrims(const std::vector<std::string>& paths, VkQueue transferQueue)
+	{
+		if (!stage) {
+			return false;
+		}
+		primPaths.insert(primPaths.end(), paths.begin(), paths.end());
+		destroyScene(device->logicalDevice);
+		filterStage();
+		loadStage(transferQueue);
+		if (deferredPrims.empty()) {
+			stage.reset();
+			usdzAsset.reset();
+		}
+		return true;
+	}
 
-			} else {
-			  env.set_search_paths({usd_basedir});
-			}
+	void Model::loadStage(VkQueue transferQueue)
+	{
+		LoaderInfo loaderInfo{};
+		size_t vertexCount = 0;
+		size_t indexCount = 0;
 
-			env.timecode = tinyusdz::value::TimeCode::Default();
-			bool ret = converter.ConvertToRenderScene(env, &render_scene);
-			if (!ret) {
-				std::cerr << "Failed to convert USD Stage to RenderScene: \n" << converter.GetError() << "\n";
+		{
+			tinyusdz::tydra::RenderScene render_scene;
+			if (!convertStage(render_scene)) {
 				return;
 			}
 
-			if (converter.GetWarning().size()) {
-				std::cout << "ConvertToRenderScene warn: " << converter.GetWarning() << "\n";
-			}
-
 			loadTextureSamplers(render_scene);
 			loadTextures(render_scene, device, transferQueue);
 			loadMaterials(render_scene, device, transferQueue);
@@ -1381,36 +1638,29 @@ namespace detail
 			loaderInfo.indexBuffer = new uint32_t[indexCount];
 
 			// TODO: scene handling with no default scene
-			const tinyusdz::tydra::Node &root = render_scene.nodes[render_scene.default_root_node];
-			uint32_t nodeIdx = 0;
-			loadNode(nullptr, root, /* inout */nodeIdx, render_scene, loaderInfo, scale);
+			if ((render_scene.default_root_node >= 0) && (size_t(render_scene.default_root_node) < render_scene.nodes.size())) {
+				const tinyusdz::tydra::Node &root = render_scene.nodes[render_scene.default_root_node];
+				uint32_t nodeIdx = 0;
+				loadNode(nullptr, root, /* inout */nodeIdx, render_scene, loaderInfo, loadScale);
+			}
 			//for (size_t i = 0; i < render_scene.nodes.size(); i++) {
 			//	const tinyusdz::Node node = gltfModel.nodes[scene.nodes[i]];
 			//	loadNode(nullptr, node, scene.nodes[i], gltfModel, loaderInfo, scale);
 			//}
 
-#if 0 // TODO
-			if (gltfModel.animations.size() > 0) {
-				loadAnimations(gltfModel);
-			}
-			loadSkins(gltfModel);
-#endif
+			loadSkins(render_scene);
+			loadAnimations(render_scene);
 
+			// Assign skins
 			for (auto node : linearNodes) {
-				// Assign skins
 				if (node->skinIndex > -1) {
 					node->skin = skins[node->skinIndex];
 				}
-				// Initial pose
-				if (node->mesh) {
-					node->update();
-				}
 			}
-		}
-		else {
-			// TODO: throw
-			std::cerr << "Could not load USDZ file: " << error << std::endl;
-			return;
+			// Initial pose
+			buildTransforms();
+			allocateJointRanges();
+			updateTransforms(true);
 		}
 
 		//extensions = gltfModel.extensionsUsed;
@@ -1418,7 +1668,13 @@ namespace detail
 		size_t vertexBufferSize = vertexCount * sizeof(Vertex);
 		size_t indexBufferSize = indexCount * sizeof(uint32_t);
 
-		assert(vertexBufferSize > 0);
+		// None of the selected prims has geometry, everything else is deferred
+		if (vertexBufferSize == 0) {
+			delete[] loaderInfo.vertexBuffer;
+			delete[] loaderInfo.indexBuffer;
+			getSceneDimensions();
+			return;
+		}
 
 		struct StagingBuffer {
 			VkBuffer buffer;
@@ -1505,6 +1761,9 @@ namespace detail
 
 	void Model::draw(VkCommandBuffer commandBuffer)
 	{
+		if (vertices.buffer == VK_NULL_HANDLE) {
+			return;
+		}
 		const VkDeviceSize offsets[1] = { 0 };
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
 		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
@@ -1559,6 +1818,31 @@ namespace detail
 		aabb[3][2] = dimensions.min[2];
 	}
 
+	// Picks up residency changes of the texture streamer
+	// Returns true if any texture's image view changed, descriptors referencing the textures then need to be updated
+	bool Model::updateTextureStreaming()
+	{
+		bool changed = false;
+		for (auto& texture : textures) {
+			if ((texture.streamSlot >= 0) && (texture.imageOwner < 0) && texture.updateStreamedResidency()) {
+				changed = true;
+			}
+		}
+		if (!changed) {
+			return false;
+		}
+		// Textures sharing a streamed image pick up the new view of its owner
+		for (auto& texture : textures) {
+			if (texture.imageOwner >= 0) {
+				const Texture& owner = textures[texture.imageOwner];
+				texture.image = owner.image;
+				texture.view = owner.view;
+				texture.updateDescriptor();
+			}
+		}
+		return true;
+	}
+
 	void Model::updateAnimation(uint32_t index, float time)
 	{
 		if (animations.empty()) {
@@ -1574,48 +1858,141 @@ namespace detail
 		bool updated = false;
 		for (auto& channel : animation.channels) {
 			vkUSDZ::AnimationSampler &sampler = animation.samplers[channel.samplerIndex];
-			if (sampler.inputs.size() > sampler.outputsVec4.size()) {
+			size_t key;
+			if ((sampler.stride == 0) || (sampler.inputs.size() * sampler.stride > sampler.outputs.size()) || !sampler.findKey(time, key)) {
 				continue;
 			}
+			const float u = (sampler.interpolation == AnimationSampler::InterpolationType::STEP) ? 0.0f : std::max(0.0f, time - sampler.inputs[key]) / (sampler.inputs[key + 1] - sampler.inputs[key]);
+			const glm::vec4 v1 = sampler.value(key);
+			const glm::vec4 v2 = sampler.value(key + 1);
+			switch (channel.path) {
+			case vkUSDZ::AnimationChannel::PathType::TRANSLATION:
+				channel.node->translation = glm::vec3(glm::mix(v1, v2, u));
+				break;
+			case vkUSDZ::AnimationChannel::PathType::SCALE:
+				channel.node->scale = glm::vec3(glm::mix(v1, v2, u));
+				break;
+			case vkUSDZ::AnimationChannel::PathType::ROTATION: {
+				glm::quat q1(v1.w, v1.x, v1.y, v1.z);
+				glm::quat q2(v2.w, v2.x, v2.y, v2.z);
+				channel.node->rotation = glm::normalize(glm::slerp(q1, q2, u));
+				break;
+			}
+			}
+			transforms.markDirty(channel.node->transformIndex);
+			updated = true;
+		}
+		if (updated) {
+			updateTransforms();
+		}
+	}
 
-			for (size_t i = 0; i < sampler.inputs.size() - 1; i++) {
-				if ((time >= sampler.inputs[i]) && (time <= sampler.inputs[i + 1])) {
-					float u = std::max(0.0f, time - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
-					if (u <= 1.0f) {
-						switch (channel.path) {
-						case vkUSDZ::AnimationChannel::PathType::TRANSLATION: {
-							glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-							channel.node->translation = glm::vec3(trans);
-							break;
-						}
-						case vkUSDZ::AnimationChannel::PathType::SCALE: {
-							glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-							channel.node->scale = glm::vec3(trans);
-							break;
-						}
-						case vkUSDZ::AnimationChannel::PathType::ROTATION: {
-							glm::quat q1;
-							q1.x = sampler.outputsVec4[i].x;
-							q1.y = sampler.outputsVec4[i].y;
-							q1.z = sampler.outputsVec4[i].z;
-							q1.w = sampler.outputsVec4[i].w;
-							glm::quat q2;
-							q2.x = sampler.outputsVec4[i + 1].x;
-							q2.y = sampler.outputsVec4[i + 1].y;
-							q2.z = sampler.outputsVec4[i + 1].z;
-							q2.w = sampler.outputsVec4[i + 1].w;
-							channel.node->rotation = glm::normalize(glm::slerp(q1, q2, u));
-							break;
-						}
-						}
-						updated = true;
+	// Flattens the node graph into the transform hierarchy, parents are added before their children
+	void Model::buildTransforms()
+	{
+		transforms.clear();
+		transformNodes.resize(0);
+		std::vector<Node*> stack(nodes.rbegin(), nodes.rend());
+		while (!stack.empty()) {
+			Node* node = stack.back();
+			stack.pop_back();
+			node->transforms = &transforms;
+			node->transformIndex = transforms.add(node->parent ? static_cast<int32_t>(node->parent->transformIndex) : -1);
+			transformNodes.push_back(node);
+			stack.insert(stack.end(), node->children.rbegin(), node->children.rend());
+		}
+	}
+
+	// Allocates a joint palette range for each skinned mesh, all joints of a skin are uploaded
+	void Model::allocateJointRanges()
+	{
+		for (auto node : transformNodes) {
+			if (!node->mesh || !node->skin) {
+				continue;
+			}
+			if (!jointPalette) {
+				std::cerr << "Skinned mesh without a joint palette, skinning is disabled" << std::endl;
+				continue;
+			}
+			Mesh* mesh = node->mesh;
+			const uint32_t jointCount = static_cast<uint32_t>(node->skin->joints.size());
+			mesh->jointRange = jointPalette->allocate(jointCount);
+			mesh->uniformBlock.jointOffset = jointPalette->getOffset(mesh->jointRange);
+			mesh->uniformBlock.jointCount = jointCount;
+			mesh->markDirty();
+		}
+	}
+
+	void Model::freeJointRanges()
+	{
+		for (auto node : transformNodes) {
+			if (node->mesh && (node->mesh->jointRange > -1)) {
+				jointPalette->free(node->mesh->jointRange);
+				node->mesh->jointRange = -1;
+			}
+		}
+	}
+
+	// Updates the world matrices of nodes with changed local transforms in one pass and uploads the matrices of meshes whose node or joints moved
+	// force recalculates and uploads everything, e.g. for the initial pose
+	void Model::updateTransforms(bool force)
+	{
+		for (size_t i = 0; i < transformNodes.size(); i++) {
+			if (force || transforms.dirty[i]) {
+				transforms.setLocalMatrix(static_cast<uint32_t>(i), transformNodes[i]->localMatrix());
+			}
+		}
+		if (!transforms.update() && !force) {
+			return;
+		}
+		for (size_t i = 0; i < transformNodes.size(); i++) {
+			Node* node = transformNodes[i];
+			Mesh* mesh = node->mesh;
+			if (!mesh) {
+				continue;
+			}
+			bool changed = force || transforms.changed[i];
+			if (node->skin && !changed) {
+				for (auto joint : node->skin->joints) {
+					if (transforms.changed[joint->transformIndex]) {
+						changed = true;
+						break;
 					}
 				}
 			}
+			if (!changed) {
+				continue;
+			}
+			const glm::mat4& m = transforms.worldMatrices[i];
+			mesh->uniformBlock.matrix = m;
+			mesh->uniformBlock.normalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(m))));
+			if (mesh->jointRange > -1) {
+				// Update joint matrices, ranges of different meshes don't overlap
+				glm::mat4 inverseTransform = glm::inverse(m);
+				glm::mat4* jointMatrices = &jointPalette->matrices[mesh->uniformBlock.jointOffset];
+				for (size_t j = 0; j < node->skin->joints.size(); j++) {
+					glm::mat4 jointMat;
+					vks::TransformHierarchy::multiply(transforms.worldMatrices[node->skin->joints[j]->transformIndex], node->skin->inverseBindMatrices[j], jointMat);
+					vks::TransformHierarchy::multiply(inverseTransform, jointMat, jointMatrices[j]);
+				}
+				if (vks::JointPalette::settings.dualQuaternions) {
+					glm::vec4* dualQuaternions = &jointPalette->dualQuaternions[mesh->uniformBlock.jointOffset * 2];
+					for (size_t j = 0; j < node->skin->joints.size(); j++) {
+						vks::JointPalette::encodeDualQuaternion(jointMatrices[j], &dualQuaternions[j * 2]);
+					}
+				}
+				jointPalette->markDirty(mesh->jointRange);
+			}
+			mesh->markDirty();
 		}
-		if (updated) {
-			for (auto &node : nodes) {
-				node->update();
+	}
+
+	// Copies the uniform blocks of meshes that changed since this frame was last submitted
+	void Model::updateUniformBuffers(uint32_t frameIndex)
+	{
+		for (auto node : linearNodes) {
+			if (node->mesh) {
+				node->mesh->updateUniformBuffer(frameIndex);
 			}
 		}
 	}
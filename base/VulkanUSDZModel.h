@@ -15,9 +15,15 @@
 #include <string>
 #include <fstream>
 #include <vector>
+#include <memory>
+#include <algorithm>
 
 #include "vulkan/vulkan.h"
 #include "VulkanDevice.hpp"
+#include "MipGenerator.h"
+#include "TextureStreamer.h"
+#include "TransformHierarchy.h"
+#include "JointPalette.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -44,9 +50,6 @@
 #include "tinyusdz.hh"
 #include "tydra/render-data.hh"
 
-// Changing this value here also requires changing it in the vertex shader
-#define MAX_NUM_JOINTS 128u
-
 namespace vkUSDZ
 {
 	struct Node;
@@ -69,20 +72,29 @@ namespace vkUSDZ
 	};
 
 	struct Texture {
-		vks::VulkanDevice *device;
+		// Null for textures that haven't been loaded (not used by any mesh with lazy loading)
+		vks::VulkanDevice *device = nullptr;
 		VkImage image;
 		VkImageLayout imageLayout;
 		VkDeviceMemory deviceMemory;
-		VkImageView view;
+		VkImageView view = VK_NULL_HANDLE;
 		uint32_t width, height;
 		uint32_t mipLevels;
 		uint32_t layerCount;
 		VkDescriptorImageInfo descriptor;
 		VkSampler sampler;
+		// Index of the texture in the same model that owns image, memory and view if they are shared (-1 if this texture owns them)
+		int32_t imageOwner = -1;
+		// Image, memory and view of streamed textures are owned by the streamer and change with the feedback of the material shaders
+		vks::TextureStreamer* streamer = nullptr;
+		int32_t streamSlot = -1;
 		void updateDescriptor();
 		void destroy();
+		void createSampler(TextureSampler textureSampler);
+		bool updateStreamedResidency();
 		// Load a texture from Tydra RenderScene image (stored as vector of chars loaded via stb_image/tinyexr/etc) and generate a full mip chaing for it
-	  void fromUSDZImage(tinyusdz::tydra::TextureImage &usdzimage, const std::vector<uint8_t> &imaedata, TextureSampler textureSampler, vks::VulkanDevice *device, VkQueue copyQueue);
+		// srgb selects sRGB correct mip generation when the image is block compressed on the CPU
+	  void fromUSDZImage(tinyusdz::tydra::TextureImage &usdzimage, const std::vector<uint8_t> &imaedata, TextureSampler textureSampler, vks::VulkanDevice *device, VkQueue copyQueue, bool srgb = true, vks::MipGenerator* mipGenerator = nullptr, vks::TextureStreamer* streamer = nullptr);
 	};
 
 	struct Material {		
@@ -98,10 +110,15 @@ namespace vkUSDZ
 		vkUSDZ::Texture *normalTexture;
 		vkUSDZ::Texture *occlusionTexture;
 		vkUSDZ::Texture *emissiveTexture;
+		// USD binds metallic separately from roughness (which uses metallicRoughnessTexture), the channels select the components the shader reads
+		vkUSDZ::Texture *metallicTexture;
+		uint8_t roughnessChannel = 1;
+		uint8_t metallicChannel = 2;
 		bool doubleSided = false;
 		struct TexCoordSets {
 			uint8_t baseColor = 0;
 			uint8_t metallicRoughness = 0;
+			uint8_t metallic = 0;
 			uint8_t specularGlossiness = 0;
 			uint8_t normal = 0;
 			uint8_t occlusion = 0;
@@ -139,21 +156,34 @@ namespace vkUSDZ
 		std::vector<Primitive*> primitives;
 		BoundingBox bb;
 		BoundingBox aabb;
+		// Each frame in flight has its own copy of the uniform block in the buffer, with its own descriptor
 		struct UniformBuffer {
 			VkBuffer buffer;
 			VkDeviceMemory memory;
-			VkDescriptorBufferInfo descriptor;
-			VkDescriptorSet descriptorSet;
+			std::vector<VkDescriptorBufferInfo> descriptors;
+			std::vector<VkDescriptorSet> descriptorSets;
+			VkDeviceSize stride;
 			void *mapped;
+			// One bit per frame whose copy doesn't contain the current uniform block yet
+			uint32_t dirtyFrames;
 		} uniformBuffer;
 		struct UniformBlock {
 			glm::mat4 matrix;
-			glm::mat4 jointMatrix[MAX_NUM_JOINTS]{};
-			float jointcount{ 0 };
+			// Inverse transpose of matrix, so the vertex shader doesn't need to invert it per vertex
+			glm::mat4 normalMatrix;
+			// Range of the joint palette holding the skin's joint matrices
+			uint32_t jointOffset{ 0 };
+			uint32_t jointCount{ 0 };
 		} uniformBlock;
-		Mesh(vks::VulkanDevice* device, glm::mat4 matrix);
+		// Joint palette range allocated for skinned meshes, -1 if not skinned
+		int32_t jointRange = -1;
+		Mesh(vks::VulkanDevice* device, glm::mat4 matrix, uint32_t frameCount = 1);
 		~Mesh();
 		void setBoundingBox(glm::vec3 min, glm::vec3 max);
+		// Mark the uniform block as changed, the mesh's own animation job may call this while other frames are in flight
+		void markDirty() { uniformBuffer.dirtyFrames = (1u << uniformBuffer.descriptors.size()) - 1; }
+		// Copy the uniform block to a frame's part of the buffer if it changed, call after waiting for the frame's fence
+		void updateUniformBuffer(uint32_t frameIndex);
 	};
 
 	struct Skin {
@@ -177,12 +207,13 @@ namespace vkUSDZ
 		glm::quat rotation{};
 		BoundingBox bvh;
 		BoundingBox aabb;
-		bool useCachedMatrix{ false };
-		glm::mat4 cachedLocalMatrix{ glm::mat4(1.0f) };
-		glm::mat4 cachedMatrix{ glm::mat4(1.0f) };
+		// Absolute path of the prim (or skeleton joint) the node was converted from
+		std::string path;
+		// Slot of the node in the model's flattened transform hierarchy, which holds its world matrix
+		vks::TransformHierarchy* transforms = nullptr;
+		uint32_t transformIndex = 0;
 		glm::mat4 localMatrix();
 		glm::mat4 getMatrix();
-		void update();
 		~Node();
 	};
 
@@ -193,11 +224,18 @@ namespace vkUSDZ
 		uint32_t samplerIndex;
 	};
 
+	// Track of one node property, pre-sampled from the stage's time samples at load time
 	struct AnimationSampler {
 		enum InterpolationType { LINEAR, STEP, CUBICSPLINE };
-		InterpolationType interpolation;
+		InterpolationType interpolation = LINEAR;
+		// Key times in seconds and tightly packed output values (stride floats per value)
 		std::vector<float> inputs;
-		std::vector<glm::vec4> outputsVec4;
+		std::vector<float> outputs;
+		uint32_t stride = 0;
+		// Keyframe interval of the last lookup, playback usually continues in the same or the next interval
+		size_t cursor = 0;
+		bool findKey(float time, size_t& index);
+		glm::vec4 value(size_t index) const;
 	};
 
 	struct Animation {
@@ -235,6 +273,11 @@ namespace vkUSDZ
 
 		std::vector<Node*> nodes;
 		std::vector<Node*> linearNodes;
+		// Nodes in the order of their slots in transforms (parents before their children)
+		std::vector<Node*> transformNodes;
+		vks::TransformHierarchy transforms;
+		// Joint matrices of skinned meshes are written to ranges of this palette, required for models with skins
+		vks::JointPalette* jointPalette = nullptr;
 
 		std::vector<Skin*> skins;
 
@@ -256,26 +299,58 @@ namespace vkUSDZ
 			size_t vertexPos = 0;
 		};
 
+		// Optional, mip chains of uploaded textures are generated with compute shaders if set
+		vks::MipGenerator* mipGenerator = nullptr;
+		// Optional, textures are streamed based on shader feedback if set and streaming is enabled
+		vks::TextureStreamer* textureStreamer = nullptr;
+		// If set, only textures of materials bound to meshes in the scene are loaded
+		bool lazyLoading = false;
+		// Number of frames in flight, each one gets its own copy of the mesh uniform blocks
+		uint32_t frameCount = 1;
+		// Absolute prim paths (e.g. "/World/Hall_A") of the subtrees to convert and upload, the whole stage is loaded if empty
+		// Prims outside of these subtrees (except materials) are deferred and can be loaded later on with loadPrims
+		std::vector<std::string> primPaths;
+		// Absolute paths of the deferred prim subtrees
+		std::vector<std::string> deferredPrimPaths;
+
+		// The stage is kept while prims are deferred, deferred subtrees are moved out of it until they are requested
+		struct DeferredPrim {
+			std::string parentPath;
+			tinyusdz::Prim prim;
+		};
+		std::vector<DeferredPrim> deferredPrims;
+		std::shared_ptr<tinyusdz::Stage> stage;
+		std::shared_ptr<tinyusdz::USDZAsset> usdzAsset;
+		std::string filename;
+		float loadScale = 1.0f;
+
 		void destroy(VkDevice device);
+		void destroyScene(VkDevice device);
 		void loadNode(vkUSDZ::Node *parent, const tinyusdz::tydra::Node &node, uint32_t &nodeIndex, const tinyusdz::tydra::RenderScene &scene, LoaderInfo& loaderInfo, float globalscale);
 		void getNodeProps(const tinyusdz::tydra::Node& node, const tinyusdz::tydra::RenderScene& scene, size_t& vertexCount, size_t& indexCount);
-#if 0 // TODO
-		void loadSkins(tinyusdz::tydra::RenderScene& scene);
-#endif
+		void loadSkins(const tinyusdz::tydra::RenderScene& scene);
 		void loadTextures(tinyusdz::tydra::RenderScene& scene, vks::VulkanDevice* device, VkQueue transferQueue);
     VkSamplerAddressMode getVkWrapMode(tinyusdz::tydra::UVTexture::WrapMode wrapMode);
 		VkFilter getVkFilterMode(int32_t filterMode);
 		void loadTextureSamplers(tinyusdz::tydra::RenderScene& scene);
     void loadMaterials(tinyusdz::tydra::RenderScene &scene, vks::VulkanDevice *device, VkQueue transferQueue);
-#if 0 // TODO
-		void loadAnimations(tinyusdz::Model& gltfModel);
-#endif
+		void loadAnimations(const tinyusdz::tydra::RenderScene& scene);
+		void filterStage();
+		bool convertStage(tinyusdz::tydra::RenderScene& renderScene);
+		void loadStage(VkQueue transferQueue);
 		void loadFromFile(std::string filename, vks::VulkanDevice* device, VkQueue transferQueue, float scale = 1.0f);
+		bool loadPrims(const std::vector<std::string>& paths, VkQueue transferQueue);
 		void drawNode(Node* node, VkCommandBuffer commandBuffer);
 		void draw(VkCommandBuffer commandBuffer);
 		void calculateBoundingBox(Node* node, Node* parent);
 		void getSceneDimensions();
 		void updateAnimation(uint32_t index, float time);
+		void buildTransforms();
+		void allocateJointRanges();
+		void freeJointRanges();
+		void updateTransforms(bool force = false);
+		void updateUniformBuffers(uint32_t frameIndex);
+		bool updateTextureStreaming();
 		Node* findNode(Node* parent, uint32_t index);
 		Node* nodeFromIndex(uint32_t index);
 	};
@@ -14,8 +14,18 @@
 #define TINYGLTF_ANDROID_LOAD_FROM_ASSETS
 #endif
 #define STBI_MSC_SECURE_CRT
+// Draco primitives are decoded by the model loader in parallel instead of serially during the parse
+#define TINYGLTF_DEFER_DRACO_DECODE
 
 #include "VulkanglTFModel.h"
+#include "MeshoptDecoder.h"
+#include "ThreadPool.hpp"
+#include "TextureCompressor.h"
+#include "TextureCache.hpp"
+#include "PixelConverter.h"
+
+#include <chrono>
+#include <algorithm>
 
 namespace vkglTF
 {
@@ -29,7 +39,30 @@ namespace vkglTF
 			}
 		}
 
-		return tinygltf::LoadImageData(image, imageIndex, error, warning, req_width, req_height, bytes, size, userData);
+		// Other images are only validated here and kept encoded (as_is), they are decoded when their texture is uploaded
+		// This way only one decoded image is alive at a time and it's converted straight into the staging buffer
+		int width, height, component;
+		if (!stbi_info_from_memory(bytes, size, &width, &height, &component) || (width < 1) || (height < 1)) {
+			if (error) {
+				(*error) += "Unknown image format. STB cannot decode image data for image[" + std::to_string(imageIndex) + "] name = \"" + image->name + "\".\n";
+			}
+			return false;
+		}
+		if (((req_width > 0) && (req_width != width)) || ((req_height > 0) && (req_height != height))) {
+			if (error) {
+				(*error) += "Image size mismatch for image[" + std::to_string(imageIndex) + "] name = \"" + image->name + "\".\n";
+			}
+			return false;
+		}
+		// 16 bit images are reduced to 8 bit when decoded
+		image->width = width;
+		image->height = height;
+		image->component = component;
+		image->bits = 8;
+		image->pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+		image->as_is = true;
+		image->image.assign(bytes, bytes + size);
+		return true;
 	}
 
 	// Bounding box
@@ -67,6 +100,162 @@ namespace vkglTF
 	}
 
 	// Texture
+
+	// Channel layout a texture needs to preserve, derived from the roles it's used with
+	enum class TextureContent { Color, Normal, Occlusion, MetallicRoughness, OcclusionRoughnessMetallic };
+
+	static TextureContent getTextureContent(uint32_t roles)
+	{
+		switch (roles) {
+		case Texture::ROLE_NORMAL:
+			return TextureContent::Normal;
+		case Texture::ROLE_OCCLUSION:
+			return TextureContent::Occlusion;
+		case Texture::ROLE_METALLIC_ROUGHNESS:
+			return TextureContent::MetallicRoughness;
+		case Texture::ROLE_OCCLUSION | Texture::ROLE_METALLIC_ROUGHNESS:
+			return TextureContent::OcclusionRoughnessMetallic;
+		default:
+			// Unknown or mixed usage keeps all channels
+			return TextureContent::Color;
+		}
+	}
+
+	// Decoded 8 bit pixels of a png/jpg image
+	struct ImagePixels {
+		const unsigned char* data = nullptr;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t component = 0;
+	};
+
+	// Block compresses a png/jpg image on the CPU if enabled, picking the format from the channels the texture needs to preserve
+	static bool compressImage(const ImagePixels& pixels, TextureContent content, vks::VulkanDevice* device, vks::TextureCompressor::Image& compressed, VkComponentMapping& components)
+	{
+		using vks::TextureCompressor;
+		if (!TextureCompressor::enabled() || (pixels.data == nullptr)) {
+			return false;
+		}
+		const bool fast = (TextureCompressor::settings.preset == TextureCompressor::Preset::Fast);
+		std::vector<uint32_t> channels = { 0, 1, 2, 3 };
+		TextureCompressor::Format format = TextureCompressor::Format::BC7;
+		bool srgb = false;
+		switch (content) {
+		case TextureContent::Normal:
+			// z is reconstructed in the shader
+			format = TextureCompressor::Format::BC5;
+			break;
+		case TextureContent::Occlusion:
+			format = TextureCompressor::Format::BC4;
+			break;
+		case TextureContent::MetallicRoughness:
+			format = TextureCompressor::Format::BC5;
+			channels = { 1, 2, 0, 3 };
+			break;
+		case TextureContent::OcclusionRoughnessMetallic:
+			format = fast ? TextureCompressor::Format::BC1 : TextureCompressor::Format::BC7;
+			break;
+		default: {
+			srgb = true;
+			bool opaque = true;
+			if ((pixels.component == 2) || (pixels.component == 4)) {
+				const size_t size = static_cast<size_t>(pixels.width) * pixels.height * pixels.component;
+				for (size_t i = pixels.component - 1; i < size && opaque; i += pixels.component) {
+					opaque = (pixels.data[i] == 255);
+				}
+			}
+			format = (fast && opaque) ? TextureCompressor::Format::BC1 : TextureCompressor::Format::BC7;
+			break;
+		}
+		}
+		if (!TextureCompressor::isSupported(device, format)) {
+			return false;
+		}
+		const size_t pixelCount = static_cast<size_t>(pixels.width) * pixels.height;
+		std::vector<unsigned char> rgba(pixelCount * 4);
+		vks::PixelConverter::swizzle(pixels.data, pixels.component, rgba.data(), channels.data(), static_cast<uint32_t>(channels.size()), pixelCount);
+		TextureCompressor::compress(rgba.data(), pixels.width, pixels.height, format, srgb, compressed);
+		if (content == TextureContent::MetallicRoughness) {
+			components = { VK_COMPONENT_SWIZZLE_ONE, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_ONE };
+		}
+		return true;
+	}
+
+	// Background transcoding state of a KTX2 image, kept alive until all mip levels have been uploaded
+	struct Texture::LevelStream {
+		VkDevice device = VK_NULL_HANDLE;
+		std::vector<uint8_t> fileData;
+		basist::ktx2_transcoder transcoder;
+		basist::transcoder_texture_format targetFormat = basist::transcoder_texture_format::cTFRGBA32;
+		// Source channels for single and two channel target formats, -1 selects the transcoder's default
+		int channel0 = -1;
+		int channel1 = -1;
+		std::vector<basist::ktx2_image_level_info> levelInfos;
+		std::vector<VkDeviceSize> levelOffsets;
+		std::vector<uint32_t> levelBlocksOrPixels;
+		VkBuffer stagingBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
+		uint8_t* stagingMapped = nullptr;
+		std::vector<std::future<bool>> levelJobs;
+
+		~LevelStream()
+		{
+			// Jobs write into the mapped staging buffer, so they need to finish first
+			for (auto& job : levelJobs) {
+				if (job.valid()) {
+					job.wait();
+				}
+			}
+			if (stagingMemory) {
+				vkUnmapMemory(device, stagingMemory);
+				vkFreeMemory(device, stagingMemory, nullptr);
+			}
+			if (stagingBuffer) {
+				vkDestroyBuffer(device, stagingBuffer, nullptr);
+			}
+		}
+
+		// Transcodes a single level into its staging buffer slice, may be called from multiple threads for different levels
+		bool transcodeLevel(uint32_t level)
+		{
+			basist::ktx2_transcoder_state state;
+			return transcoder.transcode_image_level(level, 0, 0, stagingMapped + levelOffsets[level], levelBlocksOrPixels[level], targetFormat, 0, 0, 0, channel0, channel1, &state);
+		}
+
+		// Copies the given levels from the staging buffer and makes them available for sampling
+		void recordUpload(VkCommandBuffer commandBuffer, VkImage image, uint32_t firstLevel, uint32_t levelCount)
+		{
+			for (uint32_t i = firstLevel; i < firstLevel + levelCount; i++) {
+				VkBufferImageCopy bufferCopyRegion = {};
+				bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				bufferCopyRegion.imageSubresource.mipLevel = i;
+				bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+				bufferCopyRegion.imageSubresource.layerCount = 1;
+				bufferCopyRegion.imageExtent.width = levelInfos[i].m_orig_width;
+				bufferCopyRegion.imageExtent.height = levelInfos[i].m_orig_height;
+				bufferCopyRegion.imageExtent.depth = 1;
+				bufferCopyRegion.bufferOffset = levelOffsets[i];
+				vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+			}
+
+			VkImageSubresourceRange subresourceRange = {};
+			subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			subresourceRange.baseMipLevel = firstLevel;
+			subresourceRange.levelCount = levelCount;
+			subresourceRange.layerCount = 1;
+
+			VkImageMemoryBarrier imageMemoryBarrier{};
+			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			imageMemoryBarrier.image = image;
+			imageMemoryBarrier.subresourceRange = subresourceRange;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		}
+	};
+
 	void Texture::updateDescriptor()
 	{
 		descriptor.sampler = sampler;
@@ -76,14 +265,23 @@ namespace vkglTF
 
 	void Texture::destroy()
 	{
-		vkDestroyImageView(device->logicalDevice, view, nullptr);
-		vkDestroyImage(device->logicalDevice, image, nullptr);
-		vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
-		vkDestroySampler(device->logicalDevice, sampler, nullptr);
+		if (device == nullptr) {
+			return;
+		}
+		// Waits for pending background transcodes
+		levelStream.reset();
+		if ((imageOwner < 0) && (streamSlot >= 0)) {
+			streamer->remove(streamSlot);
+		} else if (imageOwner < 0) {
+			vkDestroyImageView(device->logicalDevice, view, nullptr);
+			vkDestroyImage(device->logicalDevice, image, nullptr);
+			vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
+		}
+		vks::SamplerCache::shared().release(device->logicalDevice, sampler);
 	}
 
 	// Loads the image for this texture. Supports both glTF's web formats (jpg, png, embedded and external files) as well as external KTX2 files with basis universal texture compression
-	void Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path, TextureSampler textureSampler, vks::VulkanDevice *device, VkQueue copyQueue)
+	void Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path, TextureSampler textureSampler, vks::VulkanDevice *device, VkQueue copyQueue, uint32_t roles, vks::MipGenerator* mipGenerator, vks::TextureStreamer* streamer)
 	{
 		this->device = device;
 
@@ -95,30 +293,65 @@ namespace vkglTF
 			}
 		}
 
-		VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+		format = VK_FORMAT_R8G8B8A8_UNORM;
+		components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+		residentMipLevel = 0;
+		const TextureContent content = getTextureContent(roles);
+		vks::TextureCompressor::Image compressedImage;
+
+		// png and jpg images loaded as is are decoded here, the decoded pixels are only kept until they have been written to the staging buffer
+		ImagePixels pixels;
+		std::unique_ptr<unsigned char, void (*)(void*)> decoded(nullptr, stbi_image_free);
+		std::vector<unsigned char> resized;
+		if (!isKtx2 && !gltfimage.image.empty() && (gltfimage.bits == 8)) {
+			if (gltfimage.as_is) {
+				int decodedWidth, decodedHeight, decodedComponent;
+				decoded.reset(stbi_load_from_memory(gltfimage.image.data(), static_cast<int>(gltfimage.image.size()), &decodedWidth, &decodedHeight, &decodedComponent, 0));
+				if (!decoded) {
+					throw std::runtime_error("Could not decode image " + gltfimage.name + ": " + stbi_failure_reason());
+				}
+				pixels.data = decoded.get();
+				pixels.width = static_cast<uint32_t>(decodedWidth);
+				pixels.height = static_cast<uint32_t>(decodedHeight);
+				pixels.component = static_cast<uint32_t>(decodedComponent);
+			} else {
+				pixels.data = gltfimage.image.data();
+				pixels.width = static_cast<uint32_t>(gltfimage.width);
+				pixels.height = static_cast<uint32_t>(gltfimage.height);
+				pixels.component = static_cast<uint32_t>(gltfimage.component);
+			}
+			// Oversized images are downscaled right after decoding, before they are compressed or get their mips generated
+			if (vks::TextureCompressor::limitSize(pixels.data, pixels.width, pixels.height, pixels.component, content == TextureContent::Color, resized)) {
+				decoded.reset();
+				pixels.data = resized.data();
+			}
+		}
 
 		if (isKtx2) {
 			// Image is KTX2 using basis universal compression. Those images need to be loaded from disk and will be transcoded to a native GPU format
+			// The mip tail is transcoded and uploaded right away, so the texture is usable as soon as this function returns
+			// All larger levels are transcoded on the thread pool (smallest first) and uploaded by updateStreamedLevels once they are done
+			levelStream = std::make_shared<LevelStream>();
+			LevelStream& stream = *levelStream;
+			stream.device = device->logicalDevice;
 
-			basist::ktx2_transcoder ktxTranscoder;
-			const std::string filename = path + "\\" + gltfimage.uri;
+			const std::string filename = path + "/" + gltfimage.uri;
 			std::ifstream ifs(filename, std::ios::binary | std::ios::in | std::ios::ate);
 			if (!ifs.is_open()) {
 				throw std::runtime_error("Could not load the requested image file " + filename);
 			}
-
-			uint32_t inputDataSize = static_cast<uint32_t>(ifs.tellg());
-			char* inputData = new char[inputDataSize];
-
+			// The transcoder references the file data until all levels have been transcoded, so it's owned by the stream
+			stream.fileData.resize(static_cast<size_t>(ifs.tellg()));
 			ifs.seekg(0, std::ios::beg);
-			ifs.read(inputData, inputDataSize);
-			
-			bool success = ktxTranscoder.init(inputData, inputDataSize);
+			ifs.read(reinterpret_cast<char*>(stream.fileData.data()), stream.fileData.size());
+
+			bool success = stream.transcoder.init(stream.fileData.data(), static_cast<uint32_t>(stream.fileData.size()));
 			if (!success) {
 				throw std::runtime_error("Could not initialize ktx2 transcoder for image file " + filename);
 			}
 
-			// Select target format based on device features (use uncompressed if none supported)
+			// Select target format based on the texture's content and device features (use uncompressed if none supported)
+			// Color textures use UNORM formats as the shaders convert from sRGB themselves
 			auto targetFormat = basist::transcoder_texture_format::cTFRGBA32;
 
 			auto formatSupported = [device](VkFormat format) {
@@ -127,101 +360,192 @@ namespace vkglTF
 				return ((formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_TRANSFER_DST_BIT) && (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT));
 			};
 
-			if (device->features.textureCompressionBC) {
-				// BC7 is the preferred block compression if available
-				if (formatSupported(VK_FORMAT_BC7_UNORM_BLOCK)) {
-					targetFormat = basist::transcoder_texture_format::cTFBC7_RGBA;
-					format = VK_FORMAT_BC7_UNORM_BLOCK;
-				} else {
-					if (formatSupported(VK_FORMAT_BC3_SRGB_BLOCK)) {
-						targetFormat = basist::transcoder_texture_format::cTFBC3_RGBA;
-						format = VK_FORMAT_BC3_SRGB_BLOCK;
-					}
+			const bool bcSupported = device->features.textureCompressionBC;
+			const bool etc2Supported = device->features.textureCompressionETC2;
+			const bool hasAlpha = stream.transcoder.get_has_alpha();
+			const bool isUASTC = stream.transcoder.is_uastc();
+
+			// Source channels of X and Y for normal maps, taken from the red and green entries of the KTXswizzle metadata if present (e.g. "ra01" for Y stored in alpha)
+			int normalChannels[2] = { 0, 1 };
+			bool normalYInAlpha = false;
+			const basisu::uint8_vec* swizzle = stream.transcoder.find_key("KTXswizzle");
+			if (swizzle && (swizzle->size() >= 2)) {
+				const std::string components = "rgba";
+				const char xSource = static_cast<char>((*swizzle)[0]);
+				const char ySource = static_cast<char>((*swizzle)[1]);
+				if ((components.find(xSource) != std::string::npos) && (components.find(ySource) != std::string::npos)) {
+					normalChannels[0] = static_cast<int>(components.find(xSource));
+					normalChannels[1] = static_cast<int>(components.find(ySource));
+					normalYInAlpha = hasAlpha && (normalChannels[1] == 3);
 				}
 			}
-			// Adaptive scalable texture compression
-			if (device->features.textureCompressionASTC_LDR) {
-				if (formatSupported(VK_FORMAT_ASTC_4x4_SRGB_BLOCK))
-				{
-					targetFormat = basist::transcoder_texture_format::cTFASTC_4x4_RGBA;
-					format = VK_FORMAT_ASTC_4x4_SRGB_BLOCK;
+			// ETC1S with separate slices for X and Y (RRR + GGG or AAA) always stores Y in the second slice
+			if (!isUASTC && (stream.transcoder.get_dfd_total_samples() == 2) && (stream.transcoder.get_dfd_channel_id0() == basist::KTX2_DF_CHANNEL_ETC1S_RRR) &&
+				((stream.transcoder.get_dfd_channel_id1() == basist::KTX2_DF_CHANNEL_ETC1S_GGG) || (stream.transcoder.get_dfd_channel_id1() == basist::KTX2_DF_CHANNEL_ETC1S_AAA))) {
+				normalYInAlpha = true;
+			}
+
+			switch (content) {
+			case TextureContent::Normal:
+				// Two channel normal maps, z is reconstructed in the shader
+				// ETC1S can only transcode X from the color and Y from the alpha slice, so this requires a file whose metadata stores Y there
+				// UASTC can select any channels, other files are transcoded to RGBA and read with R and G
+				if (isUASTC || normalYInAlpha) {
+					stream.channel0 = isUASTC ? normalChannels[0] : 0;
+					stream.channel1 = isUASTC ? normalChannels[1] : 3;
+					if (bcSupported && formatSupported(VK_FORMAT_BC5_UNORM_BLOCK)) {
+						targetFormat = basist::transcoder_texture_format::cTFBC5_RG;
+						format = VK_FORMAT_BC5_UNORM_BLOCK;
+					} else if (etc2Supported && formatSupported(VK_FORMAT_EAC_R11G11_UNORM_BLOCK)) {
+						targetFormat = basist::transcoder_texture_format::cTFETC2_EAC_RG11;
+						format = VK_FORMAT_EAC_R11G11_UNORM_BLOCK;
+					}
+				}
+				break;
+			case TextureContent::Occlusion:
+				stream.channel0 = 0;
+				if (bcSupported && formatSupported(VK_FORMAT_BC4_UNORM_BLOCK)) {
+					targetFormat = basist::transcoder_texture_format::cTFBC4_R;
+					format = VK_FORMAT_BC4_UNORM_BLOCK;
+				} else if (etc2Supported && formatSupported(VK_FORMAT_EAC_R11_UNORM_BLOCK)) {
+					targetFormat = basist::transcoder_texture_format::cTFETC2_EAC_R11;
+					format = VK_FORMAT_EAC_R11_UNORM_BLOCK;
+				}
+				break;
+			case TextureContent::MetallicRoughness:
+				// Roughness (G) and metallic (B) go into a two channel format, channel selection is only possible with UASTC
+				if (isUASTC) {
+					stream.channel0 = 1;
+					stream.channel1 = 2;
+					if (bcSupported && formatSupported(VK_FORMAT_BC5_UNORM_BLOCK)) {
+						targetFormat = basist::transcoder_texture_format::cTFBC5_RG;
+						format = VK_FORMAT_BC5_UNORM_BLOCK;
+					} else if (etc2Supported && formatSupported(VK_FORMAT_EAC_R11G11_UNORM_BLOCK)) {
+						targetFormat = basist::transcoder_texture_format::cTFETC2_EAC_RG11;
+						format = VK_FORMAT_EAC_R11G11_UNORM_BLOCK;
+					}
+					if (targetFormat != basist::transcoder_texture_format::cTFRGBA32) {
+						components = { VK_COMPONENT_SWIZZLE_ONE, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_ONE };
+					}
 				}
+				break;
+			default:
+				break;
 			}
-			// Ericsson texture compression
-			if (device->features.textureCompressionETC2) {
-				if (formatSupported(VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK))
-				{
-					targetFormat = basist::transcoder_texture_format::cTFETC2_RGBA;
-					format = VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK;
+
+			// Generic RGB(A) formats for color and packed textures, and as the fallback for the specialized formats above
+			if (targetFormat == basist::transcoder_texture_format::cTFRGBA32) {
+				stream.channel0 = -1;
+				stream.channel1 = -1;
+				const bool needsAlpha = (content == TextureContent::Color);
+				if (bcSupported) {
+					// BC7 is the preferred block compression if available
+					if (formatSupported(VK_FORMAT_BC7_UNORM_BLOCK)) {
+						targetFormat = basist::transcoder_texture_format::cTFBC7_RGBA;
+						format = VK_FORMAT_BC7_UNORM_BLOCK;
+					} else if (!needsAlpha && formatSupported(VK_FORMAT_BC1_RGB_UNORM_BLOCK)) {
+						targetFormat = basist::transcoder_texture_format::cTFBC1_RGB;
+						format = VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+					} else if (formatSupported(VK_FORMAT_BC3_UNORM_BLOCK)) {
+						targetFormat = basist::transcoder_texture_format::cTFBC3_RGBA;
+						format = VK_FORMAT_BC3_UNORM_BLOCK;
+					}
+				}
+				// Adaptive scalable texture compression
+				if ((targetFormat == basist::transcoder_texture_format::cTFRGBA32) && device->features.textureCompressionASTC_LDR) {
+					if (formatSupported(VK_FORMAT_ASTC_4x4_UNORM_BLOCK)) {
+						targetFormat = basist::transcoder_texture_format::cTFASTC_4x4_RGBA;
+						format = VK_FORMAT_ASTC_4x4_UNORM_BLOCK;
+					}
+				}
+				// Ericsson texture compression
+				if ((targetFormat == basist::transcoder_texture_format::cTFRGBA32) && etc2Supported) {
+					if (!needsAlpha && formatSupported(VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK)) {
+						targetFormat = basist::transcoder_texture_format::cTFETC1_RGB;
+						format = VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK;
+					} else if (formatSupported(VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK)) {
+						targetFormat = basist::transcoder_texture_format::cTFETC2_RGBA;
+						format = VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK;
+					}
 				}
 			}
 
 			// @todo PowerVR texture compression support needs to be checked via an extension (VK_IMG_FORMAT_PVRTC_EXTENSION_NAME)
 
+			stream.targetFormat = targetFormat;
 			const bool targetFormatIsUncompressed = basist::basis_transcoder_format_is_uncompressed(targetFormat);
 
-			std::vector<basist::ktx2_image_level_info> levelInfos(ktxTranscoder.get_levels());
-			mipLevels = ktxTranscoder.get_levels();
+			mipLevels = stream.transcoder.get_levels();
+			stream.levelInfos.resize(mipLevels);
 
 			// Query image level information that we need later on for several calculations
 			// We only support 2D images (no cube maps or layered images)
 			for (uint32_t i = 0; i < mipLevels; i++) {
-				ktxTranscoder.get_image_level_info(levelInfos[i], i, 0, 0);
+				stream.transcoder.get_image_level_info(stream.levelInfos[i], i, 0, 0);
 			}
 
-			width = levelInfos[0].m_orig_width;
-			height = levelInfos[0].m_orig_height;
+			width = stream.levelInfos[0].m_orig_width;
+			height = stream.levelInfos[0].m_orig_height;
 
 			VkMemoryAllocateInfo memAllocInfo{};
 			memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 			VkMemoryRequirements memReqs{};
 
-			// Create one staging buffer large enough to hold all uncompressed image levels
+			// Create one staging buffer large enough to hold all image levels, each level is transcoded into its own slice
 			const uint32_t bytesPerBlockOrPixel = basist::basis_get_bytes_per_block_or_pixel(targetFormat);
-			uint32_t numBlocksOrPixels = 0;
 			VkDeviceSize totalBufferSize = 0;
+			stream.levelOffsets.resize(mipLevels);
+			stream.levelBlocksOrPixels.resize(mipLevels);
 			for (uint32_t i = 0; i < mipLevels; i++) {
 				// Size calculations differ for compressed/uncompressed formats
-				numBlocksOrPixels = targetFormatIsUncompressed ? levelInfos[i].m_orig_width * levelInfos[i].m_orig_height : levelInfos[i].m_total_blocks;
-				totalBufferSize += numBlocksOrPixels * bytesPerBlockOrPixel;
+				stream.levelBlocksOrPixels[i] = targetFormatIsUncompressed ? stream.levelInfos[i].m_orig_width * stream.levelInfos[i].m_orig_height : stream.levelInfos[i].m_total_blocks;
+				stream.levelOffsets[i] = totalBufferSize;
+				totalBufferSize += stream.levelBlocksOrPixels[i] * bytesPerBlockOrPixel;
 			}
 
-			VkBuffer stagingBuffer;
-			VkDeviceMemory stagingMemory;
 			VkBufferCreateInfo bufferCreateInfo{};
 			bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 			bufferCreateInfo.size = totalBufferSize;
 			bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
 			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-			vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
+			VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stream.stagingBuffer));
+			vkGetBufferMemoryRequirements(device->logicalDevice, stream.stagingBuffer, &memReqs);
 			memAllocInfo.allocationSize = memReqs.size;
 			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-			VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-			uint8_t* stagingBufferMapped;
-			VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&stagingBufferMapped));
-
-			unsigned char* buffer = new unsigned char[totalBufferSize];
-			unsigned char* bufferPtr = &buffer[0];
+			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stream.stagingMemory));
+			VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stream.stagingBuffer, stream.stagingMemory, 0));
+			VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stream.stagingMemory, 0, memReqs.size, 0, (void**)&stream.stagingMapped));
 
-			success = ktxTranscoder.start_transcoding();
+			success = stream.transcoder.start_transcoding();
 			if (!success) {
 				throw std::runtime_error("Could not start transcoding for image file " + filename);
 			}
 
-			// Transcode all mip levels into the staging buffer
-			for (uint32_t i = 0; i < mipLevels; i++) {
-				// Size calculations differ for compressed/uncompressed formats
-				numBlocksOrPixels = targetFormatIsUncompressed ? levelInfos[i].m_orig_width * levelInfos[i].m_orig_height : levelInfos[i].m_total_blocks;
-				uint32_t outputSize = numBlocksOrPixels * bytesPerBlockOrPixel;
-				if (!ktxTranscoder.transcode_image_level(i, 0, 0, bufferPtr, numBlocksOrPixels, targetFormat, 0)) {
+			// Levels up to this size form the mip tail that's transcoded right away
+			const uint32_t mipTailSize = 128;
+			residentMipLevel = mipLevels - 1;
+			while ((residentMipLevel > 0) && (std::max(stream.levelInfos[residentMipLevel - 1].m_orig_width, stream.levelInfos[residentMipLevel - 1].m_orig_height) <= mipTailSize)) {
+				residentMipLevel--;
+			}
+
+			const uint32_t tailLevelCount = mipLevels - residentMipLevel;
+			std::vector<uint8_t> tailResults(tailLevelCount, 0);
+			vks::ThreadPool::shared().parallelFor(tailLevelCount, [&](size_t i) {
+				tailResults[i] = stream.transcodeLevel(residentMipLevel + static_cast<uint32_t>(i)) ? 1 : 0;
+			});
+			for (auto result : tailResults) {
+				if (!result) {
 					throw std::runtime_error("Could not transcode the requested image file " + filename);
 				}
-				bufferPtr += outputSize;
 			}
 
-			memcpy(stagingBufferMapped, buffer, totalBufferSize);
+			// Queue the remaining levels smallest first as background jobs, so they don't delay the loading of later textures
+			stream.levelJobs.resize(mipLevels);
+			LevelStream* streamPtr = levelStream.get();
+			for (uint32_t i = residentMipLevel; i > 0; i--) {
+				const uint32_t level = i - 1;
+				stream.levelJobs[level] = vks::ThreadPool::shared().asyncBackground([streamPtr, level]() { return streamPtr->transcodeLevel(level); });
+			}
 
 			VkImageCreateInfo imageCreateInfo{};
 			imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -241,10 +565,12 @@ namespace vkglTF
 			memAllocInfo.allocationSize = memReqs.size;
 			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
+			memorySize = memReqs.size;
 			VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
 
 			VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 
+			// All levels are prepared for transfers, only the mip tail is filled now
 			VkImageSubresourceRange subresourceRange = {};
 			subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 			subresourceRange.levelCount = mipLevels;
@@ -260,243 +586,306 @@ namespace vkglTF
 			imageMemoryBarrier.subresourceRange = subresourceRange;
 			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 
-			// Transcode and copy all image levels
-			VkDeviceSize bufferOffset = 0;
-			for (uint32_t i = 0; i < mipLevels; i++) {
-				// Size calculations differ for compressed/uncompressed formats
-				numBlocksOrPixels = targetFormatIsUncompressed ? levelInfos[i].m_orig_width * levelInfos[i].m_orig_height : levelInfos[i].m_total_blocks;
-				uint32_t outputSize = numBlocksOrPixels * bytesPerBlockOrPixel;
-
-				VkBufferImageCopy bufferCopyRegion = {};
-				bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				bufferCopyRegion.imageSubresource.mipLevel = i;
-				bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-				bufferCopyRegion.imageSubresource.layerCount = 1;
-				bufferCopyRegion.imageExtent.width = levelInfos[i].m_orig_width;
-				bufferCopyRegion.imageExtent.height = levelInfos[i].m_orig_height;
-				bufferCopyRegion.imageExtent.depth = 1;
-				bufferCopyRegion.bufferOffset = bufferOffset;
-
-				vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
-
-				bufferOffset += outputSize;
-			}
-
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-			imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-			imageMemoryBarrier.image = image;
-			imageMemoryBarrier.subresourceRange = subresourceRange;
-			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+			stream.recordUpload(copyCmd, image, residentMipLevel, tailLevelCount);
 
 			device->flushCommandBuffer(copyCmd, copyQueue, true);
 
-			vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-			vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+			imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-			delete[] buffer;
-			delete[] inputData;
+			// Small images may consist of the mip tail only
+			if (residentMipLevel == 0) {
+				levelStream.reset();
+			}
+		} else if (compressImage(pixels, content, device, compressedImage, components)) {
+			// Image is a png or jpg that has been block compressed on the CPU (or loaded from the texture cache), all mip levels are already included
+			format = compressedImage.format;
+			width = compressedImage.width;
+			height = compressedImage.height;
+			mipLevels = static_cast<uint32_t>(compressedImage.levels.size());
+			if (streamer) {
+				streamSlot = streamer->add(compressedImage, components);
+			}
+			if (streamSlot < 0) {
+				memorySize = vks::TextureCompressor::upload(compressedImage, device, copyQueue, image, deviceMemory);
+			}
+			imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 		} else {
-			// Image is a basic glTF format like png or jpg and can be loaded directly via tinyglTF
-			unsigned char* buffer = nullptr;
-			VkDeviceSize bufferSize = 0;
-			bool deleteBuffer = false;
-
-			if (gltfimage.component == 3) {
-				// Most devices don't support RGB only on Vulkan so convert if necessary
-				bufferSize = gltfimage.width * gltfimage.height * 4;
-				buffer = new unsigned char[bufferSize];
-				unsigned char* rgba = buffer;
-				unsigned char* rgb = &gltfimage.image[0];
-				for (int32_t i = 0; i < gltfimage.width * gltfimage.height; ++i) {
-					for (int32_t j = 0; j < 3; ++j) {
-						rgba[j] = rgb[j];
-					}
-					rgba += 4;
-					rgb += 3;
+			// Image is a basic glTF format like png or jpg that has been decoded above
+			// Textures that only need one or two channels (occlusion, normal and metallic/roughness maps) are uploaded in R8/R8G8 formats
+			std::vector<uint32_t> channels = { 0, 1, 2, 3 };
+			auto blitSupported = [device](VkFormat format) {
+				VkFormatProperties formatProperties;
+				vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+				return ((formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT) && (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT));
+			};
+			auto mipsSupported = [mipGenerator, blitSupported](VkFormat format) {
+				return ((mipGenerator != nullptr) && mipGenerator->isSupported(format)) || blitSupported(format);
+			};
+			switch (content) {
+			case TextureContent::Occlusion:
+				if (mipsSupported(VK_FORMAT_R8_UNORM)) {
+					format = VK_FORMAT_R8_UNORM;
+					channels = { 0 };
+				}
+				break;
+			case TextureContent::Normal:
+				// z is reconstructed in the shader
+				if (mipsSupported(VK_FORMAT_R8G8_UNORM)) {
+					format = VK_FORMAT_R8G8_UNORM;
+					channels = { 0, 1 };
+				}
+				break;
+			case TextureContent::MetallicRoughness:
+				if (mipsSupported(VK_FORMAT_R8G8_UNORM)) {
+					format = VK_FORMAT_R8G8_UNORM;
+					channels = { 1, 2 };
+					components = { VK_COMPONENT_SWIZZLE_ONE, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_ONE };
 				}
-				deleteBuffer = true;
+				break;
+			default:
+				break;
 			}
-			else {
-				buffer = &gltfimage.image[0];
-				bufferSize = gltfimage.image.size();
+
+			if (pixels.data == nullptr) {
+				throw std::runtime_error("Unsupported image format for image " + gltfimage.name);
 			}
 
-			width = gltfimage.width;
-			height = gltfimage.height;
+			// Most devices don't support RGB only on Vulkan so the pixels are converted while they are written, this also drops unused channels
+			const uint32_t channelCount = static_cast<uint32_t>(channels.size());
+			const size_t pixelCount = static_cast<size_t>(pixels.width) * pixels.height;
+			const VkDeviceSize bufferSize = pixelCount * channelCount;
+
+			width = pixels.width;
+			height = pixels.height;
 			mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
 
-			VkFormatProperties formatProperties;
-			vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
-			assert(formatProperties.optimalTilingFeatures& VK_FORMAT_FEATURE_BLIT_SRC_BIT);
-			assert(formatProperties.optimalTilingFeatures& VK_FORMAT_FEATURE_BLIT_DST_BIT);
+			// Mips are generated with a compute shader if available and blits otherwise, formats that support neither get their mip chain built on the CPU
+			// Color textures are sRGB encoded, their mips are filtered in linear space
+			// Streamed textures need their full mip chain in system memory, so it's always built on the CPU for them
+			const bool srgb = (content == TextureContent::Color);
+			const bool computeMips = (mipGenerator != nullptr) && mipGenerator->isSupported(format);
+			const bool stream = (streamer != nullptr) && vks::TextureStreamer::enabled();
+			if (stream || (!computeMips && !blitSupported(format))) {
+				vks::TextureCompressor::Image levels;
+				levels.format = format;
+				std::vector<unsigned char> buffer(bufferSize);
+				vks::PixelConverter::swizzle(pixels.data, pixels.component, buffer.data(), channels.data(), channelCount, pixelCount);
+				vks::TextureCompressor::generateMipChain(buffer.data(), width, height, channelCount, srgb, levels);
+				if (stream) {
+					streamSlot = streamer->add(levels, components);
+				}
+				if (streamSlot < 0) {
+					memorySize = vks::TextureCompressor::upload(levels, device, copyQueue, image, deviceMemory);
+				}
+				imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			} else {
+				VkMemoryAllocateInfo memAllocInfo{};
+				memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+				VkMemoryRequirements memReqs{};
+
+				VkBuffer stagingBuffer;
+				VkDeviceMemory stagingMemory;
+
+				VkBufferCreateInfo bufferCreateInfo{};
+				bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+				bufferCreateInfo.size = bufferSize;
+				bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+				bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+				VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
+				vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
+				memAllocInfo.allocationSize = memReqs.size;
+				memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+				VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
+				VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
+
+				uint8_t* data;
+				VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
+				vks::PixelConverter::swizzle(pixels.data, pixels.component, data, channels.data(), channelCount, pixelCount);
+				vkUnmapMemory(device->logicalDevice, stagingMemory);
+				// The decoded image isn't needed anymore, free it before the GPU work is set up
+				decoded.reset();
+				std::vector<unsigned char>().swap(resized);
+
+				VkImageCreateInfo imageCreateInfo{};
+				imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+				imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+				imageCreateInfo.format = format;
+				imageCreateInfo.mipLevels = mipLevels;
+				imageCreateInfo.arrayLayers = 1;
+				imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+				imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+				imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+				imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+				imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				imageCreateInfo.extent = { width, height, 1 };
+				imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+				if (computeMips) {
+					imageCreateInfo.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+				}
+				VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
+				vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
+				memAllocInfo.allocationSize = memReqs.size;
+				memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+				VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
+				memorySize = memReqs.size;
+				VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+
+				// With compute mip generation the upload is recorded into the generator's batch, which is submitted once all textures have been loaded
+				VkCommandBuffer copyCmd = computeMips ? mipGenerator->commandBuffer() : device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+				VkImageSubresourceRange subresourceRange = {};
+				subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				subresourceRange.levelCount = 1;
+				subresourceRange.layerCount = 1;
 
-			VkMemoryAllocateInfo memAllocInfo{};
-			memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-			VkMemoryRequirements memReqs{};
+				{
+					VkImageMemoryBarrier imageMemoryBarrier{};
+					imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+					imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+					imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+					imageMemoryBarrier.srcAccessMask = 0;
+					imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+					imageMemoryBarrier.image = image;
+					imageMemoryBarrier.subresourceRange = subresourceRange;
+					vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+				}
 
-			VkBuffer stagingBuffer;
-			VkDeviceMemory stagingMemory;
+				VkBufferImageCopy bufferCopyRegion = {};
+				bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				bufferCopyRegion.imageSubresource.mipLevel = 0;
+				bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+				bufferCopyRegion.imageSubresource.layerCount = 1;
+				bufferCopyRegion.imageExtent.width = width;
+				bufferCopyRegion.imageExtent.height = height;
+				bufferCopyRegion.imageExtent.depth = 1;
 
-			VkBufferCreateInfo bufferCreateInfo{};
-			bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-			bufferCreateInfo.size = bufferSize;
-			bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-			vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-			memAllocInfo.allocationSize = memReqs.size;
-			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-			VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
+				vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
 
-			uint8_t* data;
-			VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-			memcpy(data, buffer, bufferSize);
-			vkUnmapMemory(device->logicalDevice, stagingMemory);
+				if (computeMips) {
+					mipGenerator->generate(image, format, width, height, mipLevels, srgb);
+					mipGenerator->releaseAfterFlush(stagingBuffer, stagingMemory, bufferSize);
+					imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+				} else {
 
-			if (deleteBuffer) {
-				delete[] buffer;
-			}
+					{
+						VkImageMemoryBarrier imageMemoryBarrier{};
+						imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+						imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+						imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+						imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+						imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+						imageMemoryBarrier.image = image;
+						imageMemoryBarrier.subresourceRange = subresourceRange;
+						vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+					}
 
-			VkImageCreateInfo imageCreateInfo{};
-			imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-			imageCreateInfo.format = format;
-			imageCreateInfo.mipLevels = mipLevels;
-			imageCreateInfo.arrayLayers = 1;
-			imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-			imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-			imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
-			imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			imageCreateInfo.extent = { width, height, 1 };
-			imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-			VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
-			vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-			memAllocInfo.allocationSize = memReqs.size;
-			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-			VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+					device->flushCommandBuffer(copyCmd, copyQueue, true);
 
-			VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+					vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
+					vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
 
-			VkImageSubresourceRange subresourceRange = {};
-			subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			subresourceRange.levelCount = 1;
-			subresourceRange.layerCount = 1;
+					// Generate the mip chain (glTF uses jpg and png, so we need to create this manually)
+					VkCommandBuffer blitCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+					for (uint32_t i = 1; i < mipLevels; i++) {
+						VkImageBlit imageBlit{};
 
-			{
-				VkImageMemoryBarrier imageMemoryBarrier{};
-				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-				imageMemoryBarrier.srcAccessMask = 0;
-				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				imageMemoryBarrier.image = image;
-				imageMemoryBarrier.subresourceRange = subresourceRange;
-				vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-			}
-
-			VkBufferImageCopy bufferCopyRegion = {};
-			bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			bufferCopyRegion.imageSubresource.mipLevel = 0;
-			bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-			bufferCopyRegion.imageSubresource.layerCount = 1;
-			bufferCopyRegion.imageExtent.width = width;
-			bufferCopyRegion.imageExtent.height = height;
-			bufferCopyRegion.imageExtent.depth = 1;
-
-			vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
-
-			{
-				VkImageMemoryBarrier imageMemoryBarrier{};
-				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-				imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-				imageMemoryBarrier.image = image;
-				imageMemoryBarrier.subresourceRange = subresourceRange;
-				vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-			}
+						imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+						imageBlit.srcSubresource.layerCount = 1;
+						imageBlit.srcSubresource.mipLevel = i - 1;
+						imageBlit.srcOffsets[1].x = int32_t(width >> (i - 1));
+						imageBlit.srcOffsets[1].y = int32_t(height >> (i - 1));
+						imageBlit.srcOffsets[1].z = 1;
 
-			device->flushCommandBuffer(copyCmd, copyQueue, true);
+						imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+						imageBlit.dstSubresource.layerCount = 1;
+						imageBlit.dstSubresource.mipLevel = i;
+						imageBlit.dstOffsets[1].x = int32_t(width >> i);
+						imageBlit.dstOffsets[1].y = int32_t(height >> i);
+						imageBlit.dstOffsets[1].z = 1;
 
-			vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-			vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-
-			// Generate the mip chain (glTF uses jpg and png, so we need to create this manually)
-			VkCommandBuffer blitCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-			for (uint32_t i = 1; i < mipLevels; i++) {
-				VkImageBlit imageBlit{};
-
-				imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				imageBlit.srcSubresource.layerCount = 1;
-				imageBlit.srcSubresource.mipLevel = i - 1;
-				imageBlit.srcOffsets[1].x = int32_t(width >> (i - 1));
-				imageBlit.srcOffsets[1].y = int32_t(height >> (i - 1));
-				imageBlit.srcOffsets[1].z = 1;
-
-				imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				imageBlit.dstSubresource.layerCount = 1;
-				imageBlit.dstSubresource.mipLevel = i;
-				imageBlit.dstOffsets[1].x = int32_t(width >> i);
-				imageBlit.dstOffsets[1].y = int32_t(height >> i);
-				imageBlit.dstOffsets[1].z = 1;
-
-				VkImageSubresourceRange mipSubRange = {};
-				mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				mipSubRange.baseMipLevel = i;
-				mipSubRange.levelCount = 1;
-				mipSubRange.layerCount = 1;
+						VkImageSubresourceRange mipSubRange = {};
+						mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+						mipSubRange.baseMipLevel = i;
+						mipSubRange.levelCount = 1;
+						mipSubRange.layerCount = 1;
 
-				{
-					VkImageMemoryBarrier imageMemoryBarrier{};
-					imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-					imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-					imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-					imageMemoryBarrier.srcAccessMask = 0;
-					imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-					imageMemoryBarrier.image = image;
-					imageMemoryBarrier.subresourceRange = mipSubRange;
-					vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-				}
+						{
+							VkImageMemoryBarrier imageMemoryBarrier{};
+							imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+							imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+							imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+							imageMemoryBarrier.srcAccessMask = 0;
+							imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+							imageMemoryBarrier.image = image;
+							imageMemoryBarrier.subresourceRange = mipSubRange;
+							vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+						}
 
-				vkCmdBlitImage(blitCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+						vkCmdBlitImage(blitCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
 
-				{
-					VkImageMemoryBarrier imageMemoryBarrier{};
-					imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-					imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-					imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-					imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-					imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-					imageMemoryBarrier.image = image;
-					imageMemoryBarrier.subresourceRange = mipSubRange;
-					vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-				}
-			}
+						{
+							VkImageMemoryBarrier imageMemoryBarrier{};
+							imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+							imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+							imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+							imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+							imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+							imageMemoryBarrier.image = image;
+							imageMemoryBarrier.subresourceRange = mipSubRange;
+							vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+						}
+					}
 
-			subresourceRange.levelCount = mipLevels;
-			imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+					subresourceRange.levelCount = mipLevels;
+					imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+					{
+						VkImageMemoryBarrier imageMemoryBarrier{};
+						imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+						imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+						imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+						imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+						imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+						imageMemoryBarrier.image = image;
+						imageMemoryBarrier.subresourceRange = subresourceRange;
+						vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+					}
 
-			{
-				VkImageMemoryBarrier imageMemoryBarrier{};
-				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-				imageMemoryBarrier.image = image;
-				imageMemoryBarrier.subresourceRange = subresourceRange;
-				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+					device->flushCommandBuffer(blitCmd, copyQueue, true);
+				}
 			}
+		}
 
-			device->flushCommandBuffer(blitCmd, copyQueue, true);
+		createSampler(textureSampler);
+		if (streamSlot >= 0) {
+			this->streamer = streamer;
+			updateStreamedResidency();
+		} else {
+			createView();
+			updateDescriptor();
 		}
+	}
 
+	// Takes over the image currently made resident by the texture streamer
+	// Returns true if it changed since the last call
+	bool Texture::updateStreamedResidency()
+	{
+		const vks::TextureStreamer::Resident& resident = streamer->getResident(streamSlot);
+		if (view == resident.view) {
+			return false;
+		}
+		image = resident.image;
+		view = resident.view;
+		deviceMemory = resident.memory;
+		residentMipLevel = resident.firstLevel;
+		memorySize = resident.memorySize;
+		updateDescriptor();
+		return true;
+	}
+
+	// Samplers come from the shared cache, so textures with the same sampler state use the same object
+	void Texture::createSampler(TextureSampler textureSampler)
+	{
 		VkSamplerCreateInfo samplerInfo{};
 		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
 		samplerInfo.magFilter = textureSampler.magFilter;
@@ -507,27 +896,67 @@ namespace vkglTF
 		samplerInfo.addressModeW = textureSampler.addressModeW;
 		samplerInfo.compareOp = VK_COMPARE_OP_NEVER;
 		samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		samplerInfo.maxAnisotropy = 1.0;
-		samplerInfo.anisotropyEnable = VK_FALSE;
-		samplerInfo.maxLod = (float)mipLevels;
+		// The image view limits the mip range, so the sampler doesn't depend on the texture's level count
+		samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 		samplerInfo.maxAnisotropy = 8.0f;
 		samplerInfo.anisotropyEnable = VK_TRUE;
-		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerInfo, nullptr, &sampler));
+		sampler = vks::SamplerCache::shared().acquire(device->logicalDevice, samplerInfo);
+	}
 
+	// Creates the image view for all mip levels that are resident on the GPU
+	void Texture::createView()
+	{
 		VkImageViewCreateInfo viewInfo{};
 		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 		viewInfo.image = image;
 		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
 		viewInfo.format = format;
-		viewInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+		viewInfo.components = components;
 		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		viewInfo.subresourceRange.layerCount = 1;
-		viewInfo.subresourceRange.levelCount = mipLevels;
+		viewInfo.subresourceRange.baseMipLevel = residentMipLevel;
+		viewInfo.subresourceRange.levelCount = mipLevels - residentMipLevel;
 		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewInfo, nullptr, &view));
+	}
 
-		descriptor.sampler = sampler;
-		descriptor.imageView = view;
-		descriptor.imageLayout = imageLayout;
+	bool Texture::streamedLevelsReady()
+	{
+		if (!levelStream || (residentMipLevel == 0)) {
+			return false;
+		}
+		return levelStream->levelJobs[residentMipLevel - 1].wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+
+	// Uploads all consecutive mip levels that finished transcoding and recreates the view to include them
+	// The caller must make sure the current view is no longer in use by the GPU
+	bool Texture::updateStreamedLevels(VkQueue copyQueue)
+	{
+		if (!streamedLevelsReady()) {
+			return false;
+		}
+
+		uint32_t firstLevel = residentMipLevel;
+		while ((firstLevel > 0) && (levelStream->levelJobs[firstLevel - 1].wait_for(std::chrono::seconds(0)) == std::future_status::ready)) {
+			if (!levelStream->levelJobs[firstLevel - 1].get()) {
+				throw std::runtime_error("Could not transcode mip level " + std::to_string(firstLevel - 1) + " of a ktx2 image");
+			}
+			firstLevel--;
+		}
+
+		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		levelStream->recordUpload(copyCmd, image, firstLevel, residentMipLevel - firstLevel);
+		device->flushCommandBuffer(copyCmd, copyQueue, true);
+
+		residentMipLevel = firstLevel;
+		vkDestroyImageView(device->logicalDevice, view, nullptr);
+		createView();
+		updateDescriptor();
+
+		// All levels are resident, staging memory and transcoder are no longer required
+		if (residentMipLevel == 0) {
+			levelStream.reset();
+		}
+		return true;
 	}
 
 	// Primitive
@@ -542,18 +971,25 @@ namespace vkglTF
 	}
 
 	// Mesh
-	Mesh::Mesh(vks::VulkanDevice *device, glm::mat4 matrix) {
+	Mesh::Mesh(vks::VulkanDevice *device, glm::mat4 matrix, uint32_t frameCount) {
+		assert(frameCount < 32);
 		this->device = device;
 		this->uniformBlock.matrix = matrix;
+		const VkDeviceSize alignment = std::max<VkDeviceSize>(device->properties.limits.minUniformBufferOffsetAlignment, 1);
+		uniformBuffer.stride = (sizeof(uniformBlock) + alignment - 1) / alignment * alignment;
 		VK_CHECK_RESULT(device->createBuffer(
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			sizeof(uniformBlock),
+			uniformBuffer.stride * frameCount,
 			&uniformBuffer.buffer,
-			&uniformBuffer.memory,
-			&uniformBlock));
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, uniformBuffer.memory, 0, sizeof(uniformBlock), 0, &uniformBuffer.mapped));
-		uniformBuffer.descriptor = { uniformBuffer.buffer, 0, sizeof(uniformBlock) };
+			&uniformBuffer.memory));
+		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, uniformBuffer.memory, 0, VK_WHOLE_SIZE, 0, &uniformBuffer.mapped));
+		for (uint32_t i = 0; i < frameCount; i++) {
+			memcpy(static_cast<uint8_t*>(uniformBuffer.mapped) + i * uniformBuffer.stride, &uniformBlock, sizeof(uniformBlock));
+			uniformBuffer.descriptors.push_back({ uniformBuffer.buffer, i * uniformBuffer.stride, sizeof(uniformBlock) });
+		}
+		uniformBuffer.descriptorSets.resize(frameCount, VK_NULL_HANDLE);
+		uniformBuffer.dirtyFrames = 0;
 	};
 
 	Mesh::~Mesh() {
@@ -569,56 +1005,32 @@ namespace vkglTF
 		bb.valid = true;
 	}
 
+	void Mesh::updateUniformBuffer(uint32_t frameIndex) {
+		const uint32_t frameBit = 1u << frameIndex;
+		if (!(uniformBuffer.dirtyFrames & frameBit)) {
+			return;
+		}
+		memcpy(static_cast<uint8_t*>(uniformBuffer.mapped) + frameIndex * uniformBuffer.stride, &uniformBlock, sizeof(uniformBlock));
+		uniformBuffer.dirtyFrames &= ~frameBit;
+	}
+
 	// Node
 	glm::mat4 Node::localMatrix() {
-		if (!useCachedMatrix) {
-			cachedLocalMatrix = glm::translate(glm::mat4(1.0f), translation) * glm::mat4(rotation) * glm::scale(glm::mat4(1.0f), scale) * matrix;
-		};
-		return cachedLocalMatrix;
+		return glm::translate(glm::mat4(1.0f), translation) * glm::mat4(rotation) * glm::scale(glm::mat4(1.0f), scale) * matrix;
 	}
 
 	glm::mat4 Node::getMatrix() {
-		// Use a simple caching algorithm to avoid having to recalculate matrices to often while traversing the node hierarchy
-		if (!useCachedMatrix) {
-			glm::mat4 m = localMatrix();
-			vkglTF::Node* p = parent;
-			while (p) {
-				m = p->localMatrix() * m;
-				p = p->parent;
-			}
-			cachedMatrix = m;
-			useCachedMatrix = true;
-			return m;
-		} else {
-			return cachedMatrix;
-		}
-	}
-
-	void Node::update() {
-		useCachedMatrix = false;
-		if (mesh) {
-			glm::mat4 m = getMatrix();
-			if (skin) {
-				mesh->uniformBlock.matrix = m;
-				// Update join matrices
-				glm::mat4 inverseTransform = glm::inverse(m);
-				size_t numJoints = std::min((uint32_t)skin->joints.size(), MAX_NUM_JOINTS);
-				for (size_t i = 0; i < numJoints; i++) {
-					vkglTF::Node *jointNode = skin->joints[i];
-					glm::mat4 jointMat = jointNode->getMatrix() * skin->inverseBindMatrices[i];
-					jointMat = inverseTransform * jointMat;
-					mesh->uniformBlock.jointMatrix[i] = jointMat;
-				}
-				mesh->uniformBlock.jointcount = static_cast<uint32_t>(numJoints);
-				memcpy(mesh->uniformBuffer.mapped, &mesh->uniformBlock, sizeof(mesh->uniformBlock));
-			} else {
-				memcpy(mesh->uniformBuffer.mapped, &m, sizeof(glm::mat4));
-			}
+		if (transforms) {
+			return transforms->worldMatrices[transformIndex];
 		}
-
-		for (auto& child : children) {
-			child->update();
+		// Not part of a transform hierarchy (yet)
+		glm::mat4 m = localMatrix();
+		vkglTF::Node* p = parent;
+		while (p) {
+			m = p->localMatrix() * m;
+			p = p->parent;
 		}
+		return m;
 	}
 
 	Node::~Node() {
@@ -631,10 +1043,135 @@ namespace vkglTF
 	}
 
 	// AnimationSampler
+
+	// Finds the keyframe interval containing time, returns false if time is outside of the sampler's range
+	// Checks the interval of the previous lookup and the one after it first, which makes forward playback O(1), seeks use a binary search
+	bool AnimationSampler::findKey(float time, size_t& index)
+	{
+		if ((inputs.size() < 2) || (time < inputs.front()) || (time > inputs.back())) {
+			return false;
+		}
+		if (cursor + 1 >= inputs.size()) {
+			cursor = 0;
+		}
+		if ((time >= inputs[cursor]) && (time <= inputs[cursor + 1])) {
+			index = cursor;
+			return true;
+		}
+		if ((cursor + 2 < inputs.size()) && (time >= inputs[cursor + 1]) && (time <= inputs[cursor + 2])) {
+			index = ++cursor;
+			return true;
+		}
+		// First key after time, the interval starts one key before it
+		size_t upper = std::upper_bound(inputs.begin(), inputs.end(), time) - inputs.begin();
+		cursor = std::min(upper, inputs.size() - 1) - 1;
+		index = cursor;
+		return true;
+	}
+
+	// Packs a unit quaternion (x, y, z, w) into three 16 bit values: the three smallest components with 15 bits each and the index of the largest one in two bits
+	// The largest component is made positive (q and -q are the same rotation) and restored from the unit length when decoding
+	static const float sqrt2 = 1.41421356f;
+
+	static void encodeSmallestThree(glm::vec4 q, uint16_t* packed)
+	{
+		q = glm::normalize(q);
+		uint32_t largest = 0;
+		for (uint32_t i = 1; i < 4; i++) {
+			if (fabsf(q[i]) > fabsf(q[largest])) {
+				largest = i;
+			}
+		}
+		if (q[largest] < 0.0f) {
+			q = -q;
+		}
+		// The smaller components lie within [-1/sqrt(2), 1/sqrt(2)]
+		uint16_t components[3];
+		uint32_t n = 0;
+		for (uint32_t i = 0; i < 4; i++) {
+			if (i != largest) {
+				const float normalized = glm::clamp(q[i] * 0.5f * sqrt2 + 0.5f, 0.0f, 1.0f);
+				components[n++] = static_cast<uint16_t>(roundf(normalized * 32767.0f));
+			}
+		}
+		packed[0] = static_cast<uint16_t>((components[0] << 1) | (largest >> 1));
+		packed[1] = static_cast<uint16_t>((components[1] << 1) | (largest & 1));
+		packed[2] = components[2];
+	}
+
+	static glm::vec4 decodeSmallestThree(const uint16_t* packed)
+	{
+		const uint32_t largest = ((packed[0] & 1) << 1) | (packed[1] & 1);
+		const float components[3] = { static_cast<float>(packed[0] >> 1), static_cast<float>(packed[1] >> 1), static_cast<float>(packed[2]) };
+		glm::vec4 q;
+		float sum = 0.0f;
+		uint32_t n = 0;
+		for (uint32_t i = 0; i < 4; i++) {
+			if (i != largest) {
+				q[i] = (components[n++] / 32767.0f - 0.5f) * sqrt2;
+				sum += q[i] * q[i];
+			}
+		}
+		q[largest] = sqrtf(std::max(0.0f, 1.0f - sum));
+		return q;
+	}
+
+	// Number of complete output values (keys, or three times the keys for cubic splines)
+	size_t AnimationSampler::valueCount() const
+	{
+		if (stride == 0) {
+			return 0;
+		}
+		switch (encoding) {
+		case AnimationSampler::OutputEncoding::RANGE:
+			return quantized.size() / stride;
+		case AnimationSampler::OutputEncoding::SMALLEST_THREE:
+			return quantized.size() / 3;
+		default:
+			return outputs.size() / stride;
+		}
+	}
+
+	float AnimationSampler::component(size_t index, uint32_t component) const
+	{
+		switch (encoding) {
+		case AnimationSampler::OutputEncoding::RANGE:
+			return rangeMin[component] + quantized[index * stride + component] * rangeStep[component];
+		case AnimationSampler::OutputEncoding::SMALLEST_THREE:
+			return decodeSmallestThree(&quantized[index * 3])[component];
+		default:
+			return outputs[index * stride + component];
+		}
+	}
+
+	glm::vec4 AnimationSampler::value(size_t index) const
+	{
+		glm::vec4 v{ 0.0f };
+		switch (encoding) {
+		case AnimationSampler::OutputEncoding::RANGE: {
+			const uint16_t* src = &quantized[index * stride];
+			for (uint32_t i = 0; i < stride; i++) {
+				v[i] = rangeMin[i] + src[i] * rangeStep[i];
+			}
+			break;
+		}
+		case AnimationSampler::OutputEncoding::SMALLEST_THREE:
+			v = decodeSmallestThree(&quantized[index * 3]);
+			break;
+		default: {
+			const float* src = &outputs[index * stride];
+			for (uint32_t i = 0; i < stride; i++) {
+				v[i] = src[i];
+			}
+			break;
+		}
+		}
+		return v;
+	}
 	
 	// Cube spline interpolation function used for translate/scale/rotate with cubic spline animation samples
 	// Details on how this works can be found in the specs https://github.com/KhronosGroup/glTF/tree/master/specification/2.0#appendix-c-spline-interpolation
-	glm::vec4 AnimationSampler::cubicSplineInterpolation(size_t index, float time, uint32_t stride) {
+	glm::vec4 AnimationSampler::cubicSplineInterpolation(size_t index, float time) {
 		float delta = inputs[index + 1] - inputs[index];
 		float t = (time - inputs[index]) / delta;
 		const size_t current = index * stride * 3;
@@ -661,15 +1198,15 @@ namespace vkglTF
 		switch (interpolation) {
 		case AnimationSampler::InterpolationType::LINEAR: {
 			float u = std::max(0.0f, time - inputs[index]) / (inputs[index + 1] - inputs[index]);
-			node->translation = glm::mix(outputsVec4[index], outputsVec4[index + 1], u);
+			node->translation = glm::mix(value(index), value(index + 1), u);
 			break;
 		}
 		case AnimationSampler::InterpolationType::STEP: {
-			node->translation = outputsVec4[index];
+			node->translation = value(index);
 			break;
 		}
 		case AnimationSampler::InterpolationType::CUBICSPLINE: {
-			node->translation = cubicSplineInterpolation(index, time, 3);
+			node->translation = cubicSplineInterpolation(index, time);
 			break;
 		}
 		}
@@ -680,15 +1217,15 @@ namespace vkglTF
 		switch (interpolation) {
 		case AnimationSampler::InterpolationType::LINEAR: {
 			float u = std::max(0.0f, time - inputs[index]) / (inputs[index + 1] - inputs[index]);
-			node->scale = glm::mix(outputsVec4[index], outputsVec4[index + 1], u);
+			node->scale = glm::mix(value(index), value(index + 1), u);
 			break;
 		}
 		case AnimationSampler::InterpolationType::STEP: {
-			node->scale = outputsVec4[index];
+			node->scale = value(index);
 			break;
 		}
 		case AnimationSampler::InterpolationType::CUBICSPLINE: {
-			node->scale = cubicSplineInterpolation(index, time, 3);
+			node->scale = cubicSplineInterpolation(index, time);
 			break;
 		}
 		}
@@ -699,44 +1236,188 @@ namespace vkglTF
 		switch (interpolation) {
 		case AnimationSampler::InterpolationType::LINEAR: {
 			float u = std::max(0.0f, time - inputs[index]) / (inputs[index + 1] - inputs[index]);
-			glm::quat q1;
-			q1.x = outputsVec4[index].x;
-			q1.y = outputsVec4[index].y;
-			q1.z = outputsVec4[index].z;
-			q1.w = outputsVec4[index].w;
-			glm::quat q2;
-			q2.x = outputsVec4[index + 1].x;
-			q2.y = outputsVec4[index + 1].y;
-			q2.z = outputsVec4[index + 1].z;
-			q2.w = outputsVec4[index + 1].w;
+			const glm::vec4 v1 = value(index);
+			const glm::vec4 v2 = value(index + 1);
+			glm::quat q1(v1.w, v1.x, v1.y, v1.z);
+			glm::quat q2(v2.w, v2.x, v2.y, v2.z);
 			node->rotation = glm::normalize(glm::slerp(q1, q2, u));
 			break;
 		}
 		case AnimationSampler::InterpolationType::STEP: {
-			glm::quat q1;
-			q1.x = outputsVec4[index].x;
-			q1.y = outputsVec4[index].y;
-			q1.z = outputsVec4[index].z;
-			q1.w = outputsVec4[index].w;
-			node->rotation = q1;
+			const glm::vec4 v1 = value(index);
+			node->rotation = glm::quat(v1.w, v1.x, v1.y, v1.z);
 			break;
 		}
 		case AnimationSampler::InterpolationType::CUBICSPLINE: {
-			glm::vec4 rot = cubicSplineInterpolation(index, time, 4);
-			glm::quat q;
-			q.x = rot.x;
-			q.y = rot.y;
-			q.z = rot.z;
-			q.w = rot.w;
+			glm::vec4 rot = cubicSplineInterpolation(index, time);
+			glm::quat q(rot.w, rot.x, rot.y, rot.z);
 			node->rotation = glm::normalize(q);
 			break;
 		}
 		}
 	}
 
+	// Calculates the morph target weights of this sampler at a given time point depending on the interpolation type, writes stride weights
+	void AnimationSampler::morphWeights(size_t index, float time, float* weights) {
+		switch (interpolation) {
+		case AnimationSampler::InterpolationType::LINEAR: {
+			float u = std::max(0.0f, time - inputs[index]) / (inputs[index + 1] - inputs[index]);
+			for (uint32_t i = 0; i < stride; i++) {
+				weights[i] = glm::mix(component(index, i), component(index + 1, i), u);
+			}
+			break;
+		}
+		case AnimationSampler::InterpolationType::STEP: {
+			for (uint32_t i = 0; i < stride; i++) {
+				weights[i] = component(index, i);
+			}
+			break;
+		}
+		case AnimationSampler::InterpolationType::CUBICSPLINE: {
+			float delta = inputs[index + 1] - inputs[index];
+			float t = (time - inputs[index]) / delta;
+			float t2 = t * t;
+			float t3 = t2 * t;
+			const size_t current = index * stride * 3;
+			const size_t next = (index + 1) * stride * 3;
+			for (uint32_t i = 0; i < stride; i++) {
+				float p0 = outputs[current + stride + i];
+				float m0 = delta * outputs[current + stride * 2 + i];
+				float p1 = outputs[next + stride + i];
+				float m1 = delta * outputs[next + i];
+				weights[i] = ((2.f * t3 - 3.f * t2 + 1.f) * p0) + ((t3 - 2.f * t2 + t) * m0) + ((-2.f * t3 + 3.f * t2) * p1) + ((t3 - t2) * m1);
+			}
+			break;
+		}
+		}
+	}
+
+	// Removes keys that interpolating between the remaining keys reproduces within tolerance (largest component deviation), cubic splines are kept as they are
+	// A key is removed if all keys since the last kept one are reproduced by the curve from that key to the next one
+	void AnimationSampler::simplify(float tolerance, bool rotation)
+	{
+		if ((interpolation == AnimationSampler::InterpolationType::CUBICSPLINE) || (encoding != AnimationSampler::OutputEncoding::FLOAT) || (stride == 0) || (inputs.size() < 3) || (outputs.size() < inputs.size() * stride)) {
+			return;
+		}
+		// Bounds the cost of checking a span, long constant stretches keep one key per span
+		const size_t maxSpan = 64;
+		auto deviation = [&](size_t first, size_t last, size_t key) {
+			const float delta = inputs[last] - inputs[first];
+			const float u = ((interpolation == AnimationSampler::InterpolationType::STEP) || (delta <= 0.0f)) ? 0.0f : (inputs[key] - inputs[first]) / delta;
+			float maxDeviation = 0.0f;
+			if (rotation && (stride == 4)) {
+				const glm::vec4 v1 = value(first);
+				const glm::vec4 v2 = value(last);
+				const glm::vec4 v = value(key);
+				const glm::quat q = glm::normalize(glm::slerp(glm::quat(v1.w, v1.x, v1.y, v1.z), glm::quat(v2.w, v2.x, v2.y, v2.z), u));
+				glm::vec4 interpolated(q.x, q.y, q.z, q.w);
+				if (glm::dot(interpolated, v) < 0.0f) {
+					interpolated = -interpolated;
+				}
+				for (uint32_t i = 0; i < 4; i++) {
+					maxDeviation = std::max(maxDeviation, fabsf(interpolated[i] - v[i]));
+				}
+			} else {
+				for (uint32_t i = 0; i < stride; i++) {
+					const float interpolated = glm::mix(outputs[first * stride + i], outputs[last * stride + i], u);
+					maxDeviation = std::max(maxDeviation, fabsf(interpolated - outputs[key * stride + i]));
+				}
+			}
+			return maxDeviation;
+		};
+
+		std::vector<size_t> keep = { 0 };
+		for (size_t k = 1; k + 1 < inputs.size(); k++) {
+			const size_t anchor = keep.back();
+			bool removable = (k + 1 - anchor <= maxSpan);
+			for (size_t j = anchor + 1; removable && (j <= k); j++) {
+				removable = deviation(anchor, k + 1, j) <= tolerance;
+			}
+			if (!removable) {
+				keep.push_back(k);
+			}
+		}
+		keep.push_back(inputs.size() - 1);
+		if (keep.size() == inputs.size()) {
+			return;
+		}
+
+		std::vector<float> keptInputs(keep.size());
+		std::vector<float> keptOutputs(keep.size() * stride);
+		for (size_t i = 0; i < keep.size(); i++) {
+			keptInputs[i] = inputs[keep[i]];
+			memcpy(&keptOutputs[i * stride], &outputs[keep[i] * stride], stride * sizeof(float));
+		}
+		inputs.swap(keptInputs);
+		outputs.swap(keptOutputs);
+		cursor = 0;
+	}
+
+	// Replaces the float outputs with 16 bit values, rotations as smallest three quaternions and everything else in per component ranges
+	void AnimationSampler::quantize(bool rotation)
+	{
+		if ((interpolation == AnimationSampler::InterpolationType::CUBICSPLINE) || (encoding != AnimationSampler::OutputEncoding::FLOAT) || (stride == 0)) {
+			return;
+		}
+		const size_t count = outputs.size() / stride;
+		if (rotation && (stride == 4)) {
+			quantized.resize(count * 3);
+			for (size_t k = 0; k < count; k++) {
+				encodeSmallestThree(glm::make_vec4(&outputs[k * 4]), &quantized[k * 3]);
+			}
+			encoding = AnimationSampler::OutputEncoding::SMALLEST_THREE;
+		} else {
+			rangeMin.assign(stride, FLT_MAX);
+			rangeStep.assign(stride, 0.0f);
+			std::vector<float> rangeMax(stride, -FLT_MAX);
+			for (size_t k = 0; k < count; k++) {
+				for (uint32_t i = 0; i < stride; i++) {
+					rangeMin[i] = std::min(rangeMin[i], outputs[k * stride + i]);
+					rangeMax[i] = std::max(rangeMax[i], outputs[k * stride + i]);
+				}
+			}
+			for (uint32_t i = 0; i < stride; i++) {
+				rangeStep[i] = (count > 0) ? (rangeMax[i] - rangeMin[i]) / 65535.0f : 0.0f;
+			}
+			quantized.resize(count * stride);
+			for (size_t k = 0; k < count; k++) {
+				for (uint32_t i = 0; i < stride; i++) {
+					const float normalized = (rangeStep[i] > 0.0f) ? (outputs[k * stride + i] - rangeMin[i]) / rangeStep[i] : 0.0f;
+					quantized[k * stride + i] = static_cast<uint16_t>(std::min(65535.0f, roundf(normalized)));
+				}
+			}
+			encoding = AnimationSampler::OutputEncoding::RANGE;
+		}
+		outputs.clear();
+		outputs.shrink_to_fit();
+	}
+
+	// Size of the keys in bytes
+	size_t AnimationSampler::memorySize() const
+	{
+		return (inputs.size() + outputs.size() + rangeMin.size() + rangeStep.size()) * sizeof(float) + quantized.size() * sizeof(uint16_t);
+	}
+
 	// Model
 	void Model::destroy(VkDevice device)
 	{
+		destroySceneNodes(device);
+		for (auto texture : textures) {
+			texture.destroy();
+		}
+		textures.resize(0);
+		textureSamplers.resize(0);
+		materials.resize(0);
+		extensions.resize(0);
+		activeScene = -1;
+		sceneNames.resize(0);
+		gltfSource.reset();
+	};
+
+	// Destroys everything that's built from the active scene's node graph, textures and materials are kept
+	void Model::destroySceneNodes(VkDevice device)
+	{
+		freeJointRanges();
 		if (vertices.buffer != VK_NULL_HANDLE) {
 			vkDestroyBuffer(device, vertices.buffer, nullptr);
 			vkFreeMemory(device, vertices.memory, nullptr);
@@ -747,25 +1428,73 @@ namespace vkglTF
 			vkFreeMemory(device, indices.memory, nullptr);
 			indices.buffer = VK_NULL_HANDLE;
 		}
-		for (auto texture : textures) {
-			texture.destroy();
-		}
-		textures.resize(0);
-		textureSamplers.resize(0);
 		for (auto node : nodes) {
 			delete node;
 		}
-		materials.resize(0);
 		animations.resize(0);
 		nodes.resize(0);
 		linearNodes.resize(0);
-		extensions.resize(0);
+		transformNodes.resize(0);
+		changedMeshNodes.resize(0);
+		transforms.clear();
+		morphTargets = vks::ComputeSkinner::MorphTargets();
 		for (auto skin : skins) {
 			delete skin;
 		}
 		skins.resize(0);
-	};
+	}
 	
+	// Reads a float VEC3 morph target attribute of a primitive, sparse accessors are applied on top of their dense values (zero if they have no buffer view)
+	static std::vector<glm::vec3> readMorphTargetAttribute(const tinygltf::Model& model, const std::map<std::string, int>& target, const char* attribute, size_t vertexCount)
+	{
+		std::vector<glm::vec3> values(vertexCount, glm::vec3(0.0f));
+		auto it = target.find(attribute);
+		if (it == target.end()) {
+			return values;
+		}
+		const tinygltf::Accessor& accessor = model.accessors[it->second];
+		if ((accessor.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT) || (accessor.type != TINYGLTF_TYPE_VEC3)) {
+			std::cerr << "Morph target " << attribute << " component type " << accessor.componentType << " not supported!" << std::endl;
+			return values;
+		}
+		const size_t count = std::min(vertexCount, accessor.count);
+		if (accessor.bufferView > -1) {
+			const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+			const float* buf = reinterpret_cast<const float*>(&(model.buffers[view.buffer].data[accessor.byteOffset + view.byteOffset]));
+			const int byteStride = accessor.ByteStride(view) ? (accessor.ByteStride(view) / sizeof(float)) : tinygltf::GetNumComponentsInType(TINYGLTF_TYPE_VEC3);
+			for (size_t v = 0; v < count; v++) {
+				values[v] = glm::make_vec3(&buf[v * byteStride]);
+			}
+		}
+		if (accessor.sparse.isSparse) {
+			const tinygltf::BufferView& indexView = model.bufferViews[accessor.sparse.indices.bufferView];
+			const tinygltf::BufferView& valueView = model.bufferViews[accessor.sparse.values.bufferView];
+			const unsigned char* indexData = &(model.buffers[indexView.buffer].data[accessor.sparse.indices.byteOffset + indexView.byteOffset]);
+			const float* valueData = reinterpret_cast<const float*>(&(model.buffers[valueView.buffer].data[accessor.sparse.values.byteOffset + valueView.byteOffset]));
+			for (int i = 0; i < accessor.sparse.count; i++) {
+				size_t index;
+				switch (accessor.sparse.indices.componentType) {
+				case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+					index = reinterpret_cast<const uint32_t*>(indexData)[i];
+					break;
+				case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+					index = reinterpret_cast<const uint16_t*>(indexData)[i];
+					break;
+				case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+					index = indexData[i];
+					break;
+				default:
+					std::cerr << "Sparse index component type " << accessor.sparse.indices.componentType << " not supported!" << std::endl;
+					return values;
+				}
+				if (index < count) {
+					values[index] = glm::make_vec3(&valueData[i * 3]);
+				}
+			}
+		}
+		return values;
+	}
+
 	void Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, uint32_t nodeIndex, const tinygltf::Model &model, LoaderInfo& loaderInfo, float globalscale)
 	{
 		vkglTF::Node *newNode = new Node{};
@@ -805,7 +1534,11 @@ namespace vkglTF
 		// Node contains mesh data
 		if (node.mesh > -1) {
 			const tinygltf::Mesh mesh = model.meshes[node.mesh];
-			Mesh *newMesh = new Mesh(device, newNode->matrix);
+			Mesh *newMesh = new Mesh(device, newNode->matrix, frameCount);
+			// Non-zero morph target deltas of each vertex of the mesh
+			const uint32_t meshFirstVertex = static_cast<uint32_t>(loaderInfo.vertexPos);
+			std::vector<std::vector<vks::ComputeSkinner::MorphDelta>> morphVertexDeltas;
+			uint32_t morphTargetCount = 0;
 			for (size_t j = 0; j < mesh.primitives.size(); j++) {
 				const tinygltf::Primitive &primitive = mesh.primitives[j];
 				uint32_t vertexStart = static_cast<uint32_t>(loaderInfo.vertexPos);
@@ -973,7 +1706,26 @@ namespace vkglTF
 						return;
 					}
 				}					
+				// Morph targets
+				if (!primitive.targets.empty()) {
+					morphTargetCount = std::max(morphTargetCount, static_cast<uint32_t>(primitive.targets.size()));
+					morphVertexDeltas.resize(vertexStart + vertexCount - meshFirstVertex);
+					for (size_t t = 0; t < primitive.targets.size(); t++) {
+						const std::vector<glm::vec3> positions = readMorphTargetAttribute(model, primitive.targets[t], "POSITION", vertexCount);
+						const std::vector<glm::vec3> normals = readMorphTargetAttribute(model, primitive.targets[t], "NORMAL", vertexCount);
+						for (uint32_t v = 0; v < vertexCount; v++) {
+							if ((positions[v] != glm::vec3(0.0f)) || (normals[v] != glm::vec3(0.0f))) {
+								vks::ComputeSkinner::MorphDelta delta;
+								delta.position = positions[v];
+								delta.target = static_cast<uint32_t>(t);
+								delta.normal = normals[v];
+								morphVertexDeltas[vertexStart - meshFirstVertex + v].push_back(delta);
+							}
+						}
+					}
+				}
 				Primitive *newPrimitive = new Primitive(indexStart, indexCount, vertexCount, primitive.material > -1 ? materials[primitive.material] : materials.back());
+				newPrimitive->firstVertex = vertexStart;
 				newPrimitive->setBoundingBox(posMin, posMax);
 				newMesh->primitives.push_back(newPrimitive);
 			}
@@ -986,6 +1738,23 @@ namespace vkglTF
 				newMesh->bb.min = glm::min(newMesh->bb.min, p->bb.min);
 				newMesh->bb.max = glm::max(newMesh->bb.max, p->bb.max);
 			}
+			// Deltas are stored ordered by vertex, with the index of each vertex' first delta, so the blend shader only visits a vertex' own deltas
+			if (morphTargetCount > 0) {
+				newMesh->morphTargetCount = morphTargetCount;
+				newMesh->morphVertexOffset = static_cast<uint32_t>(morphTargets.vertexDeltas.size());
+				morphVertexDeltas.resize(loaderInfo.vertexPos - meshFirstVertex);
+				for (auto& vertexDeltas : morphVertexDeltas) {
+					morphTargets.vertexDeltas.push_back(static_cast<uint32_t>(morphTargets.deltas.size()));
+					morphTargets.deltas.insert(morphTargets.deltas.end(), vertexDeltas.begin(), vertexDeltas.end());
+				}
+				morphTargets.vertexDeltas.push_back(static_cast<uint32_t>(morphTargets.deltas.size()));
+				// Default weights of the node override those of the mesh
+				newNode->morphWeightOffset = static_cast<int32_t>(morphTargets.weights.size());
+				const std::vector<double>& weights = (node.weights.size() == morphTargetCount) ? node.weights : mesh.weights;
+				for (uint32_t t = 0; t < morphTargetCount; t++) {
+					morphTargets.weights.push_back((t < weights.size()) ? static_cast<float>(weights[t]) : 0.0f);
+				}
+			}
 			newNode->mesh = newMesh;
 		}
 		if (parent) {
@@ -1003,61 +1772,441 @@ namespace vkglTF
 				getNodeProps(model.nodes[node.children[i]], model, vertexCount, indexCount);
 			}
 		}
-		if (node.mesh > -1) {
-			const tinygltf::Mesh mesh = model.meshes[node.mesh];
-			for (size_t i = 0; i < mesh.primitives.size(); i++) {
-				auto primitive = mesh.primitives[i];
-				vertexCount += model.accessors[primitive.attributes.find("POSITION")->second].count;
-				if (primitive.indices > -1) {
-					indexCount += model.accessors[primitive.indices].count;
-				}
+		if (node.mesh > -1) {
+			const tinygltf::Mesh mesh = model.meshes[node.mesh];
+			for (size_t i = 0; i < mesh.primitives.size(); i++) {
+				auto primitive = mesh.primitives[i];
+				vertexCount += model.accessors[primitive.attributes.find("POSITION")->second].count;
+				if (primitive.indices > -1) {
+					indexCount += model.accessors[primitive.indices].count;
+				}
+			}
+		}
+	}
+
+	void Model::loadSkins(tinygltf::Model &gltfModel)
+	{
+		for (tinygltf::Skin &source : gltfModel.skins) {
+			Skin *newSkin = new Skin{};
+			newSkin->name = source.name;
+				
+			// Find skeleton root node
+			if (source.skeleton > -1) {
+				newSkin->skeletonRoot = nodeFromIndex(source.skeleton);
+			}
+
+			// Find joint nodes
+			for (int jointIndex : source.joints) {
+				Node* node = nodeFromIndex(jointIndex);
+				if (node) {
+					newSkin->joints.push_back(nodeFromIndex(jointIndex));
+				}
+			}
+
+			// Get inverse bind matrices from buffer
+			if (source.inverseBindMatrices > -1) {
+				const tinygltf::Accessor &accessor = gltfModel.accessors[source.inverseBindMatrices];
+				const tinygltf::BufferView &bufferView = gltfModel.bufferViews[accessor.bufferView];
+				const tinygltf::Buffer &buffer = gltfModel.buffers[bufferView.buffer];
+				newSkin->inverseBindMatrices.resize(accessor.count);
+				memcpy(newSkin->inverseBindMatrices.data(), &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::mat4));
+			}
+
+			skins.push_back(newSkin);
+		}
+	}
+
+	// Decode all EXT_meshopt_compression buffer views in place into their (fallback) buffers, so loadNode reads them like uncompressed data
+	// Buffer views are independent, so they are decoded in parallel
+	bool Model::decodeMeshoptBufferViews(tinygltf::Model& gltfModel)
+	{
+		struct CompressedView {
+			size_t viewIndex;
+			int sourceBuffer;
+			size_t sourceOffset;
+			size_t sourceSize;
+			size_t count;
+			size_t stride;
+			meshopt::Mode mode;
+			meshopt::Filter filter;
+		};
+		std::vector<CompressedView> compressedViews;
+
+		for (size_t i = 0; i < gltfModel.bufferViews.size(); i++) {
+			tinygltf::BufferView& view = gltfModel.bufferViews[i];
+			auto ext = view.extensions.find("EXT_meshopt_compression");
+			if (ext == view.extensions.end()) {
+				continue;
+			}
+			const tinygltf::Value& value = ext->second;
+			CompressedView compressedView{};
+			compressedView.viewIndex = i;
+			compressedView.sourceBuffer = value.Get("buffer").GetNumberAsInt();
+			compressedView.sourceOffset = value.Has("byteOffset") ? static_cast<size_t>(value.Get("byteOffset").GetNumberAsDouble()) : 0;
+			compressedView.sourceSize = static_cast<size_t>(value.Get("byteLength").GetNumberAsDouble());
+			compressedView.count = static_cast<size_t>(value.Get("count").GetNumberAsDouble());
+			compressedView.stride = static_cast<size_t>(value.Get("byteStride").GetNumberAsDouble());
+
+			const std::string mode = value.Get("mode").Get<std::string>();
+			if (mode == "ATTRIBUTES") {
+				compressedView.mode = meshopt::Mode::Attributes;
+			} else if (mode == "TRIANGLES") {
+				compressedView.mode = meshopt::Mode::Triangles;
+			} else if (mode == "INDICES") {
+				compressedView.mode = meshopt::Mode::Indices;
+			} else {
+				std::cerr << "EXT_meshopt_compression: unknown mode \"" << mode << "\" in buffer view " << i << std::endl;
+				return false;
+			}
+			const std::string filter = value.Has("filter") ? value.Get("filter").Get<std::string>() : "NONE";
+			if (filter == "OCTAHEDRAL") {
+				compressedView.filter = meshopt::Filter::Octahedral;
+			} else if (filter == "QUATERNION") {
+				compressedView.filter = meshopt::Filter::Quaternion;
+			} else if (filter == "EXPONENTIAL") {
+				compressedView.filter = meshopt::Filter::Exponential;
+			} else {
+				compressedView.filter = meshopt::Filter::None;
+			}
+
+			if ((compressedView.sourceBuffer < 0) || (compressedView.sourceBuffer >= static_cast<int>(gltfModel.buffers.size())) || (view.buffer < 0) || (view.buffer >= static_cast<int>(gltfModel.buffers.size()))) {
+				std::cerr << "EXT_meshopt_compression: invalid buffer index in buffer view " << i << std::endl;
+				return false;
+			}
+			if (compressedView.sourceOffset + compressedView.sourceSize > gltfModel.buffers[compressedView.sourceBuffer].data.size()) {
+				std::cerr << "EXT_meshopt_compression: compressed data of buffer view " << i << " is out of range" << std::endl;
+				return false;
+			}
+			// Make sure the destination can hold the decoded data, this must happen before any decoding starts as buffers may be shared between views
+			tinygltf::Buffer& destination = gltfModel.buffers[view.buffer];
+			const size_t decodedSize = compressedView.count * compressedView.stride;
+			if (view.byteOffset + decodedSize > destination.data.size()) {
+				destination.data.resize(view.byteOffset + decodedSize);
+			}
+			compressedViews.push_back(compressedView);
+		}
+
+		// Largest views first to balance the work over the pool
+		std::sort(compressedViews.begin(), compressedViews.end(), [](const CompressedView& a, const CompressedView& b) { return a.count * a.stride > b.count * b.stride; });
+
+		std::vector<int> results(compressedViews.size(), 0);
+		vks::ThreadPool::shared().parallelFor(compressedViews.size(), [&](size_t i) {
+			const CompressedView& compressedView = compressedViews[i];
+			const tinygltf::BufferView& view = gltfModel.bufferViews[compressedView.viewIndex];
+			const unsigned char* source = gltfModel.buffers[compressedView.sourceBuffer].data.data() + compressedView.sourceOffset;
+			unsigned char* destination = gltfModel.buffers[view.buffer].data.data() + view.byteOffset;
+			results[i] = meshopt::decode(destination, compressedView.count, compressedView.stride, source, compressedView.sourceSize, compressedView.mode, compressedView.filter);
+		});
+
+		bool success = true;
+		for (size_t i = 0; i < compressedViews.size(); i++) {
+			if (results[i] != 0) {
+				std::cerr << "EXT_meshopt_compression: failed to decode buffer view " << compressedViews[i].viewIndex << " (error " << results[i] << ")" << std::endl;
+				success = false;
+			}
+		}
+		return success;
+	}
+
+	// Decode all KHR_draco_mesh_compression primitives on the thread pool
+	// Each primitive's decoded indices and attributes are moved into new buffers and its accessors are redirected to them, so loadNode reads them like uncompressed data
+	void Model::decodeDracoPrimitives(tinygltf::Model& gltfModel)
+	{
+#if defined(TINYGLTF_ENABLE_DRACO)
+		struct DecodedAccessor {
+			int accessor;
+			size_t count;
+			std::vector<unsigned char> data;
+		};
+		struct DracoPrimitive {
+			size_t meshIndex;
+			size_t primitiveIndex;
+			const tinygltf::Value* extension;
+		};
+		// All primitives referencing the same compressed buffer view, the mesh is decoded once and every primitive's accessors are filled from it
+		struct DracoView {
+			int bufferView;
+			std::vector<DracoPrimitive> primitives;
+			bool success = false;
+			size_t pointCount = 0;
+			size_t indexCount = 0;
+			std::vector<DecodedAccessor> accessors;
+			double decodeTime = 0.0;
+		};
+		std::vector<DracoView> dracoViews;
+
+		std::vector<int> viewJob(gltfModel.bufferViews.size(), -1);
+		size_t primitiveCount = 0;
+		for (size_t m = 0; m < gltfModel.meshes.size(); m++) {
+			for (size_t p = 0; p < gltfModel.meshes[m].primitives.size(); p++) {
+				const tinygltf::Primitive& primitive = gltfModel.meshes[m].primitives[p];
+				auto ext = primitive.extensions.find("KHR_draco_mesh_compression");
+				if (ext == primitive.extensions.end()) {
+					continue;
+				}
+				const tinygltf::Value& bufferView = ext->second.Get("bufferView");
+				if (!bufferView.IsInt() || (bufferView.Get<int>() < 0) || (bufferView.Get<int>() >= static_cast<int>(gltfModel.bufferViews.size()))) {
+					std::cerr << "KHR_draco_mesh_compression: invalid buffer view in mesh " << m << " primitive " << p << std::endl;
+					continue;
+				}
+				if (viewJob[bufferView.Get<int>()] < 0) {
+					viewJob[bufferView.Get<int>()] = static_cast<int>(dracoViews.size());
+					DracoView dracoView{};
+					dracoView.bufferView = bufferView.Get<int>();
+					dracoViews.push_back(std::move(dracoView));
+				}
+				dracoViews[viewJob[bufferView.Get<int>()]].primitives.push_back({ m, p, &ext->second });
+				primitiveCount++;
+			}
+		}
+		if (dracoViews.empty()) {
+			return;
+		}
+
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		// The model is only read while decoding, results are stored per buffer view
+		vks::ThreadPool::shared().parallelFor(dracoViews.size(), [&](size_t i) {
+			DracoView& dracoView = dracoViews[i];
+			auto tDecodeStart = std::chrono::high_resolution_clock::now();
+			const tinygltf::BufferView& view = gltfModel.bufferViews[dracoView.bufferView];
+			const tinygltf::Buffer& buffer = gltfModel.buffers[view.buffer];
+
+			draco::DecoderBuffer decoderBuffer;
+			decoderBuffer.Init(reinterpret_cast<const char*>(buffer.data.data() + view.byteOffset), view.byteLength);
+			draco::Decoder decoder;
+			auto decodeResult = decoder.DecodeMeshFromBuffer(&decoderBuffer);
+			if (!decodeResult.ok()) {
+				return;
+			}
+			const std::unique_ptr<draco::Mesh>& mesh = decodeResult.value();
+			dracoView.pointCount = mesh->num_points();
+			dracoView.indexCount = mesh->num_faces() * 3;
+
+			// Primitives sharing the compressed data may still use different accessors, each of them gets its own decoded copy
+			auto decoded = [&dracoView](int accessor) {
+				for (const DecodedAccessor& decodedAccessor : dracoView.accessors) {
+					if (decodedAccessor.accessor == accessor) {
+						return true;
+					}
+				}
+				return false;
+			};
+			for (const DracoPrimitive& dracoPrimitive : dracoView.primitives) {
+				const tinygltf::Primitive& primitive = gltfModel.meshes[dracoPrimitive.meshIndex].primitives[dracoPrimitive.primitiveIndex];
+				if ((primitive.indices >= 0) && !decoded(primitive.indices)) {
+					const int32_t componentSize = tinygltf::GetComponentSizeInBytes(gltfModel.accessors[primitive.indices].componentType);
+					DecodedAccessor indices{};
+					indices.accessor = primitive.indices;
+					indices.count = dracoView.indexCount;
+					indices.data.resize(dracoView.indexCount * componentSize);
+					tinygltf::DecodeIndexBuffer(mesh.get(), componentSize, indices.data);
+					dracoView.accessors.push_back(std::move(indices));
+				}
+
+				const tinygltf::Value& attributes = dracoPrimitive.extension->Get("attributes");
+				for (const std::string& name : attributes.Keys()) {
+					auto primitiveAttribute = primitive.attributes.find(name);
+					if ((primitiveAttribute == primitive.attributes.end()) || !attributes.Get(name).IsInt()) {
+						return;
+					}
+					if (decoded(primitiveAttribute->second)) {
+						continue;
+					}
+					const draco::PointAttribute* pAttribute = mesh->GetAttributeByUniqueId(attributes.Get(name).Get<int>());
+					if (!pAttribute) {
+						return;
+					}
+					const int componentType = gltfModel.accessors[primitiveAttribute->second].componentType;
+					DecodedAccessor attribute{};
+					attribute.accessor = primitiveAttribute->second;
+					attribute.count = dracoView.pointCount;
+					attribute.data.resize(mesh->num_points() * pAttribute->num_components() * tinygltf::GetComponentSizeInBytes(componentType));
+					if (!tinygltf::GetAttributeForAllPoints(componentType, mesh.get(), pAttribute, attribute.data)) {
+						return;
+					}
+					dracoView.accessors.push_back(std::move(attribute));
+				}
+			}
+
+			dracoView.success = true;
+			dracoView.decodeTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tDecodeStart).count();
+		});
+
+		auto tDecode = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+
+		// Hand the decoded data over to the model (moved, not copied) and point the accessors at it
+		double decodeTimeSum = 0.0;
+		for (DracoView& dracoView : dracoViews) {
+			if (!dracoView.success) {
+				for (const DracoPrimitive& dracoPrimitive : dracoView.primitives) {
+					std::cerr << "KHR_draco_mesh_compression: failed to decode mesh " << dracoPrimitive.meshIndex << " primitive " << dracoPrimitive.primitiveIndex << std::endl;
+				}
+				continue;
+			}
+			// Primitives sharing a buffer view share its decode time
+			for (const DracoPrimitive& dracoPrimitive : dracoView.primitives) {
+				std::cout << "Draco decoded mesh " << dracoPrimitive.meshIndex << " primitive " << dracoPrimitive.primitiveIndex << " (" << dracoView.pointCount << " points, " << dracoView.indexCount << " indices) in " << dracoView.decodeTime << " ms";
+				if (dracoView.primitives.size() > 1) {
+					std::cout << " (buffer view " << dracoView.bufferView << " shared by " << dracoView.primitives.size() << " primitives)";
+				}
+				std::cout << std::endl;
+			}
+			decodeTimeSum += dracoView.decodeTime;
+
+			for (DecodedAccessor& decodedAccessor : dracoView.accessors) {
+				tinygltf::Buffer decodedBuffer;
+				decodedBuffer.data = std::move(decodedAccessor.data);
+				tinygltf::BufferView decodedBufferView;
+				decodedBufferView.buffer = static_cast<int>(gltfModel.buffers.size());
+				decodedBufferView.byteOffset = 0;
+				decodedBufferView.byteLength = decodedBuffer.data.size();
+				// Decoded data is always tightly packed
+				decodedBufferView.byteStride = 0;
+				decodedBufferView.dracoDecoded = true;
+				gltfModel.buffers.push_back(std::move(decodedBuffer));
+				gltfModel.bufferViews.push_back(std::move(decodedBufferView));
+
+				tinygltf::Accessor& accessor = gltfModel.accessors[decodedAccessor.accessor];
+				accessor.bufferView = static_cast<int>(gltfModel.bufferViews.size() - 1);
+				accessor.byteOffset = 0;
+				accessor.count = decodedAccessor.count;
+			}
+		}
+		std::cout << "Draco decoded " << primitiveCount << " primitives (" << dracoViews.size() << " buffer views) in " << tDecode << " ms (" << decodeTimeSum << " ms decode time on " << vks::ThreadPool::shared().threadCount() << " threads)" << std::endl;
+#else
+		(void)gltfModel;
+#endif
+	}
+
+	// Collects how each glTF texture is used by the materials, so textures can be stored in formats matching their content
+	std::vector<uint32_t> Model::getTextureRoles(const tinygltf::Model& gltfModel)
+	{
+		std::vector<uint32_t> roles(gltfModel.textures.size(), 0);
+		auto addRole = [&roles](int textureIndex, uint32_t role) {
+			if ((textureIndex >= 0) && (textureIndex < static_cast<int>(roles.size()))) {
+				roles[textureIndex] |= role;
+			}
+		};
+		for (const tinygltf::Material& mat : gltfModel.materials) {
+			addRole(mat.pbrMetallicRoughness.baseColorTexture.index, Texture::ROLE_COLOR);
+			addRole(mat.pbrMetallicRoughness.metallicRoughnessTexture.index, Texture::ROLE_METALLIC_ROUGHNESS);
+			addRole(mat.normalTexture.index, Texture::ROLE_NORMAL);
+			addRole(mat.occlusionTexture.index, Texture::ROLE_OCCLUSION);
+			addRole(mat.emissiveTexture.index, Texture::ROLE_COLOR);
+			// Specular glossiness textures use all four channels
+			auto ext = mat.extensions.find("KHR_materials_pbrSpecularGlossiness");
+			if (ext != mat.extensions.end()) {
+				if (ext->second.Has("diffuseTexture")) {
+					addRole(ext->second.Get("diffuseTexture").Get("index").Get<int>(), Texture::ROLE_COLOR);
+				}
+				if (ext->second.Has("specularGlossinessTexture")) {
+					addRole(ext->second.Get("specularGlossinessTexture").Get("index").Get<int>(), Texture::ROLE_COLOR);
+				}
+			}
+		}
+		// Textures not referenced by any material are treated as color textures
+		for (auto& role : roles) {
+			if (role == 0) {
+				role = Texture::ROLE_COLOR;
 			}
 		}
+		return roles;
 	}
 
-	void Model::loadSkins(tinygltf::Model &gltfModel)
+	// Textures used by the materials of all meshes in the given scene's node graph (all textures if lazy loading is disabled)
+	std::vector<bool> Model::getReachableTextures(const tinygltf::Model& gltfModel, uint32_t sceneIndex)
 	{
-		for (tinygltf::Skin &source : gltfModel.skins) {
-			Skin *newSkin = new Skin{};
-			newSkin->name = source.name;
-				
-			// Find skeleton root node
-			if (source.skeleton > -1) {
-				newSkin->skeletonRoot = nodeFromIndex(source.skeleton);
+		std::vector<bool> textures(gltfModel.textures.size(), !lazyLoading);
+		if (!lazyLoading) {
+			return textures;
+		}
+		std::vector<bool> visitedNodes(gltfModel.nodes.size(), false);
+		std::vector<bool> materials(gltfModel.materials.size(), false);
+		std::vector<int> stack(gltfModel.scenes[sceneIndex].nodes.begin(), gltfModel.scenes[sceneIndex].nodes.end());
+		while (!stack.empty()) {
+			const int nodeIndex = stack.back();
+			stack.pop_back();
+			if ((nodeIndex < 0) || (nodeIndex >= static_cast<int>(visitedNodes.size())) || visitedNodes[nodeIndex]) {
+				continue;
 			}
-
-			// Find joint nodes
-			for (int jointIndex : source.joints) {
-				Node* node = nodeFromIndex(jointIndex);
-				if (node) {
-					newSkin->joints.push_back(nodeFromIndex(jointIndex));
+			visitedNodes[nodeIndex] = true;
+			const tinygltf::Node& node = gltfModel.nodes[nodeIndex];
+			if (node.mesh > -1) {
+				for (const tinygltf::Primitive& primitive : gltfModel.meshes[node.mesh].primitives) {
+					if (primitive.material > -1) {
+						materials[primitive.material] = true;
+					}
 				}
 			}
-
-			// Get inverse bind matrices from buffer
-			if (source.inverseBindMatrices > -1) {
-				const tinygltf::Accessor &accessor = gltfModel.accessors[source.inverseBindMatrices];
-				const tinygltf::BufferView &bufferView = gltfModel.bufferViews[accessor.bufferView];
-				const tinygltf::Buffer &buffer = gltfModel.buffers[bufferView.buffer];
-				newSkin->inverseBindMatrices.resize(accessor.count);
-				memcpy(newSkin->inverseBindMatrices.data(), &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::mat4));
+			stack.insert(stack.end(), node.children.begin(), node.children.end());
+		}
+		auto addTexture = [&textures](int textureIndex) {
+			if ((textureIndex >= 0) && (textureIndex < static_cast<int>(textures.size()))) {
+				textures[textureIndex] = true;
+			}
+		};
+		for (size_t i = 0; i < materials.size(); i++) {
+			if (!materials[i]) {
+				continue;
+			}
+			const tinygltf::Material& mat = gltfModel.materials[i];
+			addTexture(mat.pbrMetallicRoughness.baseColorTexture.index);
+			addTexture(mat.pbrMetallicRoughness.metallicRoughnessTexture.index);
+			addTexture(mat.normalTexture.index);
+			addTexture(mat.occlusionTexture.index);
+			addTexture(mat.emissiveTexture.index);
+			auto ext = mat.extensions.find("KHR_materials_pbrSpecularGlossiness");
+			if (ext != mat.extensions.end()) {
+				if (ext->second.Has("diffuseTexture")) {
+					addTexture(ext->second.Get("diffuseTexture").Get("index").Get<int>());
+				}
+				if (ext->second.Has("specularGlossinessTexture")) {
+					addTexture(ext->second.Get("specularGlossinessTexture").Get("index").Get<int>());
+				}
 			}
-
-			skins.push_back(newSkin);
 		}
+		return textures;
 	}
 
-	void Model::loadTextures(tinygltf::Model &gltfModel, vks::VulkanDevice *device, VkQueue transferQueue)
+	// Loads all required textures that haven't been loaded yet, the texture list always has one entry per glTF texture
+	void Model::loadTextures(tinygltf::Model &gltfModel, vks::VulkanDevice *device, VkQueue transferQueue, const std::vector<bool>& requiredTextures)
 	{
-		for (tinygltf::Texture &tex : gltfModel.textures) {
+		const std::vector<uint32_t> textureRoles = getTextureRoles(gltfModel);
+		VkDeviceSize textureMemory = 0;
+		VkDeviceSize rgba8TextureMemory = 0;
+		textures.resize(gltfModel.textures.size());
+
+		auto getImage = [&gltfModel](const tinygltf::Texture& tex) -> tinygltf::Image& {
 			int source = tex.source;
 			// If this texture uses the KHR_texture_basisu, we need to get the source index from the extension structure
 			if (tex.extensions.find("KHR_texture_basisu") != tex.extensions.end()) {
 				auto ext = tex.extensions.find("KHR_texture_basisu");
 				auto value = ext->second.Get("source");
 				source = value.Get<int>();
-			}				
-			tinygltf::Image image = gltfModel.images[source];
+			}
+			return gltfModel.images[source];
+		};
+		// Textures referencing the same file or identical image data (with the same usage) share one uploaded image
+		auto getImageKey = [&](size_t textureIndex) {
+			const tinygltf::Image& image = getImage(gltfModel.textures[textureIndex]);
+			const uint32_t roles = textureRoles[textureIndex];
+			const bool isFile = !image.uri.empty() && (image.uri.compare(0, 5, "data:") != 0);
+			return isFile ? vks::TextureCache::identityKey(filePath + "/" + image.uri, roles) : vks::TextureCache::contentKey(image.image.data(), image.image.size(), image.width, image.height, image.component, roles);
+		};
+		vks::TextureCache imageCache;
+		for (size_t i = 0; i < textures.size(); i++) {
+			if ((textures[i].device != nullptr) && (textures[i].imageOwner < 0)) {
+				imageCache.insert(getImageKey(i), static_cast<uint32_t>(i));
+			}
+		}
+
+		for (size_t i = 0; i < textures.size(); i++) {
+			if ((textures[i].device != nullptr) || !requiredTextures[i]) {
+				continue;
+			}
+			tinygltf::Texture &tex = gltfModel.textures[i];
+			tinygltf::Image &image = getImage(tex);
 			vkglTF::TextureSampler textureSampler;
 			if (tex.sampler == -1) {
 				// No sampler specified, use a default one
@@ -1069,10 +2218,33 @@ namespace vkglTF
 			} else {
 				textureSampler = textureSamplers[tex.sampler];
 			}
+			const std::string imageKey = getImageKey(i);
+			uint32_t owner;
+			if (imageCache.find(imageKey, owner)) {
+				vkglTF::Texture texture = textures[owner];
+				texture.imageOwner = static_cast<int32_t>(owner);
+				texture.levelStream.reset();
+				texture.createSampler(textureSampler);
+				texture.updateDescriptor();
+				textures[i] = texture;
+				continue;
+			}
 			vkglTF::Texture texture;
-			texture.fromglTfImage(image, filePath, textureSampler, device, transferQueue);
-			textures.push_back(texture);
+			texture.fromglTfImage(image, filePath, textureSampler, device, transferQueue, textureRoles[i], mipGenerator, textureStreamer);
+			imageCache.insert(imageKey, static_cast<uint32_t>(i));
+			textures[i] = texture;
+			textureMemory += texture.memorySize;
+			// A full RGBA8 mip chain takes about 4/3 of the base level
+			rgba8TextureMemory += (VkDeviceSize)texture.width * texture.height * 4 * 4 / 3;
+		}
+		if (mipGenerator) {
+			mipGenerator->flush();
 		}
+		if (rgba8TextureMemory > 0) {
+			std::cout << "Texture memory: " << textureMemory / (1024.0 * 1024.0) << " MB (" << rgba8TextureMemory / (1024.0 * 1024.0) << " MB as RGBA8, " << (100.0 - 100.0 * (double)textureMemory / (double)rgba8TextureMemory) << "% saved)" << std::endl;
+		}
+		const auto loadedCount = std::count_if(textures.begin(), textures.end(), [](const Texture& texture) { return texture.device != nullptr; });
+		std::cout << "Textures: " << loadedCount << " of " << textures.size() << " loaded, unique images: " << std::count_if(textures.begin(), textures.end(), [](const Texture& texture) { return (texture.device != nullptr) && (texture.imageOwner < 0); }) << ", samplers in use: " << vks::SamplerCache::shared().size() << std::endl;
 	}
 
 	VkSamplerAddressMode Model::getVkWrapMode(int32_t wrapMode)
@@ -1128,15 +2300,22 @@ namespace vkglTF
 
 	void Model::loadMaterials(tinygltf::Model &gltfModel)
 	{
+		// Textures that haven't been loaded are left unbound, with lazy loading their materials aren't used by the active scene
+		auto getTexture = [this](int index) -> Texture* {
+			if ((index < 0) || (index >= static_cast<int>(textures.size())) || (textures[index].device == nullptr)) {
+				return nullptr;
+			}
+			return &textures[index];
+		};
 		for (tinygltf::Material &mat : gltfModel.materials) {
 			vkglTF::Material material{};
 			material.doubleSided = mat.doubleSided;
 			if (mat.values.find("baseColorTexture") != mat.values.end()) {
-				material.baseColorTexture = &textures[mat.values["baseColorTexture"].TextureIndex()];
+				material.baseColorTexture = getTexture(mat.values["baseColorTexture"].TextureIndex());
 				material.texCoordSets.baseColor = mat.values["baseColorTexture"].TextureTexCoord();
 			}
 			if (mat.values.find("metallicRoughnessTexture") != mat.values.end()) {
-				material.metallicRoughnessTexture = &textures[mat.values["metallicRoughnessTexture"].TextureIndex()];
+				material.metallicRoughnessTexture = getTexture(mat.values["metallicRoughnessTexture"].TextureIndex());
 				material.texCoordSets.metallicRoughness = mat.values["metallicRoughnessTexture"].TextureTexCoord();
 			}
 			if (mat.values.find("roughnessFactor") != mat.values.end()) {
@@ -1149,15 +2328,15 @@ namespace vkglTF
 				material.baseColorFactor = glm::make_vec4(mat.values["baseColorFactor"].ColorFactor().data());
 			}				
 			if (mat.additionalValues.find("normalTexture") != mat.additionalValues.end()) {
-				material.normalTexture = &textures[mat.additionalValues["normalTexture"].TextureIndex()];
+				material.normalTexture = getTexture(mat.additionalValues["normalTexture"].TextureIndex());
 				material.texCoordSets.normal = mat.additionalValues["normalTexture"].TextureTexCoord();
 			}
 			if (mat.additionalValues.find("emissiveTexture") != mat.additionalValues.end()) {
-				material.emissiveTexture = &textures[mat.additionalValues["emissiveTexture"].TextureIndex()];
+				material.emissiveTexture = getTexture(mat.additionalValues["emissiveTexture"].TextureIndex());
 				material.texCoordSets.emissive = mat.additionalValues["emissiveTexture"].TextureTexCoord();
 			}
 			if (mat.additionalValues.find("occlusionTexture") != mat.additionalValues.end()) {
-				material.occlusionTexture = &textures[mat.additionalValues["occlusionTexture"].TextureIndex()];
+				material.occlusionTexture = getTexture(mat.additionalValues["occlusionTexture"].TextureIndex());
 				material.texCoordSets.occlusion = mat.additionalValues["occlusionTexture"].TextureTexCoord();
 			}
 			if (mat.additionalValues.find("alphaMode") != mat.additionalValues.end()) {
@@ -1182,7 +2361,7 @@ namespace vkglTF
 				auto ext = mat.extensions.find("KHR_materials_pbrSpecularGlossiness");
 				if (ext->second.Has("specularGlossinessTexture")) {
 					auto index = ext->second.Get("specularGlossinessTexture").Get("index");
-					material.extension.specularGlossinessTexture = &textures[index.Get<int>()];
+					material.extension.specularGlossinessTexture = getTexture(index.Get<int>());
 					auto texCoordSet = ext->second.Get("specularGlossinessTexture").Get("texCoord");
 					material.texCoordSets.specularGlossiness = texCoordSet.Get<int>();
 					material.pbrWorkflows.specularGlossiness = true;
@@ -1190,7 +2369,7 @@ namespace vkglTF
 				}
 				if (ext->second.Has("diffuseTexture")) {
 					auto index = ext->second.Get("diffuseTexture").Get("index");
-					material.extension.diffuseTexture = &textures[index.Get<int>()];
+					material.extension.diffuseTexture = getTexture(index.Get<int>());
 				}
 				if (ext->second.Has("diffuseFactor")) {
 					auto factor = ext->second.Get("diffuseFactor");
@@ -1285,25 +2464,19 @@ namespace vkglTF
 					const void *dataPtr = &buffer.data[accessor.byteOffset + bufferView.byteOffset];
 
 					switch (accessor.type) {
-					case TINYGLTF_TYPE_VEC3: {
-						const glm::vec3 *buf = static_cast<const glm::vec3*>(dataPtr);
-						for (size_t index = 0; index < accessor.count; index++) {
-							sampler.outputsVec4.push_back(glm::vec4(buf[index], 0.0f));
-							sampler.outputs.push_back(buf[index][0]);
-							sampler.outputs.push_back(buf[index][1]);
-							sampler.outputs.push_back(buf[index][2]);
-						}
+					case TINYGLTF_TYPE_VEC3:
+					case TINYGLTF_TYPE_VEC4: {
+						sampler.stride = (accessor.type == TINYGLTF_TYPE_VEC3) ? 3 : 4;
+						sampler.outputs.resize(accessor.count * sampler.stride);
+						memcpy(sampler.outputs.data(), dataPtr, sampler.outputs.size() * sizeof(float));
 						break;
 					}
-					case TINYGLTF_TYPE_VEC4: {
-						const glm::vec4 *buf = static_cast<const glm::vec4*>(dataPtr);
-						for (size_t index = 0; index < accessor.count; index++) {
-							sampler.outputsVec4.push_back(buf[index]);
-							sampler.outputs.push_back(buf[index][0]);
-							sampler.outputs.push_back(buf[index][1]);
-							sampler.outputs.push_back(buf[index][2]);
-							sampler.outputs.push_back(buf[index][3]);
-						}
+					case TINYGLTF_TYPE_SCALAR: {
+						// Morph target weights, one value per target for each key
+						const size_t valuesPerKey = (sampler.interpolation == AnimationSampler::InterpolationType::CUBICSPLINE) ? 3 : 1;
+						sampler.stride = sampler.inputs.empty() ? 0 : static_cast<uint32_t>(accessor.count / (sampler.inputs.size() * valuesPerKey));
+						sampler.outputs.resize(accessor.count);
+						memcpy(sampler.outputs.data(), dataPtr, sampler.outputs.size() * sizeof(float));
 						break;
 					}
 					default: {
@@ -1330,25 +2503,33 @@ namespace vkglTF
 					channel.path = AnimationChannel::PathType::SCALE;
 				}
 				if (source.target_path == "weights") {
-					std::cout << "weights not yet supported, skipping channel" << std::endl;
-					continue;
+					channel.path = AnimationChannel::PathType::WEIGHTS;
 				}
 				channel.samplerIndex = source.sampler;
 				channel.node = nodeFromIndex(source.target_node);
 				if (!channel.node) {
 					continue;
 				}
+				if (channel.path == AnimationChannel::PathType::WEIGHTS) {
+					const AnimationSampler& sampler = animation.samplers[channel.samplerIndex];
+					if ((channel.node->morphWeightOffset < 0) || (channel.node->mesh->morphTargetCount != sampler.stride)) {
+						std::cout << "weights channel doesn't match the morph targets of node " << channel.node->name << ", skipping channel" << std::endl;
+						continue;
+					}
+				}
 
 				animation.channels.push_back(channel);
 			}
 
 			animations.push_back(animation);
 		}
+		compressAnimations();
 	}
 
 	void Model::loadFromFile(std::string filename, vks::VulkanDevice* device, VkQueue transferQueue, float scale)
 	{
-		tinygltf::Model gltfModel;
+		std::shared_ptr<tinygltf::Model> gltfModelPtr = std::make_shared<tinygltf::Model>();
+		tinygltf::Model& gltfModel = *gltfModelPtr;
 		tinygltf::TinyGLTF gltfContext;
 
 		std::string error;
@@ -1373,10 +2554,6 @@ namespace vkglTF
 
 		bool fileLoaded = binary ? gltfContext.LoadBinaryFromFile(&gltfModel, &error, &warning, filename.c_str()) : gltfContext.LoadASCIIFromFile(&gltfModel, &error, &warning, filename.c_str());
 
-		LoaderInfo loaderInfo{};
-		size_t vertexCount = 0;
-		size_t indexCount = 0;
-
 		if (fileLoaded) {
 			extensions = gltfModel.extensionsUsed;
 			for (auto& extension : extensions) {
@@ -1386,40 +2563,32 @@ namespace vkglTF
 					std::cout << "Model uses KHR_texture_basisu, initializing basisu transcoder\n";
 					basist::basisu_transcoder_init();
 				}
+				// Compressed buffer views and primitives need to be decoded before any mesh data is read
+				if (extension == "KHR_draco_mesh_compression") {
+					decodeDracoPrimitives(gltfModel);
+				}
+				if (extension == "EXT_meshopt_compression") {
+					if (!decodeMeshoptBufferViews(gltfModel)) {
+						std::cerr << "Could not decode EXT_meshopt_compression data, meshes may be corrupt" << std::endl;
+					}
+				}
 			}
 
 			loadTextureSamplers(gltfModel);
-			loadTextures(gltfModel, device, transferQueue);
-			loadMaterials(gltfModel);
-
-			const tinygltf::Scene& scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
-
-			// Get vertex and index buffer sizes up-front
-			for (size_t i = 0; i < scene.nodes.size(); i++) {
-				getNodeProps(gltfModel.nodes[scene.nodes[i]], gltfModel, vertexCount, indexCount);
-			}
-			loaderInfo.vertexBuffer = new Vertex[vertexCount];
-			loaderInfo.indexBuffer = new uint32_t[indexCount];
 
 			// TODO: scene handling with no default scene
-			for (size_t i = 0; i < scene.nodes.size(); i++) {
-				const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
-				loadNode(nullptr, node, scene.nodes[i], gltfModel, loaderInfo, scale);
-			}
-			if (gltfModel.animations.size() > 0) {
-				loadAnimations(gltfModel);
+			const uint32_t sceneIndex = (gltfModel.defaultScene > -1) ? static_cast<uint32_t>(gltfModel.defaultScene) : 0;
+			for (size_t i = 0; i < gltfModel.scenes.size(); i++) {
+				sceneNames.push_back(gltfModel.scenes[i].name.empty() ? "Scene " + std::to_string(i) : gltfModel.scenes[i].name);
 			}
-			loadSkins(gltfModel);
 
-			for (auto node : linearNodes) {
-				// Assign skins
-				if (node->skinIndex > -1) {
-					node->skin = skins[node->skinIndex];
-				}
-				// Initial pose
-				if (node->mesh) {
-					node->update();
-				}
+			loadTextures(gltfModel, device, transferQueue, getReachableTextures(gltfModel, sceneIndex));
+			loadMaterials(gltfModel);
+			loadSceneNodes(gltfModel, sceneIndex, transferQueue, scale);
+
+			if (lazyLoading) {
+				gltfSource = gltfModelPtr;
+				loadScale = scale;
 			}
 		}
 		else {
@@ -1427,6 +2596,63 @@ namespace vkglTF
 			std::cerr << "Could not load gltf file: " << error << std::endl;
 			return;
 		}
+	}
+
+	// Switches to another scene of the file, only works with lazy loading
+	// The node graph and vertex/index buffers are rebuilt, only textures that haven't been loaded for previous scenes are uploaded
+	// Materials are recreated, so descriptors and material buffers referencing them need to be recreated too
+	bool Model::loadScene(uint32_t sceneIndex, VkQueue transferQueue)
+	{
+		if (!gltfSource || (sceneIndex >= gltfSource->scenes.size())) {
+			return false;
+		}
+		if (static_cast<int32_t>(sceneIndex) == activeScene) {
+			return true;
+		}
+		destroySceneNodes(device->logicalDevice);
+		loadTextures(*gltfSource, device, transferQueue, getReachableTextures(*gltfSource, sceneIndex));
+		materials.resize(0);
+		loadMaterials(*gltfSource);
+		loadSceneNodes(*gltfSource, sceneIndex, transferQueue, loadScale);
+		return true;
+	}
+
+	void Model::loadSceneNodes(tinygltf::Model& gltfModel, uint32_t sceneIndex, VkQueue transferQueue, float scale)
+	{
+		LoaderInfo loaderInfo{};
+		size_t vertexCount = 0;
+		size_t indexCount = 0;
+
+		const tinygltf::Scene& scene = gltfModel.scenes[sceneIndex];
+		activeScene = static_cast<int32_t>(sceneIndex);
+
+		// Get vertex and index buffer sizes up-front
+		for (size_t i = 0; i < scene.nodes.size(); i++) {
+			getNodeProps(gltfModel.nodes[scene.nodes[i]], gltfModel, vertexCount, indexCount);
+		}
+		loaderInfo.vertexBuffer = new Vertex[vertexCount];
+		loaderInfo.indexBuffer = new uint32_t[indexCount];
+
+		for (size_t i = 0; i < scene.nodes.size(); i++) {
+			const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
+			loadNode(nullptr, node, scene.nodes[i], gltfModel, loaderInfo, scale);
+		}
+		if (gltfModel.animations.size() > 0) {
+			loadAnimations(gltfModel);
+		}
+		loadSkins(gltfModel);
+
+		// Assign skins
+		for (auto node : linearNodes) {
+			if (node->skinIndex > -1) {
+				node->skin = skins[node->skinIndex];
+			}
+		}
+		// Initial pose
+		buildTransforms();
+		allocateJointRanges();
+		buildAnimationLod();
+		updateTransforms(true);
 
 		size_t vertexBufferSize = vertexCount * sizeof(Vertex);
 		size_t indexBufferSize = indexCount * sizeof(uint32_t);
@@ -1461,7 +2687,8 @@ namespace vkglTF
 		// Create device local buffers
 		// Vertex buffer
 		VK_CHECK_RESULT(device->createBuffer(
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			// Skinned meshes can be read by the compute skinner
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			vertexBufferSize,
 			&vertices.buffer,
@@ -1572,6 +2799,101 @@ namespace vkglTF
 		aabb[3][2] = dimensions.min[2];
 	}
 
+	// Uploads KTX2 mip levels that finished transcoding in the background and picks up residency changes of the texture streamer
+	// Returns true if any texture's image view changed, descriptors referencing the textures then need to be updated
+	bool Model::updateTextureStreaming(VkQueue transferQueue)
+	{
+		bool levelsReady = false;
+		for (auto& texture : textures) {
+			if (texture.streamedLevelsReady()) {
+				levelsReady = true;
+				break;
+			}
+		}
+		bool changed = false;
+		if (levelsReady) {
+			// Image views get replaced, so they must not be used by any pending command buffer
+			vkQueueWaitIdle(transferQueue);
+			for (auto& texture : textures) {
+				texture.updateStreamedLevels(transferQueue);
+			}
+			changed = true;
+		}
+		// The streamer already waited for the images it replaced to be no longer in use
+		for (auto& texture : textures) {
+			if ((texture.streamSlot >= 0) && (texture.imageOwner < 0) && texture.updateStreamedResidency()) {
+				changed = true;
+			}
+		}
+		if (!changed) {
+			return false;
+		}
+		// Textures sharing a streamed image pick up the new view of its owner
+		for (auto& texture : textures) {
+			if (texture.imageOwner >= 0) {
+				const Texture& owner = textures[texture.imageOwner];
+				texture.image = owner.image;
+				texture.view = owner.view;
+				texture.residentMipLevel = owner.residentMipLevel;
+				texture.updateDescriptor();
+			}
+		}
+		return true;
+	}
+
+	// Calls func(i) for every i in [0, count), distributed over the pool in blocks of blockSize if one is set
+	// Results must not depend on the order of the calls, so they are the same for any number of threads
+	template <typename F>
+	static void parallelBlocks(vks::ThreadPool* pool, size_t count, size_t blockSize, F&& func)
+	{
+		const size_t blockCount = (count + blockSize - 1) / blockSize;
+		auto block = [&](size_t b) {
+			const size_t end = std::min(count, (b + 1) * blockSize);
+			for (size_t i = b * blockSize; i < end; i++) {
+				func(i);
+			}
+		};
+		if (pool && (blockCount > 1)) {
+			pool->parallelFor(blockCount, block);
+		} else {
+			for (size_t b = 0; b < blockCount; b++) {
+				block(b);
+			}
+		}
+	}
+
+	// Simplifies and quantizes linear and step samplers as set in animationCompression, rotation samplers are found from the channels using them
+	void Model::compressAnimations()
+	{
+		const bool simplify = animationCompression.tolerance >= 0.0f;
+		if (!simplify && !animationCompression.quantize) {
+			return;
+		}
+		size_t sizeBefore = 0;
+		size_t sizeAfter = 0;
+		for (auto& animation : animations) {
+			std::vector<bool> rotation(animation.samplers.size(), false);
+			for (auto& channel : animation.channels) {
+				rotation[channel.samplerIndex] = (channel.path == AnimationChannel::PathType::ROTATION);
+			}
+			for (auto& sampler : animation.samplers) {
+				sizeBefore += sampler.memorySize();
+			}
+			parallelBlocks(threadPool, animation.samplers.size(), 1, [&](size_t i) {
+				if (simplify) {
+					animation.samplers[i].simplify(animationCompression.tolerance, rotation[i]);
+				}
+				if (animationCompression.quantize) {
+					animation.samplers[i].quantize(rotation[i]);
+				}
+			});
+			for (auto& sampler : animation.samplers) {
+				sizeAfter += sampler.memorySize();
+			}
+		}
+		std::cout << "Animation keys compressed from " << sizeBefore / 1024 << " KB to " << sizeAfter / 1024 << " KB" << std::endl;
+	}
+
 	void Model::updateAnimation(uint32_t index, float time)
 	{
 		if (animations.empty()) {
@@ -1584,36 +2906,383 @@ namespace vkglTF
 		}
 		Animation &animation = animations[index];
 
+		// Keys are looked up once per sampler, as channels may share samplers
+		parallelBlocks(threadPool, animation.samplers.size(), 64, [&](size_t i) {
+			vkglTF::AnimationSampler &sampler = animation.samplers[i];
+			const size_t valuesPerKey = (sampler.interpolation == AnimationSampler::InterpolationType::CUBICSPLINE) ? 3 : 1;
+			sampler.active = (sampler.inputs.size() * valuesPerKey <= sampler.valueCount()) && sampler.findKey(time, sampler.activeKey);
+		});
+		// A node property is targeted by at most one channel of an animation, so channels can be evaluated independently
+		parallelBlocks(threadPool, animation.channels.size(), 64, [&](size_t i) {
+			vkglTF::AnimationChannel &channel = animation.channels[i];
+			vkglTF::AnimationSampler &sampler = animation.samplers[channel.samplerIndex];
+			if (!sampler.active || isLodSkipped(channel)) {
+				return;
+			}
+			switch (channel.path) {
+			case vkglTF::AnimationChannel::PathType::TRANSLATION:
+				sampler.translate(sampler.activeKey, time, channel.node);
+				break;
+			case vkglTF::AnimationChannel::PathType::SCALE:
+				sampler.scale(sampler.activeKey, time, channel.node);
+				break;
+			case vkglTF::AnimationChannel::PathType::ROTATION:
+				sampler.rotate(sampler.activeKey, time, channel.node);
+				break;
+			case vkglTF::AnimationChannel::PathType::WEIGHTS:
+				sampler.morphWeights(sampler.activeKey, time, &morphTargets.weights[channel.node->morphWeightOffset]);
+				break;
+			}
+		});
+
+		// Morph weights are uploaded by the compute skinner and don't affect transforms
 		bool updated = false;
+		animationLodStats.skippedChannels = 0;
 		for (auto& channel : animation.channels) {
-			vkglTF::AnimationSampler &sampler = animation.samplers[channel.samplerIndex];
-			if (sampler.inputs.size() > sampler.outputsVec4.size()) {
+			if (!animation.samplers[channel.samplerIndex].active) {
+				continue;
+			}
+			if (isLodSkipped(channel)) {
+				animationLodStats.skippedChannels++;
 				continue;
 			}
+			if (channel.path != vkglTF::AnimationChannel::PathType::WEIGHTS) {
+				transforms.markDirty(channel.node->transformIndex);
+				updated = true;
+			}
+		}
+		if (updated) {
+			updateTransforms();
+		}
+	}
 
-			for (size_t i = 0; i < sampler.inputs.size() - 1; i++) {
-				if ((time >= sampler.inputs[i]) && (time <= sampler.inputs[i + 1])) {
-					float u = std::max(0.0f, time - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
-					if (u <= 1.0f) {
-						switch (channel.path) {
-						case vkglTF::AnimationChannel::PathType::TRANSLATION:
-							sampler.translate(i, time, channel.node);
-							break;
-						case vkglTF::AnimationChannel::PathType::SCALE:
-							sampler.scale(i, time, channel.node);
-							break;
-						case vkglTF::AnimationChannel::PathType::ROTATION:
-							sampler.rotate(i, time, channel.node);
-							break;
-						}
-						updated = true;
+	// Flattens the node graph into the transform hierarchy, parents are added before their children
+	void Model::buildTransforms()
+	{
+		transforms.clear();
+		transformNodes.resize(0);
+		std::vector<Node*> stack(nodes.rbegin(), nodes.rend());
+		while (!stack.empty()) {
+			Node* node = stack.back();
+			stack.pop_back();
+			node->transforms = &transforms;
+			node->transformIndex = transforms.add(node->parent ? static_cast<int32_t>(node->parent->transformIndex) : -1);
+			transformNodes.push_back(node);
+			stack.insert(stack.end(), node->children.rbegin(), node->children.rend());
+		}
+	}
+
+	// Allocates a joint palette range for each skinned mesh, all joints of a skin are uploaded
+	void Model::allocateJointRanges()
+	{
+		for (auto node : transformNodes) {
+			if (!node->mesh || !node->skin) {
+				continue;
+			}
+			if (!jointPalette) {
+				std::cerr << "Skinned mesh without a joint palette, skinning is disabled" << std::endl;
+				continue;
+			}
+			Mesh* mesh = node->mesh;
+			const uint32_t jointCount = static_cast<uint32_t>(node->skin->joints.size());
+			mesh->jointRange = jointPalette->allocate(jointCount);
+			mesh->uniformBlock.jointOffset = jointPalette->getOffset(mesh->jointRange);
+			mesh->uniformBlock.jointCount = jointCount;
+			mesh->markDirty();
+		}
+	}
+
+	// Assigns joints to the skin whose pose is the only thing they affect, so the animation LOD can skip them
+	// Joints shared by several skins or with meshes or joints of other skins below them are always evaluated
+	void Model::buildAnimationLod()
+	{
+		std::vector<uint8_t> shared(transformNodes.size(), 0);
+		for (auto node : transformNodes) {
+			node->lodSkin = -1;
+			node->lodDepth = 0;
+		}
+		for (size_t s = 0; s < skins.size(); s++) {
+			skins[s]->lodLevel = Skin::LOD_FULL;
+			skins[s]->lodDue = true;
+			for (auto joint : skins[s]->joints) {
+				if ((joint->lodSkin > -1) && (joint->lodSkin != static_cast<int32_t>(s))) {
+					shared[joint->transformIndex] = 1;
+				}
+				joint->lodSkin = static_cast<int32_t>(s);
+			}
+		}
+		// Children are stored after their parents, so walking backwards visits a node's subtree before the node itself
+		std::vector<uint8_t> hasMesh(transformNodes.size(), 0);
+		for (size_t i = transformNodes.size(); i-- > 0;) {
+			Node* node = transformNodes[i];
+			if (shared[i]) {
+				node->lodSkin = -1;
+			}
+			if (node->mesh) {
+				node->mesh->jointsStale = false;
+				hasMesh[i] = 1;
+			}
+			if (!node->parent) {
+				continue;
+			}
+			const uint32_t parent = node->parent->transformIndex;
+			if ((node->lodSkin != node->parent->lodSkin) && (hasMesh[i] || (node->lodSkin > -1))) {
+				shared[parent] = 1;
+			}
+			hasMesh[parent] |= hasMesh[i];
+		}
+		// Root joints (depth 0) are always evaluated, so root motion keeps moving the bounds of skipped skins
+		for (auto node : transformNodes) {
+			if ((node->lodSkin > -1) && node->parent && (node->parent->lodSkin == node->lodSkin)) {
+				node->lodDepth = node->parent->lodDepth + 1;
+			}
+		}
+	}
+
+	// Fraction of the viewport covered by a box, negative if the box is outside of the view frustum
+	static float screenCoverage(const glm::mat4& viewProjection, const glm::vec3& min, const glm::vec3& max)
+	{
+		uint32_t outside[6] = {};
+		bool behindCamera = false;
+		glm::vec2 ndcMin(FLT_MAX);
+		glm::vec2 ndcMax(-FLT_MAX);
+		for (uint32_t i = 0; i < 8; i++) {
+			const glm::vec4 corner = viewProjection * glm::vec4((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z, 1.0f);
+			outside[0] += corner.x < -corner.w;
+			outside[1] += corner.x > corner.w;
+			outside[2] += corner.y < -corner.w;
+			outside[3] += corner.y > corner.w;
+			outside[4] += corner.z < 0.0f;
+			outside[5] += corner.z > corner.w;
+			if (corner.w <= 0.0f) {
+				behindCamera = true;
+				continue;
+			}
+			const glm::vec2 ndc = glm::vec2(corner) / corner.w;
+			ndcMin = glm::min(ndcMin, ndc);
+			ndcMax = glm::max(ndcMax, ndc);
+		}
+		for (uint32_t plane = 0; plane < 6; plane++) {
+			if (outside[plane] == 8) {
+				return -1.0f;
+			}
+		}
+		if (behindCamera) {
+			return 1.0f;
+		}
+		const glm::vec2 extent = (ndcMax - ndcMin) * 0.5f;
+		return std::max(extent.x, extent.y);
+	}
+
+	// Classifies skins by the screen coverage of their bounds, call before updateAnimation with the matrix the model is drawn with
+	// Bounds are taken from the last update, as joint positions and the bind pose bounds of the skin's meshes in model space
+	void Model::updateAnimationLod(const glm::mat4& viewProjection)
+	{
+		animationLodFrame++;
+		animationLodStats.fullSkins = 0;
+		animationLodStats.reducedSkins = 0;
+		animationLodStats.culledSkins = 0;
+		if (skins.empty()) {
+			return;
+		}
+		std::vector<glm::vec3> boundsMin(skins.size(), glm::vec3(FLT_MAX));
+		std::vector<glm::vec3> boundsMax(skins.size(), glm::vec3(-FLT_MAX));
+		if (animationLod.enabled) {
+			for (size_t s = 0; s < skins.size(); s++) {
+				for (auto joint : skins[s]->joints) {
+					const glm::vec3 position = glm::vec3(transforms.worldMatrices[joint->transformIndex][3]);
+					boundsMin[s] = glm::min(boundsMin[s], position);
+					boundsMax[s] = glm::max(boundsMax[s], position);
+				}
+			}
+			for (auto node : transformNodes) {
+				if (node->mesh && node->skin && (node->skinIndex > -1) && node->mesh->bb.valid) {
+					const BoundingBox bb = node->mesh->bb.getAABB(transforms.worldMatrices[node->transformIndex]);
+					boundsMin[node->skinIndex] = glm::min(boundsMin[node->skinIndex], bb.min);
+					boundsMax[node->skinIndex] = glm::max(boundsMax[node->skinIndex], bb.max);
+				}
+			}
+		}
+		const uint32_t interval = std::max(animationLod.reducedInterval, 1u);
+		for (size_t s = 0; s < skins.size(); s++) {
+			Skin* skin = skins[s];
+			skin->lodLevel = Skin::LOD_FULL;
+			if (animationLod.enabled && (boundsMin[s].x <= boundsMax[s].x)) {
+				const float coverage = screenCoverage(viewProjection, boundsMin[s], boundsMax[s]);
+				if (coverage < 0.0f) {
+					skin->lodLevel = Skin::LOD_CULLED;
+				} else if (coverage < animationLod.reducedScreenSize) {
+					skin->lodLevel = Skin::LOD_REDUCED;
+				}
+			}
+			// Reduced skins are spread over the frames of an interval
+			skin->lodDue = (skin->lodLevel != Skin::LOD_REDUCED) || ((animationLodFrame + s) % interval == 0);
+			switch (skin->lodLevel) {
+			case Skin::LOD_FULL:
+				animationLodStats.fullSkins++;
+				break;
+			case Skin::LOD_REDUCED:
+				animationLodStats.reducedSkins++;
+				break;
+			case Skin::LOD_CULLED:
+				animationLodStats.culledSkins++;
+				break;
+			}
+		}
+	}
+
+	// Channels targeting joints of culled skins, of reduced skins that aren't due or deeper than the reduced joint depth, and morph weights of culled or not due skinned meshes are skipped
+	bool Model::isLodSkipped(const AnimationChannel& channel) const
+	{
+		if (!animationLod.enabled) {
+			return false;
+		}
+		const Node* node = channel.node;
+		if (channel.path == AnimationChannel::PathType::WEIGHTS) {
+			return node->skin && ((node->skin->lodLevel == Skin::LOD_CULLED) || !node->skin->lodDue);
+		}
+		if ((node->lodSkin < 0) || (node->lodDepth == 0)) {
+			return false;
+		}
+		const Skin* skin = skins[node->lodSkin];
+		switch (skin->lodLevel) {
+		case Skin::LOD_CULLED:
+			return true;
+		case Skin::LOD_REDUCED:
+			return !skin->lodDue || ((animationLod.reducedJointDepth > 0) && (node->lodDepth > animationLod.reducedJointDepth));
+		default:
+			return false;
+		}
+	}
+
+	void Model::freeJointRanges()
+	{
+		for (auto node : transformNodes) {
+			if (node->mesh && (node->mesh->jointRange > -1)) {
+				jointPalette->free(node->mesh->jointRange);
+				node->mesh->jointRange = -1;
+			}
+		}
+	}
+
+	// Hands the vertex ranges of skinned and morphed meshes to the compute skinner, meshes it skins aren't skinned in the vertex shader anymore
+	// Meshes are packed into the skinner's target buffer in node order, primitives without indices are left to the vertex shader (and aren't morphed)
+	std::vector<vks::ComputeSkinner::Job> Model::prepareComputeDeformation(bool skinning, bool morphing)
+	{
+		std::vector<vks::ComputeSkinner::Job> jobs;
+		uint32_t targetVertex = 0;
+		for (auto node : transformNodes) {
+			Mesh* mesh = node->mesh;
+			if (!mesh || mesh->primitives.empty()) {
+				continue;
+			}
+			const bool skin = skinning && (mesh->jointRange > -1);
+			const bool morph = morphing && (node->morphWeightOffset > -1);
+			if (!skin && !morph) {
+				continue;
+			}
+			bool indexed = true;
+			for (auto primitive : mesh->primitives) {
+				indexed &= primitive->hasIndices;
+			}
+			if (!indexed) {
+				continue;
+			}
+			// Primitives of a mesh are loaded into one contiguous vertex range
+			vks::ComputeSkinner::Job job{};
+			job.firstVertex = mesh->primitives.front()->firstVertex;
+			job.vertexCount = mesh->primitives.back()->firstVertex + mesh->primitives.back()->vertexCount - job.firstVertex;
+			job.targetVertex = targetVertex;
+			job.skin = skin;
+			job.jointOffset = mesh->uniformBlock.jointOffset;
+			if (morph) {
+				job.morphTargetCount = mesh->morphTargetCount;
+				job.morphVertexOffset = mesh->morphVertexOffset;
+				job.morphWeightOffset = static_cast<uint32_t>(node->morphWeightOffset);
+			}
+			jobs.push_back(job);
+			mesh->computeDeformed = true;
+			mesh->deformedVertexOffset = static_cast<int32_t>(targetVertex) - static_cast<int32_t>(job.firstVertex);
+			// Morphed meshes skinned in the vertex shader are skinned from the morphed vertices
+			if (skin) {
+				mesh->uniformBlock.jointCount = 0;
+				mesh->markDirty();
+			}
+			targetVertex += job.vertexCount;
+		}
+		return jobs;
+	}
+
+	// Updates the world matrices of nodes with changed local transforms in one pass and uploads the matrices of meshes whose node or joints moved
+	// force recalculates and uploads everything, e.g. for the initial pose
+	void Model::updateTransforms(bool force)
+	{
+		parallelBlocks(threadPool, transformNodes.size(), 256, [&](size_t i) {
+			if (force || transforms.dirty[i]) {
+				transforms.setLocalMatrix(static_cast<uint32_t>(i), transformNodes[i]->localMatrix());
+			}
+		});
+		if (!transforms.update() && !force) {
+			return;
+		}
+		changedMeshNodes.resize(0);
+		for (size_t i = 0; i < transformNodes.size(); i++) {
+			Node* node = transformNodes[i];
+			if (!node->mesh) {
+				continue;
+			}
+			// Joints skipped while the skin was culled are recomputed once it is visible again
+			bool changed = force || transforms.changed[i] || (node->mesh->jointsStale && (node->skin->lodLevel != Skin::LOD_CULLED));
+			if (node->skin && !changed) {
+				for (auto joint : node->skin->joints) {
+					if (transforms.changed[joint->transformIndex]) {
+						changed = true;
+						break;
 					}
 				}
 			}
+			if (changed) {
+				changedMeshNodes.push_back(static_cast<uint32_t>(i));
+			}
 		}
-		if (updated) {
-			for (auto &node : nodes) {
-				node->update();
+		// Each mesh only writes its own uniform block, joint matrices of skinned meshes are computed in parallel
+		parallelBlocks(threadPool, changedMeshNodes.size(), 4, [&](size_t n) {
+			const uint32_t i = changedMeshNodes[n];
+			Node* node = transformNodes[i];
+			Mesh* mesh = node->mesh;
+			const glm::mat4& m = transforms.worldMatrices[i];
+			mesh->uniformBlock.matrix = m;
+			mesh->uniformBlock.normalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(m))));
+			if ((mesh->jointRange > -1) && (node->skin->lodLevel == Skin::LOD_CULLED) && !force) {
+				mesh->jointsStale = true;
+			} else if (mesh->jointRange > -1) {
+				// Update joint matrices, ranges of different meshes don't overlap
+				mesh->jointsStale = false;
+				glm::mat4 inverseTransform = glm::inverse(m);
+				glm::mat4* jointMatrices = &jointPalette->matrices[mesh->uniformBlock.jointOffset];
+				for (size_t j = 0; j < node->skin->joints.size(); j++) {
+					glm::mat4 jointMat;
+					vks::TransformHierarchy::multiply(transforms.worldMatrices[node->skin->joints[j]->transformIndex], node->skin->inverseBindMatrices[j], jointMat);
+					vks::TransformHierarchy::multiply(inverseTransform, jointMat, jointMatrices[j]);
+				}
+				if (vks::JointPalette::settings.dualQuaternions) {
+					glm::vec4* dualQuaternions = &jointPalette->dualQuaternions[mesh->uniformBlock.jointOffset * 2];
+					for (size_t j = 0; j < node->skin->joints.size(); j++) {
+						vks::JointPalette::encodeDualQuaternion(jointMatrices[j], &dualQuaternions[j * 2]);
+					}
+				}
+				jointPalette->markDirty(mesh->jointRange);
+			}
+			mesh->markDirty();
+		});
+	}
+
+	// Copies the uniform blocks of meshes that changed since this frame was last submitted
+	void Model::updateUniformBuffers(uint32_t frameIndex)
+	{
+		for (auto node : linearNodes) {
+			if (node->mesh) {
+				node->mesh->updateUniformBuffer(frameIndex);
 			}
 		}
 	}
@@ -13,9 +13,16 @@
 #include <string>
 #include <fstream>
 #include <vector>
+#include <memory>
 
 #include "vulkan/vulkan.h"
 #include "VulkanDevice.hpp"
+#include "MipGenerator.h"
+#include "TextureStreamer.h"
+#include "TransformHierarchy.h"
+#include "JointPalette.h"
+#include "ComputeSkinner.h"
+#include "ThreadPool.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -42,9 +49,6 @@
 
 #include "tiny_gltf.h"
 
-// Changing this value here also requires changing it in the vertex shader
-#define MAX_NUM_JOINTS 128u
-
 namespace vkglTF
 {
 	struct Node;
@@ -67,19 +71,41 @@ namespace vkglTF
 	};
 
 	struct Texture {
-		vks::VulkanDevice *device;
+		// How materials sample a texture, used to pick the smallest format that preserves the sampled channels
+		enum Role { ROLE_COLOR = 1, ROLE_NORMAL = 2, ROLE_OCCLUSION = 4, ROLE_METALLIC_ROUGHNESS = 8 };
+		// Null for textures that haven't been loaded (not reachable from the active scene with lazy loading)
+		vks::VulkanDevice *device = nullptr;
 		VkImage image;
 		VkImageLayout imageLayout;
 		VkDeviceMemory deviceMemory;
-		VkImageView view;
+		VkImageView view = VK_NULL_HANDLE;
 		uint32_t width, height;
 		uint32_t mipLevels;
 		uint32_t layerCount;
 		VkDescriptorImageInfo descriptor;
 		VkSampler sampler;
+		VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+		// Two channel formats store metallic/roughness in R/G, the view maps them back to G/B
+		VkComponentMapping components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+		VkDeviceSize memorySize = 0;
+		// KTX2 mip levels are transcoded in the background and streamed in smallest first
+		// Only levels starting at residentMipLevel are visible through the image view
+		struct LevelStream;
+		std::shared_ptr<LevelStream> levelStream;
+		uint32_t residentMipLevel = 0;
+		// Index of the texture in the same model that owns image, memory and view if they are shared (-1 if this texture owns them)
+		int32_t imageOwner = -1;
+		// Image, memory and view of streamed textures are owned by the streamer and change with the feedback of the material shaders
+		vks::TextureStreamer* streamer = nullptr;
+		int32_t streamSlot = -1;
 		void updateDescriptor();
 		void destroy();
-		void fromglTfImage(tinygltf::Image& gltfimage, std::string path, TextureSampler textureSampler, vks::VulkanDevice* device, VkQueue copyQueue);
+		void createView();
+		void createSampler(TextureSampler textureSampler);
+		void fromglTfImage(tinygltf::Image& gltfimage, std::string path, TextureSampler textureSampler, vks::VulkanDevice* device, VkQueue copyQueue, uint32_t roles = ROLE_COLOR, vks::MipGenerator* mipGenerator = nullptr, vks::TextureStreamer* streamer = nullptr);
+		bool streamedLevelsReady();
+		bool updateStreamedLevels(VkQueue copyQueue);
+		bool updateStreamedResidency();
 	};
 
 	struct Material {		
@@ -123,6 +149,7 @@ namespace vkglTF
 	struct Primitive {
 		uint32_t firstIndex;
 		uint32_t indexCount;
+		uint32_t firstVertex = 0;
 		uint32_t vertexCount;
 		Material &material;
 		bool hasIndices;
@@ -136,21 +163,42 @@ namespace vkglTF
 		std::vector<Primitive*> primitives;
 		BoundingBox bb;
 		BoundingBox aabb;
+		// Each frame in flight has its own copy of the uniform block in the buffer, with its own descriptor
 		struct UniformBuffer {
 			VkBuffer buffer;
 			VkDeviceMemory memory;
-			VkDescriptorBufferInfo descriptor;
-			VkDescriptorSet descriptorSet;
+			std::vector<VkDescriptorBufferInfo> descriptors;
+			std::vector<VkDescriptorSet> descriptorSets;
+			VkDeviceSize stride;
 			void *mapped;
+			// One bit per frame whose copy doesn't contain the current uniform block yet
+			uint32_t dirtyFrames;
 		} uniformBuffer;
 		struct UniformBlock {
 			glm::mat4 matrix;
-			glm::mat4 jointMatrix[MAX_NUM_JOINTS]{};
-			uint32_t jointcount{ 0 };
+			// Inverse transpose of matrix, so the vertex shader doesn't need to invert it per vertex
+			glm::mat4 normalMatrix;
+			// Range of the joint palette holding the skin's joint matrices, jointCount is 0 if the vertex shader doesn't need to skin the mesh
+			uint32_t jointOffset{ 0 };
+			uint32_t jointCount{ 0 };
 		} uniformBlock;
-		Mesh(vks::VulkanDevice* device, glm::mat4 matrix);
+		// Joint palette range allocated for skinned meshes, -1 if not skinned
+		int32_t jointRange = -1;
+		// Morph targets of the mesh, deltas are stored in the model's morphTargets starting at this offset
+		uint32_t morphTargetCount = 0;
+		uint32_t morphVertexOffset = 0;
+		// Joint matrices weren't recomputed while the mesh's skin was culled by the animation LOD
+		bool jointsStale = false;
+		// Set if the mesh is skinned and/or morphed by the compute skinner, its vertices are then drawn from the skinner's target buffer with this vertex offset
+		bool computeDeformed = false;
+		int32_t deformedVertexOffset = 0;
+		Mesh(vks::VulkanDevice* device, glm::mat4 matrix, uint32_t frameCount = 1);
 		~Mesh();
 		void setBoundingBox(glm::vec3 min, glm::vec3 max);
+		// Mark the uniform block as changed, the mesh's own animation job may call this while other frames are in flight
+		void markDirty() { uniformBuffer.dirtyFrames = (1u << uniformBuffer.descriptors.size()) - 1; }
+		// Copy the uniform block to a frame's part of the buffer if it changed, call after waiting for the frame's fence
+		void updateUniformBuffer(uint32_t frameIndex);
 	};
 
 	struct Skin {
@@ -158,6 +206,11 @@ namespace vkglTF
 		Node *skeletonRoot = nullptr;
 		std::vector<glm::mat4> inverseBindMatrices;
 		std::vector<Node*> joints;
+		// Animation level of detail, set by Model::updateAnimationLod from the skin's screen coverage
+		enum LodLevel { LOD_FULL, LOD_REDUCED, LOD_CULLED };
+		LodLevel lodLevel = LOD_FULL;
+		// Reduced skins are only evaluated on the frames this is set
+		bool lodDue = true;
 	};
 
 	struct Node {
@@ -174,17 +227,22 @@ namespace vkglTF
 		glm::quat rotation{};
 		BoundingBox bvh;
 		BoundingBox aabb;
-		bool useCachedMatrix{ false };
-		glm::mat4 cachedLocalMatrix{ glm::mat4(1.0f) };
-		glm::mat4 cachedMatrix{ glm::mat4(1.0f) };
+		// Slot of the node in the model's flattened transform hierarchy, which holds its world matrix
+		vks::TransformHierarchy* transforms = nullptr;
+		uint32_t transformIndex = 0;
+		// Start of the node's morph target weights in the model's morphTargets, -1 if its mesh has no morph targets
+		// Weights are animated per node, so every instance of a morphed mesh has its own range
+		int32_t morphWeightOffset = -1;
+		// Skin whose pose is the only thing this joint affects (-1 if it is shared or moves other nodes), and its depth below the skin's root joints
+		int32_t lodSkin = -1;
+		uint32_t lodDepth = 0;
 		glm::mat4 localMatrix();
 		glm::mat4 getMatrix();
-		void update();
 		~Node();
 	};
 
 	struct AnimationChannel {
-		enum PathType { TRANSLATION, ROTATION, SCALE };
+		enum PathType { TRANSLATION, ROTATION, SCALE, WEIGHTS };
 		PathType path;
 		Node *node;
 		uint32_t samplerIndex;
@@ -193,13 +251,35 @@ namespace vkglTF
 	struct AnimationSampler {
 		enum InterpolationType { LINEAR, STEP, CUBICSPLINE };
 		InterpolationType interpolation;
+		// How output values are stored, quantized samplers keep their values in quantized instead of outputs
+		enum OutputEncoding { FLOAT, RANGE, SMALLEST_THREE };
+		OutputEncoding encoding = FLOAT;
+		// Key times and tightly packed output values (stride floats per value, cubic spline keys store in tangent, value and out tangent)
 		std::vector<float> inputs;
-		std::vector<glm::vec4> outputsVec4;
 		std::vector<float> outputs;
-		glm::vec4 cubicSplineInterpolation(size_t index, float time, uint32_t stride);
+		uint32_t stride = 0;
+		// RANGE: stride 16 bit values per key, mapped to the component's range with rangeMin + value * rangeStep
+		// SMALLEST_THREE: three 16 bit values per key, holding the unit quaternion's three smallest components and the index of the largest one
+		std::vector<uint16_t> quantized;
+		std::vector<float> rangeMin;
+		std::vector<float> rangeStep;
+		// Keyframe interval of the last lookup, playback usually continues in the same or the next interval
+		size_t cursor = 0;
+		// Result of the lookup for the current animation update, shared by all channels using this sampler
+		bool active = false;
+		size_t activeKey = 0;
+		bool findKey(float time, size_t& index);
+		size_t valueCount() const;
+		float component(size_t index, uint32_t component) const;
+		glm::vec4 value(size_t index) const;
+		glm::vec4 cubicSplineInterpolation(size_t index, float time);
 		void translate(size_t index, float time, vkglTF::Node* node);
 		void scale(size_t index, float time, vkglTF::Node* node);
 		void rotate(size_t index, float time, vkglTF::Node* node);
+		void morphWeights(size_t index, float time, float* weights);
+		void simplify(float tolerance, bool rotation);
+		void quantize(bool rotation);
+		size_t memorySize() const;
 	};
 
 	struct Animation {
@@ -237,6 +317,19 @@ namespace vkglTF
 
 		std::vector<Node*> nodes;
 		std::vector<Node*> linearNodes;
+		// Nodes in the order of their slots in transforms (parents before their children)
+		std::vector<Node*> transformNodes;
+		vks::TransformHierarchy transforms;
+		// Joint matrices of skinned meshes are written to ranges of this palette, required for models with skins
+		vks::JointPalette* jointPalette = nullptr;
+		// Sparse deltas and current weights of all morphed meshes, blended by the compute skinner
+		vks::ComputeSkinner::MorphTargets morphTargets;
+		// Meshes of transformNodes that need new matrices uploaded after an update
+		std::vector<uint32_t> changedMeshNodes;
+		// Optional, animation channels and joint matrices are evaluated on this pool if set
+		vks::ThreadPool* threadPool = nullptr;
+		// Number of frames in flight, each one gets its own copy of the mesh uniform blocks
+		uint32_t frameCount = 1;
 
 		std::vector<Skin*> skins;
 
@@ -260,22 +353,80 @@ namespace vkglTF
 
 		std::string filePath;
 
+		// Optional, textures without mips in their source file get their mip chain generated with compute shaders if set
+		vks::MipGenerator* mipGenerator = nullptr;
+		// Optional, png and jpg textures are streamed based on shader feedback if set and streaming is enabled
+		vks::TextureStreamer* textureStreamer = nullptr;
+
+		// If set, only textures reachable from the selected scene's node graph are loaded
+		// The parsed file is kept, so other scenes can be selected later with loadScene, which only loads the textures that are missing
+		bool lazyLoading = false;
+		int32_t activeScene = -1;
+		std::vector<std::string> sceneNames;
+		std::shared_ptr<tinygltf::Model> gltfSource;
+		float loadScale = 1.0f;
+
+		// Load time compression of linear and step animation samplers
+		struct AnimationCompression {
+			// Keys that interpolating their remaining neighbours reproduces within this tolerance are removed, negative keeps all keys
+			float tolerance = -1.0f;
+			// Store rotations as smallest three quaternions and other values in 16 bit per component ranges
+			bool quantize = false;
+		} animationCompression;
+
+		// Animation level of detail for skinned meshes, joints are skipped based on the skin's bounds in the view
+		struct AnimationLod {
+			bool enabled = false;
+			// Skins covering less than this fraction of the viewport are updated at a reduced rate
+			float reducedScreenSize = 0.1f;
+			// Reduced skins are evaluated every n frames
+			uint32_t reducedInterval = 4;
+			// Joints of reduced skins deeper than this below the root joints are not evaluated, 0 evaluates all joints
+			uint32_t reducedJointDepth = 0;
+		} animationLod;
+		struct AnimationLodStats {
+			uint32_t fullSkins = 0;
+			uint32_t reducedSkins = 0;
+			uint32_t culledSkins = 0;
+			// Channels skipped by the last animation update
+			uint32_t skippedChannels = 0;
+		} animationLodStats;
+		uint32_t animationLodFrame = 0;
+
 		void destroy(VkDevice device);
+		void destroySceneNodes(VkDevice device);
 		void loadNode(vkglTF::Node* parent, const tinygltf::Node& node, uint32_t nodeIndex, const tinygltf::Model& model, LoaderInfo& loaderInfo, float globalscale);
 		void getNodeProps(const tinygltf::Node& node, const tinygltf::Model& model, size_t& vertexCount, size_t& indexCount);
 		void loadSkins(tinygltf::Model& gltfModel);
-		void loadTextures(tinygltf::Model& gltfModel, vks::VulkanDevice* device, VkQueue transferQueue);
+		bool decodeMeshoptBufferViews(tinygltf::Model& gltfModel);
+		void decodeDracoPrimitives(tinygltf::Model& gltfModel);
+		std::vector<uint32_t> getTextureRoles(const tinygltf::Model& gltfModel);
+		std::vector<bool> getReachableTextures(const tinygltf::Model& gltfModel, uint32_t sceneIndex);
+		void loadTextures(tinygltf::Model& gltfModel, vks::VulkanDevice* device, VkQueue transferQueue, const std::vector<bool>& requiredTextures);
 		VkSamplerAddressMode getVkWrapMode(int32_t wrapMode);
 		VkFilter getVkFilterMode(int32_t filterMode);
 		void loadTextureSamplers(tinygltf::Model& gltfModel);
 		void loadMaterials(tinygltf::Model& gltfModel);
 		void loadAnimations(tinygltf::Model& gltfModel);
+		void compressAnimations();
+		void loadSceneNodes(tinygltf::Model& gltfModel, uint32_t sceneIndex, VkQueue transferQueue, float scale);
 		void loadFromFile(std::string filename, vks::VulkanDevice* device, VkQueue transferQueue, float scale = 1.0f);
+		bool loadScene(uint32_t sceneIndex, VkQueue transferQueue);
 		void drawNode(Node* node, VkCommandBuffer commandBuffer);
 		void draw(VkCommandBuffer commandBuffer);
 		void calculateBoundingBox(Node* node, Node* parent);
 		void getSceneDimensions();
 		void updateAnimation(uint32_t index, float time);
+		void buildTransforms();
+		void allocateJointRanges();
+		void freeJointRanges();
+		void buildAnimationLod();
+		void updateAnimationLod(const glm::mat4& viewProjection);
+		bool isLodSkipped(const AnimationChannel& channel) const;
+		std::vector<vks::ComputeSkinner::Job> prepareComputeDeformation(bool skinning, bool morphing);
+		void updateTransforms(bool force = false);
+		void updateUniformBuffers(uint32_t frameIndex);
+		bool updateTextureStreaming(VkQueue transferQueue);
 		Node* findNode(Node* parent, uint32_t index);
 		Node* nodeFromIndex(uint32_t index);
 	};
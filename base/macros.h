@@ -8,6 +8,8 @@
 
 #pragma once
 
+#include <assert.h>
+#include <iostream>
 #include "vulkan/vulkan.h"
 
 #if defined(__ANDROID__)
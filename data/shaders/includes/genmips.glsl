@@ -0,0 +1,113 @@
+/* Copyright (c) 2018-2024, Sascha Willems
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+// Single pass mip generation: every workgroup reduces a 64x64 texel tile of the source level into up to six mip levels
+// IMAGE_FORMAT has to be defined to the storage image format qualifier before including this file
+
+#include "srgbtolinear.glsl"
+
+layout (local_size_x = 16, local_size_y = 16) in;
+
+layout (binding = 0, IMAGE_FORMAT) uniform readonly image2D sourceLevel;
+layout (binding = 1, IMAGE_FORMAT) uniform writeonly image2D levels[6];
+
+layout (push_constant) uniform PushConsts {
+	ivec2 sourceSize;
+	// Number of levels to generate (1 to 6)
+	int levelCount;
+	// Averages color channels in linear space for images storing sRGB encoded data in UNORM formats
+	int srgb;
+} pushConsts;
+
+shared vec4 tile[16][16];
+
+vec4 LINEARtoSRGB(vec4 linearIn)
+{
+	vec3 bLess = step(vec3(0.0031308), linearIn.xyz);
+	vec3 srgbOut = mix(linearIn.xyz * vec3(12.92), vec3(1.055) * pow(linearIn.xyz, vec3(1.0 / 2.4)) - vec3(0.055), bLess);
+	return vec4(srgbOut, linearIn.w);
+}
+
+// Size of the given output level, level 0 is the first level below the source level
+ivec2 levelSize(int level)
+{
+	return max(pushConsts.sourceSize >> (level + 1), ivec2(1));
+}
+
+vec4 loadSource(ivec2 pos)
+{
+	vec4 color = imageLoad(sourceLevel, min(pos, pushConsts.sourceSize - ivec2(1)));
+	return (pushConsts.srgb != 0) ? SRGBtoLINEAR(color) : color;
+}
+
+void storeLevel(int level, ivec2 pos, vec4 color)
+{
+	if ((level >= pushConsts.levelCount) || any(greaterThanEqual(pos, levelSize(level)))) {
+		return;
+	}
+	if (pushConsts.srgb != 0) {
+		color = LINEARtoSRGB(color);
+	}
+	// Constant indices, dynamic indexing of storage image arrays is an optional feature
+	switch (level) {
+		case 0: imageStore(levels[0], pos, color); break;
+		case 1: imageStore(levels[1], pos, color); break;
+		case 2: imageStore(levels[2], pos, color); break;
+		case 3: imageStore(levels[3], pos, color); break;
+		case 4: imageStore(levels[4], pos, color); break;
+		case 5: imageStore(levels[5], pos, color); break;
+	}
+}
+
+// Reads a texel of the previous level from shared memory, positions outside of that level are clamped to its edge
+vec4 loadTile(ivec2 pos, ivec2 tileOrigin, int level)
+{
+	ivec2 local = clamp(min(pos, levelSize(level) - ivec2(1)) - tileOrigin, ivec2(0), ivec2(15));
+	return tile[local.y][local.x];
+}
+
+void main()
+{
+	ivec2 group = ivec2(gl_WorkGroupID.xy);
+	ivec2 local = ivec2(gl_LocalInvocationID.xy);
+
+	// First level: every thread produces a 2x2 quad, each texel averaged from a 2x2 quad of the source level
+	vec4 quad[4];
+	for (int i = 0; i < 4; i++) {
+		ivec2 pos = group * 32 + local * 2 + ivec2(i & 1, i >> 1);
+		ivec2 src = min(pos, levelSize(0) - ivec2(1)) * 2;
+		quad[i] = 0.25 * (loadSource(src) + loadSource(src + ivec2(1, 0)) + loadSource(src + ivec2(0, 1)) + loadSource(src + ivec2(1, 1)));
+		storeLevel(0, pos, quad[i]);
+	}
+	if (pushConsts.levelCount < 2) {
+		return;
+	}
+
+	// Second level: one texel per thread
+	vec4 color = 0.25 * (quad[0] + quad[1] + quad[2] + quad[3]);
+	storeLevel(1, group * 16 + local, color);
+	tile[local.y][local.x] = color;
+
+	// Remaining levels are reduced in shared memory
+	int size = 8;
+	for (int level = 2; level < 6; level++) {
+		memoryBarrierShared();
+		barrier();
+		bool active = all(lessThan(local, ivec2(size)));
+		ivec2 tileOrigin = group * size * 2;
+		ivec2 pos = group * size + local;
+		if (active) {
+			color = 0.25 * (loadTile(pos * 2, tileOrigin, level - 1) + loadTile(pos * 2 + ivec2(1, 0), tileOrigin, level - 1) + loadTile(pos * 2 + ivec2(0, 1), tileOrigin, level - 1) + loadTile(pos * 2 + ivec2(1, 1), tileOrigin, level - 1));
+		}
+		memoryBarrierShared();
+		barrier();
+		if (active) {
+			tile[local.y][local.x] = color;
+			storeLevel(level, pos, color);
+		}
+		size >>= 1;
+	}
+}
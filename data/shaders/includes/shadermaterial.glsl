@@ -20,4 +20,15 @@ struct ShaderMaterial {
 	float alphaMask;	
 	float alphaMaskCutoff;
 	float emissiveStrength;
+	// Texture streaming feedback slots, -1 if a texture isn't streamed
+	int baseColorTextureFeedback;
+	int physicalDescriptorTextureFeedback;
+	int normalTextureFeedback;
+	int occlusionTextureFeedback;
+	int emissiveTextureFeedback;
+	// Metallic can come from its own texture (USD), the channels select the components roughness and metallic are read from
+	int metallicTextureSet;
+	int roughnessChannel;
+	int metallicChannel;
+	int metallicTextureFeedback;
 };
\ No newline at end of file
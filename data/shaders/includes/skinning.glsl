@@ -0,0 +1,53 @@
+/* Copyright (c) 2018-2024, Sascha Willems
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+// Joint palette access and skinning of a vertex by up to four joints
+// The including shader declares the palette as a vec4 jointData[] buffer, joints take up four vec4 (matrix) or two vec4 (real and dual part of a dual quaternion)
+
+layout (constant_id = 0) const bool DUAL_QUATERNION_SKINNING = false;
+
+mat4 jointMatrix(uint joint)
+{
+	uint i = joint * 4;
+	return mat4(jointData[i], jointData[i + 1], jointData[i + 2], jointData[i + 3]);
+}
+
+// Rotate v by a unit quaternion
+vec3 rotate(vec4 q, vec3 v)
+{
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+// Joint transforms are rigid (or uniformly scaled), so normals are transformed without an inverse transpose
+void skinVertex(uvec4 joints, vec4 weights, inout vec3 position, inout vec3 normal)
+{
+	if (DUAL_QUATERNION_SKINNING) {
+		// Blend in the hemisphere of the first joint, so rotations take the shortest path
+		vec4 firstReal = jointData[joints.x * 2];
+		vec4 real = vec4(0.0);
+		vec4 dual = vec4(0.0);
+		for (int i = 0; i < 4; i++) {
+			vec4 jointReal = jointData[joints[i] * 2];
+			float weight = (dot(firstReal, jointReal) < 0.0) ? -weights[i] : weights[i];
+			real += weight * jointReal;
+			dual += weight * jointData[joints[i] * 2 + 1];
+		}
+		float len = length(real);
+		real /= len;
+		dual /= len;
+		vec3 translation = 2.0 * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+		position = rotate(real, position) + translation;
+		normal = rotate(real, normal);
+	} else {
+		mat4 skinMat =
+			weights.x * jointMatrix(joints.x) +
+			weights.y * jointMatrix(joints.y) +
+			weights.z * jointMatrix(joints.z) +
+			weights.w * jointMatrix(joints.w);
+		position = (skinMat * vec4(position, 1.0)).xyz;
+		normal = mat3(skinMat) * normal;
+	}
+}
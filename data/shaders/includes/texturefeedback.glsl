@@ -0,0 +1,30 @@
+/* Copyright (c) 2018-2024, Sascha Willems
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+// Feedback for texture streaming, stores the finest mip level sampled for each streamed texture
+// Levels are relative to the first resident level and biased, so requests for levels that aren't resident yet can be stored
+// Only one pixel of each 4x4 block writes feedback to keep the number of atomics low
+// The write is disabled with a specialization constant on devices without fragmentStoresAndAtomics
+
+layout (constant_id = 0) const bool TEXTURE_FEEDBACK = false;
+
+layout (std430, set = 0, binding = 5) buffer TextureFeedback {
+	uint textureFeedback[];
+};
+
+const float TEXTURE_FEEDBACK_BIAS = 16.0;
+
+// Must be called from (dynamically) uniform control flow and before any discard, as the level of detail depends on derivatives
+void writeTextureFeedback(sampler2D textureMap, int slot, int textureSet)
+{
+	if (!TEXTURE_FEEDBACK || (slot < 0) || (textureSet < 0)) {
+		return;
+	}
+	float lod = textureQueryLod(textureMap, textureSet == 0 ? inUV0 : inUV1).y;
+	if (((int(gl_FragCoord.x) | int(gl_FragCoord.y)) & 3) == 0) {
+		atomicMin(textureFeedback[slot], uint(clamp(floor(lod) + TEXTURE_FEEDBACK_BIAS, 0.0, 31.0)));
+	}
+}
@@ -49,6 +49,7 @@ layout (set = 1, binding = 1) uniform sampler2D physicalDescriptorMap;
 layout (set = 1, binding = 2) uniform sampler2D normalMap;
 layout (set = 1, binding = 3) uniform sampler2D aoMap;
 layout (set = 1, binding = 4) uniform sampler2D emissiveMap;
+layout (set = 1, binding = 5) uniform sampler2D metallicMap;
 
 // Properties
 
@@ -65,6 +66,8 @@ layout (push_constant) uniform PushConstants {
 
 layout (location = 0) out vec4 outColor;
 
+#include "includes/texturefeedback.glsl"
+
 // Encapsulate the various inputs used by the various functions in the shading equation
 // We store values in this struct to simplify the integration of alternative implementations
 // of the shading terms, outlined in the Readme.MD Appendix.
@@ -98,7 +101,10 @@ const float PBR_WORKFLOW_SPECULAR_GLOSSINESS = 1.0;
 vec3 getNormal(ShaderMaterial material)
 {
 	// Perturb normal, see http://www.thetenthplanet.de/archives/1180
-	vec3 tangentNormal = texture(normalMap, material.normalTextureSet == 0 ? inUV0 : inUV1).xyz * 2.0 - 1.0;
+	// Only x and y are sampled, z is reconstructed so two channel (BC5, RG8) normal maps work as well
+	vec3 tangentNormal;
+	tangentNormal.xy = texture(normalMap, material.normalTextureSet == 0 ? inUV0 : inUV1).xy * 2.0 - 1.0;
+	tangentNormal.z = sqrt(clamp(1.0 - dot(tangentNormal.xy, tangentNormal.xy), 0.0, 1.0));
 
 	vec3 q1 = dFdx(inWorldPos);
 	vec3 q2 = dFdy(inWorldPos);
@@ -194,6 +200,13 @@ void main()
 {
 	ShaderMaterial material = materials[pushConstants.materialIndex];
 
+	writeTextureFeedback(colorMap, material.baseColorTextureFeedback, material.baseColorTextureSet);
+	writeTextureFeedback(physicalDescriptorMap, material.physicalDescriptorTextureFeedback, material.physicalDescriptorTextureSet);
+	writeTextureFeedback(normalMap, material.normalTextureFeedback, material.normalTextureSet);
+	writeTextureFeedback(aoMap, material.occlusionTextureFeedback, material.occlusionTextureSet);
+	writeTextureFeedback(emissiveMap, material.emissiveTextureFeedback, material.emissiveTextureSet);
+	writeTextureFeedback(metallicMap, material.metallicTextureFeedback, material.metallicTextureSet);
+
 	float perceptualRoughness;
 	float metallic;
 	vec3 diffuseColor;
@@ -218,14 +231,17 @@ void main()
 		// or from a metallic-roughness map
 		perceptualRoughness = material.roughnessFactor;
 		metallic = material.metallicFactor;
+		// In glTF, roughness is stored in the 'g' channel and metallic in the 'b' channel of the same map.
+		// This layout intentionally reserves the 'r' channel for (optional) occlusion map data
+		// USD materials bind separate roughness and metallic maps instead, so the channels are selected per material
 		if (material.physicalDescriptorTextureSet > -1) {
-			// Roughness is stored in the 'g' channel, metallic is stored in the 'b' channel.
-			// This layout intentionally reserves the 'r' channel for (optional) occlusion map data
-			vec4 mrSample = texture(physicalDescriptorMap, material.physicalDescriptorTextureSet == 0 ? inUV0 : inUV1);
-			perceptualRoughness = mrSample.g * perceptualRoughness;
-			metallic = mrSample.b * metallic;
+			perceptualRoughness = texture(physicalDescriptorMap, material.physicalDescriptorTextureSet == 0 ? inUV0 : inUV1)[material.roughnessChannel] * perceptualRoughness;
 		} else {
 			perceptualRoughness = clamp(perceptualRoughness, c_MinRoughness, 1.0);
+		}
+		if (material.metallicTextureSet > -1) {
+			metallic = texture(metallicMap, material.metallicTextureSet == 0 ? inUV0 : inUV1)[material.metallicChannel] * metallic;
+		} else {
 			metallic = clamp(metallic, 0.0, 1.0);
 		}
 		// Roughness is authored as perceptual roughness; as is convention,
@@ -61,12 +61,16 @@ layout (push_constant) uniform PushConstants {
 
 layout (location = 0) out vec4 outColor;
 
+#include "includes/texturefeedback.glsl"
+
 #include "includes/srgbtolinear.glsl"
 
 void main()
 {
 	ShaderMaterial material = materials[pushConstants.materialIndex];
 
+	writeTextureFeedback(colorMap, material.baseColorTextureFeedback, material.baseColorTextureSet);
+
 	float perceptualRoughness;
 	float metallic;
 	vec3 diffuseColor;
@@ -6,6 +6,8 @@
 
 #version 450
 
+#extension GL_GOOGLE_include_directive : require
+
 layout (location = 0) in vec3 inPos;
 layout (location = 1) in vec3 inNormal;
 layout (location = 2) in vec2 inUV0;
@@ -22,11 +24,18 @@ layout (set = 0, binding = 0) uniform UBO
 	vec3 camPos;
 } ubo;
 
-#define MAX_NUM_JOINTS 128
+// Joints of all skinned meshes, each mesh references its range
+layout (set = 0, binding = 6) readonly buffer JointPalette {
+	vec4 jointData[];
+};
+
+#include "includes/skinning.glsl"
 
 layout (set = 2, binding = 0) uniform UBONode {
 	mat4 matrix;
-	mat4 jointMatrix[MAX_NUM_JOINTS];
+	// Inverse transpose of the node's matrix, calculated on the CPU with the node's transform
+	mat4 normalMatrix;
+	uint jointOffset;
 	uint jointCount;
 } node;
 
@@ -40,21 +49,15 @@ void main()
 {
 	outColor0 = inColor0;
 
-	vec4 locPos;
+	vec3 pos = inPos;
+	vec3 normal = inNormal;
 	if (node.jointCount > 0) {
 		// Mesh is skinned
-		mat4 skinMat = 
-			inWeight0.x * node.jointMatrix[inJoint0.x] +
-			inWeight0.y * node.jointMatrix[inJoint0.y] +
-			inWeight0.z * node.jointMatrix[inJoint0.z] +
-			inWeight0.w * node.jointMatrix[inJoint0.w];
-
-		locPos = ubo.model * node.matrix * skinMat * vec4(inPos, 1.0);
-		outNormal = normalize(transpose(inverse(mat3(ubo.model * node.matrix * skinMat))) * inNormal);
-	} else {
-		locPos = ubo.model * node.matrix * vec4(inPos, 1.0);
-		outNormal = normalize(transpose(inverse(mat3(ubo.model * node.matrix))) * inNormal);
+		skinVertex(inJoint0 + node.jointOffset, inWeight0, pos, normal);
 	}
+	// The scene's model matrix only applies a uniform scale, which doesn't change the normal's direction
+	vec4 locPos = ubo.model * node.matrix * vec4(pos, 1.0);
+	outNormal = normalize(mat3(node.normalMatrix) * normal);
 	locPos.y = -locPos.y;
 	outWorldPos = locPos.xyz / locPos.w;
 	outUV0 = inUV0;
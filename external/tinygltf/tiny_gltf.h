@@ -4077,6 +4077,27 @@ static bool ParseBuffer(Buffer *buffer, std::string *err, const json &o,
   buffer->uri.clear();
   ParseStringProperty(&buffer->uri, err, o, "uri", false, "Buffer");
 
+  // EXT_meshopt_compression fallback buffers have no uri and no data.
+  // Allocate zero-filled storage so the application can decode compressed
+  // bufferViews into it.
+  if (buffer->uri.empty()) {
+    json_const_iterator extIt;
+    json_const_iterator meshoptIt;
+    if (FindMember(o, "extensions", extIt) &&
+        FindMember(GetValue(extIt), "EXT_meshopt_compression", meshoptIt)) {
+      bool fallback = false;
+      ParseBooleanProperty(&fallback, nullptr, GetValue(meshoptIt), "fallback",
+                           false);
+      if (fallback) {
+        buffer->data.resize(byteLength, 0);
+        ParseStringProperty(&buffer->name, err, o, "name", false);
+        ParseExtensionsProperty(&buffer->extensions, err, o);
+        ParseExtrasProperty(&buffer->extras, o);
+        return true;
+      }
+    }
+  }
+
   // having an empty uri for a non embedded image should not be valid
   if (!is_binary && buffer->uri.empty()) {
     if (err) {
@@ -4678,13 +4699,15 @@ static bool ParsePrimitive(Primitive *primitive, Model *model, std::string *err,
     }
   }
 
-#ifdef TINYGLTF_ENABLE_DRACO
+#if defined(TINYGLTF_ENABLE_DRACO) && !defined(TINYGLTF_DEFER_DRACO_DECODE)
   auto dracoExtension =
       primitive->extensions.find("KHR_draco_mesh_compression");
   if (dracoExtension != primitive->extensions.end()) {
     ParseDracoExtension(primitive, model, err, dracoExtension->second);
   }
 #else
+  // With TINYGLTF_DEFER_DRACO_DECODE the extension is kept on the primitive
+  // and decoding is left to the application
   (void)model;
 #endif
 
@@ -24,6 +24,12 @@
 #include "VulkanTexture.hpp"
 #include "VulkanglTFModel.h"
 #include "VulkanUSDZModel.h"
+#include "TextureCompressor.h"
+#include "MipGenerator.h"
+#include "TextureStreamer.h"
+#include "JointPalette.h"
+#include "ComputeSkinner.h"
+#include "ThreadPool.hpp"
 #include "VulkanUtils.hpp"
 #include "ui.hpp"
 
@@ -56,6 +62,11 @@ public:
 		vkglTF::Model skybox;
 	} models;
 
+	vks::MipGenerator mipGenerator;
+	vks::TextureStreamer textureStreamer;
+	vks::JointPalette jointPalette;
+	vks::ComputeSkinner computeSkinner;
+
 	struct UniformBufferSet {
 		Buffer scene;
 		Buffer skybox;
@@ -83,6 +94,7 @@ public:
 
 	std::unordered_map<std::string, VkPipeline> pipelines;
 	VkPipeline boundPipeline{ VK_NULL_HANDLE };
+	VkBuffer boundVertexBuffer{ VK_NULL_HANDLE };
 
 	struct DescriptorSetLayouts {
 		VkDescriptorSetLayout scene{ VK_NULL_HANDLE };
@@ -110,6 +122,10 @@ public:
 	int32_t animationIndex = 0;
 	float animationTimer = 0.0f;
 	bool animate = true;
+	// Runs the per frame animation update, so it never queues behind loading jobs (e.g. texture level transcodes) of the shared pool
+	vks::ThreadPool animationThread{ 1 };
+
+	int32_t deferredPrimIndex = 0;
 
 	bool displayBackground = true;
 	
@@ -145,6 +161,15 @@ public:
 		float alphaMask;
 		float alphaMaskCutoff;
 		float emissiveStrength;
+		int baseColorTextureFeedback;
+		int physicalDescriptorTextureFeedback;
+		int normalTextureFeedback;
+		int occlusionTextureFeedback;
+		int emissiveTextureFeedback;
+		int metallicTextureSet;
+		int roughnessChannel;
+		int metallicChannel;
+		int metallicTextureFeedback;
 	};
 	Buffer shaderMaterialBuffer;
 	VkDescriptorSet descriptorSetMaterials{ VK_NULL_HANDLE };
@@ -166,7 +191,8 @@ public:
 		"KHR_texture_basisu",
 		"KHR_materials_pbrSpecularGlossiness",
 		"KHR_materials_unlit",
-		"KHR_materials_emissive_strength"
+		"KHR_materials_emissive_strength",
+		"EXT_meshopt_compression"
 	};
 
 	VulkanApplication() : VulkanExampleBase()
@@ -194,6 +220,10 @@ public:
 			models.scene.destroy(device);
 		}
 		models.skybox.destroy(device);
+		mipGenerator.destroy();
+		textureStreamer.destroy();
+		computeSkinner.destroy();
+		jointPalette.destroy();
 
 		for (auto buffer : uniformBuffers) {
 			buffer.params.destroy();
@@ -257,7 +287,7 @@ public:
 					const std::vector<VkDescriptorSet> descriptorsets = {
 						descriptorSets[cbIndex].scene,
 						primitive->material.descriptorSet,
-						node->mesh->uniformBuffer.descriptorSet,
+						node->mesh->uniformBuffer.descriptorSets[cbIndex],
 						descriptorSetMaterials
 					};
 					vkCmdBindDescriptorSets(commandBuffers[cbIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, static_cast<uint32_t>(descriptorsets.size()), descriptorsets.data(), 0, NULL);
@@ -281,6 +311,13 @@ public:
 
 	void renderNode(vkglTF::Node *node, uint32_t cbIndex, vkglTF::Material::AlphaMode alphaMode) {
 		if (node->mesh) {
+			// Meshes skinned or morphed by the compute pre-pass are drawn from the skinner's target buffer
+			const VkBuffer vertexBuffer = node->mesh->computeDeformed ? computeSkinner.getTargetBuffer(cbIndex) : models.scene.vertices.buffer;
+			if (vertexBuffer != boundVertexBuffer) {
+				const VkDeviceSize offsets[1] = { 0 };
+				vkCmdBindVertexBuffers(commandBuffers[cbIndex], 0, 1, &vertexBuffer, offsets);
+				boundVertexBuffer = vertexBuffer;
+			}
 			// Render mesh primitives
 			for (vkglTF::Primitive * primitive : node->mesh->primitives) {
 				if (primitive->material.alphaMode == alphaMode) {
@@ -311,7 +348,7 @@ public:
 					const std::vector<VkDescriptorSet> descriptorsets = {
 						descriptorSets[cbIndex].scene,
 						primitive->material.descriptorSet,
-						node->mesh->uniformBuffer.descriptorSet,
+						node->mesh->uniformBuffer.descriptorSets[cbIndex],
 						descriptorSetMaterials
 					};
 					vkCmdBindDescriptorSets(commandBuffers[cbIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, static_cast<uint32_t>(descriptorsets.size()), descriptorsets.data(), 0, NULL);
@@ -320,7 +357,7 @@ public:
 					vkCmdPushConstants(commandBuffers[cbIndex], pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(uint32_t), &primitive->material.index);
 
 					if (primitive->hasIndices) {
-						vkCmdDrawIndexed(commandBuffers[cbIndex], primitive->indexCount, 1, primitive->firstIndex, 0, 0);
+						vkCmdDrawIndexed(commandBuffers[cbIndex], primitive->indexCount, 1, primitive->firstIndex, node->mesh->deformedVertexOffset, 0);
 					} else {
 						vkCmdDraw(commandBuffers[cbIndex], primitive->vertexCount, 1, 0, 0);
 					}
@@ -448,6 +485,8 @@ public:
 		VkCommandBuffer currentCB = commandBuffers[currentFrame];
 
 		VK_CHECK_RESULT(vkBeginCommandBuffer(currentCB, &cmdBufferBeginInfo));
+		// Skinned meshes are skinned once into vertex buffers that all following draws read from
+		computeSkinner.record(currentCB, currentFrame);
 		vkCmdBeginRenderPass(currentCB, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 		VkViewport viewport{};
@@ -477,6 +516,7 @@ public:
 		}
 
 		boundPipeline = VK_NULL_HANDLE;
+		boundVertexBuffer = model.vertices.buffer;
 
 		// Opaque primitives first
 		for (auto node : model.nodes) {
@@ -518,6 +558,9 @@ public:
 			shaderMaterial.alphaMask = static_cast<float>(material.alphaMode == vkglTF::Material::ALPHAMODE_MASK);
 			shaderMaterial.alphaMaskCutoff = material.alphaCutoff;
 			shaderMaterial.emissiveStrength = material.emissiveStrength;
+			shaderMaterial.metallicTextureSet = -1;
+			shaderMaterial.roughnessChannel = 1;
+			shaderMaterial.metallicChannel = 2;
 
 			if (material.pbrWorkflows.metallicRoughness) {
 				// Metallic roughness workflow
@@ -526,6 +569,8 @@ public:
 				shaderMaterial.metallicFactor = material.metallicFactor;
 				shaderMaterial.roughnessFactor = material.roughnessFactor;
 				shaderMaterial.PhysicalDescriptorTextureSet = material.metallicRoughnessTexture != nullptr ? material.texCoordSets.metallicRoughness : -1;
+				// glTF packs metallic into the same texture, which is also bound as the metallic map
+				shaderMaterial.metallicTextureSet = shaderMaterial.PhysicalDescriptorTextureSet;
 				shaderMaterial.colorTextureSet = material.baseColorTexture != nullptr ? material.texCoordSets.baseColor : -1;
 			} else {
 				if (material.pbrWorkflows.specularGlossiness) {
@@ -537,6 +582,7 @@ public:
 					shaderMaterial.specularFactor = glm::vec4(material.extension.specularFactor, 1.0f);
 				}
 			}
+			setTextureFeedbackSlots(material, shaderMaterial);
 
 			shaderMaterials.push_back(shaderMaterial);
 		}
@@ -581,16 +627,20 @@ public:
 			shaderMaterial.alphaMask = static_cast<float>(material.alphaMode == vkUSDZ::Material::ALPHAMODE_MASK);
 			shaderMaterial.alphaMaskCutoff = material.alphaCutoff;
 			shaderMaterial.emissiveStrength = material.emissiveStrength;
+			shaderMaterial.metallicTextureSet = -1;
+			shaderMaterial.roughnessChannel = material.roughnessChannel;
+			shaderMaterial.metallicChannel = material.metallicChannel;
 
 			// TODO: glTF specs states that metallic roughness should be preferred, even if specular glosiness is present
 
 			if (material.pbrWorkflows.metallicRoughness) {
-				// Metallic roughness workflow
+				// Metallic roughness workflow, roughness and metallic are separate textures
 				shaderMaterial.workflow = static_cast<float>(PBR_WORKFLOW_METALLIC_ROUGHNESS);
 				shaderMaterial.baseColorFactor = material.baseColorFactor;
 				shaderMaterial.metallicFactor = material.metallicFactor;
 				shaderMaterial.roughnessFactor = material.roughnessFactor;
 				shaderMaterial.PhysicalDescriptorTextureSet = material.metallicRoughnessTexture != nullptr ? material.texCoordSets.metallicRoughness : -1;
+				shaderMaterial.metallicTextureSet = material.metallicTexture != nullptr ? material.texCoordSets.metallic : -1;
 				shaderMaterial.colorTextureSet = material.baseColorTexture != nullptr ? material.texCoordSets.baseColor : -1;
 			}
 
@@ -602,6 +652,7 @@ public:
 				shaderMaterial.diffuseFactor = material.extension.diffuseFactor;
 				shaderMaterial.specularFactor = glm::vec4(material.extension.specularFactor, 1.0f);
 			}
+			setTextureFeedbackSlots(material, shaderMaterial);
 
 			shaderMaterials.push_back(shaderMaterial);
 		}
@@ -680,6 +731,166 @@ public:
 		generateCubemaps();
 	}
 
+	// Measures keyframe sampling throughput of synthetic glTF animations for different channel and key counts
+	void benchmarkAnimation()
+	{
+		const float keyInterval = 1.0f / 30.0f;
+		const uint32_t channelCounts[] = { 64, 1024 };
+		const uint32_t keyCounts[] = { 100, 10000, 100000 };
+		std::cout << "Animation sampling benchmark (ns per channel update)" << std::endl;
+		for (uint32_t channelCount : channelCounts) {
+			for (uint32_t keyCount : keyCounts) {
+				vkglTF::Model model;
+				vkglTF::Animation animation{};
+				animation.start = 0.0f;
+				animation.end = (keyCount - 1) * keyInterval;
+				for (uint32_t c = 0; c < channelCount; c++) {
+					vkglTF::Node* node = new vkglTF::Node{};
+					node->index = c;
+					model.nodes.push_back(node);
+					model.linearNodes.push_back(node);
+
+					vkglTF::AnimationChannel channel{};
+					channel.path = static_cast<vkglTF::AnimationChannel::PathType>(c % 3);
+					channel.node = node;
+					channel.samplerIndex = c;
+					animation.channels.push_back(channel);
+
+					vkglTF::AnimationSampler sampler{};
+					sampler.interpolation = vkglTF::AnimationSampler::InterpolationType::LINEAR;
+					sampler.stride = (channel.path == vkglTF::AnimationChannel::PathType::ROTATION) ? 4 : 3;
+					sampler.inputs.resize(keyCount);
+					sampler.outputs.resize(keyCount * sampler.stride);
+					for (uint32_t k = 0; k < keyCount; k++) {
+						sampler.inputs[k] = k * keyInterval;
+						for (uint32_t i = 0; i < sampler.stride; i++) {
+							sampler.outputs[k * sampler.stride + i] = sinf(static_cast<float>(k + i + c));
+						}
+					}
+					animation.samplers.push_back(sampler);
+				}
+				model.animations.push_back(animation);
+				model.buildTransforms();
+
+				// Forward playback at 60 fps and random seeks
+				const uint32_t frameCount = 2000;
+				auto tStart = std::chrono::high_resolution_clock::now();
+				for (uint32_t f = 0; f < frameCount; f++) {
+					model.updateAnimation(0, fmodf(f / 60.0f, animation.end));
+				}
+				double tPlayback = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - tStart).count();
+				std::srand(0);
+				tStart = std::chrono::high_resolution_clock::now();
+				for (uint32_t f = 0; f < frameCount; f++) {
+					model.updateAnimation(0, animation.end * (static_cast<float>(std::rand()) / RAND_MAX));
+				}
+				double tSeek = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - tStart).count();
+				// Same playback with 16 bit quantized keys
+				for (auto& channel : model.animations[0].channels) {
+					model.animations[0].samplers[channel.samplerIndex].quantize(channel.path == vkglTF::AnimationChannel::PathType::ROTATION);
+				}
+				tStart = std::chrono::high_resolution_clock::now();
+				for (uint32_t f = 0; f < frameCount; f++) {
+					model.updateAnimation(0, fmodf(f / 60.0f, animation.end));
+				}
+				double tQuantized = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - tStart).count();
+				std::cout << channelCount << " channels x " << keyCount << " keys: playback " << tPlayback / (frameCount * channelCount) << ", seek " << tSeek / (frameCount * channelCount) << ", quantized playback " << tQuantized / (frameCount * channelCount) << std::endl;
+				model.destroy(device);
+			}
+		}
+
+		// Crowd of independently animated skinned characters, evaluated with different numbers of threads
+		const uint32_t characterCount = 256;
+		const uint32_t jointCount = 64;
+		const uint32_t keyCount = 300;
+		vkglTF::Model crowd;
+		vkglTF::Animation animation{};
+		animation.start = 0.0f;
+		animation.end = (keyCount - 1) * keyInterval;
+		for (uint32_t c = 0; c < characterCount; c++) {
+			vkglTF::Node* root = new vkglTF::Node{};
+			root->mesh = new vkglTF::Mesh(vulkanDevice, glm::mat4(1.0f));
+			root->skin = new vkglTF::Skin{};
+			crowd.skins.push_back(root->skin);
+			crowd.nodes.push_back(root);
+			vkglTF::Node* parent = root;
+			for (uint32_t j = 0; j < jointCount; j++) {
+				vkglTF::Node* joint = new vkglTF::Node{};
+				joint->parent = parent;
+				joint->translation = glm::vec3(0.0f, 0.1f, 0.0f);
+				parent->children.push_back(joint);
+				root->skin->joints.push_back(joint);
+				root->skin->inverseBindMatrices.push_back(glm::mat4(1.0f));
+				parent = joint;
+
+				vkglTF::AnimationChannel channel{};
+				channel.path = vkglTF::AnimationChannel::PathType::ROTATION;
+				channel.node = joint;
+				channel.samplerIndex = static_cast<uint32_t>(animation.samplers.size());
+				animation.channels.push_back(channel);
+
+				vkglTF::AnimationSampler sampler{};
+				sampler.interpolation = vkglTF::AnimationSampler::InterpolationType::LINEAR;
+				sampler.stride = 4;
+				for (uint32_t k = 0; k < keyCount; k++) {
+					glm::quat q = glm::angleAxis(0.2f * sinf(k * 0.1f + c + j), glm::vec3(0.0f, 0.0f, 1.0f));
+					sampler.inputs.push_back(k * keyInterval);
+					sampler.outputs.insert(sampler.outputs.end(), { q.x, q.y, q.z, q.w });
+				}
+				animation.samplers.push_back(sampler);
+			}
+		}
+		crowd.animations.push_back(animation);
+		crowd.jointPalette = &jointPalette;
+		crowd.buildTransforms();
+		crowd.allocateJointRanges();
+		std::cout << "Crowd animation benchmark (" << characterCount << " characters x " << jointCount << " joints, ms per frame)" << std::endl;
+		std::vector<glm::mat4> reference;
+		const uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+		for (uint32_t threads = 1; threads <= hardwareThreads; threads = (threads == hardwareThreads) ? threads + 1 : std::min(threads * 2, hardwareThreads)) {
+			// The calling thread takes part in the work, so the pool gets one thread less
+			std::unique_ptr<vks::ThreadPool> pool(threads > 1 ? new vks::ThreadPool(threads - 1) : nullptr);
+			crowd.threadPool = pool.get();
+			const uint32_t frameCount = 200;
+			auto tStart = std::chrono::high_resolution_clock::now();
+			for (uint32_t f = 0; f < frameCount; f++) {
+				crowd.updateAnimation(0, fmodf(f / 60.0f, animation.end));
+			}
+			double tFrames = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			// Output has to be identical for any number of threads
+			std::vector<glm::mat4> palettes;
+			for (auto node : crowd.nodes) {
+				const glm::mat4* jointMatrices = &jointPalette.matrices[node->mesh->uniformBlock.jointOffset];
+				palettes.insert(palettes.end(), jointMatrices, jointMatrices + jointCount);
+			}
+			if (reference.empty()) {
+				reference = palettes;
+			}
+			const bool identical = memcmp(reference.data(), palettes.data(), reference.size() * sizeof(glm::mat4)) == 0;
+			std::cout << threads << " threads: " << tFrames / frameCount << (identical ? "" : " (output differs from 1 thread)") << std::endl;
+		}
+		crowd.threadPool = nullptr;
+
+		// Same crowd with the animation LOD on one thread, characters are spread along x and the view only covers the first half of them at the reduced rate
+		for (size_t c = 0; c < crowd.nodes.size(); c++) {
+			crowd.nodes[c]->translation = glm::vec3(c * 2.0f, 0.0f, 0.0f);
+		}
+		crowd.updateTransforms(true);
+		crowd.buildAnimationLod();
+		crowd.animationLod.enabled = true;
+		crowd.animationLod.reducedScreenSize = 1.0f;
+		const glm::mat4 viewProjection = glm::ortho(-1.0f, static_cast<float>(characterCount), -1.0f, 8.0f, -10.0f, 10.0f);
+		const uint32_t frameCount = 200;
+		auto tStart = std::chrono::high_resolution_clock::now();
+		for (uint32_t f = 0; f < frameCount; f++) {
+			crowd.updateAnimationLod(viewProjection);
+			crowd.updateAnimation(0, fmodf(f / 60.0f, animation.end));
+		}
+		double tFrames = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		std::cout << "1 thread with animation LOD (" << crowd.animationLodStats.reducedSkins << " reduced, " << crowd.animationLodStats.culledSkins << " culled): " << tFrames / frameCount << std::endl;
+		crowd.destroy(device);
+	}
+
 	void loadAssets(bool use_usdz = true)
 	{
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
@@ -715,6 +926,87 @@ public:
 
 		std::string envMapFile = assetpath + "environments/papermill.ktx";
 		for (size_t i = 0; i < args.size(); i++) {
+			// Optional CPU block compression of png/jpg textures: --texture-compression fast|quality, --texture-cache <dir>
+			if ((std::string(args[i]) == "--texture-compression") && (i + 1 < args.size())) {
+				const std::string preset = args[++i];
+				if (preset == "fast") {
+					vks::TextureCompressor::settings.preset = vks::TextureCompressor::Preset::Fast;
+				} else if (preset == "quality") {
+					vks::TextureCompressor::settings.preset = vks::TextureCompressor::Preset::Quality;
+				} else {
+					std::cout << "unknown texture compression preset \"" << preset << "\"" << std::endl;
+				}
+				continue;
+			}
+			if ((std::string(args[i]) == "--texture-cache") && (i + 1 < args.size())) {
+				vks::TextureCompressor::settings.cacheDirectory = args[++i];
+				continue;
+			}
+			// Downscale png and jpg textures larger than this on load: --texture-max-size <pixels>
+			if ((std::string(args[i]) == "--texture-max-size") && (i + 1 < args.size())) {
+				vks::TextureCompressor::settings.maxSize = static_cast<uint32_t>(std::max(0, atoi(args[++i])));
+				continue;
+			}
+			// Skin animated meshes in a compute pre-pass instead of the vertex shader: --compute-skinning
+			if (std::string(args[i]) == "--compute-skinning") {
+				vks::ComputeSkinner::settings.enabled = true;
+				continue;
+			}
+			// Remove animation keys that interpolation reproduces within a tolerance on load: --animation-tolerance <value>
+			if ((std::string(args[i]) == "--animation-tolerance") && (i + 1 < args.size())) {
+				models.scene.animationCompression.tolerance = static_cast<float>(atof(args[++i]));
+				continue;
+			}
+			// Store animation keys as 16 bit values (smallest three quaternions for rotations): --quantize-animations
+			if (std::string(args[i]) == "--quantize-animations") {
+				models.scene.animationCompression.quantize = true;
+				continue;
+			}
+			// Skip joints of off-screen skinned meshes and update small ones at a reduced rate: --animation-lod
+			if (std::string(args[i]) == "--animation-lod") {
+				models.scene.animationLod.enabled = true;
+				continue;
+			}
+			// Fraction of the viewport below which skinned meshes use the reduced rate: --animation-lod-size <fraction>
+			if ((std::string(args[i]) == "--animation-lod-size") && (i + 1 < args.size())) {
+				models.scene.animationLod.reducedScreenSize = static_cast<float>(atof(args[++i]));
+				continue;
+			}
+			// Frames between updates of small skinned meshes: --animation-lod-interval <frames>
+			if ((std::string(args[i]) == "--animation-lod-interval") && (i + 1 < args.size())) {
+				models.scene.animationLod.reducedInterval = static_cast<uint32_t>(std::max(atoi(args[++i]), 1));
+				continue;
+			}
+			// Only evaluate joints up to this depth below the root joints of small skinned meshes: --animation-lod-depth <depth>
+			if ((std::string(args[i]) == "--animation-lod-depth") && (i + 1 < args.size())) {
+				models.scene.animationLod.reducedJointDepth = static_cast<uint32_t>(std::max(atoi(args[++i]), 0));
+				continue;
+			}
+			// Blend joints as dual quaternions, which avoids the volume loss of linear blending and halves the palette size: --dual-quaternion-skinning
+			if (std::string(args[i]) == "--dual-quaternion-skinning") {
+				vks::JointPalette::settings.dualQuaternions = true;
+				continue;
+			}
+			// Feedback based texture streaming with a device memory budget in MB: --texture-budget <MB>
+			if ((std::string(args[i]) == "--texture-budget") && (i + 1 < args.size())) {
+				vks::TextureStreamer::settings.budget = static_cast<VkDeviceSize>(std::max(0, atoi(args[++i]))) * 1024 * 1024;
+				continue;
+			}
+			// Only load textures used by the active scene, other glTF scenes can be selected in the UI: --lazy-loading
+			if (std::string(args[i]) == "--lazy-loading") {
+				models.scene.lazyLoading = true;
+				models.usdz_scene.lazyLoading = true;
+				continue;
+			}
+			if (std::string(args[i]) == "--benchmark-animation") {
+				benchmarkAnimation();
+				continue;
+			}
+			// Only convert and upload this USD prim subtree (can be repeated), other prims can be loaded from the UI: --usd-prim <path>
+			if ((std::string(args[i]) == "--usd-prim") && (i + 1 < args.size())) {
+				models.usdz_scene.primPaths.push_back(args[++i]);
+				continue;
+			}
       if ((std::string(args[i]).find(".usd") != std::string::npos) || (std::string(args[i]).find(".usda") != std::string::npos) ||
           (std::string(args[i]).find(".usdc") != std::string::npos) || (std::string(args[i]).find(".usdz") != std::string::npos)) {
         std::ifstream file(args[i]);
@@ -762,17 +1054,20 @@ public:
 			descriptorSetAllocInfo.descriptorPool = descriptorPool;
 			descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayouts.node;
 			descriptorSetAllocInfo.descriptorSetCount = 1;
-			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &node->mesh->uniformBuffer.descriptorSet));
+			// One set per frame in flight, each references that frame's copy of the uniform block
+			for (size_t i = 0; i < node->mesh->uniformBuffer.descriptorSets.size(); i++) {
+				VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &node->mesh->uniformBuffer.descriptorSets[i]));
 
-			VkWriteDescriptorSet writeDescriptorSet{};
-			writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			writeDescriptorSet.descriptorCount = 1;
-			writeDescriptorSet.dstSet = node->mesh->uniformBuffer.descriptorSet;
-			writeDescriptorSet.dstBinding = 0;
-			writeDescriptorSet.pBufferInfo = &node->mesh->uniformBuffer.descriptor;
+				VkWriteDescriptorSet writeDescriptorSet{};
+				writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+				writeDescriptorSet.descriptorCount = 1;
+				writeDescriptorSet.dstSet = node->mesh->uniformBuffer.descriptorSets[i];
+				writeDescriptorSet.dstBinding = 0;
+				writeDescriptorSet.pBufferInfo = &node->mesh->uniformBuffer.descriptors[i];
 
-			vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+				vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+			}
 		}
 		for (auto& child : node->children) {
 			setupNodeDescriptorSet(child);
@@ -786,25 +1081,102 @@ public:
 			descriptorSetAllocInfo.descriptorPool = descriptorPool;
 			descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayouts.node;
 			descriptorSetAllocInfo.descriptorSetCount = 1;
-			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &node->mesh->uniformBuffer.descriptorSet));
+			// One set per frame in flight, each references that frame's copy of the uniform block
+			for (size_t i = 0; i < node->mesh->uniformBuffer.descriptorSets.size(); i++) {
+				VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &node->mesh->uniformBuffer.descriptorSets[i]));
 
-			VkWriteDescriptorSet writeDescriptorSet{};
-			writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			writeDescriptorSet.descriptorCount = 1;
-			writeDescriptorSet.dstSet = node->mesh->uniformBuffer.descriptorSet;
-			writeDescriptorSet.dstBinding = 0;
-			writeDescriptorSet.pBufferInfo = &node->mesh->uniformBuffer.descriptor;
+				VkWriteDescriptorSet writeDescriptorSet{};
+				writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+				writeDescriptorSet.descriptorCount = 1;
+				writeDescriptorSet.dstSet = node->mesh->uniformBuffer.descriptorSets[i];
+				writeDescriptorSet.dstBinding = 0;
+				writeDescriptorSet.pBufferInfo = &node->mesh->uniformBuffer.descriptors[i];
 
-			vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+				vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+			}
 		}
 		for (auto& child : node->children) {
 			setupNodeDescriptorSetUSDZ(child);
 		}
 	}
 
+	// glTF packs metallic with roughness, USD materials may reference a separate metallic texture
+	static vkglTF::Texture *getMetallicTexture(const vkglTF::Material &material) { return material.metallicRoughnessTexture; }
+	static vkUSDZ::Texture *getMetallicTexture(const vkUSDZ::Material &material) { return material.metallicTexture; }
+
+	// Texture streaming feedback slots of the textures bound by updateMaterialDescriptorSet (-1 for textures that aren't streamed)
+	template <typename MaterialT>
+	void setTextureFeedbackSlots(const MaterialT &material, ShaderMaterial &shaderMaterial)
+	{
+		auto slot = [](const auto *texture) { return texture ? texture->streamSlot : -1; };
+		const bool specularGlossiness = !material.pbrWorkflows.metallicRoughness && material.pbrWorkflows.specularGlossiness;
+		shaderMaterial.baseColorTextureFeedback = specularGlossiness ? slot(material.extension.diffuseTexture) : slot(material.baseColorTexture);
+		shaderMaterial.physicalDescriptorTextureFeedback = specularGlossiness ? slot(material.extension.specularGlossinessTexture) : slot(material.metallicRoughnessTexture);
+		shaderMaterial.normalTextureFeedback = slot(material.normalTexture);
+		shaderMaterial.occlusionTextureFeedback = slot(material.occlusionTexture);
+		shaderMaterial.emissiveTextureFeedback = slot(material.emissiveTexture);
+		// A metallic texture shared with roughness (glTF) already gets its feedback from the physical descriptor map
+		const auto *metallicTexture = specularGlossiness ? nullptr : getMetallicTexture(material);
+		shaderMaterial.metallicTextureFeedback = (metallicTexture != material.metallicRoughnessTexture) ? slot(metallicTexture) : -1;
+	}
+
+	// Writes the material's textures to its descriptor set, vkglTF and vkUSDZ materials share the same layout
+	template <typename MaterialT>
+	void updateMaterialDescriptorSet(MaterialT &material)
+	{
+		std::vector<VkDescriptorImageInfo> imageDescriptors = {
+			textures.empty.descriptor,
+			textures.empty.descriptor,
+			material.normalTexture ? material.normalTexture->descriptor : textures.empty.descriptor,
+			material.occlusionTexture ? material.occlusionTexture->descriptor : textures.empty.descriptor,
+			material.emissiveTexture ? material.emissiveTexture->descriptor : textures.empty.descriptor,
+			textures.empty.descriptor
+		};
+
+		if (material.pbrWorkflows.metallicRoughness) {
+			if (material.baseColorTexture) {
+				imageDescriptors[0] = material.baseColorTexture->descriptor;
+			}
+			if (material.metallicRoughnessTexture) {
+				imageDescriptors[1] = material.metallicRoughnessTexture->descriptor;
+			}
+			if (getMetallicTexture(material)) {
+				imageDescriptors[5] = getMetallicTexture(material)->descriptor;
+			}
+		} else {
+			if (material.pbrWorkflows.specularGlossiness) {
+				if (material.extension.diffuseTexture) {
+					imageDescriptors[0] = material.extension.diffuseTexture->descriptor;
+				}
+				if (material.extension.specularGlossinessTexture) {
+					imageDescriptors[1] = material.extension.specularGlossinessTexture->descriptor;
+				}
+			}
+		}
+
+		std::array<VkWriteDescriptorSet, 6> writeDescriptorSets{};
+		for (size_t i = 0; i < imageDescriptors.size(); i++) {
+			writeDescriptorSets[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writeDescriptorSets[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			writeDescriptorSets[i].descriptorCount = 1;
+			writeDescriptorSets[i].dstSet = material.descriptorSet;
+			writeDescriptorSets[i].dstBinding = static_cast<uint32_t>(i);
+			writeDescriptorSets[i].pImageInfo = &imageDescriptors[i];
+		}
+
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+	}
+
 	void setupDescriptors()
 	{
+		// The loaded scene may need more joint matrices than the palette's buffers can hold
+		jointPalette.allocateBuffers();
+		if (!models.use_usdz && (computeSkinner.isAvailable() || computeSkinner.isMorphAvailable())) {
+			const std::vector<vks::ComputeSkinner::Job> jobs = models.scene.prepareComputeDeformation(computeSkinner.isAvailable(), computeSkinner.isMorphAvailable());
+			computeSkinner.setSource(models.scene.vertices.buffer, sizeof(vkglTF::Model::Vertex), jobs, models.scene.morphTargets);
+		}
+
 		/*
 			Descriptor Pool
 		*/
@@ -822,7 +1194,7 @@ public:
 
 		for (auto &model : modellist) {
 			for (auto &material : model->materials) {
-				imageSamplerCount += 5;
+				imageSamplerCount += 6;
 				materialCount++;
 			}
 			for (auto node : model->linearNodes) {
@@ -838,7 +1210,7 @@ public:
 		}
 		for (auto &model : usdz_modellist) {
 			for (auto &material : model->materials) {
-				imageSamplerCount += 5;
+				imageSamplerCount += 6;
 				materialCount++;
 			}
 			for (auto node : model->linearNodes) {
@@ -851,8 +1223,8 @@ public:
 		std::vector<VkDescriptorPoolSize> poolSizes = {
 			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, (4 + meshCount) * swapChain.imageCount },
 			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageSamplerCount * swapChain.imageCount },
-			// One SSBO for the shader material buffer
-			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 } 
+			// One SSBO for the shader material buffer, one texture streaming feedback buffer and one joint palette per frame
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 + 2 * swapChain.imageCount } 
 		};
 		VkDescriptorPoolCreateInfo descriptorPoolCI{};
 		descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -873,6 +1245,8 @@ public:
 				{ 2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr },
 				{ 3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr },
 				{ 4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr },
+				{ 5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr },
+				{ 6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr },
 			};
 			VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI{};
 			descriptorSetLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -889,7 +1263,7 @@ public:
 				descriptorSetAllocInfo.descriptorSetCount = 1;
 				VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &descriptorSets[i].scene));
 
-				std::array<VkWriteDescriptorSet, 5> writeDescriptorSets{};
+				std::array<VkWriteDescriptorSet, 7> writeDescriptorSets{};
 
 				writeDescriptorSets[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 				writeDescriptorSets[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
@@ -926,6 +1300,20 @@ public:
 				writeDescriptorSets[4].dstBinding = 4;
 				writeDescriptorSets[4].pImageInfo = &textures.lutBrdf.descriptor;
 
+				writeDescriptorSets[5].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				writeDescriptorSets[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				writeDescriptorSets[5].descriptorCount = 1;
+				writeDescriptorSets[5].dstSet = descriptorSets[i].scene;
+				writeDescriptorSets[5].dstBinding = 5;
+				writeDescriptorSets[5].pBufferInfo = textureStreamer.getFeedbackDescriptor(i);
+
+				writeDescriptorSets[6].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				writeDescriptorSets[6].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				writeDescriptorSets[6].descriptorCount = 1;
+				writeDescriptorSets[6].dstSet = descriptorSets[i].scene;
+				writeDescriptorSets[6].dstBinding = 6;
+				writeDescriptorSets[6].pBufferInfo = jointPalette.getDescriptor(i);
+
 				vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 			}
 		}
@@ -938,6 +1326,7 @@ public:
 				{ 2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr },
 				{ 3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr },
 				{ 4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr },
+				{ 5, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr },
 			};
 			VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI{};
 			descriptorSetLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -954,45 +1343,7 @@ public:
           descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayouts.material;
           descriptorSetAllocInfo.descriptorSetCount = 1;
           VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &material.descriptorSet));
-
-          std::vector<VkDescriptorImageInfo> imageDescriptors = {
-            textures.empty.descriptor,
-            textures.empty.descriptor,
-            material.normalTexture ? material.normalTexture->descriptor : textures.empty.descriptor,
-            material.occlusionTexture ? material.occlusionTexture->descriptor : textures.empty.descriptor,
-            material.emissiveTexture ? material.emissiveTexture->descriptor : textures.empty.descriptor
-          };
-
-          if (material.pbrWorkflows.metallicRoughness) {
-            if (material.baseColorTexture) {
-              imageDescriptors[0] = material.baseColorTexture->descriptor;
-            }
-            if (material.metallicRoughnessTexture) {
-              imageDescriptors[1] = material.metallicRoughnessTexture->descriptor;
-            }
-          } else {
-            if (material.pbrWorkflows.specularGlossiness) {
-              if (material.extension.diffuseTexture) {
-                imageDescriptors[0] = material.extension.diffuseTexture->descriptor;
-              }
-              if (material.extension.specularGlossinessTexture) {
-                imageDescriptors[1] = material.extension.specularGlossinessTexture->descriptor;
-              }
-            }
-          }
-
-          std::array<VkWriteDescriptorSet, 5> writeDescriptorSets{};
-          for (size_t i = 0; i < imageDescriptors.size(); i++) {
-            writeDescriptorSets[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            writeDescriptorSets[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            writeDescriptorSets[i].descriptorCount = 1;
-            writeDescriptorSets[i].dstSet = material.descriptorSet;
-            writeDescriptorSets[i].dstBinding = static_cast<uint32_t>(i);
-            writeDescriptorSets[i].pImageInfo = &imageDescriptors[i];
-          }
-
-          vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
-
+          updateMaterialDescriptorSet(material);
         }
 			} else {
         for (auto &material : models.scene.materials) {
@@ -1002,46 +1353,7 @@ public:
           descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayouts.material;
           descriptorSetAllocInfo.descriptorSetCount = 1;
           VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &material.descriptorSet));
-
-          std::vector<VkDescriptorImageInfo> imageDescriptors = {
-            textures.empty.descriptor,
-            textures.empty.descriptor,
-            material.normalTexture ? material.normalTexture->descriptor : textures.empty.descriptor,
-            material.occlusionTexture ? material.occlusionTexture->descriptor : textures.empty.descriptor,
-            material.emissiveTexture ? material.emissiveTexture->descriptor : textures.empty.descriptor
-          };
-
-          if (material.pbrWorkflows.metallicRoughness) {
-            if (material.baseColorTexture) {
-              imageDescriptors[0] = material.baseColorTexture->descriptor;
-            }
-            if (material.metallicRoughnessTexture) {
-              imageDescriptors[1] = material.metallicRoughnessTexture->descriptor;
-            }
-          } else {
-            if (material.pbrWorkflows.specularGlossiness) {
-              if (material.extension.diffuseTexture) {
-                imageDescriptors[0] = material.extension.diffuseTexture->descriptor;
-              }
-              if (material.extension.specularGlossinessTexture) {
-                imageDescriptors[1] = material.extension.specularGlossinessTexture->descriptor;
-              }
-            }
-          }
-
-          std::array<VkWriteDescriptorSet, 5> writeDescriptorSets{};
-          for (size_t i = 0; i < imageDescriptors.size(); i++) {
-            writeDescriptorSets[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            writeDescriptorSets[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            writeDescriptorSets[i].descriptorCount = 1;
-            writeDescriptorSets[i].dstSet = material.descriptorSet;
-            writeDescriptorSets[i].dstBinding = static_cast<uint32_t>(i);
-            writeDescriptorSets[i].pImageInfo = &imageDescriptors[i];
-          }
-
-          vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
-
-
+          updateMaterialDescriptorSet(material);
         }
 			}
 
@@ -1240,6 +1552,17 @@ public:
 		shaderStages[0] = loadShader(device, vertexShader, VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(device, fragmentShader, VK_SHADER_STAGE_FRAGMENT_BIT);
 
+		// Joint layout of the palette used for vertex shader skinning
+		VkBool32 dualQuaternionSkinning = vks::JointPalette::settings.dualQuaternions;
+		VkSpecializationMapEntry vertexSpecializationEntry{ 0, 0, sizeof(VkBool32) };
+		VkSpecializationInfo vertexSpecializationInfo{ 1, &vertexSpecializationEntry, sizeof(VkBool32), &dualQuaternionSkinning };
+		shaderStages[0].pSpecializationInfo = &vertexSpecializationInfo;
+		// Texture streaming feedback is only written if fragment shaders may write to storage buffers
+		VkBool32 textureFeedback = vulkanDevice->enabledFeatures.fragmentStoresAndAtomics;
+		VkSpecializationMapEntry fragmentSpecializationEntry{ 0, 0, sizeof(VkBool32) };
+		VkSpecializationInfo fragmentSpecializationInfo{ 1, &fragmentSpecializationEntry, sizeof(VkBool32), &textureFeedback };
+		shaderStages[1].pSpecializationInfo = &fragmentSpecializationInfo;
+
 		VkPipeline pipeline{};
 		// Default pipeline with back-face culling
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
@@ -2204,8 +2527,27 @@ public:
 			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, commandBuffers.data()));
 		}
 
+		// Mip chains of textures loaded from png and jpg files are generated with compute shaders
+		mipGenerator.prepare(vulkanDevice, queue, assetpath + "shaders/");
+		models.scene.mipGenerator = &mipGenerator;
+		models.usdz_scene.mipGenerator = &mipGenerator;
+		models.skybox.mipGenerator = &mipGenerator;
+		// The feedback buffers are referenced by the material shaders, so the streamer is also prepared if streaming is disabled
+		textureStreamer.prepare(vulkanDevice, queue, static_cast<uint32_t>(descriptorSets.size()));
+		models.scene.textureStreamer = &textureStreamer;
+		models.usdz_scene.textureStreamer = &textureStreamer;
+		models.scene.threadPool = &vks::ThreadPool::shared();
+		// Meshes keep a copy of their uniform block per frame in flight, as animation updates are written while other frames are still in flight
+		models.scene.frameCount = renderAhead;
+		models.usdz_scene.frameCount = renderAhead;
+		// Joint matrices of all skinned meshes are passed to the vertex shader in one storage buffer per frame
+		jointPalette.prepare(vulkanDevice, static_cast<uint32_t>(descriptorSets.size()));
+		models.scene.jointPalette = &jointPalette;
+		models.usdz_scene.jointPalette = &jointPalette;
+
 		bool use_usdz = true; // HACK
 		loadAssets(use_usdz);
+		computeSkinner.prepare(vulkanDevice, queue, assetpath + "shaders/", &jointPalette, static_cast<uint32_t>(descriptorSets.size()));
 		generateBRDFLUT();
 		prepareUniformBuffers();
 		setupDescriptors();
@@ -2294,6 +2636,28 @@ public:
 				}
 			}
 #endif
+			if (!models.use_usdz && models.scene.gltfSource && (models.scene.sceneNames.size() > 1)) {
+				int32_t sceneIndex = models.scene.activeScene;
+				if (ui->combo("Scene##gltfscene", &sceneIndex, models.scene.sceneNames)) {
+					vkDeviceWaitIdle(device);
+					models.scene.loadScene(static_cast<uint32_t>(sceneIndex), queue);
+					animationIndex = 0;
+					animationTimer = 0.0f;
+					createMaterialBuffer();
+					setupDescriptors();
+					resetCamera();
+				}
+			}
+			if (models.use_usdz && !models.usdz_scene.deferredPrimPaths.empty()) {
+				ui->combo("Deferred prims", &deferredPrimIndex, models.usdz_scene.deferredPrimPaths);
+				if (ui->button("Load prim")) {
+					vkDeviceWaitIdle(device);
+					models.usdz_scene.loadPrims({ models.usdz_scene.deferredPrimPaths[std::min<size_t>(deferredPrimIndex, models.usdz_scene.deferredPrimPaths.size() - 1)] }, queue);
+					deferredPrimIndex = 0;
+					createMaterialBufferUSDZ();
+					setupDescriptors();
+				}
+			}
 			if (ui->combo("Environment##env", selectedEnvironment, environments)) {
 				vkDeviceWaitIdle(device);
 				loadEnvironment(environments[selectedEnvironment]);
@@ -2317,6 +2681,11 @@ public:
 			}
 		}
 
+		if (vks::TextureStreamer::enabled() && ui->header("Texture streaming")) {
+			ui->text("%u textures", textureStreamer.getTextureCount());
+			ui->text("%.1f / %.1f MB resident", textureStreamer.getResidentSize() / (1024.0 * 1024.0), vks::TextureStreamer::settings.budget / (1024.0 * 1024.0));
+		}
+
 		if (ui->header("Debug view")) {
 			const std::vector<std::string> debugNamesInputs = {
 				"none", "Base color", "Normal", "Occlusion", "Emissive", "Metallic", "Roughness"
@@ -2352,6 +2721,13 @@ public:
             animationNames.push_back(animation.name);
           }
           ui->combo("Animation", &animationIndex, animationNames);
+          if (!models.scene.skins.empty()) {
+            ui->checkbox("Animation LOD", &models.scene.animationLod.enabled);
+            if (models.scene.animationLod.enabled) {
+              ui->text("%u full, %u reduced, %u culled skins", models.scene.animationLodStats.fullSkins, models.scene.animationLodStats.reducedSkins, models.scene.animationLodStats.culledSkins);
+              ui->text("%u channels skipped", models.scene.animationLodStats.skippedChannels);
+            }
+          }
         }
       }
 		}
@@ -2429,6 +2805,37 @@ public:
 			VK_CHECK_RESULT(acquire);
 		}
 		
+		// The feedback of this frame's previous use is complete now, the streamer adjusts texture residency based on it
+		textureStreamer.update(currentFrame);
+
+		// KTX2 mip levels that finished transcoding in the background and streamed textures replace the textures' image views
+		if (!models.use_usdz && models.scene.updateTextureStreaming(queue)) {
+			for (auto &material : models.scene.materials) {
+				updateMaterialDescriptorSet(material);
+			}
+		}
+		if (models.use_usdz && models.usdz_scene.updateTextureStreaming()) {
+			for (auto &material : models.usdz_scene.materials) {
+				updateMaterialDescriptorSet(material);
+			}
+		}
+
+		// Animations and joint matrices are evaluated on their own thread (helped by the shared pool if it is idle) while this frame's command buffer is recorded
+		// It starts after the UI update and a possible window resize (which updates the UI again), as both can reload the scene, and no node is used for recording the command buffer
+		std::future<void> animationUpdate;
+		const size_t animationCount = models.use_usdz ? models.usdz_scene.animations.size() : models.scene.animations.size();
+		if (!paused && animate && (animationCount > 0)) {
+			const uint32_t index = animationIndex;
+			const float time = animationTimer;
+			if (models.use_usdz) {
+				animationUpdate = animationThread.async([this, index, time]() { models.usdz_scene.updateAnimation(index, time); });
+			} else {
+				// Skins are classified with the matrices of the last frame, before the update starts using the result
+				models.scene.updateAnimationLod(camera.matrices.perspective * camera.matrices.view * shaderValuesScene.model);
+				animationUpdate = animationThread.async([this, index, time]() { models.scene.updateAnimation(index, time); });
+			}
+		}
+
 		if (models.use_usdz) {
       recordCommandBufferUSDZ();
 		}
@@ -2436,6 +2843,21 @@ public:
       recordCommandBuffer();
 		}
 
+		// Matrices of animated meshes have to be written before the frame is submitted
+		if (animationUpdate.valid()) {
+			animationUpdate.get();
+		}
+		if (models.use_usdz) {
+			models.usdz_scene.updateUniformBuffers(currentFrame);
+		} else {
+			models.scene.updateUniformBuffers(currentFrame);
+		}
+		// Only joint ranges that changed since this frame's buffer was last used are copied
+		jointPalette.update(currentFrame);
+		if (!models.use_usdz) {
+			computeSkinner.updateWeights(currentFrame, models.scene.morphTargets.weights);
+		}
+
 		// Update UBOs
 		updateUniformBuffers();
 		UniformBufferSet currentUB = uniformBuffers[currentFrame];
@@ -2470,12 +2892,12 @@ public:
 		currentFrame %= renderAhead;
 
 		if (!paused) {
-			if ((animate) && (models.scene.animations.size() > 0)) {
+			if ((animate) && (animationCount > 0)) {
+				const float end = models.use_usdz ? models.usdz_scene.animations[animationIndex].end : models.scene.animations[animationIndex].end;
 				animationTimer += frameTimer;
-				if (animationTimer > models.scene.animations[animationIndex].end) {
-					animationTimer -= models.scene.animations[animationIndex].end;
+				if (animationTimer > end) {
+					animationTimer -= end;
 				}
-				models.scene.updateAnimation(animationIndex, animationTimer);
 			}
 			updateParams();
 		}